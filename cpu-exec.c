@@ -101,14 +101,18 @@ static void cpu_exec_nocache(CPUArchState *env, int max_cycles,
     if (max_cycles > CF_COUNT_MASK)
         max_cycles = CF_COUNT_MASK;
 
+    spin_lock(&tb_ctx.tb_lock);
     tb = tb_gen_code(cpu, orig_tb->pc, orig_tb->cs_base, orig_tb->flags,
                      max_cycles);
+    spin_unlock(&tb_ctx.tb_lock);
     cpu->current_tb = tb;
     /* execute the generated code */
     cpu_tb_exec(cpu, tb->tc_ptr);
     cpu->current_tb = NULL;
+    spin_lock(&tb_ctx.tb_lock);
     tb_phys_invalidate(tb, -1);
     tb_free(tb);
+    spin_unlock(&tb_ctx.tb_lock);
 }
 
 static TranslationBlock *tb_find_slow(CPUArchState *env,
@@ -122,13 +126,13 @@ static TranslationBlock *tb_find_slow(CPUArchState *env,
     tb_page_addr_t phys_pc, phys_page1;
     target_ulong virt_page2;
 
-    tcg_ctx.tb_ctx.tb_invalidated_flag = 0;
+    tb_ctx.tb_invalidated_flag = 0;
 
     /* find translated block using physical mappings */
     phys_pc = get_page_addr_code(env, pc);
     phys_page1 = phys_pc & TARGET_PAGE_MASK;
     h = tb_phys_hash_func(phys_pc);
-    ptb1 = &tcg_ctx.tb_ctx.tb_phys_hash[h];
+    ptb1 = &tb_ctx.tb_phys_hash[h];
     for(;;) {
         tb = *ptb1;
         if (!tb)
@@ -155,20 +159,30 @@ static TranslationBlock *tb_find_slow(CPUArchState *env,
  not_found:
    /* if no translated code available, then translate it now */
     tb = tb_gen_code(cpu, pc, cs_base, flags, 0);
+    /* tb_lock was dropped while translating, so ptb1 may be stale; the
+       new TB is at the head of its hash chain anyway.  */
+    goto add_jmp_cache;
 
  found:
     /* Move the last found TB to the head of the list */
     if (likely(*ptb1)) {
         *ptb1 = tb->phys_hash_next;
-        tb->phys_hash_next = tcg_ctx.tb_ctx.tb_phys_hash[h];
-        tcg_ctx.tb_ctx.tb_phys_hash[h] = tb;
+        tb->phys_hash_next = tb_ctx.tb_phys_hash[h];
+        tb_ctx.tb_phys_hash[h] = tb;
     }
+ add_jmp_cache:
     /* we add the TB in the virtual pc hash table */
     cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)] = tb;
     return tb;
 }
 
-static inline TranslationBlock *tb_find_fast(CPUArchState *env)
+/* The virtual PC cache is private to the CPU, so a hit needs no lock
+ * and threads of a user-mode guest running translated code do not
+ * contend with each other.  On a miss take tb_lock for the physical
+ * hash table and translation, and tell the caller it is held.
+ */
+static inline TranslationBlock *tb_find_fast(CPUArchState *env,
+                                             volatile bool *have_tb_lock)
 {
     CPUState *cpu = ENV_GET_CPU(env);
     TranslationBlock *tb;
@@ -179,14 +193,37 @@ static inline TranslationBlock *tb_find_fast(CPUArchState *env)
        always be the same before a given translated block
        is executed. */
     cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
-    tb = cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)];
+    tb = atomic_read(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)]);
+    smp_read_barrier_depends();
     if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
                  tb->flags != flags)) {
+        spin_lock(&tb_ctx.tb_lock);
+        *have_tb_lock = true;
         tb = tb_find_slow(env, pc, cs_base, flags);
     }
     return tb;
 }
 
+/* Find the host code for the current CPU state in the virtual PC cache,
+ * for generated code that jumps there directly with goto_ptr.  On a miss
+ * return the epilogue, which exits to the main loop without chaining.
+ */
+void *tb_lookup_tc_ptr(CPUArchState *env)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+    TranslationBlock *tb;
+    target_ulong cs_base, pc;
+    int flags;
+
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+    tb = cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)];
+    if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
+                 tb->flags != flags)) {
+        return tcg_ctx.code_gen_epilogue;
+    }
+    return tb->tc_ptr;
+}
+
 static CPUDebugExcpHandler *debug_excp_handler;
 
 void cpu_set_debug_excp_handler(CPUDebugExcpHandler *handler)
@@ -601,17 +638,23 @@ int cpu_exec(CPUArchState *env)
                     cpu->exception_index = EXCP_INTERRUPT;
                     cpu_loop_exit(cpu);
                 }
-                spin_lock(&tcg_ctx.tb_ctx.tb_lock);
-                have_tb_lock = true;
-                tb = tb_find_fast(env);
+                tb = tb_find_fast(env, &have_tb_lock);
+                /* Chaining needs tb_lock even after a lockless hit, so
+                   that the test below sees a TB that another thread has
+                   invalidated or flushed since the lookup. */
+                if (next_tb != 0 && tb->page_addr[1] == -1 &&
+                    !have_tb_lock) {
+                    spin_lock(&tb_ctx.tb_lock);
+                    have_tb_lock = true;
+                }
                 /* Note: we do it here to avoid a gcc bug on Mac OS X when
                    doing it in tb_find_slow */
-                if (tcg_ctx.tb_ctx.tb_invalidated_flag) {
+                if (have_tb_lock && tb_ctx.tb_invalidated_flag) {
                     /* as some TB could have been invalidated because
                        of memory exceptions while generating the code, we
                        must recompute the hash index here */
                     next_tb = 0;
-                    tcg_ctx.tb_ctx.tb_invalidated_flag = 0;
+                    tb_ctx.tb_invalidated_flag = 0;
                 }
                 if (qemu_loglevel_mask(CPU_LOG_EXEC)) {
                     qemu_log("Trace %p [" TARGET_FMT_lx "] %s\n",
@@ -621,11 +664,24 @@ int cpu_exec(CPUArchState *env)
                    spans two pages, we cannot safely do a direct
                    jump. */
                 if (next_tb != 0 && tb->page_addr[1] == -1) {
-                    tb_add_jump((TranslationBlock *)(next_tb & ~TB_EXIT_MASK),
-                                next_tb & TB_EXIT_MASK, tb);
+                    TranslationBlock *prev_tb =
+                        (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
+                    int n = next_tb & TB_EXIT_MASK;
+
+#if !defined(CONFIG_USER_ONLY)
+                    /* jumps to another page are checked against the TLB */
+                    if ((prev_tb->pc ^ tb->pc) & TARGET_PAGE_MASK) {
+                        tb_add_cross_page_jump(env, prev_tb, n, tb);
+                    } else
+#endif
+                    {
+                        tb_add_jump(prev_tb, n, tb);
+                    }
+                }
+                if (have_tb_lock) {
+                    have_tb_lock = false;
+                    spin_unlock(&tb_ctx.tb_lock);
                 }
-                have_tb_lock = false;
-                spin_unlock(&tcg_ctx.tb_ctx.tb_lock);
 
                 /* cpu_interrupt might be called while translating the
                    TB, but before it is linked into a potentially
@@ -696,8 +752,12 @@ int cpu_exec(CPUArchState *env)
 #ifdef TARGET_I386
             x86_cpu = X86_CPU(cpu);
 #endif
+            if (tb_gen_code_abort()) {
+                /* tb_gen_code() does not hold tb_lock while translating */
+                have_tb_lock = false;
+            }
             if (have_tb_lock) {
-                spin_unlock(&tcg_ctx.tb_ctx.tb_lock);
+                spin_unlock(&tb_ctx.tb_lock);
                 have_tb_lock = false;
             }
         }
@@ -45,6 +45,10 @@ these four paragraphs for those parts of this code that are retained.
 /* We only need stdlib for abort() */
 #include <stdlib.h>
 
+/* Host arithmetic for the fast path */
+#include <math.h>
+#include <float.h>
+
 /*----------------------------------------------------------------------------
 | Primitive arithmetic functions, including multi-word arithmetic, and
 | division and square root approximations.  (Can be specialized to target if
@@ -1862,6 +1866,69 @@ float32 float32_round_to_int( float32 a STATUS_PARAM)
 
 }
 
+/*----------------------------------------------------------------------------
+| Host floating-point fast path.  When rounding to nearest-even with the
+| inexact flag already raised, the only flags an operation on zero or normal
+| inputs can add are invalid, divide-by-zero, overflow and underflow.  Those
+| show up as a NaN, infinite or tiny result, so the common case is computed
+| with the host FPU and anything that looks special is redone in softfloat,
+| which also takes care of target-specific NaN, tininess and flush-to-zero
+| behaviour.  Targets that clear the flags before every operation never take
+| the fast path; PowerPC additionally needs the inexact flag of each result.
+| Hosts that evaluate in extended precision would double-round doubles.
+*----------------------------------------------------------------------------*/
+
+#if defined(TARGET_PPC) || defined(__FAST_MATH__) || \
+    (defined(__i386__) && !defined(__SSE2_MATH__))
+#define USE_HARDFLOAT 0
+#else
+#define USE_HARDFLOAT 1
+#endif
+
+typedef union {
+    float32 s;
+    float h;
+} float32_host;
+
+typedef union {
+    float64 s;
+    double h;
+} float64_host;
+
+INLINE flag hardfloat_enabled(float_status *status)
+{
+    return USE_HARDFLOAT &&
+           STATUS(float_rounding_mode) == float_round_nearest_even &&
+           (STATUS(float_exception_flags) & float_flag_inexact);
+}
+
+INLINE flag float32_is_zero_or_normal(float32 a)
+{
+    int_fast16_t aExp = extractFloat32Exp(a);
+
+    return aExp ? aExp != 0xff : extractFloat32Frac(a) == 0;
+}
+
+INLINE flag float64_is_zero_or_normal(float64 a)
+{
+    int_fast16_t aExp = extractFloat64Exp(a);
+
+    return aExp ? aExp != 0x7ff : extractFloat64Frac(a) == 0;
+}
+
+/* Results that are finite and above the smallest normal are exact up to
+ * rounding, which the inexact flag already covers.
+ */
+INLINE flag float32_host_result_ok(float r)
+{
+    return isfinite(r) && fabsf(r) > FLT_MIN;
+}
+
+INLINE flag float64_host_result_ok(double r)
+{
+    return isfinite(r) && fabs(r) > DBL_MIN;
+}
+
 /*----------------------------------------------------------------------------
 | Returns the result of adding the absolute values of the single-precision
 | floating-point values `a' and `b'.  If `zSign' is 1, the sum is negated
@@ -2025,6 +2092,17 @@ static float32 subFloat32Sigs( float32 a, float32 b, flag zSign STATUS_PARAM)
 float32 float32_add( float32 a, float32 b STATUS_PARAM )
 {
     flag aSign, bSign;
+
+    if (hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float32_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h + ub.h;
+        if (float32_host_result_ok(ur.h) || ur.h == 0) {
+            return ur.s;
+        }
+    }
+
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -2048,6 +2126,17 @@ float32 float32_add( float32 a, float32 b STATUS_PARAM )
 float32 float32_sub( float32 a, float32 b STATUS_PARAM )
 {
     flag aSign, bSign;
+
+    if (hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float32_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h - ub.h;
+        if (float32_host_result_ok(ur.h) || ur.h == 0) {
+            return ur.s;
+        }
+    }
+
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -2076,6 +2165,16 @@ float32 float32_mul( float32 a, float32 b STATUS_PARAM )
     uint64_t zSig64;
     uint32_t zSig;
 
+    if (hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float32_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h * ub.h;
+        if (float32_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -2136,6 +2235,17 @@ float32 float32_div( float32 a, float32 b STATUS_PARAM )
     flag aSign, bSign, zSign;
     int_fast16_t aExp, bExp, zExp;
     uint32_t aSig, bSig, zSig;
+
+    if (hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        float32_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h / ub.h;
+        if (float32_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
 
@@ -2312,6 +2422,28 @@ float32 float32_muladd(float32 a, float32 b, float32 c, int flags STATUS_PARAM)
     int shiftcount;
     flag signflip, infzero;
 
+#ifdef FP_FAST_FMAF
+    if (!(flags & float_muladd_halve_result) && hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b) &&
+        float32_is_zero_or_normal(c)) {
+        float32_host ua = { .s = a }, ub = { .s = b }, uc = { .s = c }, ur;
+
+        if (flags & float_muladd_negate_product) {
+            ua.h = -ua.h;
+        }
+        if (flags & float_muladd_negate_c) {
+            uc.h = -uc.h;
+        }
+        ur.h = fmaf(ua.h, ub.h, uc.h);
+        if (flags & float_muladd_negate_result) {
+            ur.h = -ur.h;
+        }
+        if (float32_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+#endif
+
     a = float32_squash_input_denormal(a STATUS_VAR);
     b = float32_squash_input_denormal(b STATUS_VAR);
     c = float32_squash_input_denormal(c STATUS_VAR);
@@ -2527,6 +2659,17 @@ float32 float32_sqrt( float32 a STATUS_PARAM )
     int_fast16_t aExp, zExp;
     uint32_t aSig, zSig;
     uint64_t rem, term;
+
+    if (hardfloat_enabled(status) &&
+        float32_is_zero_or_normal(a) && !extractFloat32Sign(a)) {
+        float32_host ua = { .s = a }, ur;
+
+        ur.h = sqrtf(ua.h);
+        if (float32_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float32_squash_input_denormal(a STATUS_VAR);
 
     aSig = extractFloat32Frac( a );
@@ -3769,6 +3912,17 @@ static float64 subFloat64Sigs( float64 a, float64 b, flag zSign STATUS_PARAM )
 float64 float64_add( float64 a, float64 b STATUS_PARAM )
 {
     flag aSign, bSign;
+
+    if (hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        float64_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h + ub.h;
+        if (float64_host_result_ok(ur.h) || ur.h == 0) {
+            return ur.s;
+        }
+    }
+
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3792,6 +3946,17 @@ float64 float64_add( float64 a, float64 b STATUS_PARAM )
 float64 float64_sub( float64 a, float64 b STATUS_PARAM )
 {
     flag aSign, bSign;
+
+    if (hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        float64_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h - ub.h;
+        if (float64_host_result_ok(ur.h) || ur.h == 0) {
+            return ur.s;
+        }
+    }
+
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3818,6 +3983,16 @@ float64 float64_mul( float64 a, float64 b STATUS_PARAM )
     int_fast16_t aExp, bExp, zExp;
     uint64_t aSig, bSig, zSig0, zSig1;
 
+    if (hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        float64_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h * ub.h;
+        if (float64_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -3880,6 +4055,17 @@ float64 float64_div( float64 a, float64 b STATUS_PARAM )
     uint64_t aSig, bSig, zSig;
     uint64_t rem0, rem1;
     uint64_t term0, term1;
+
+    if (hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        float64_host ua = { .s = a }, ub = { .s = b }, ur;
+
+        ur.h = ua.h / ub.h;
+        if (float64_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
 
@@ -4046,6 +4232,28 @@ float64 float64_muladd(float64 a, float64 b, float64 c, int flags STATUS_PARAM)
     int shiftcount;
     flag signflip, infzero;
 
+#ifdef FP_FAST_FMA
+    if (!(flags & float_muladd_halve_result) && hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b) &&
+        float64_is_zero_or_normal(c)) {
+        float64_host ua = { .s = a }, ub = { .s = b }, uc = { .s = c }, ur;
+
+        if (flags & float_muladd_negate_product) {
+            ua.h = -ua.h;
+        }
+        if (flags & float_muladd_negate_c) {
+            uc.h = -uc.h;
+        }
+        ur.h = fma(ua.h, ub.h, uc.h);
+        if (flags & float_muladd_negate_result) {
+            ur.h = -ur.h;
+        }
+        if (float64_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+#endif
+
     a = float64_squash_input_denormal(a STATUS_VAR);
     b = float64_squash_input_denormal(b STATUS_VAR);
     c = float64_squash_input_denormal(c STATUS_VAR);
@@ -4283,6 +4491,17 @@ float64 float64_sqrt( float64 a STATUS_PARAM )
     int_fast16_t aExp, zExp;
     uint64_t aSig, zSig, doubleZSig;
     uint64_t rem0, rem1, term0, term1;
+
+    if (hardfloat_enabled(status) &&
+        float64_is_zero_or_normal(a) && !extractFloat64Sign(a)) {
+        float64_host ua = { .s = a }, ur;
+
+        ur.h = sqrt(ua.h);
+        if (float64_host_result_ok(ur.h)) {
+            return ur.s;
+        }
+    }
+
     a = float64_squash_input_denormal(a STATUS_VAR);
 
     aSig = extractFloat64Frac( a );
@@ -342,6 +342,38 @@ STEXI
 @findex loadvm
 Set the whole virtual machine to the snapshot identified by the tag
 @var{tag} or the unique snapshot ID @var{id}.
+ETEXI
+
+    {
+        .name       = "savevm-file",
+        .args_type  = "filename:F,threads:i?",
+        .params     = "filename [threads]",
+        .help       = "save the VM to a file with a mappable RAM image",
+        .mhandler.cmd = hmp_savevm_file,
+    },
+
+STEXI
+@item savevm-file @var{filename} [@var{threads}]
+@findex savevm-file
+Save the whole virtual machine, except block devices, to @var{filename}.
+RAM is stored page-aligned so that @code{loadvm-file} can map it instead of
+reading it; it is written by @var{threads} threads (4 by default).
+ETEXI
+
+    {
+        .name       = "loadvm-file",
+        .args_type  = "filename:F",
+        .params     = "filename",
+        .help       = "restore the VM from a file written by savevm-file",
+        .mhandler.cmd = hmp_loadvm_file,
+    },
+
+STEXI
+@item loadvm-file @var{filename}
+@findex loadvm-file
+Restore the virtual machine from @var{filename}, as written by
+@code{savevm-file}.  Guest RAM is mapped copy-on-write from the file, so
+the file must not be modified while the VM uses it.
 ETEXI
 
     {
@@ -1708,6 +1740,8 @@ show virtual to physical memory mappings (i386, SH4, SPARC, PPC, and Xtensa only
 show the active virtual memory mappings (i386 only)
 @item info jit
 show dynamic compiler info
+@item info tb-hot [@var{count}]
+show the @var{count} most executed translated blocks (requires -tb-hot)
 @item info numa
 show NUMA information
 @item info kvm
@@ -1754,6 +1788,10 @@ show qdev device model list
 show roms
 @item info tpm
 show the TPM device
+@item info thread-pools
+show worker thread pool statistics
+@item info timers
+show timer statistics for each clock
 @end table
 ETEXI
 
@@ -426,6 +426,7 @@ void hmp_info_vnc(Monitor *mon, const QDict *qdict)
     VncInfo *info;
     Error *err = NULL;
     VncClientInfoList *client;
+    VncEncodingInfoList *enc;
 
     info = qmp_query_vnc(&err);
     if (err) {
@@ -460,6 +461,14 @@ void hmp_info_vnc(Monitor *mon, const QDict *qdict)
             monitor_printf(mon, "    username: %s\n",
                            client->value->has_sasl_username ?
                            client->value->sasl_username : "none");
+            for (enc = client->value->encodings; enc; enc = enc->next) {
+                monitor_printf(mon, "    encoding: %s %" PRId64 " rects %"
+                               PRId64 " pixels %" PRId64 " bytes %"
+                               PRId64 " us\n",
+                               enc->value->encoding, enc->value->rects,
+                               enc->value->pixels, enc->value->bytes,
+                               enc->value->ns / 1000);
+            }
         }
     }
 
@@ -712,6 +721,72 @@ void hmp_info_tpm(Monitor *mon, const QDict *qdict)
     qapi_free_TPMInfoList(info_list);
 }
 
+static void hmp_print_thread_pool_hist(Monitor *mon, const char *name,
+                                       intList *hist)
+{
+    int bucket;
+
+    monitor_printf(mon, "  %s:", name);
+    for (bucket = 0; hist; hist = hist->next, bucket++) {
+        if (!hist->value) {
+            continue;
+        }
+        if (bucket == 0) {
+            monitor_printf(mon, " <1us=%" PRId64, hist->value);
+        } else if (!hist->next) {
+            monitor_printf(mon, " >=%" PRIu64 "us=%" PRId64,
+                           (uint64_t)1 << (bucket - 1), hist->value);
+        } else {
+            monitor_printf(mon, " <%" PRIu64 "us=%" PRId64,
+                           (uint64_t)1 << bucket, hist->value);
+        }
+    }
+    monitor_printf(mon, "\n");
+}
+
+void hmp_info_thread_pools(Monitor *mon, const QDict *qdict)
+{
+    ThreadPoolInfoList *info_list, *info;
+
+    info_list = qmp_query_thread_pools(NULL);
+    for (info = info_list; info; info = info->next) {
+        ThreadPoolInfo *value = info->value;
+
+        monitor_printf(mon, "%s: threads=%" PRId64 " (idle %" PRId64
+                       ", min %" PRId64 ", max %" PRId64 ")"
+                       " idle-timeout=%" PRId64 "ms\n",
+                       value->has_iothread ? value->iothread : "main-loop",
+                       value->cur_threads, value->idle_threads,
+                       value->min_threads, value->max_threads,
+                       value->idle_timeout);
+        monitor_printf(mon, "  queue-depth=%" PRId64 " (max %" PRId64 ")"
+                       " submitted=%" PRId64 " completed=%" PRId64 "\n",
+                       value->queue_depth, value->max_queue_depth,
+                       value->submitted, value->completed);
+        hmp_print_thread_pool_hist(mon, "wait", value->wait_histogram);
+        hmp_print_thread_pool_hist(mon, "run", value->run_histogram);
+    }
+
+    qapi_free_ThreadPoolInfoList(info_list);
+}
+
+void hmp_info_timers(Monitor *mon, const QDict *qdict)
+{
+    ClockTimerInfoList *info_list, *info;
+
+    info_list = qmp_query_timers(NULL);
+    for (info = info_list; info; info = info->next) {
+        ClockTimerInfo *value = info->value;
+
+        monitor_printf(mon, "%s: active=%" PRId64 " rearms=%" PRId64
+                       " deadline-changes=%" PRId64 " expired=%" PRId64 "\n",
+                       value->clock, value->active, value->rearms,
+                       value->deadline_changes, value->expired);
+    }
+
+    qapi_free_ClockTimerInfoList(info_list);
+}
+
 void hmp_quit(Monitor *mon, const QDict *qdict)
 {
     monitor_suspend(mon);
@@ -767,6 +842,26 @@ void hmp_pmemsave(Monitor *mon, const QDict *qdict)
     hmp_handle_error(mon, &errp);
 }
 
+void hmp_savevm_file(Monitor *mon, const QDict *qdict)
+{
+    const char *filename = qdict_get_str(qdict, "filename");
+    bool has_threads = qdict_haskey(qdict, "threads");
+    int64_t threads = qdict_get_try_int(qdict, "threads", 0);
+    Error *errp = NULL;
+
+    qmp_savevm_file(filename, has_threads, threads, &errp);
+    hmp_handle_error(mon, &errp);
+}
+
+void hmp_loadvm_file(Monitor *mon, const QDict *qdict)
+{
+    const char *filename = qdict_get_str(qdict, "filename");
+    Error *errp = NULL;
+
+    qmp_loadvm_file(filename, &errp);
+    hmp_handle_error(mon, &errp);
+}
+
 void hmp_ringbuf_write(Monitor *mon, const QDict *qdict)
 {
     const char *chardev = qdict_get_str(qdict, "device");
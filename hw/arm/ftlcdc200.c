@@ -135,12 +135,13 @@ static void ftlcdc200_update_irq(Ftlcdc200State *s)
 static void ftlcdc200_update_display(void *opaque)
 {
     Ftlcdc200State *s = FTLCDC200(opaque);
-    DisplaySurface *surface = qemu_console_surface(s->con);
+    DisplaySurface *surface;
     drawfn *fntable;
     drawfn fn;
     int dest_width;
     int src_width;
     int bpp_offset;
+    int shared_bpp;
     int first;
     int last;
 
@@ -148,6 +149,25 @@ static void ftlcdc200_update_display(void *opaque)
         return;
     }
 
+    /* The console takes 565 and 888 as they are */
+    switch (s->bpp) {
+    case BPP_16_565:
+        shared_bpp = 16;
+        break;
+    case BPP_32:
+        shared_bpp = 32;
+        break;
+    default:
+        shared_bpp = 0;
+        break;
+    }
+    if (framebuffer_update_shared(s->con, sysbus_address_space(&s->busdev),
+                                  s->fb[0], s->cols, s->rows, shared_bpp,
+                                  &s->invalidate)) {
+        goto done;
+    }
+
+    surface = qemu_console_surface(s->con);
     switch (surface_bits_per_pixel(surface)) {
     case 0:
         return;
@@ -210,14 +230,16 @@ static void ftlcdc200_update_display(void *opaque)
                                s->invalidate,
                                fn, s->palette,
                                &first, &last);
-    if (s->ier & (IER_VCOMP | IER_NEXTFB)) {
-        s->isr |= (IER_VCOMP | IER_NEXTFB);
-        ftlcdc200_update_irq(s);
-    }
     if (first >= 0) {
         dpy_gfx_update(s->con, 0, first, s->cols, last - first + 1);
     }
     s->invalidate = 0;
+
+done:
+    if (s->ier & (IER_VCOMP | IER_NEXTFB)) {
+        s->isr |= (IER_VCOMP | IER_NEXTFB);
+        ftlcdc200_update_irq(s);
+    }
 }
 
 static void ftlcdc200_invalidate_display(void *opaque)
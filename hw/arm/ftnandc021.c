@@ -37,6 +37,9 @@ typedef struct Ftnandc021State {
     /* DMA hardware handshake */
     qemu_irq req;
 
+    /* Command completion held back until the flash drives R/B# high */
+    bool     wait_rb;
+
     uint8_t  manf_id, chip_id;
 
     int      cmd;
@@ -74,8 +77,24 @@ static void ftnandc021_update_irq(Ftnandc021State *s)
     }
 }
 
+static bool ftnandc021_flash_ready(Ftnandc021State *s)
+{
+    int rb;
+
+    nand_getpins(s->flash, &rb);
+    return rb;
+}
+
 static void ftnandc021_set_idle(Ftnandc021State *s)
 {
+    if (!ftnandc021_flash_ready(s)) {
+        s->sr |= SR_BUSY;
+        s->wait_rb = true;
+        return;
+    }
+    s->sr &= ~SR_BUSY;
+    s->wait_rb = false;
+
     /* CLE=0, ALE=0, CS=1 */
     nand_setpins(s->flash, 0, 0, 1, 1, 0);
 
@@ -137,6 +156,35 @@ static void ftnandc021_handle_ack(void *opaque, int line, int level)
     }
 }
 
+static void ftnandc021_handle_rb(void *opaque, int line, int level)
+{
+    Ftnandc021State *s = FTNANDC021(opaque);
+
+    if (!level || !s->wait_rb) {
+        return;
+    }
+
+    switch (s->cmd) {
+    case FTNANDC021_CMD_RDPG:
+        s->sr &= ~SR_BUSY;
+        s->wait_rb = false;
+        if (s->bcr && (s->len > 0)) {
+            qemu_set_irq(s->req, 1);
+        }
+        break;
+    case FTNANDC021_CMD_RDST:
+        /* Program and erase finish with a status read; redo it now */
+        ftnandc021_set_cmd(s, 0x70);
+        nand_setpins(s->flash, 0, 0, 0, 1, 0);
+        s->id[1] = (nand_getio(s->flash) << 0);
+        ftnandc021_set_idle(s);
+        break;
+    default:
+        ftnandc021_set_idle(s);
+        break;
+    }
+}
+
 static void ftnandc021_command(Ftnandc021State *s, uint32_t cmd)
 {
     int i;
@@ -249,6 +297,13 @@ printf("******pi=0x%x\n", s->pi);
     /* if cmd is not page read/write, then return to idle mode */
     switch (s->cmd) {
     case FTNANDC021_CMD_RDPG:
+        /* Page data is valid once tR has elapsed */
+        if (!ftnandc021_flash_ready(s)) {
+            s->sr |= SR_BUSY;
+            s->wait_rb = true;
+            break;
+        }
+        /* fall through */
     case FTNANDC021_CMD_WRPG:
         if (s->bcr && (s->len > 0)) {
             qemu_set_irq(s->req, 1);
@@ -319,7 +374,7 @@ DB_PRINT("memory access@%#" HWADDR_PRIx "\n", addr);
     case REG_ATR2:
         return 0x42054209;  /* AC Timing */
     case REG_PRR:
-        return 0x00000001;  /* Always ready for I/O */
+        return ftnandc021_flash_ready(s);
     case REG_REVR:
         return 0x00010100;  /* Rev. 1.1.0 */
     case REG_CFGR:
@@ -459,6 +514,7 @@ static void ftnandc021_reset(DeviceState *ds)
     s->bcr   = 0;
     s->id[0] = 0;
     s->id[1] = 0;
+    s->wait_rb = false;
 
     /* We can assume our GPIO outputs have been wired up now */
     qemu_set_irq(s->req, 0);
@@ -479,20 +535,34 @@ static void ftnandc021_realize(DeviceState *dev, Error **errp)
     sysbus_init_irq(sbd, &s->irq);
 
     qdev_init_gpio_in(dev, ftnandc021_handle_ack, 1);
+    qdev_init_gpio_in(dev, ftnandc021_handle_rb, 1);
     qdev_init_gpio_out(dev, &s->req, 1);
 }
 
+static int ftnandc021_post_load(void *opaque, int version_id)
+{
+    Ftnandc021State *s = FTNANDC021(opaque);
+
+    /* The flash array timing is not migrated; finish a pending command */
+    if (s->wait_rb) {
+        ftnandc021_handle_rb(s, 1, 1);
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_ftnandc021 = {
     .name = TYPE_FTNANDC021,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .minimum_version_id_old = 1,
+    .post_load = ftnandc021_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(sr, Ftnandc021State),
         VMSTATE_UINT32(fcr, Ftnandc021State),
         VMSTATE_UINT32(mcr, Ftnandc021State),
         VMSTATE_UINT32(ier, Ftnandc021State),
         VMSTATE_UINT32(bcr, Ftnandc021State),
+        VMSTATE_BOOL_V(wait_rb, Ftnandc021State, 2),
         VMSTATE_END_OF_LIST()
     }
 };
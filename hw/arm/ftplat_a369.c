@@ -113,6 +113,8 @@ static void a369_board_init(QEMUMachineInitArgs *args)
         fprintf(stderr, "a369: Unable to set flash link for FTNANDC021\n");
         abort();
     }
+    /* R/B# of the flash feeds the second GPIO input of the controller */
+    qdev_connect_gpio_out(ds, 0, qdev_get_gpio_in(s->nandc[0], 1));
 
     /* Attach the spi flash to ftssp010.0 */
     nr_flash = 1;
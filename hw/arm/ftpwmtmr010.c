@@ -45,6 +45,59 @@ struct Ftpwmtmr010State {
 #define FTPWMTMR010(obj) \
     OBJECT_CHECK(Ftpwmtmr010State, obj, TYPE_FTPWMTMR010)
 
+/*
+ * Expiries are only timed with a host timer when they raise an interrupt
+ * the guest has not seen yet: edge interrupts always, level interrupts
+ * while the status bit is clear.  Otherwise the countdown is caught up
+ * lazily when the guest reads it.
+ */
+static bool ftpwmtmr010_timer_observable(Ftpwmtmr010Timer *t)
+{
+    if (!(t->ctrl & TIMER_CTRL_INTR)) {
+        return false;
+    }
+    return (t->ctrl & TIMER_CTRL_INTR_EDGE) || !(t->chip->stat & BIT(t->id));
+}
+
+/* Account for the expiries up to now */
+static void ftpwmtmr010_timer_sync(Ftpwmtmr010Timer *t)
+{
+    Ftpwmtmr010State *s = t->chip;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    int64_t timeout = t->timeout;
+
+    if (!(t->ctrl & TIMER_CTRL_START) || timeout > now) {
+        return;
+    }
+
+    /* if auto-reload is enabled */
+    if (t->ctrl & TIMER_CTRL_AUTORELOAD) {
+        timer_advance_deadline(&timeout, t->countdown, now);
+        t->timeout = timeout;
+    } else {
+        t->ctrl &= ~TIMER_CTRL_START;
+    }
+
+    /* if the interrupt enabled */
+    if (t->ctrl & TIMER_CTRL_INTR) {
+        s->stat |= BIT(t->id);
+        if (t->ctrl & TIMER_CTRL_INTR_EDGE) {
+            qemu_irq_pulse(t->irq);
+        } else {
+            qemu_irq_raise(t->irq);
+        }
+    }
+}
+
+static void ftpwmtmr010_timer_rearm(Ftpwmtmr010Timer *t)
+{
+    if ((t->ctrl & TIMER_CTRL_START) && ftpwmtmr010_timer_observable(t)) {
+        timer_mod(t->qtimer, t->timeout);
+    } else {
+        timer_del(t->qtimer);
+    }
+}
+
 static uint64_t
 ftpwmtmr010_mem_read(void *opaque, hwaddr addr, unsigned size)
 {
@@ -62,6 +115,7 @@ ftpwmtmr010_mem_read(void *opaque, hwaddr addr, unsigned size)
         break;
     case REG_TIMER_BASE(1) ... REG_TIMER_BASE(8) + 0x0C:
         t = s->timer + (addr >> 4) - 1;
+        ftpwmtmr010_timer_sync(t);
         switch (addr & 0x0f) {
         case REG_TIMER_CTRL:
             return t->ctrl;
@@ -92,10 +146,16 @@ ftpwmtmr010_mem_write(void *opaque, hwaddr addr, uint64_t val, unsigned size)
 
     switch (addr) {
     case REG_SR:
+        for (i = 0; i < 8; ++i) {
+            if (val & BIT(i)) {
+                ftpwmtmr010_timer_sync(s->timer + i);
+            }
+        }
         s->stat &= ~((uint32_t)val);
         for (i = 0; i < 8; ++i) {
             if (val & BIT(i)) {
                 qemu_irq_lower(s->timer[i].irq);
+                ftpwmtmr010_timer_rearm(s->timer + i);
             }
         }
         break;
@@ -103,14 +163,15 @@ ftpwmtmr010_mem_write(void *opaque, hwaddr addr, uint64_t val, unsigned size)
         t = s->timer + (addr >> 4) - 1;
         switch (addr & 0x0f) {
         case REG_TIMER_CTRL:
+            ftpwmtmr010_timer_sync(t);
             t->ctrl = (uint32_t)val;
             if (t->ctrl & TIMER_CTRL_UPDATE) {
                 t->countdown = (uint64_t)t->cntb * s->step;
             }
             if (t->ctrl & TIMER_CTRL_START) {
                 t->timeout = t->countdown + qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-                timer_mod(t->qtimer, t->timeout);
             }
+            ftpwmtmr010_timer_rearm(t);
             break;
         case REG_TIMER_CNTB:
             t->cntb = (uint32_t)val;
@@ -137,30 +198,9 @@ static const MemoryRegionOps mmio_ops = {
 static void ftpwmtmr010_timer_tick(void *opaque)
 {
     Ftpwmtmr010Timer *t = opaque;
-    Ftpwmtmr010State *s = t->chip;
 
-    /* if the timer has been enabled/started */
-    if (!(t->ctrl & TIMER_CTRL_START)) {
-        return;
-    }
-
-    /* if the interrupt enabled */
-    if (t->ctrl & TIMER_CTRL_INTR) {
-        s->stat |= BIT(t->id);
-        if (t->ctrl & TIMER_CTRL_INTR_EDGE) {
-            qemu_irq_pulse(t->irq);
-        } else {
-            qemu_irq_raise(t->irq);
-        }
-    }
-
-    /* if auto-reload is enabled */
-    if (t->ctrl & TIMER_CTRL_AUTORELOAD) {
-        t->timeout = t->countdown + qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-        timer_mod(t->qtimer, t->timeout);
-    } else {
-        t->ctrl &= ~TIMER_CTRL_START;
-    }
+    ftpwmtmr010_timer_sync(t);
+    ftpwmtmr010_timer_rearm(t);
 }
 
 static void ftpwmtmr010_reset(DeviceState *ds)
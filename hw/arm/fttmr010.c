@@ -57,146 +57,173 @@ struct Fttmr010State {
 #define FTTMR010(obj) \
     OBJECT_CHECK(Fttmr010State, obj, TYPE_FTTMR010)
 
-static void fttmr010_timer_restart(Fttmr010Timer *t)
+/*
+ * The counters are not ticked: each running timer remembers the counter
+ * value at a start time and works out its current value, and the matches
+ * and overflows it went through, when the guest looks at it.  The host
+ * timer is only armed for the next event that raises an unmasked
+ * interrupt; masked events just set their status bits when the guest
+ * next reads the counter or the status register.
+ */
+
+/* Ticks from the current counter value to the overflow/underflow */
+static uint64_t fttmr010_ticks_to_overflow(Fttmr010Timer *t)
 {
-    Fttmr010State *s = t->chip;
-    uint64_t interval;
-    int pending = 0;
+    return t->up ? 0xffffffffULL - t->counter : t->counter;
+}
 
-    t->intr_match1 = 0;
-    t->intr_match2 = 0;
+/* Has the counter reached match in the current period? */
+static bool fttmr010_match_passed(Fttmr010Timer *t, uint32_t match)
+{
+    return t->up ? match <= t->counter : match >= t->counter;
+}
 
-    /* check match1 */
-    if (t->up && t->match1 <= t->counter) {
-        t->intr_match1 = 1;
-    }
-    if (!t->up && t->match1 >= t->counter) {
-        t->intr_match1 = 1;
-    }
-    if (t->match1 == t->counter) {
-        s->isr |= ISR_MATCH1(t->id);
-        ++pending;
-    }
+static void fttmr010_raise(Fttmr010Timer *t, uint32_t events)
+{
+    Fttmr010State *s = t->chip;
 
-    /* check match2 */
-    if (t->up && t->match2 <= t->counter) {
-        t->intr_match2 = 1;
+    s->isr |= events;
+    if (events & ~s->imr) {
+        qemu_irq_pulse(s->irq);
+        qemu_irq_pulse(t->irq);
     }
-    if (!t->up && t->match2 >= t->counter) {
-        t->intr_match2 = 1;
+}
+
+/* Start a period from the current counter value */
+static uint32_t fttmr010_timer_load(Fttmr010Timer *t)
+{
+    uint32_t events = 0;
+
+    t->intr_match1 = fttmr010_match_passed(t, t->match1);
+    t->intr_match2 = fttmr010_match_passed(t, t->match2);
+    if (t->match1 == t->counter) {
+        events |= ISR_MATCH1(t->id);
     }
     if (t->match2 == t->counter) {
-        s->isr |= ISR_MATCH2(t->id);
-        ++pending;
+        events |= ISR_MATCH2(t->id);
     }
+    return events;
+}
+
+/* Count ticks that do not reach the overflow/underflow */
+static uint32_t fttmr010_timer_advance(Fttmr010Timer *t, uint64_t ticks)
+{
+    uint32_t events = 0;
 
-    /* determine delay interval */
     if (t->up) {
-        if ((t->match1 > t->counter) && (t->match2 > t->counter)) {
-            interval = MIN(t->match1, t->match2) - t->counter;
-        } else if (t->match1 > t->counter) {
-            interval = t->match1 - t->counter;
-        } else if (t->match2 > t->reload) {
-            interval = t->match2 - t->counter;
-        } else {
-            interval = 0xffffffffULL - t->counter;
-        }
+        t->counter += ticks;
     } else {
-        if ((t->match1 < t->counter) && (t->match2 < t->counter)) {
-            interval = t->counter - MAX(t->match1, t->match2);
-        } else if (t->match1 < t->reload) {
-            interval = t->counter - t->match1;
-        } else if (t->match2 < t->reload) {
-            interval = t->counter - t->match2;
-        } else {
-            interval = t->counter;
-        }
+        t->counter -= ticks;
     }
+    if (!t->intr_match1 && fttmr010_match_passed(t, t->match1)) {
+        t->intr_match1 = 1;
+        events |= ISR_MATCH1(t->id);
+    }
+    if (!t->intr_match2 && fttmr010_match_passed(t, t->match2)) {
+        t->intr_match2 = 1;
+        events |= ISR_MATCH2(t->id);
+    }
+    return events;
+}
 
-    if (pending) {
-        qemu_irq_pulse(s->irq);
-        qemu_irq_pulse(t->irq);
+/* Count up to the overflow/underflow and reload */
+static uint32_t fttmr010_timer_overflow(Fttmr010Timer *t)
+{
+    Fttmr010State *s = t->chip;
+    uint32_t events;
+
+    events = fttmr010_timer_advance(t, fttmr010_ticks_to_overflow(t));
+    if (s->cr & CR_TMR_OFEN(t->id)) {
+        events |= ISR_OF(t->id);
     }
-    t->start = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-    timer_mod(t->qtimer, t->start + interval * s->step);
+    t->counter = t->reload;
+    return events | fttmr010_timer_load(t);
 }
 
-static uint64_t fttmr010_update_counter(Fttmr010Timer *t)
+/* Bring a running timer up to the current time */
+static void fttmr010_timer_sync(Fttmr010Timer *t)
 {
     Fttmr010State *s = t->chip;
     uint64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-    uint64_t elapsed;
-    int pending = 0;
+    uint64_t ticks, period;
+    uint32_t events = 0;
 
-    if (s->cr & CR_TMR_EN(t->id)) {
-        /* get elapsed time */
-        elapsed = (now - t->start) / s->step;
-
-        /* convert to count-up/count-down value */
-        if (t->up) {
-            t->counter = t->counter + elapsed;
-        } else {
-            if (t->counter > elapsed) {
-                t->counter -= elapsed;
-            } else {
-                t->counter = 0;
-            }
-        }
-        t->start = now;
-
-        /* check match1 */
-        if (!t->intr_match1) {
-            if (t->up && t->match1 <= t->counter) {
-                t->intr_match1 = 1;
-                s->isr |= ISR_MATCH1(t->id);
-                ++pending;
-            }
-            if (!t->up && t->match1 >= t->counter) {
-                t->intr_match1 = 1;
-                s->isr |= ISR_MATCH1(t->id);
-                ++pending;
-            }
-        }
+    if (!(s->cr & CR_TMR_EN(t->id))) {
+        return;
+    }
 
-        /* check match2 */
-        if (!t->intr_match2) {
-            if (t->up && t->match2 <= t->counter) {
-                t->intr_match2 = 1;
-                s->isr |= ISR_MATCH2(t->id);
-                ++pending;
-            }
-            if (!t->up && t->match2 >= t->counter) {
-                t->intr_match2 = 1;
-                s->isr |= ISR_MATCH2(t->id);
-                ++pending;
-            }
+    ticks = (now - t->start) / s->step;
+    t->start += ticks * s->step;
+
+    if (ticks >= fttmr010_ticks_to_overflow(t)) {
+        ticks -= fttmr010_ticks_to_overflow(t);
+        events |= fttmr010_timer_overflow(t);
+
+        /* One more full period raises every event a period can raise;
+         * later periods would only set the same status bits again.
+         */
+        period = MAX(fttmr010_ticks_to_overflow(t), 1);
+        if (ticks >= period) {
+            events |= fttmr010_timer_overflow(t);
+            ticks = (ticks - period) % period;
         }
+    }
+    events |= fttmr010_timer_advance(t, ticks);
 
-        /* check overflow/underflow */
-        if (t->up && t->counter >= 0xffffffffULL) {
-            if (s->cr & CR_TMR_OFEN(t->id)) {
-                s->isr |= ISR_OF(t->id);
-                ++pending;
-            }
-            t->counter = t->reload;
-            fttmr010_timer_restart(t);
+    fttmr010_raise(t, events);
+}
+
+/* Ticks until match raises an unmasked interrupt, UINT64_MAX if never */
+static uint64_t fttmr010_match_next(Fttmr010Timer *t, uint32_t match,
+                                    bool passed, uint32_t bit)
+{
+    if (t->chip->imr & bit) {
+        return UINT64_MAX;
+    }
+    if (!passed) {
+        if (fttmr010_match_passed(t, match)) {
+            return 0;
         }
-        if (!t->up && t->counter == 0) {
-            if (s->cr & CR_TMR_OFEN(t->id)) {
-                s->isr |= ISR_OF(t->id);
-                ++pending;
-            }
-            t->counter = t->reload;
-            fttmr010_timer_restart(t);
+        return t->up ? match - t->counter : t->counter - match;
+    }
+    /* next period, unless the reload value is already past it */
+    if (t->up && match >= t->reload) {
+        return fttmr010_ticks_to_overflow(t) + match - t->reload;
+    }
+    if (!t->up && match <= t->reload) {
+        return fttmr010_ticks_to_overflow(t) + t->reload - match;
+    }
+    return UINT64_MAX;
+}
+
+/* Arm the host timer for the next event with an unmasked interrupt */
+static void fttmr010_timer_rearm(Fttmr010Timer *t)
+{
+    Fttmr010State *s = t->chip;
+    uint64_t next = UINT64_MAX;
+
+    if (s->cr & CR_TMR_EN(t->id)) {
+        if ((s->cr & CR_TMR_OFEN(t->id)) && !(s->imr & ISR_OF(t->id))) {
+            next = fttmr010_ticks_to_overflow(t);
         }
+        next = MIN(next, fttmr010_match_next(t, t->match1, t->intr_match1,
+                                             ISR_MATCH1(t->id)));
+        next = MIN(next, fttmr010_match_next(t, t->match2, t->intr_match2,
+                                             ISR_MATCH2(t->id)));
     }
 
-    if (pending) {
-        qemu_irq_pulse(s->irq);
-        qemu_irq_pulse(t->irq);
+    if (next == UINT64_MAX) {
+        timer_del(t->qtimer);
+    } else {
+        timer_mod(t->qtimer, t->start + MAX(next, 1) * s->step);
     }
+}
 
-    return t->counter;
+static void fttmr010_timer_restart(Fttmr010Timer *t)
+{
+    t->start = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    fttmr010_raise(t, fttmr010_timer_load(t));
+    fttmr010_timer_rearm(t);
 }
 
 static uint64_t
@@ -205,13 +232,15 @@ fttmr010_mem_read(void *opaque, hwaddr addr, unsigned size)
     Fttmr010State *s = FTTMR010(opaque);
     Fttmr010Timer *t;
     uint64_t ret = 0;
+    int i;
 
     switch (addr) {
     case REG_TMR_BASE(0) ... REG_TMR_BASE(2) + 0x0C:
         t = s->timer + REG_TMR_ID(addr);
         switch (addr & 0x0f) {
         case REG_TMR_COUNTER:
-            return fttmr010_update_counter(t);
+            fttmr010_timer_sync(t);
+            return t->counter;
         case REG_TMR_RELOAD:
             return t->reload;
         case REG_TMR_MATCH1:
@@ -223,6 +252,9 @@ fttmr010_mem_read(void *opaque, hwaddr addr, unsigned size)
     case REG_CR:
         return s->cr;
     case REG_ISR:
+        for (i = 0; i < 3; ++i) {
+            fttmr010_timer_sync(s->timer + i);
+        }
         return s->isr;
     case REG_IMR:
         return s->imr;
@@ -247,9 +279,11 @@ fttmr010_mem_write(void *opaque, hwaddr addr, uint64_t val, unsigned size)
     switch (addr) {
     case REG_TMR_BASE(0) ... REG_TMR_BASE(2) + 0x0C:
         t = s->timer + REG_TMR_ID(addr);
+        fttmr010_timer_sync(t);
         switch (addr & 0x0f) {
         case REG_TMR_COUNTER:
             t->counter = (uint32_t)val;
+            t->start = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
             break;
         case REG_TMR_RELOAD:
             t->reload = (uint32_t)val;
@@ -261,8 +295,12 @@ fttmr010_mem_write(void *opaque, hwaddr addr, uint64_t val, unsigned size)
             t->match2 = (uint32_t)val;
             break;
         }
+        fttmr010_timer_rearm(t);
         break;
     case REG_CR:
+        for (i = 0; i < 3; ++i) {
+            fttmr010_timer_sync(s->timer + i);
+        }
         s->cr = (uint32_t)val;
         for (i = 0; i < 3; ++i) {
             t = s->timer + i;
@@ -279,10 +317,19 @@ fttmr010_mem_write(void *opaque, hwaddr addr, uint64_t val, unsigned size)
         }
         break;
     case REG_ISR:
+        for (i = 0; i < 3; ++i) {
+            fttmr010_timer_sync(s->timer + i);
+        }
         s->isr &= ~((uint32_t)val);
         break;
     case REG_IMR:
+        for (i = 0; i < 3; ++i) {
+            fttmr010_timer_sync(s->timer + i);
+        }
         s->imr = (uint32_t)val;
+        for (i = 0; i < 3; ++i) {
+            fttmr010_timer_rearm(s->timer + i);
+        }
         break;
     default:
         qemu_log_mask(LOG_GUEST_ERROR,
@@ -304,45 +351,9 @@ static const MemoryRegionOps mmio_ops = {
 static void fttmr010_timer_tick(void *opaque)
 {
     Fttmr010Timer *t = opaque;
-    Fttmr010State *s = t->chip;
-    uint64_t now;
 
-    /* if the timer has been enabled/started */
-    if (!(s->cr & CR_TMR_EN(t->id))) {
-        return;
-    }
-
-    fttmr010_update_counter(t);
-
-    if (t->reload == t->counter) {
-        return;
-    }
-
-    now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-
-    if (t->up) {
-        if (!t->intr_match1 && t->match1 > t->counter) {
-            timer_mod(t->qtimer,
-                now + (t->match1 - t->counter) * s->step);
-        } else if (!t->intr_match2 && t->match2 > t->counter) {
-            timer_mod(t->qtimer,
-                now + (t->match2 - t->counter) * s->step);
-        } else {
-            timer_mod(t->qtimer,
-                now + (0xffffffffULL - t->counter) * s->step);
-        }
-    } else {
-        if (!t->intr_match1 && t->match1 < t->counter) {
-            timer_mod(t->qtimer,
-                now + (t->counter - t->match1) * s->step);
-        } else if (!t->intr_match2 && t->match2 < t->counter) {
-            timer_mod(t->qtimer,
-                now + (t->counter - t->match2) * s->step);
-        } else {
-            timer_mod(t->qtimer,
-                now + t->counter * s->step);
-        }
-    }
+    fttmr010_timer_sync(t);
+    fttmr010_timer_rearm(t);
 }
 
 static void fttmr010_reset(DeviceState *ds)
@@ -360,6 +371,8 @@ static void fttmr010_reset(DeviceState *ds)
         s->timer[i].reload  = 0;
         s->timer[i].match1  = 0;
         s->timer[i].match2  = 0;
+        s->timer[i].intr_match1 = 0;
+        s->timer[i].intr_match2 = 0;
         qemu_irq_lower(s->timer[i].irq);
         timer_del(s->timer[i].qtimer);
     }
@@ -404,11 +417,41 @@ static const VMStateDescription vmstate_fttmr010_timer = {
     },
 };
 
+static void fttmr010_pre_save(void *opaque)
+{
+    Fttmr010State *s = opaque;
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        fttmr010_timer_sync(s->timer + i);
+    }
+}
+
+/* The start times are not migrated; resume counting from now */
+static int fttmr010_post_load(void *opaque, int version_id)
+{
+    Fttmr010State *s = opaque;
+    Fttmr010Timer *t;
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        t = s->timer + i;
+        t->up = !!(s->cr & CR_TMR_COUNTUP(t->id));
+        t->start = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        t->intr_match1 = fttmr010_match_passed(t, t->match1);
+        t->intr_match2 = fttmr010_match_passed(t, t->match2);
+        fttmr010_timer_rearm(t);
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_fttmr010 = {
     .name = TYPE_FTTMR010,
     .version_id = 1,
     .minimum_version_id = 1,
     .minimum_version_id_old = 1,
+    .pre_save = fttmr010_pre_save,
+    .post_load = fttmr010_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(cr, Fttmr010State),
         VMSTATE_UINT32(isr, Fttmr010State),
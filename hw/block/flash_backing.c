@@ -0,0 +1,243 @@
+/*
+ * Block device backing store for flash device models
+ *
+ * Keeps the working copy of a flash array in host memory and writes
+ * modified sectors back to the drive asynchronously.  Sectors dirtied in
+ * a short window are coalesced into as few requests as possible, so that
+ * a program or erase sequence does not block the iothread with one
+ * synchronous write per command.
+ *
+ * Models that never map the array into guest memory can also ask for the
+ * working copy to be populated lazily, one chunk at a time, on first
+ * access.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "hw/hw.h"
+#include "qemu/bitmap.h"
+#include "qemu/error-report.h"
+#include "qemu/timer.h"
+#include "block/block.h"
+#include "sysemu/sysemu.h"
+#include "hw/block/flash.h"
+
+/* Dirty sectors are collected for this long before being written back */
+#define FLASH_BACKING_WB_DELAY_MS   20
+
+/* Granularity of lazy population, in sectors (64 KiB) */
+#define FLASH_BACKING_CHUNK_SECTORS 128
+
+struct FlashBacking {
+    BlockDriverState *bs;
+    uint8_t *storage;
+    int64_t nb_sectors;
+
+    /* Write-back state.  Writes of the same sector must not be reordered,
+     * so a new batch is only started once the previous one completed.
+     */
+    unsigned long *dirty;
+    int inflight;
+    QEMUTimer *wb_timer;
+
+    /* Chunks already read from the drive; NULL if populated eagerly */
+    unsigned long *loaded;
+    int64_t nb_chunks;
+
+    VMChangeStateEntry *vmstate_entry;
+    Notifier close_notifier;
+};
+
+typedef struct FlashBackingReq {
+    FlashBacking *fb;
+    QEMUIOVector qiov;
+} FlashBackingReq;
+
+static void flash_backing_kick(FlashBacking *fb);
+
+static void flash_backing_write_cb(void *opaque, int ret)
+{
+    FlashBackingReq *req = opaque;
+    FlashBacking *fb = req->fb;
+
+    if (ret < 0) {
+        error_report("flash: write-back to %s failed: %s",
+                     bdrv_get_device_name(fb->bs), strerror(-ret));
+    }
+    qemu_iovec_destroy(&req->qiov);
+    g_free(req);
+
+    /* Sectors dirtied while the batch was in flight */
+    if (--fb->inflight == 0 && !bitmap_empty(fb->dirty, fb->nb_sectors)) {
+        timer_mod(fb->wb_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                  FLASH_BACKING_WB_DELAY_MS);
+    }
+}
+
+/* Issue one request per run of contiguous dirty sectors */
+static void flash_backing_kick(FlashBacking *fb)
+{
+    unsigned long start, end;
+
+    if (fb->inflight) {
+        return;
+    }
+    timer_del(fb->wb_timer);
+
+    start = find_first_bit(fb->dirty, fb->nb_sectors);
+    while (start < fb->nb_sectors) {
+        FlashBackingReq *req = g_new(FlashBackingReq, 1);
+
+        end = find_next_zero_bit(fb->dirty, fb->nb_sectors, start);
+        bitmap_clear(fb->dirty, start, end - start);
+
+        req->fb = fb;
+        qemu_iovec_init(&req->qiov, 1);
+        qemu_iovec_add(&req->qiov, fb->storage + start * BDRV_SECTOR_SIZE,
+                       (end - start) * BDRV_SECTOR_SIZE);
+        fb->inflight++;
+        bdrv_aio_writev(fb->bs, start, &req->qiov, end - start,
+                        flash_backing_write_cb, req);
+
+        start = find_next_bit(fb->dirty, fb->nb_sectors, end);
+    }
+}
+
+static void flash_backing_timer_cb(void *opaque)
+{
+    flash_backing_kick(opaque);
+}
+
+void flash_backing_flush(FlashBacking *fb)
+{
+    if (!fb) {
+        return;
+    }
+
+    while (fb->inflight || !bitmap_empty(fb->dirty, fb->nb_sectors)) {
+        flash_backing_kick(fb);
+        bdrv_drain_all();
+    }
+}
+
+static void flash_backing_vm_state_change(void *opaque, int running,
+                                          RunState state)
+{
+    /* A batch may be in flight with more sectors dirtied behind it, so
+     * write everything out before a snapshot or migration sees the drive.
+     */
+    if (!running) {
+        flash_backing_flush(opaque);
+    }
+}
+
+static void flash_backing_close(Notifier *n, void *data)
+{
+    FlashBacking *fb = container_of(n, FlashBacking, close_notifier);
+
+    flash_backing_flush(fb);
+    bdrv_flush(fb->bs);
+}
+
+void flash_backing_populate(FlashBacking *fb, uint64_t offset, uint64_t len)
+{
+    int64_t chunk, last;
+
+    if (!fb || !fb->loaded || !len) {
+        return;
+    }
+
+    chunk = offset / (FLASH_BACKING_CHUNK_SECTORS * BDRV_SECTOR_SIZE);
+    last = (offset + len - 1) / (FLASH_BACKING_CHUNK_SECTORS * BDRV_SECTOR_SIZE);
+    for (; chunk <= last && chunk < fb->nb_chunks; chunk++) {
+        int64_t sector = chunk * FLASH_BACKING_CHUNK_SECTORS;
+        int nb_sectors = MIN(FLASH_BACKING_CHUNK_SECTORS,
+                             fb->nb_sectors - sector);
+
+        if (test_bit(chunk, fb->loaded)) {
+            continue;
+        }
+        if (bdrv_read(fb->bs, sector, fb->storage + sector * BDRV_SECTOR_SIZE,
+                      nb_sectors) < 0) {
+            error_report("flash: failed to read %s at sector %" PRId64,
+                         bdrv_get_device_name(fb->bs), sector);
+            memset(fb->storage + sector * BDRV_SECTOR_SIZE, 0xff,
+                   nb_sectors * BDRV_SECTOR_SIZE);
+        }
+        set_bit(chunk, fb->loaded);
+    }
+}
+
+/* The caller is about to overwrite [offset, offset + len) completely, e.g.
+ * with an erase.  Chunks inside the range are not read from the drive;
+ * only partially covered chunks at either end are populated.
+ */
+void flash_backing_discard(FlashBacking *fb, uint64_t offset, uint64_t len)
+{
+    uint64_t chunk_size = FLASH_BACKING_CHUNK_SECTORS * BDRV_SECTOR_SIZE;
+    int64_t first, end;
+
+    if (!fb || !fb->loaded || !len) {
+        return;
+    }
+
+    first = DIV_ROUND_UP(offset, chunk_size);
+    if (offset + len >= fb->nb_sectors * BDRV_SECTOR_SIZE) {
+        end = fb->nb_chunks;
+    } else {
+        end = (offset + len) / chunk_size;
+    }
+    if (first < end) {
+        bitmap_set(fb->loaded, first, end - first);
+    }
+    flash_backing_populate(fb, offset, len);
+}
+
+void flash_backing_mark_dirty(FlashBacking *fb, uint64_t offset, uint64_t len)
+{
+    int64_t start, end;
+
+    if (!fb || !len) {
+        return;
+    }
+
+    start = offset / BDRV_SECTOR_SIZE;
+    end = MIN(DIV_ROUND_UP(offset + len, BDRV_SECTOR_SIZE), fb->nb_sectors);
+    bitmap_set(fb->dirty, start, end - start);
+
+    if (!fb->inflight && !timer_pending(fb->wb_timer)) {
+        timer_mod(fb->wb_timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                  FLASH_BACKING_WB_DELAY_MS);
+    }
+}
+
+FlashBacking *flash_backing_new(BlockDriverState *bs, void *storage,
+                                uint64_t size, bool lazy, Error **errp)
+{
+    FlashBacking *fb;
+    int64_t nb_sectors = DIV_ROUND_UP(size, BDRV_SECTOR_SIZE);
+
+    if (!lazy && bdrv_read(bs, 0, storage, nb_sectors) < 0) {
+        error_setg(errp, "failed to read the initial flash content");
+        return NULL;
+    }
+
+    fb = g_new0(FlashBacking, 1);
+    fb->bs = bs;
+    fb->storage = storage;
+    fb->nb_sectors = nb_sectors;
+    fb->dirty = bitmap_new(nb_sectors);
+    fb->wb_timer = timer_new_ms(QEMU_CLOCK_REALTIME, flash_backing_timer_cb,
+                                fb);
+    if (lazy) {
+        fb->nb_chunks = DIV_ROUND_UP(nb_sectors, FLASH_BACKING_CHUNK_SECTORS);
+        fb->loaded = bitmap_new(fb->nb_chunks);
+    }
+
+    fb->vmstate_entry =
+        qemu_add_vm_change_state_handler(flash_backing_vm_state_change, fb);
+    fb->close_notifier.notify = flash_backing_close;
+    bdrv_add_close_notifier(bs, &fb->close_notifier);
+    return fb;
+}
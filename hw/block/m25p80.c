@@ -24,6 +24,7 @@
 #include "hw/hw.h"
 #include "sysemu/blockdev.h"
 #include "hw/ssi.h"
+#include "hw/block/flash.h"
 
 #ifndef M25P80_ERR_DEBUG
 #define M25P80_ERR_DEBUG 0
@@ -246,6 +247,7 @@ typedef struct Flash {
     uint32_t r;
 
     BlockDriverState *bdrv;
+    FlashBacking *backing;
 
     uint8_t *storage;
     uint32_t size;
@@ -279,46 +281,15 @@ typedef struct M25P80Class {
 #define M25P80_GET_CLASS(obj) \
      OBJECT_GET_CLASS(M25P80Class, (obj), TYPE_M25P80)
 
-static void bdrv_sync_complete(void *opaque, int ret)
-{
-    /* do nothing. Masters do not directly interact with the backing store,
-     * only the working copy so no mutexing required.
-     */
-}
-
 static void flash_sync_page(Flash *s, int page)
 {
-    if (s->bdrv) {
-        int bdrv_sector, nb_sectors;
-        QEMUIOVector iov;
-
-        bdrv_sector = (page * s->pi->page_size) / BDRV_SECTOR_SIZE;
-        nb_sectors = DIV_ROUND_UP(s->pi->page_size, BDRV_SECTOR_SIZE);
-        qemu_iovec_init(&iov, 1);
-        qemu_iovec_add(&iov, s->storage + bdrv_sector * BDRV_SECTOR_SIZE,
-                                                nb_sectors * BDRV_SECTOR_SIZE);
-        bdrv_aio_writev(s->bdrv, bdrv_sector, &iov, nb_sectors,
-                                                bdrv_sync_complete, NULL);
-    }
+    flash_backing_mark_dirty(s->backing, page * s->pi->page_size,
+                             s->pi->page_size);
 }
 
 static inline void flash_sync_area(Flash *s, int64_t off, int64_t len)
 {
-    int64_t start, end, nb_sectors;
-    QEMUIOVector iov;
-
-    if (!s->bdrv) {
-        return;
-    }
-
-    assert(!(len % BDRV_SECTOR_SIZE));
-    start = off / BDRV_SECTOR_SIZE;
-    end = (off + len) / BDRV_SECTOR_SIZE;
-    nb_sectors = end - start;
-    qemu_iovec_init(&iov, 1);
-    qemu_iovec_add(&iov, s->storage + (start * BDRV_SECTOR_SIZE),
-                                        nb_sectors * BDRV_SECTOR_SIZE);
-    bdrv_aio_writev(s->bdrv, start, &iov, nb_sectors, bdrv_sync_complete, NULL);
+    flash_backing_mark_dirty(s->backing, off, len);
 }
 
 static void flash_erase(Flash *s, int offset, FlashCMD cmd)
@@ -355,6 +326,7 @@ static void flash_erase(Flash *s, int offset, FlashCMD cmd)
         qemu_log_mask(LOG_GUEST_ERROR, "M25P80: erase with write protect!\n");
         return;
     }
+    flash_backing_discard(s->backing, offset, len);
     memset(s->storage + offset, 0xff, len);
     flash_sync_area(s, offset, len);
 }
@@ -371,7 +343,10 @@ static inline
 void flash_write8(Flash *s, uint64_t addr, uint8_t data)
 {
     int64_t page = addr / s->pi->page_size;
-    uint8_t prev = s->storage[s->cur_addr];
+    uint8_t prev;
+
+    flash_backing_populate(s->backing, s->cur_addr, 1);
+    prev = s->storage[s->cur_addr];
 
     if (!s->write_enable) {
         qemu_log_mask(LOG_GUEST_ERROR, "M25P80: write with write protect!\n");
@@ -575,6 +550,7 @@ static uint32_t m25p80_transfer8(SSISlave *ss, uint32_t tx)
         break;
 
     case STATE_READ:
+        flash_backing_populate(s->backing, s->cur_addr, 1);
         r = s->storage[s->cur_addr];
         DB_PRINT_L(1, "READ 0x%" PRIx64 "=%" PRIx8 "\n", s->cur_addr,
                    (uint8_t)r);
@@ -630,12 +606,11 @@ static int m25p80_init(SSISlave *ss)
             return 1;
         }
 
-        /* FIXME: Move to late init */
-        if (bdrv_read(s->bdrv, 0, s->storage, DIV_ROUND_UP(s->size,
-                                                    BDRV_SECTOR_SIZE))) {
-            fprintf(stderr, "Failed to initialize SPI flash!\n");
-            return 1;
-        }
+        /* The array is only reached through SPI transfers, so read it in
+         * from the drive as the guest touches it.
+         */
+        s->backing = flash_backing_new(s->bdrv, s->storage, s->size, true,
+                                       NULL);
     } else {
         DB_PRINT_L(0, "No BDRV - binding to RAM\n");
         memset(s->storage, 0xFF, s->size);
@@ -646,7 +621,10 @@ static int m25p80_init(SSISlave *ss)
 
 static void m25p80_pre_save(void *opaque)
 {
-    flash_sync_dirty((Flash *)opaque, -1);
+    Flash *s = opaque;
+
+    flash_sync_dirty(s, -1);
+    flash_backing_flush(s->backing);
 }
 
 static const VMStateDescription vmstate_m25p80 = {
@@ -74,6 +74,13 @@ struct NANDFlashState {
     BlockDriverState *bdrv;
     int mem_oob;
 
+    /* Raw data and OOB image files, mapped in place of a drive */
+    char *image;
+    char *oob_image;
+    uint8_t *oob_storage;
+
+    NANDTiming timing;
+
     uint8_t cle, ale, ce, wp, gnd;
 
     uint8_t io[MAX_PAGE + MAX_OOB + 0x400];
@@ -248,6 +255,8 @@ static void nand_reset(DeviceState *dev)
     s->offset = 0;
     s->status &= NAND_IOSTATUS_UNPROTCT;
     s->status |= NAND_IOSTATUS_READY;
+
+    nand_timing_reset(&s->timing);
 }
 
 static inline void nand_pushio_byte(NANDFlashState *s, uint8_t value)
@@ -258,9 +267,19 @@ static inline void nand_pushio_byte(NANDFlashState *s, uint8_t value)
     }
 }
 
+/* The ready bits read back clear while the array is busy */
+static int nand_status(NANDFlashState *s)
+{
+    if (nand_timing_busy(&s->timing)) {
+        return s->status & ~NAND_IOSTATUS_READY;
+    }
+    return s->status;
+}
+
 static void nand_command(NANDFlashState *s)
 {
     unsigned int offset;
+    int64_t block;
     switch (s->cmd) {
     case NAND_CMD_READ0:
     case NAND_CMD_READCACHEEXIT:
@@ -306,7 +325,9 @@ static void nand_command(NANDFlashState *s)
 
     case NAND_CMD_PAGEPROGRAM2:
         if (s->wp) {
+            block = (s->addr >> s->addr_shift) >> s->erase_shift;
             s->blk_write(s);
+            nand_timing_begin(&s->timing, NAND_TIMING_PROGRAM, block);
         }
         break;
 
@@ -320,13 +341,15 @@ static void nand_command(NANDFlashState *s)
 
         if (s->wp) {
             s->blk_erase(s);
+            nand_timing_begin(&s->timing, NAND_TIMING_ERASE,
+                              (s->addr >> s->addr_shift) >> s->erase_shift);
         }
         break;
 
     case NAND_CMD_READSTATUS:
         s->ioaddr = s->io;
         s->iolen = 0;
-        nand_pushio_byte(s, s->status);
+        nand_pushio_byte(s, nand_status(s));
         break;
 
     default:
@@ -412,7 +435,19 @@ static void nand_realize(DeviceState *dev, Error **errp)
 
     pagesize = 1 << s->oob_shift;
     s->mem_oob = 1;
-    if (s->bdrv) {
+    if (s->image) {
+        if (s->bdrv) {
+            error_setg(errp, "A NAND image can't be used along with a drive");
+            return;
+        }
+        if (nand_image_map(s->image, s->oob_image,
+                           (uint64_t)s->pages << s->page_shift,
+                           (uint64_t)s->pages << s->oob_shift,
+                           &s->storage, &s->oob_storage, errp) < 0) {
+            return;
+        }
+        pagesize = 0;
+    } else if (s->bdrv) {
         if (bdrv_is_read_only(s->bdrv)) {
             error_setg(errp, "Can't use a read-only drive");
             return;
@@ -431,6 +466,9 @@ static void nand_realize(DeviceState *dev, Error **errp)
     }
     /* Give s->ioaddr a sane value in case we save state before it is used. */
     s->ioaddr = s->io;
+
+    nand_timing_init(&s->timing, dev, 1 << s->page_shift,
+                     s->pages >> s->erase_shift);
 DEBUGF("%s\n size=%d\n pages=%d\n,page_shift=%d\n oob_shift=%d\n buswidth=%d\n chipid=%x\n pagesize=%d\n bdrv=%d\n storage=%lx\n mem_oob=%d\n" , __func__,s->size, s->pages, s->page_shift,s->oob_shift, s->buswidth, s->chip_id, pagesize, (uint)bdrv_getlength(s->bdrv), (int long)s->storage, s->mem_oob);
 }
 
@@ -438,6 +476,9 @@ static Property nand_properties[] = {
     DEFINE_PROP_UINT8("manufacturer_id", NANDFlashState, manf_id, 0),
     DEFINE_PROP_UINT8("chip_id", NANDFlashState, chip_id, 0),
     DEFINE_PROP_DRIVE("drive", NANDFlashState, bdrv),
+    DEFINE_PROP_STRING("image", NANDFlashState, image),
+    DEFINE_PROP_STRING("oob-image", NANDFlashState, oob_image),
+    DEFINE_NAND_TIMING_PROPERTIES(NANDFlashState, timing),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -488,7 +529,9 @@ void nand_setpins(DeviceState *dev, uint8_t cle, uint8_t ale,
 
 void nand_getpins(DeviceState *dev, int *rb)
 {
-    *rb = 1;
+    NANDFlashState *s = NAND(dev);
+
+    *rb = !nand_timing_busy(&s->timing);
 }
 
 void nand_setio(DeviceState *dev, uint32_t value)
@@ -501,8 +544,11 @@ DEBUGF("[**%s**] cle=%x ale=%x ce=%x wp=%x gnd=%x ****s->addr=%" PRIx64 "\n", __
             if (s->cmd == NAND_CMD_READ0
                 && (value == NAND_CMD_LPREAD2
                     || value == NAND_CMD_READCACHESTART
-                    || value == NAND_CMD_READCACHELAST))
+                    || value == NAND_CMD_READCACHELAST)) {
+                nand_timing_begin(&s->timing, NAND_TIMING_READ,
+                                  (s->addr >> s->addr_shift) >> s->erase_shift);
                 return;
+            }
             if (value == NAND_CMD_RANDOMREAD1) {
                 s->addr &= ~((1 << s->addr_shift) - 1);
                 s->addrlen = 0;
@@ -622,6 +668,9 @@ DEBUGF("%s s->addr=0x%" PRIx64 " offset=0x%x cmd=0x%" PRIx32 " iolen=0x%x\n", __
     if (s->ce || s->iolen <= 0) {
         return 0;
     }
+    if (s->cmd == NAND_CMD_READSTATUS) {
+        s->io[0] = nand_status(s);
+    }
 //DEBUGF("%s addr=%x offset=%x cmd=%x\n", __func__,(int) s->addr, (uint)offset,s->cmd);
     for (offset = s->buswidth; offset--;) {
         x |= s->ioaddr[offset] << (offset << 3);
@@ -675,7 +724,22 @@ static void glue(nand_blk_write_, PAGE_SIZE)(NANDFlashState *s)
     if (PAGE(s->addr) >= s->pages)
         return;
 
-    if (!s->bdrv) {
+    if (s->oob_storage) {
+        uint64_t end;
+
+        page = PAGE(s->addr);
+        off = (s->addr & PAGE_MASK) + s->offset;
+        end = MIN(off + s->iolen, PAGE_SIZE);
+        if (end > off) {
+            mem_and(s->storage + (page << PAGE_SHIFT) + off, s->io, end - off);
+        }
+        soff = MAX(off, PAGE_SIZE);
+        end = MIN(off + s->iolen, PAGE_SIZE + OOB_SIZE);
+        if (end > soff) {
+            mem_and(s->oob_storage + (page << OOB_SHIFT) + soff - PAGE_SIZE,
+                    s->io + soff - off, end - soff);
+        }
+    } else if (!s->bdrv) {
         mem_and(s->storage + PAGE_START(s->addr) + (s->addr & PAGE_MASK) +
                         s->offset, s->io, s->iolen);
     } else if (s->mem_oob) {
@@ -726,7 +790,12 @@ static void glue(nand_blk_erase_, PAGE_SIZE)(NANDFlashState *s)
         return;
     }
 
-    if (!s->bdrv) {
+    if (s->oob_storage) {
+        memset(s->storage + (PAGE(addr) << PAGE_SHIFT),
+                        0xff, PAGE_SIZE << s->erase_shift);
+        memset(s->oob_storage + (PAGE(addr) << OOB_SHIFT),
+                        0xff, OOB_SIZE << s->erase_shift);
+    } else if (!s->bdrv) {
         memset(s->storage + PAGE_START(addr),
                         0xff, (PAGE_SIZE + OOB_SIZE) << s->erase_shift);
     } else if (s->mem_oob) {
@@ -777,7 +846,12 @@ static void glue(nand_blk_load_, PAGE_SIZE)(NANDFlashState *s,
         return;
     }
 
-    if (s->bdrv) {
+    if (s->oob_storage) {
+        memcpy(s->io, s->storage + (PAGE(addr) << PAGE_SHIFT), PAGE_SIZE);
+        memcpy(s->io + PAGE_SIZE, s->oob_storage + (PAGE(addr) << OOB_SHIFT),
+                        OOB_SIZE);
+        s->ioaddr = s->io + offset;
+    } else if (s->bdrv) {
         if (s->mem_oob) {
             if (bdrv_read(s->bdrv, SECTOR(addr), s->io, PAGE_SECTORS) < 0) {
                 DEBUGF("%s: read error in sector %" PRIu64 "\n",
@@ -0,0 +1,87 @@
+/*
+ * Memory-mapped raw images for NAND flash models
+ *
+ * The page data and the spare (OOB) area live in two separate raw files
+ * that are mapped MAP_SHARED, so page reads and programs are plain memory
+ * accesses and the host page cache takes care of persistence.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "hw/hw.h"
+#include "hw/block/flash.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+
+static uint8_t *nand_image_map_one(const char *path, uint64_t len,
+                                   Error **errp)
+{
+    struct stat st;
+    uint8_t *p;
+    int fd;
+
+    fd = qemu_open(path, O_RDWR | O_CREAT | O_BINARY, 0644);
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "Could not open '%s'", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0) {
+        error_setg_errno(errp, errno, "Could not stat '%s'", path);
+        qemu_close(fd);
+        return NULL;
+    }
+    if (st.st_size < len && ftruncate(fd, len) < 0) {
+        error_setg_errno(errp, errno, "Could not resize '%s'", path);
+        qemu_close(fd);
+        return NULL;
+    }
+
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    qemu_close(fd);
+    if (p == MAP_FAILED) {
+        error_setg_errno(errp, errno, "Could not map '%s'", path);
+        return NULL;
+    }
+
+    /* Space added to the file reads back as erased flash */
+    if (st.st_size < len) {
+        memset(p + st.st_size, 0xff, len - st.st_size);
+    }
+    return p;
+}
+
+int nand_image_map(const char *image, const char *oob_image,
+                   uint64_t data_len, uint64_t oob_len,
+                   uint8_t **data, uint8_t **oob, Error **errp)
+{
+    if (!oob_image) {
+        error_setg(errp, "NAND image '%s' needs an OOB image as well", image);
+        return -EINVAL;
+    }
+
+    *data = nand_image_map_one(image, data_len, errp);
+    if (!*data) {
+        return -EIO;
+    }
+    *oob = nand_image_map_one(oob_image, oob_len, errp);
+    if (!*oob) {
+        munmap(*data, data_len);
+        *data = NULL;
+        return -EIO;
+    }
+    return 0;
+}
+
+#else
+
+int nand_image_map(const char *image, const char *oob_image,
+                   uint64_t data_len, uint64_t oob_len,
+                   uint8_t **data, uint8_t **oob, Error **errp)
+{
+    error_setg(errp, "Mapped NAND images are not supported on this host");
+    return -ENOTSUP;
+}
+
+#endif
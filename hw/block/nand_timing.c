@@ -0,0 +1,162 @@
+/*
+ * NAND flash array timing and wear model
+ *
+ * Page reads, page programs and block erases complete immediately as far
+ * as the data is concerned, but the chip reports itself busy on its R/B#
+ * line and in its status register for the configured tR, tPROG and tBERS,
+ * measured on QEMU_CLOCK_VIRTUAL.  Blocks are spread over the planes
+ * round-robin; operations on the same plane are serialized while planes
+ * overlap.  All latencies default to zero, which keeps the chip always
+ * ready.
+ *
+ * The model also keeps per-block erase counters and access statistics,
+ * reported by the query-nand QMP command.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "hw/hw.h"
+#include "hw/qdev.h"
+#include "hw/block/flash.h"
+#include "qemu/timer.h"
+#include "qmp-commands.h"
+
+static QTAILQ_HEAD(, NANDTiming) nand_timings =
+    QTAILQ_HEAD_INITIALIZER(nand_timings);
+
+static void nand_timing_ready(void *opaque)
+{
+    NANDTiming *t = opaque;
+
+    if (!nand_timing_busy(t)) {
+        qemu_set_irq(t->rb, 1);
+    }
+}
+
+void nand_timing_init(NANDTiming *t, DeviceState *dev, int page_size,
+                      int nb_blocks)
+{
+    t->dev = dev;
+    t->page_size = page_size;
+    t->nb_blocks = nb_blocks;
+    t->erase_count = g_new0(uint32_t, nb_blocks);
+    t->planes = MAX(t->planes, 1);
+    t->plane_ready = g_new0(int64_t, t->planes);
+    t->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, nand_timing_ready, t);
+    qdev_init_gpio_out(dev, &t->rb, 1);
+
+    QTAILQ_INSERT_TAIL(&nand_timings, t, next);
+}
+
+void nand_timing_reset(NANDTiming *t)
+{
+    int i;
+
+    timer_del(t->timer);
+    t->ready = 0;
+    for (i = 0; i < t->planes; i++) {
+        t->plane_ready[i] = 0;
+    }
+    qemu_set_irq(t->rb, 1);
+}
+
+bool nand_timing_busy(NANDTiming *t)
+{
+    return qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) < t->ready;
+}
+
+void nand_timing_begin(NANDTiming *t, NANDTimingOp op, int64_t block)
+{
+    int64_t now, start, end;
+    uint32_t latency;
+    int plane;
+
+    switch (op) {
+    case NAND_TIMING_READ:
+        t->pages_read++;
+        latency = t->t_read;
+        break;
+    case NAND_TIMING_PROGRAM:
+        t->pages_programmed++;
+        latency = t->t_prog;
+        break;
+    case NAND_TIMING_ERASE:
+        t->blocks_erased++;
+        if (block >= 0 && block < t->nb_blocks) {
+            t->erase_count[block]++;
+        }
+        latency = t->t_erase;
+        break;
+    default:
+        abort();
+    }
+
+    if (!latency) {
+        return;
+    }
+
+    now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    plane = block % t->planes;
+    start = MAX(now, t->plane_ready[plane]);
+    end = start + latency;
+    t->plane_ready[plane] = end;
+
+    /* Busy time is the union over all planes; only count what this
+     * operation adds beyond the point the chip was already busy until.
+     */
+    if (end > t->ready) {
+        t->busy_ns += end - MAX(start, t->ready);
+        t->ready = end;
+    }
+
+    qemu_set_irq(t->rb, 0);
+    timer_mod(t->timer, t->ready);
+}
+
+static NandInfo *nand_timing_info(NANDTiming *t, bool erase_counts)
+{
+    NandInfo *info = g_new0(NandInfo, 1);
+    intList **prev = &info->erase_counts;
+    int i;
+
+    info->path = object_get_canonical_path(OBJECT(t->dev));
+    info->pages_read = t->pages_read;
+    info->pages_programmed = t->pages_programmed;
+    info->blocks_erased = t->blocks_erased;
+    info->bytes_read = t->pages_read * t->page_size;
+    info->bytes_programmed = t->pages_programmed * t->page_size;
+    info->busy_ns = t->busy_ns;
+
+    for (i = 0; i < t->nb_blocks; i++) {
+        if (!i || t->erase_count[i] < info->min_erase_count) {
+            info->min_erase_count = t->erase_count[i];
+        }
+        if (t->erase_count[i] > info->max_erase_count) {
+            info->max_erase_count = t->erase_count[i];
+        }
+        if (erase_counts) {
+            *prev = g_new0(intList, 1);
+            (*prev)->value = t->erase_count[i];
+            prev = &(*prev)->next;
+        }
+    }
+    info->has_erase_counts = erase_counts;
+    return info;
+}
+
+NandInfoList *qmp_query_nand(bool has_erase_counts, bool erase_counts,
+                             Error **errp)
+{
+    NandInfoList *head = NULL, **prev = &head;
+    NANDTiming *t;
+
+    QTAILQ_FOREACH(t, &nand_timings, next) {
+        NandInfoList *elem = g_new0(NandInfoList, 1);
+
+        elem->value = nand_timing_info(t, has_erase_counts && erase_counts);
+        *prev = elem;
+        prev = &elem->next;
+    }
+    return head;
+}
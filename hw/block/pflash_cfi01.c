@@ -92,6 +92,7 @@ struct pflash_t {
     MemoryRegion mem;
     char *name;
     void *storage;
+    FlashBacking *backing;
 };
 
 static const VMStateDescription vmstate_pflash = {
@@ -391,15 +392,7 @@ static uint32_t pflash_read (pflash_t *pfl, hwaddr offset,
 static void pflash_update(pflash_t *pfl, int offset,
                           int size)
 {
-    int offset_end;
-    if (pfl->bs) {
-        offset_end = offset + size;
-        /* round to sectors */
-        offset = offset >> 9;
-        offset_end = (offset_end + 511) >> 9;
-        bdrv_write(pfl->bs, offset, pfl->storage + (offset << 9),
-                   offset_end - offset);
-    }
+    flash_backing_mark_dirty(pfl->backing, offset, size);
 }
 
 static inline void pflash_data_write(pflash_t *pfl, hwaddr offset,
@@ -747,7 +740,6 @@ static void pflash_cfi01_realize(DeviceState *dev, Error **errp)
 {
     pflash_t *pfl = CFI_PFLASH01(dev);
     uint64_t total_len;
-    int ret;
 
     total_len = pfl->sector_len * pfl->nb_blocs;
 
@@ -767,13 +759,16 @@ static void pflash_cfi01_realize(DeviceState *dev, Error **errp)
     sysbus_init_mmio(SYS_BUS_DEVICE(dev), &pfl->mem);
 
     if (pfl->bs) {
-        /* read the initial flash content */
-        ret = bdrv_read(pfl->bs, 0, pfl->storage, total_len >> 9);
+        /* read the initial flash content; the array is mapped into
+         * guest memory for execute-in-place, so it cannot be populated
+         * lazily.
+         */
+        pfl->backing = flash_backing_new(pfl->bs, pfl->storage, total_len,
+                                         false, errp);
 
-        if (ret < 0) {
+        if (!pfl->backing) {
             vmstate_unregister_ram(&pfl->mem, DEVICE(pfl));
             memory_region_destroy(&pfl->mem);
-            error_setg(errp, "failed to read the initial flash content");
             return;
         }
     }
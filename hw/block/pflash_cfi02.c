@@ -96,6 +96,7 @@ struct pflash_t {
     int read_counter; /* used for lazy switch-back to rom mode */
     char *name;
     void *storage;
+    FlashBacking *backing;
 };
 
 /*
@@ -248,15 +249,7 @@ static uint32_t pflash_read (pflash_t *pfl, hwaddr offset,
 static void pflash_update(pflash_t *pfl, int offset,
                           int size)
 {
-    int offset_end;
-    if (pfl->bs) {
-        offset_end = offset + size;
-        /* round to sectors */
-        offset = offset >> 9;
-        offset_end = (offset_end + 511) >> 9;
-        bdrv_write(pfl->bs, offset, pfl->storage + (offset << 9),
-                   offset_end - offset);
-    }
+    flash_backing_mark_dirty(pfl->backing, offset, size);
 }
 
 static void pflash_write (pflash_t *pfl, hwaddr offset,
@@ -596,7 +589,6 @@ static void pflash_cfi02_realize(DeviceState *dev, Error **errp)
 {
     pflash_t *pfl = CFI_PFLASH02(dev);
     uint32_t chip_len;
-    int ret;
 
     chip_len = pfl->sector_len * pfl->nb_blocs;
     /* XXX: to be fixed */
@@ -613,12 +605,15 @@ static void pflash_cfi02_realize(DeviceState *dev, Error **errp)
     pfl->storage = memory_region_get_ram_ptr(&pfl->orig_mem);
     pfl->chip_len = chip_len;
     if (pfl->bs) {
-        /* read the initial flash content */
-        ret = bdrv_read(pfl->bs, 0, pfl->storage, chip_len >> 9);
-        if (ret < 0) {
+        /* read the initial flash content; the array is mapped into
+         * guest memory for execute-in-place, so it cannot be populated
+         * lazily.
+         */
+        pfl->backing = flash_backing_new(pfl->bs, pfl->storage, chip_len,
+                                         false, errp);
+        if (!pfl->backing) {
             vmstate_unregister_ram(&pfl->orig_mem, DEVICE(pfl));
             memory_region_destroy(&pfl->orig_mem);
-            error_setg(errp, "failed to read the initial flash content");
             return;
         }
     }
@@ -19,6 +19,7 @@ struct ptimer_state
     int64_t period;
     int64_t last_event;
     int64_t next_event;
+    bool masked;
     QEMUBH *bh;
     QEMUTimer *timer;
 };
@@ -26,11 +27,38 @@ struct ptimer_state
 /* Use a bottom-half routine to avoid reentrancy issues.  */
 static void ptimer_trigger(ptimer_state *s)
 {
-    if (s->bh) {
+    if (s->bh && !s->masked) {
         qemu_bh_schedule(s->bh);
     }
 }
 
+/* Account for the expiries a masked timer did not arm the host timer for */
+static void ptimer_catch_up(ptimer_state *s, int64_t now)
+{
+    int64_t period;
+
+    if (!s->masked || !s->enabled || now < s->next_event) {
+        return;
+    }
+    if (s->enabled == 2) {
+        s->enabled = 0;
+        s->delta = 0;
+        return;
+    }
+
+    period = s->limit * s->period;
+    if (s->period_frac) {
+        period += ((int64_t)s->period_frac * s->limit) >> 32;
+    }
+    if (period == 0) {
+        s->enabled = 0;
+        return;
+    }
+    timer_advance_deadline(&s->next_event, period, now);
+    s->last_event = s->next_event - period;
+    s->delta = s->limit;
+}
+
 static void ptimer_reload(ptimer_state *s)
 {
     if (s->delta == 0) {
@@ -48,7 +76,9 @@ static void ptimer_reload(ptimer_state *s)
     if (s->period_frac) {
         s->next_event += ((int64_t)s->period_frac * s->delta) >> 32;
     }
-    timer_mod(s->timer, s->next_event);
+    if (!s->masked) {
+        timer_mod(s->timer, s->next_event);
+    }
 }
 
 static void ptimer_tick(void *opaque)
@@ -70,6 +100,9 @@ uint64_t ptimer_get_count(ptimer_state *s)
 
     if (s->enabled) {
         now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        ptimer_catch_up(s, now);
+    }
+    if (s->enabled) {
         /* Figure out the current counter value.  */
         if (now - s->next_event > 0
             || s->period == 0) {
@@ -154,6 +187,26 @@ void ptimer_stop(ptimer_state *s)
     s->enabled = 0;
 }
 
+/* A masked timer keeps counting and reloading, but it neither arms a host
+   timer nor schedules the bottom half; use it while the expiries are not
+   observable by the guest.  */
+void ptimer_set_masked(ptimer_state *s, bool masked)
+{
+    if (s->masked == masked) {
+        return;
+    }
+    if (masked) {
+        s->masked = true;
+        timer_del(s->timer);
+    } else {
+        ptimer_catch_up(s, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+        s->masked = false;
+        if (s->enabled) {
+            timer_mod(s->timer, s->next_event);
+        }
+    }
+}
+
 /* Set counter increment interval in nanoseconds.  */
 void ptimer_set_period(ptimer_state *s, int64_t period)
 {
@@ -193,6 +246,9 @@ void ptimer_set_limit(ptimer_state *s, uint64_t limit, int reload)
         limit = 10000 / s->period;
     }
 
+    /* Finish the periods that ran with the old limit */
+    ptimer_catch_up(s, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+
     s->limit = limit;
     if (reload)
         s->delta = limit;
@@ -202,11 +258,25 @@ void ptimer_set_limit(ptimer_state *s, uint64_t limit, int reload)
     }
 }
 
+/* The mask is not migrated, so hand over a masked timer armed */
+static void ptimer_pre_save(void *opaque)
+{
+    ptimer_state *s = opaque;
+
+    if (s->masked && s->enabled) {
+        ptimer_catch_up(s, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+        if (s->enabled) {
+            timer_mod(s->timer, s->next_event);
+        }
+    }
+}
+
 const VMStateDescription vmstate_ptimer = {
     .name = "ptimer",
     .version_id = 1,
     .minimum_version_id = 1,
     .minimum_version_id_old = 1,
+    .pre_save = ptimer_pre_save,
     .fields      = (VMStateField[]) {
         VMSTATE_UINT8(enabled, ptimer_state),
         VMSTATE_UINT64(limit, ptimer_state),
@@ -91,7 +91,9 @@ void framebuffer_update_display(
         dirty = memory_region_get_dirty(mem, addr, src_width,
                                              DIRTY_MEMORY_VGA);
         if (dirty || invalidate) {
-            fn(opaque, dest, src, cols, dest_col_pitch);
+            if (fn) {
+                fn(opaque, dest, src, cols, dest_col_pitch);
+            }
             if (first == -1)
                 first = i;
             last = i;
@@ -111,3 +113,70 @@ void framebuffer_update_display(
 out:
     memory_region_unref(mem);
 }
+
+/* Display a framebuffer straight from guest RAM.  */
+
+bool framebuffer_update_shared(
+    QemuConsole *con,
+    MemoryRegion *address_space,
+    hwaddr base,
+    int cols, /* Width in pixels.  */
+    int rows, /* Height in pixels.  */
+    int bpp, /* 16 or 32, or 0 if the guest format cannot be shared.  */
+    int *invalidate) /* Input and output.  */
+{
+    DisplaySurface *surface = qemu_console_surface(con);
+    MemoryRegionSection mem_section;
+    int linesize = cols * bpp / 8;
+    uint8_t *data;
+    int first, last;
+#ifdef HOST_WORDS_BIGENDIAN
+    bool byteswap = true;
+#else
+    bool byteswap = false;
+#endif
+
+    if (!bpp) {
+        goto unshare;
+    }
+    mem_section = memory_region_find(address_space, base, linesize * rows);
+    if (!mem_section.mr) {
+        goto unshare;
+    }
+    if (int128_get64(mem_section.size) != linesize * rows ||
+        !memory_region_is_ram(mem_section.mr)) {
+        memory_region_unref(mem_section.mr);
+        goto unshare;
+    }
+
+    data = memory_region_get_ram_ptr(mem_section.mr) +
+           mem_section.offset_within_region;
+    if (!surface || !is_buffer_shared(surface) ||
+        surface_data(surface) != data ||
+        surface_width(surface) != cols || surface_height(surface) != rows ||
+        surface_bits_per_pixel(surface) != bpp) {
+        surface = qemu_create_displaysurface_from(cols, rows, bpp, linesize,
+                                                  data, byteswap);
+        dpy_gfx_replace_surface(con, surface);
+        *invalidate = 1;
+    }
+    memory_region_unref(mem_section.mr);
+
+    /* Nothing to draw, but the dirty rows still need reporting.  */
+    first = 0;
+    framebuffer_update_display(surface, address_space, base, cols, rows,
+                               linesize, linesize, 0, *invalidate,
+                               NULL, NULL, &first, &last);
+    if (first >= 0) {
+        dpy_gfx_update(con, 0, first, cols, last - first + 1);
+    }
+    *invalidate = 0;
+    return true;
+
+unshare:
+    if (surface && is_buffer_shared(surface)) {
+        qemu_console_resize(con, cols, rows);
+        *invalidate = 1;
+    }
+    return false;
+}
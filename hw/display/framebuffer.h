@@ -22,4 +22,19 @@ void framebuffer_update_display(
     int *first_row,
     int *last_row);
 
+/* Point the console at the framebuffer in guest RAM instead of copying it
+   into a surface of its own, when the guest pixels are little-endian
+   RGB565 (BPP 16) or XRGB8888 (BPP 32).  Only the dirty rows are
+   reported to the display.  Returns false if the framebuffer cannot be
+   shared, after giving the console back a private surface; the caller
+   then draws it with framebuffer_update_display().  */
+bool framebuffer_update_shared(
+    QemuConsole *con,
+    MemoryRegion *address_space,
+    hwaddr base,
+    int cols,
+    int rows,
+    int bpp,
+    int *invalidate);
+
 #endif
@@ -128,16 +128,60 @@ static int pl110_enabled(PL110State *s)
   return (s->cr & PL110_CR_EN) && (s->cr & PL110_CR_PWR);
 }
 
+/* Offset into the draw function tables for the colour order and, on a
+ * PL110, the 16 bit format selected by the external mux.
+ */
+static int pl110_bpp_offset(PL110State *s)
+{
+    int bpp_offset;
+
+    if (s->cr & PL110_CR_BGR)
+        bpp_offset = 0;
+    else
+        bpp_offset = 24;
+
+    if ((s->version != PL111) && (s->bpp == BPP_16)) {
+        /* The PL110's native 16 bit mode is 5551; however
+         * most boards with a PL110 implement an external
+         * mux which allows bits to be reshuffled to give
+         * 565 format. The mux is typically controlled by
+         * an external system register.
+         * This is controlled by a GPIO input pin
+         * so boards can wire it up to their register.
+         *
+         * The PL111 straightforwardly implements both
+         * 5551 and 565 under control of the bpp field
+         * in the LCDControl register.
+         */
+        switch (s->mux_ctrl) {
+        case 3: /* 565 BGR */
+            bpp_offset = (BPP_16_565 - BPP_16);
+            break;
+        case 1: /* 5551 */
+            break;
+        case 0: /* 888; also if we have loaded vmstate from an old version */
+        case 2: /* 565 RGB */
+        default:
+            /* treat as 565 but honour BGR bit */
+            bpp_offset += (BPP_16_565 - BPP_16);
+            break;
+        }
+    }
+
+    return bpp_offset;
+}
+
 static void pl110_update_display(void *opaque)
 {
     PL110State *s = (PL110State *)opaque;
     SysBusDevice *sbd;
-    DisplaySurface *surface = qemu_console_surface(s->con);
+    DisplaySurface *surface;
     drawfn* fntable;
     drawfn fn;
     int dest_width;
     int src_width;
     int bpp_offset;
+    int shared_bpp;
     int first;
     int last;
 
@@ -147,6 +191,23 @@ static void pl110_update_display(void *opaque)
 
     sbd = SYS_BUS_DEVICE(s);
 
+    bpp_offset = pl110_bpp_offset(s);
+    /* The console takes little-endian BGR 565 and 888 as they are */
+    shared_bpp = 0;
+    if (!(s->cr & (PL110_CR_BEBO | PL110_CR_BEPO))) {
+        if (s->bpp + bpp_offset == BPP_16_565) {
+            shared_bpp = 16;
+        } else if (s->bpp + bpp_offset == BPP_32) {
+            shared_bpp = 32;
+        }
+    }
+    if (framebuffer_update_shared(s->con, sysbus_address_space(sbd),
+                                  s->upbase, s->cols, s->rows, shared_bpp,
+                                  &s->invalidate)) {
+        return;
+    }
+
+    surface = qemu_console_surface(s->con);
     switch (surface_bits_per_pixel(surface)) {
     case 0:
         return;
@@ -174,38 +235,6 @@ static void pl110_update_display(void *opaque)
         fprintf(stderr, "pl110: Bad color depth\n");
         exit(1);
     }
-    if (s->cr & PL110_CR_BGR)
-        bpp_offset = 0;
-    else
-        bpp_offset = 24;
-
-    if ((s->version != PL111) && (s->bpp == BPP_16)) {
-        /* The PL110's native 16 bit mode is 5551; however
-         * most boards with a PL110 implement an external
-         * mux which allows bits to be reshuffled to give
-         * 565 format. The mux is typically controlled by
-         * an external system register.
-         * This is controlled by a GPIO input pin
-         * so boards can wire it up to their register.
-         *
-         * The PL111 straightforwardly implements both
-         * 5551 and 565 under control of the bpp field
-         * in the LCDControl register.
-         */
-        switch (s->mux_ctrl) {
-        case 3: /* 565 BGR */
-            bpp_offset = (BPP_16_565 - BPP_16);
-            break;
-        case 1: /* 5551 */
-            break;
-        case 0: /* 888; also if we have loaded vmstate from an old version */
-        case 2: /* 565 RGB */
-        default:
-            /* treat as 565 but honour BGR bit */
-            bpp_offset += (BPP_16_565 - BPP_16);
-            break;
-        }
-    }
 
     if (s->cr & PL110_CR_BEBO)
         fn = fntable[s->bpp + 8 + bpp_offset];
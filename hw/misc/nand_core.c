@@ -58,6 +58,13 @@ struct NCore_State {
     BlockDriverState *bdrv;
     int mem_oob;
 
+    /* Raw data and OOB image files, mapped in place of a drive */
+    char *image;
+    char *oob_image;
+    uint8_t *oob_storage;
+
+    NANDTiming timing;
+
     uint8_t cle, ale, ce, wp, gnd;
 
     uint8_t io[MAX_PAGE + MAX_OOB + 0x400];
@@ -252,6 +259,7 @@ static void ncore_reset(DeviceState *d)
     s->offset = 0;
 //    s->status &= NAND_IOSTATUS_UNPROTCT;
     s->status |= NANDIST_CTRL_READY | NANDIST_FLASH_READY;
+    nand_timing_reset(&s->timing);
 
 	s->ncregs.revision=0x80000601;
 	s->ncregs.cmd_start=0x0000000;
@@ -377,10 +385,20 @@ static inline void ncore_pushio_byte(NCore_State *s, uint8_t value)
     }
 }
 
+/* The ready bits read back clear while the array is busy */
+static int ncore_status(NCore_State *s)
+{
+    if (nand_timing_busy(&s->timing)) {
+        return s->status & ~NANDIST_FLASH_READY;
+    }
+    return s->status;
+}
+
 
 static void ncore_command(NCore_State *s)
 {
     unsigned int offset;
+    int64_t block;
     switch (s->cmd) {
     case NAND_CMD_READ0:
     case NAND_CMD_READCACHEEXIT:
@@ -426,7 +444,9 @@ static void ncore_command(NCore_State *s)
 
     case NAND_CMD_PAGEPROGRAM2:
         if (s->wp) {
+            block = (s->addr >> s->addr_shift) >> s->erase_shift;
             s->blk_write(s);
+            nand_timing_begin(&s->timing, NAND_TIMING_PROGRAM, block);
         }
         break;
 
@@ -440,13 +460,15 @@ static void ncore_command(NCore_State *s)
 
         if (s->wp) {
             s->blk_erase(s);
+            nand_timing_begin(&s->timing, NAND_TIMING_ERASE,
+                              (s->addr >> s->addr_shift) >> s->erase_shift);
         }
         break;
 
     case NAND_CMD_READSTATUS:
         s->ioaddr = s->io;
         s->iolen = 0;
-        ncore_pushio_byte(s, s->status);
+        ncore_pushio_byte(s, ncore_status(s));
         break;
 
     default:
@@ -589,7 +611,19 @@ static void ncore_realize(DeviceState *dev, Error **errp)
 
     pagesize = 1 << s->oob_shift;  //0x40(64)
     s->mem_oob = 1;
-    if (s->bdrv) {
+    if (s->image) {
+        if (s->bdrv) {
+            error_setg(errp, "A NAND image can't be used along with a drive");
+            return;
+        }
+        if (nand_image_map(s->image, s->oob_image,
+                           (uint64_t)s->pages << s->page_shift,
+                           (uint64_t)s->pages << s->oob_shift,
+                           &s->storage, &s->oob_storage, errp) < 0) {
+            return;
+        }
+        pagesize = 0;
+    } else if (s->bdrv) {
         if (bdrv_is_read_only(s->bdrv)) {
             error_setg(errp, "Can't use a read-only drive");
             return;
@@ -608,6 +642,9 @@ static void ncore_realize(DeviceState *dev, Error **errp)
     }
     /* Give s->ioaddr a sane value in case we save state before it is used. */
     s->ioaddr = s->io;
+
+    nand_timing_init(&s->timing, dev, 1 << s->page_shift,
+                     s->pages >> s->erase_shift);
 DB_PRINT("%s\n size=%d\n pages=%d\n,page_shift=%d\n oob_shift=%d\n buswidth=%d\n chipid=%x\n pagesize=%d\n bdrv=%d\n storage=%lx\n mem_oob=%d\n" , __func__,s->size, s->pages, s->page_shift,s->oob_shift, s->buswidth, s->chip_id, pagesize, (uint)bdrv_getlength(s->bdrv), (int long)s->storage, s->mem_oob);
 }
 
@@ -617,6 +654,9 @@ static Property ncore_properties[] = {
     DEFINE_PROP_UINT8("manf_id", NCore_State, manf_id, 0),
     DEFINE_PROP_UINT8("chip_id", NCore_State, chip_id, 0),
     DEFINE_PROP_DRIVE("drive", NCore_State, bdrv),
+    DEFINE_PROP_STRING("image", NCore_State, image),
+    DEFINE_PROP_STRING("oob-image", NCore_State, oob_image),
+    DEFINE_NAND_TIMING_PROPERTIES(NCore_State, timing),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -673,7 +713,9 @@ void ncore_setpins(DeviceState *dev, uint8_t cle, uint8_t ale,
 
 void ncore_getpins(DeviceState *dev, int *rb)
 {
-    *rb = 1;
+    NCore_State *s = NCORE(dev);
+
+    *rb = !nand_timing_busy(&s->timing);
 }
 
 
@@ -687,8 +729,11 @@ DB_PRINT("[**%s**] cle=%x ale=%x ce=%x wp=%x gnd=%x ****s->addr=%" PRIx64 "\n",
             if (s->cmd == NAND_CMD_READ0
                 && (value == NAND_CMD_LPREAD2
                     || value == NAND_CMD_READCACHESTART
-                    || value == NAND_CMD_READCACHELAST))
+                    || value == NAND_CMD_READCACHELAST)) {
+                nand_timing_begin(&s->timing, NAND_TIMING_READ,
+                                  (s->addr >> s->addr_shift) >> s->erase_shift);
                 return;
+            }
             if (value == NAND_CMD_RANDOMREAD1) {
                 s->addr &= ~((1 << s->addr_shift) - 1);
                 s->addrlen = 0;
@@ -808,6 +853,9 @@ DB_PRINT("%s s->addr=0x%" PRIx64 " offset=0x%x cmd=0x%" PRIx32 " iolen=0x%x\n",
     if (s->ce || s->iolen <= 0) {
         return 0;
     }
+    if (s->cmd == NAND_CMD_READSTATUS) {
+        s->io[0] = ncore_status(s);
+    }
 //DB_PRINT("%s addr=%x offset=%x cmd=%x\n", __func__,(int) s->addr, (uint)offset,s->cmd);
     for (offset = s->buswidth; offset--;) {
         x |= s->ioaddr[offset] << (offset << 3);
@@ -882,7 +930,22 @@ static void glue(ncore_blk_write_, PAGE_SIZE)(NCore_State *s)
     if (PAGE(s->addr) >= s->pages)
         return;
 
-    if (!s->bdrv) {
+    if (s->oob_storage) {
+        uint64_t end;
+
+        page = PAGE(s->addr);
+        off = (s->addr & PAGE_MASK) + s->offset;
+        end = MIN(off + s->iolen, PAGE_SIZE);
+        if (end > off) {
+            mem_and(s->storage + (page << PAGE_SHIFT) + off, s->io, end - off);
+        }
+        soff = MAX(off, PAGE_SIZE);
+        end = MIN(off + s->iolen, PAGE_SIZE + OOB_SIZE);
+        if (end > soff) {
+            mem_and(s->oob_storage + (page << OOB_SHIFT) + soff - PAGE_SIZE,
+                    s->io + soff - off, end - soff);
+        }
+    } else if (!s->bdrv) {
         mem_and(s->storage + PAGE_START(s->addr) + (s->addr & PAGE_MASK) +
                         s->offset, s->io, s->iolen);
     } else if (s->mem_oob) {
@@ -933,7 +996,12 @@ static void glue(ncore_blk_erase_, PAGE_SIZE)(NCore_State *s)
         return;
     }
 
-    if (!s->bdrv) {
+    if (s->oob_storage) {
+        memset(s->storage + (PAGE(addr) << PAGE_SHIFT),
+                        0xff, PAGE_SIZE << s->erase_shift);
+        memset(s->oob_storage + (PAGE(addr) << OOB_SHIFT),
+                        0xff, OOB_SIZE << s->erase_shift);
+    } else if (!s->bdrv) {
         memset(s->storage + PAGE_START(addr),
                         0xff, (PAGE_SIZE + OOB_SIZE) << s->erase_shift);
     } else if (s->mem_oob) {
@@ -984,7 +1052,12 @@ static void glue(ncore_blk_load_, PAGE_SIZE)(NCore_State *s,
         return;
     }
 
-    if (s->bdrv) {
+    if (s->oob_storage) {
+        memcpy(s->io, s->storage + (PAGE(addr) << PAGE_SHIFT), PAGE_SIZE);
+        memcpy(s->io + PAGE_SIZE, s->oob_storage + (PAGE(addr) << OOB_SHIFT),
+                        OOB_SIZE);
+        s->ioaddr = s->io + offset;
+    } else if (s->bdrv) {
         if (s->mem_oob) {
             if (bdrv_read(s->bdrv, SECTOR(addr), s->io, PAGE_SECTORS) < 0) {
                 DB_PRINT("%s: read error in sector %" PRIu64 "\n",
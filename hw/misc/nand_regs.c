@@ -201,6 +201,9 @@ uint64_t r=0;
 
     ncore_getpins(s->nand, &rdy);
     s->rdy = rdy;
+	    if (!rdy) {
+	        return s->ncregs.intfc_status & ~NANDIST_FLASH_READY;
+	    }
 	    return s->ncregs.intfc_status;
 	case 0x018: /* cs_nand_select */
 	    return s->ncregs.cs_nand_select;
@@ -44,6 +44,9 @@ static void arm_timer_update(arm_timer_state *s)
     } else {
         qemu_irq_lower(s->irq);
     }
+    /* Further expiries change nothing until the guest clears the
+       interrupt, so let the counter run without waking up.  */
+    ptimer_set_masked(s->timer, s->int_level);
 }
 
 static uint32_t arm_timer_read(void *opaque, hwaddr offset)
@@ -28,9 +28,34 @@ typedef int ThreadPoolFunc(void *opaque);
 
 typedef struct ThreadPool ThreadPool;
 
+#define THREAD_POOL_DEFAULT_MAX_THREADS     64
+#define THREAD_POOL_DEFAULT_IDLE_TIMEOUT    10000   /* ms */
+
+/* Latency histograms use power-of-two microsecond buckets; the last
+ * bucket collects everything slower.
+ */
+#define THREAD_POOL_HIST_BUCKETS            24
+
+typedef struct ThreadPoolStats {
+    int cur_threads;
+    int idle_threads;
+    int64_t queue_depth;
+    int64_t max_queue_depth;
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t wait_hist[THREAD_POOL_HIST_BUCKETS];
+    uint64_t run_hist[THREAD_POOL_HIST_BUCKETS];
+} ThreadPoolStats;
+
 ThreadPool *thread_pool_new(struct AioContext *ctx);
 void thread_pool_free(ThreadPool *pool);
 
+void thread_pool_set_params(ThreadPool *pool, int min_threads,
+                            int max_threads, int idle_timeout);
+void thread_pool_get_params(ThreadPool *pool, int *min_threads,
+                            int *max_threads, int *idle_timeout);
+void thread_pool_get_stats(ThreadPool *pool, ThreadPoolStats *stats);
+
 BlockDriverAIOCB *thread_pool_submit_aio(ThreadPool *pool,
         ThreadPoolFunc *func, void *arg,
         BlockDriverCompletionFunc *cb, void *opaque);
@@ -88,6 +88,8 @@ void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 TranslationBlock *tb_gen_code(CPUState *cpu,
                               target_ulong pc, target_ulong cs_base, int flags,
                               int cflags);
+bool tb_gen_code_abort(void);
+void *tb_lookup_tc_ptr(CPUArchState *env);
 void cpu_exec_init(CPUArchState *env);
 void QEMU_NORETURN cpu_loop_exit(CPUState *cpu);
 int page_unprotect(target_ulong address, uintptr_t pc, void *puc);
@@ -167,13 +169,40 @@ struct TranslationBlock {
        jmp_first */
     struct TranslationBlock *jmp_next[2];
     struct TranslationBlock *jmp_first;
+#if !defined(CONFIG_USER_ONLY)
+    /* for jumps leaving the guest page of this TB: the TLB addend the
+       destination page had when the jump was linked.  The generated
+       code only follows the link while the TLB still agrees. */
+    uintptr_t jmp_addend[2];
+#endif
     uint32_t icount;
+
+    /* -tb-hot profiling: executions since translation, bumped by the
+       generated code, plus the host code size and translation time. */
+    uint64_t exec_count;
+    uint32_t tc_size;
+    int64_t gen_time;
 };
 
 #include "exec/spinlock.h"
 
+typedef struct TBRegion TBRegion;
 typedef struct TBContext TBContext;
 
+/* A slice of the code buffer and of the TB array.  A region is owned by
+   one translating thread at a time, so that several threads can
+   generate code without holding tb_lock.  */
+struct TBRegion {
+    uint8_t *code_start;
+    uint8_t *code_ptr;
+    /* threshold to stop allocating TBs from this region */
+    uint8_t *code_end;
+    TranslationBlock *tbs;
+    int nb_tbs;
+    int max_tbs;
+    bool busy;
+};
+
 struct TBContext {
 
     TranslationBlock *tbs;
@@ -182,6 +211,15 @@ struct TBContext {
     /* any access to the tbs or the page table must use this lock */
     spinlock_t tb_lock;
 
+    TBRegion *regions;
+    int nb_regions;
+    int nb_busy_regions;
+    size_t region_size;
+#ifdef CONFIG_USER_ONLY
+    /* signalled when a region is released */
+    pthread_cond_t region_cond;
+#endif
+
     /* statistics */
     int tb_flush_count;
     int tb_phys_invalidate_count;
@@ -189,6 +227,8 @@ struct TBContext {
     int tb_invalidated_flag;
 };
 
+extern TBContext tb_ctx;
+
 static inline unsigned int tb_jmp_cache_hash_page(target_ulong pc)
 {
     target_ulong tmp;
@@ -297,6 +337,11 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
     }
 }
 
+#if !defined(CONFIG_USER_ONLY)
+void tb_add_cross_page_jump(CPUArchState *env, TranslationBlock *tb, int n,
+                            TranslationBlock *tb_next);
+#endif
+
 /* GETRA is the true target of the return instruction that we'll execute,
    defined here for simplicity of defining the follow-up macros.  */
 #if defined(CONFIG_TCG_INTERPRETER)
@@ -5,11 +5,11 @@
 
 /* Helpers for instruction counting code generation.  */
 
-static TCGArg *icount_arg;
-static int icount_label;
-static int exitreq_label;
+static TCG_THREAD TCGArg *icount_arg;
+static TCG_THREAD int icount_label;
+static TCG_THREAD int exitreq_label;
 
-static inline void gen_tb_start(void)
+static inline void gen_tb_start(TranslationBlock *tb)
 {
     TCGv_i32 count;
     TCGv_i32 flag;
@@ -21,6 +21,17 @@ static inline void gen_tb_start(void)
     tcg_gen_brcondi_i32(TCG_COND_NE, flag, 0, exitreq_label);
     tcg_temp_free_i32(flag);
 
+    if (tb_profile_enabled) {
+        TCGv_ptr ptr = tcg_const_ptr(&tb->exec_count);
+        TCGv_i64 exec_count = tcg_temp_new_i64();
+
+        tcg_gen_ld_i64(exec_count, ptr, 0);
+        tcg_gen_addi_i64(exec_count, exec_count, 1);
+        tcg_gen_st_i64(exec_count, ptr, 0);
+        tcg_temp_free_i64(exec_count);
+        tcg_temp_free_ptr(ptr);
+    }
+
     if (!use_icount)
         return;
 
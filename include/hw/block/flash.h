@@ -4,6 +4,9 @@
 /* NOR flash devices */
 
 #include "exec/memory.h"
+#include "qapi/error.h"
+#include "qemu/queue.h"
+#include "hw/irq.h"
 
 typedef struct pflash_t pflash_t;
 
@@ -29,6 +32,60 @@ pflash_t *pflash_cfi02_register(hwaddr base,
 
 MemoryRegion *pflash_cfi01_get_memory(pflash_t *fl);
 
+/* flash_backing.c */
+typedef struct FlashBacking FlashBacking;
+
+FlashBacking *flash_backing_new(BlockDriverState *bs, void *storage,
+                                uint64_t size, bool lazy, Error **errp);
+void flash_backing_populate(FlashBacking *fb, uint64_t offset, uint64_t len);
+void flash_backing_discard(FlashBacking *fb, uint64_t offset, uint64_t len);
+void flash_backing_mark_dirty(FlashBacking *fb, uint64_t offset,
+                              uint64_t len);
+void flash_backing_flush(FlashBacking *fb);
+
+/* nand_timing.c */
+typedef enum {
+    NAND_TIMING_READ,
+    NAND_TIMING_PROGRAM,
+    NAND_TIMING_ERASE,
+} NANDTimingOp;
+
+typedef struct NANDTiming {
+    /* Properties; latencies are in nanoseconds, 0 means no delay */
+    uint32_t t_read;
+    uint32_t t_prog;
+    uint32_t t_erase;
+    uint32_t planes;
+
+    DeviceState *dev;
+    qemu_irq rb;            /* R/B#, high when ready */
+    QEMUTimer *timer;
+    int64_t ready;          /* QEMU_CLOCK_VIRTUAL time the chip is ready */
+    int64_t *plane_ready;
+    int page_size;
+    int nb_blocks;
+    uint32_t *erase_count;
+
+    uint64_t pages_read;
+    uint64_t pages_programmed;
+    uint64_t blocks_erased;
+    int64_t busy_ns;
+
+    QTAILQ_ENTRY(NANDTiming) next;
+} NANDTiming;
+
+#define DEFINE_NAND_TIMING_PROPERTIES(_state, _timing)          \
+    DEFINE_PROP_UINT32("t-read", _state, _timing.t_read, 0),    \
+    DEFINE_PROP_UINT32("t-prog", _state, _timing.t_prog, 0),    \
+    DEFINE_PROP_UINT32("t-erase", _state, _timing.t_erase, 0),  \
+    DEFINE_PROP_UINT32("planes", _state, _timing.planes, 1)
+
+void nand_timing_init(NANDTiming *t, DeviceState *dev, int page_size,
+                      int nb_blocks);
+void nand_timing_reset(NANDTiming *t);
+void nand_timing_begin(NANDTiming *t, NANDTimingOp op, int64_t block);
+bool nand_timing_busy(NANDTiming *t);
+
 /* nand.c */
 DeviceState *nand_init(BlockDriverState *bdrv, int manf_id, int chip_id);
 void nand_setpins(DeviceState *dev, uint8_t cle, uint8_t ale,
@@ -37,6 +94,10 @@ void nand_getpins(DeviceState *dev, int *rb);
 void nand_setio(DeviceState *dev, uint32_t value);
 uint64_t nand_getio(DeviceState *dev);
 uint32_t nand_getbuswidth(DeviceState *dev);
+/* nand_image.c */
+int nand_image_map(const char *image, const char *oob_image,
+                   uint64_t data_len, uint64_t oob_len,
+                   uint8_t **data, uint8_t **oob, Error **errp);
 /* nand_core.c */
 void ncore_cmdfunc(DeviceState *dev, uint32_t value);
 DeviceState *ncore_init(BlockDriverState *bdrv, int manf_id, int chip_id);
@@ -24,6 +24,7 @@ uint64_t ptimer_get_count(ptimer_state *s);
 void ptimer_set_count(ptimer_state *s, uint64_t count);
 void ptimer_run(ptimer_state *s, int oneshot);
 void ptimer_stop(ptimer_state *s);
+void ptimer_set_masked(ptimer_state *s, bool masked);
 
 extern const VMStateDescription vmstate_ptimer;
 
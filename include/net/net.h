@@ -56,6 +56,7 @@ typedef bool (HasVnetHdrLen)(NetClientState *, int);
 typedef void (UsingVnetHdr)(NetClientState *, bool);
 typedef void (SetOffload)(NetClientState *, int, int, int, int, int);
 typedef void (SetVnetHdrLen)(NetClientState *, int);
+typedef void (NetPrintStats)(NetClientState *, Monitor *);
 
 typedef struct NetClientInfo {
     NetClientOptionsKind type;
@@ -74,6 +75,7 @@ typedef struct NetClientInfo {
     UsingVnetHdr *using_vnet_hdr;
     SetOffload *set_offload;
     SetVnetHdrLen *set_vnet_hdr_len;
+    NetPrintStats *print_stats;
 } NetClientInfo;
 
 struct NetClientState {
@@ -125,6 +127,8 @@ ssize_t qemu_sendv_packet(NetClientState *nc, const struct iovec *iov,
                           int iovcnt);
 ssize_t qemu_sendv_packet_async(NetClientState *nc, const struct iovec *iov,
                                 int iovcnt, NetPacketSent *sent_cb);
+ssize_t qemu_sendv_packet_shared(NetClientState *nc, const struct iovec *iov,
+                                 int iovcnt, NetPacketBuf **shared);
 void qemu_send_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_send_packet_raw(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_send_packet_async(NetClientState *nc, const uint8_t *buf,
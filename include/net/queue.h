@@ -27,8 +27,16 @@
 #include "qemu-common.h"
 
 typedef struct NetPacket NetPacket;
+typedef struct NetPacketBuf NetPacketBuf;
 typedef struct NetQueue NetQueue;
 
+typedef struct NetQueueStats {
+    uint32_t depth;         /* packets queued right now */
+    uint32_t peak;          /* highest depth seen */
+    uint64_t queued;        /* packets that could not be delivered at once */
+    uint64_t dropped;       /* packets dropped because the queue was full */
+} NetQueueStats;
+
 typedef void (NetPacketSent) (NetClientState *sender, ssize_t ret);
 
 #define QEMU_NET_PACKET_FLAG_NONE  0
@@ -52,7 +60,17 @@ ssize_t qemu_net_queue_send_iov(NetQueue *queue,
                                 int iovcnt,
                                 NetPacketSent *sent_cb);
 
+ssize_t qemu_net_queue_send_shared(NetQueue *queue,
+                                   NetClientState *sender,
+                                   unsigned flags,
+                                   const struct iovec *iov,
+                                   int iovcnt,
+                                   NetPacketBuf **shared);
+
+void qemu_net_packet_buf_unref(NetPacketBuf *buf);
+
 void qemu_net_queue_purge(NetQueue *queue, NetClientState *from);
 bool qemu_net_queue_flush(NetQueue *queue);
+void qemu_net_queue_get_stats(NetQueue *queue, NetQueueStats *stats);
 
 #endif /* QEMU_NET_QUEUE_H */
@@ -271,6 +271,13 @@ typedef struct PCIHostDeviceAddress {
 void tcg_exec_init(unsigned long tb_size);
 bool tcg_enabled(void);
 
+/* TB execution profiling, enabled with -tb-hot.  Counts only cover TBs
+   translated since the last flush.  */
+extern bool tb_profile_enabled;
+extern int tb_hot_exit_count;
+void tb_hot_dump(FILE *f, fprintf_function cpu_fprintf, int count);
+void tb_hot_exit(void);
+
 void cpu_exec_init_all(void);
 
 /* CPU save/load.  */
@@ -59,10 +59,18 @@ struct QEMUTimer {
     QEMUTimerList *timer_list;
     QEMUTimerCB *cb;
     void *opaque;
-    QEMUTimer *next;
+    uint64_t seq;               /* orders timers with equal expire_time */
+    int heap_index;             /* position in the timer list's heap */
     int scale;
 };
 
+typedef struct QEMUClockStats {
+    int64_t active;             /* pending timers */
+    uint64_t rearms;            /* timer_mod*() calls that moved a timer */
+    uint64_t deadline_changes;  /* re-arms that brought the deadline forward */
+    uint64_t expired;           /* callbacks run */
+} QEMUClockStats;
+
 extern QEMUTimerListGroup main_loop_tlg;
 
 /*
@@ -228,6 +236,16 @@ void qemu_clock_register_reset_notifier(QEMUClockType type,
 void qemu_clock_unregister_reset_notifier(QEMUClockType type,
                                           Notifier *notifier);
 
+/**
+ * qemu_clock_get_stats:
+ * @type: the clock type
+ * @stats: filled with the counters of the clock
+ *
+ * Sum up the timer counters of every timer list attached
+ * to a clock.  Caller should hold BQL.
+ */
+void qemu_clock_get_stats(QEMUClockType type, QEMUClockStats *stats);
+
 /**
  * qemu_clock_run_timers:
  * @type: clock on which to operate
@@ -677,6 +695,37 @@ static inline int64_t qemu_soonest_timeout(int64_t timeout1, int64_t timeout2)
     return ((uint64_t) timeout1 < (uint64_t) timeout2) ? timeout1 : timeout2;
 }
 
+/**
+ * timer_advance_deadline:
+ * @deadline: expiry time of a periodic event, updated in place
+ * @period: the period of the event, same unit as @deadline
+ * @now: the current time
+ *
+ * Move a periodic deadline that is not in the future past @now, in one
+ * step however many periods were missed.  This lets a device model leave
+ * its timer unarmed while nothing could observe the events, and compute
+ * its state lazily when the guest looks.  A non-positive @period counts
+ * as a single expiry at @now.
+ *
+ * Returns: the number of periods that elapsed, 0 if @deadline > @now
+ */
+static inline uint64_t timer_advance_deadline(int64_t *deadline,
+                                              int64_t period, int64_t now)
+{
+    uint64_t n;
+
+    if (*deadline > now) {
+        return 0;
+    }
+    if (period <= 0) {
+        *deadline = now;
+        return 1;
+    }
+    n = (now - *deadline) / period + 1;
+    *deadline += n * period;
+    return n;
+}
+
 /**
  * initclocks:
  *
@@ -13,9 +13,12 @@
 
 #include "qom/object.h"
 #include "qom/object_interfaces.h"
+#include "qapi/qmp/qerror.h"
 #include "qemu/module.h"
 #include "block/aio.h"
+#include "block/thread-pool.h"
 #include "sysemu/iothread.h"
+#include "qemu/main-loop.h"
 #include "qmp-commands.h"
 
 #define IOTHREADS_PATH "/objects"
@@ -165,3 +168,142 @@ IOThreadInfoList *qmp_query_iothreads(Error **errp)
     object_child_foreach(container, query_one_iothread, &prev);
     return head;
 }
+
+static intList *thread_pool_hist_to_list(const uint64_t *hist)
+{
+    intList *head = NULL;
+    int i;
+
+    for (i = THREAD_POOL_HIST_BUCKETS - 1; i >= 0; i--) {
+        intList *elem = g_new0(intList, 1);
+        elem->value = hist[i];
+        elem->next = head;
+        head = elem;
+    }
+    return head;
+}
+
+static ThreadPoolInfo *query_one_thread_pool(ThreadPool *pool,
+                                             IOThread *iothread)
+{
+    ThreadPoolInfo *info = g_new0(ThreadPoolInfo, 1);
+    ThreadPoolStats stats;
+    int min_threads, max_threads, idle_timeout;
+
+    thread_pool_get_params(pool, &min_threads, &max_threads, &idle_timeout);
+    thread_pool_get_stats(pool, &stats);
+
+    if (iothread) {
+        info->has_iothread = true;
+        info->iothread = iothread_get_id(iothread);
+    }
+    info->min_threads = min_threads;
+    info->max_threads = max_threads;
+    info->idle_timeout = idle_timeout;
+    info->cur_threads = stats.cur_threads;
+    info->idle_threads = stats.idle_threads;
+    info->queue_depth = stats.queue_depth;
+    info->max_queue_depth = stats.max_queue_depth;
+    info->submitted = stats.submitted;
+    info->completed = stats.completed;
+    info->wait_histogram = thread_pool_hist_to_list(stats.wait_hist);
+    info->run_histogram = thread_pool_hist_to_list(stats.run_hist);
+    return info;
+}
+
+static int query_one_iothread_pool(Object *object, void *opaque)
+{
+    ThreadPoolInfoList ***prev = opaque;
+    ThreadPoolInfoList *elem;
+    IOThread *iothread;
+
+    iothread = (IOThread *)object_dynamic_cast(object, TYPE_IOTHREAD);
+    if (!iothread || !iothread->ctx->thread_pool) {
+        return 0;
+    }
+
+    elem = g_new0(ThreadPoolInfoList, 1);
+    elem->value = query_one_thread_pool(iothread->ctx->thread_pool, iothread);
+
+    **prev = elem;
+    *prev = &elem->next;
+    return 0;
+}
+
+ThreadPoolInfoList *qmp_query_thread_pools(Error **errp)
+{
+    ThreadPoolInfoList *head = NULL;
+    ThreadPoolInfoList **prev = &head;
+    Object *container = container_get(object_get_root(), IOTHREADS_PATH);
+    AioContext *ctx = qemu_get_aio_context();
+
+    /* Pools are created lazily on first use, do not force them into
+     * existence just to report them.
+     */
+    if (ctx->thread_pool) {
+        head = g_new0(ThreadPoolInfoList, 1);
+        head->value = query_one_thread_pool(ctx->thread_pool, NULL);
+        prev = &head->next;
+    }
+
+    object_child_foreach(container, query_one_iothread_pool, &prev);
+    return head;
+}
+
+void qmp_thread_pool_set(bool has_iothread, const char *id,
+                         bool has_min_threads, int64_t min_threads,
+                         bool has_max_threads, int64_t max_threads,
+                         bool has_idle_timeout, int64_t idle_timeout,
+                         Error **errp)
+{
+    ThreadPool *pool;
+    AioContext *ctx;
+    int cur_min, cur_max, cur_timeout;
+
+    if (has_iothread) {
+        IOThread *iothread = iothread_find(id);
+
+        if (!iothread) {
+            error_set(errp, QERR_DEVICE_NOT_FOUND, id);
+            return;
+        }
+        ctx = iothread_get_aio_context(iothread);
+    } else {
+        ctx = qemu_get_aio_context();
+    }
+
+    pool = aio_get_thread_pool(ctx);
+    thread_pool_get_params(pool, &cur_min, &cur_max, &cur_timeout);
+
+    if (has_min_threads) {
+        if (min_threads < 0 || min_threads > INT_MAX) {
+            error_set(errp, QERR_INVALID_PARAMETER_VALUE, "min-threads",
+                      "a non-negative thread count");
+            return;
+        }
+        cur_min = min_threads;
+    }
+    if (has_max_threads) {
+        if (max_threads < 1 || max_threads > INT_MAX) {
+            error_set(errp, QERR_INVALID_PARAMETER_VALUE, "max-threads",
+                      "a positive thread count");
+            return;
+        }
+        cur_max = max_threads;
+    }
+    if (has_idle_timeout) {
+        if (idle_timeout < 1 || idle_timeout > INT_MAX) {
+            error_set(errp, QERR_INVALID_PARAMETER_VALUE, "idle-timeout",
+                      "a positive number of milliseconds");
+            return;
+        }
+        cur_timeout = idle_timeout;
+    }
+    if (cur_min > cur_max) {
+        error_setg(errp, "min-threads (%d) must not exceed max-threads (%d)",
+                   cur_min, cur_max);
+        return;
+    }
+
+    thread_pool_set_params(pool, cur_min, cur_max, cur_timeout);
+}
@@ -33,20 +33,37 @@
 
 //#define DEBUG_MMAP
 
-static pthread_mutex_t mmap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t mmap_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 static __thread int mmap_lock_count;
+/* true if this thread only holds mmap_rwlock for reading */
+static __thread bool mmap_lock_shared;
 
+/* Exclude every other user of the guest memory map.  */
 void mmap_lock(void)
 {
     if (mmap_lock_count++ == 0) {
-        pthread_mutex_lock(&mmap_mutex);
+        pthread_rwlock_wrlock(&mmap_rwlock);
+    } else {
+        /* a shared hold cannot be upgraded without deadlocking */
+        assert(!mmap_lock_shared);
+    }
+}
+
+/* Keep the guest memory map stable while letting other threads do the
+   same, as translators do.  Nests inside mmap_lock().  */
+void mmap_read_lock(void)
+{
+    if (mmap_lock_count++ == 0) {
+        pthread_rwlock_rdlock(&mmap_rwlock);
+        mmap_lock_shared = true;
     }
 }
 
 void mmap_unlock(void)
 {
     if (--mmap_lock_count == 0) {
-        pthread_mutex_unlock(&mmap_mutex);
+        mmap_lock_shared = false;
+        pthread_rwlock_unlock(&mmap_rwlock);
     }
 }
 
@@ -55,15 +72,15 @@ void mmap_fork_start(void)
 {
     if (mmap_lock_count)
         abort();
-    pthread_mutex_lock(&mmap_mutex);
+    pthread_rwlock_wrlock(&mmap_rwlock);
 }
 
 void mmap_fork_end(int child)
 {
     if (child)
-        pthread_mutex_init(&mmap_mutex, NULL);
+        pthread_rwlock_init(&mmap_rwlock, NULL);
     else
-        pthread_mutex_unlock(&mmap_mutex);
+        pthread_rwlock_unlock(&mmap_rwlock);
 }
 
 /* NOTE: all the constants are the HOST ones, but addresses are target. */
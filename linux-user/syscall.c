@@ -113,6 +113,7 @@ int __clone2(int (*fn)(void *), void *child_stack_base,
 #include "cpu-uname.h"
 
 #include "qemu.h"
+#include "tcg.h"
 
 #define CLONE_NPTL_FLAGS2 (CLONE_SETTLS | \
     CLONE_PARENT_SETTID | CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID)
@@ -4232,6 +4233,7 @@ abi_long do_arch_prctl(CPUX86State *env, int code, abi_ulong addr)
 static pthread_mutex_t clone_lock = PTHREAD_MUTEX_INITIALIZER;
 typedef struct {
     CPUArchState *env;
+    TCGContext *parent_tcg_ctx;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     pthread_t thread;
@@ -4259,6 +4261,9 @@ static void *clone_func(void *arg)
         put_user_u32(info->tid, info->child_tidptr);
     if (info->parent_tidptr)
         put_user_u32(info->tid, info->parent_tidptr);
+    /* Translate with our own copy of the parent's code generator, which
+       waits below until we are done with it.  */
+    tcg_context_clone(&tcg_ctx, info->parent_tcg_ctx);
     /* Enable signals.  */
     sigprocmask(SIG_SETMASK, &info->sigmask, NULL);
     /* Signal to the parent that we're ready.  */
@@ -4324,6 +4329,7 @@ static int do_fork(CPUArchState *env, unsigned int flags, abi_ulong newsp,
         pthread_mutex_lock(&info.mutex);
         pthread_cond_init(&info.cond, NULL);
         info.env = new_env;
+        info.parent_tcg_ctx = &tcg_ctx;
         if (nptl_flags & CLONE_CHILD_SETTID)
             info.child_tidptr = child_tidptr;
         if (nptl_flags & CLONE_PARENT_SETTID)
@@ -5303,12 +5309,14 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
             thread_cpu = NULL;
             object_unref(OBJECT(cpu));
             g_free(ts);
+            tcg_pool_delete(&tcg_ctx);
             pthread_exit(NULL);
         }
 #ifdef TARGET_GPROF
         _mcleanup();
 #endif
         gdb_exit(cpu_env, arg1);
+        tb_hot_exit();
         _exit(arg1);
         ret = 0; /* avoid warning */
         break;
@@ -7112,6 +7120,7 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
         _mcleanup();
 #endif
         gdb_exit(cpu_env, arg1);
+        tb_hot_exit();
         ret = get_errno(exit_group(arg1));
         break;
 #endif
@@ -1126,6 +1126,12 @@ static void do_info_jit(Monitor *mon, const QDict *qdict)
     dump_exec_info((FILE *)mon, monitor_fprintf);
 }
 
+static void do_info_tb_hot(Monitor *mon, const QDict *qdict)
+{
+    tb_hot_dump((FILE *)mon, monitor_fprintf,
+                qdict_get_try_int(qdict, "count", 10));
+}
+
 static void do_info_history(Monitor *mon, const QDict *qdict)
 {
     int i;
@@ -2786,6 +2792,13 @@ static mon_cmd_t info_cmds[] = {
         .help       = "show dynamic compiler info",
         .mhandler.cmd = do_info_jit,
     },
+    {
+        .name       = "tb-hot",
+        .args_type  = "count:i?",
+        .params     = "[count]",
+        .help       = "show the most executed translated blocks",
+        .mhandler.cmd = do_info_tb_hot,
+    },
     {
         .name       = "kvm",
         .args_type  = "",
@@ -2965,6 +2978,20 @@ static mon_cmd_t info_cmds[] = {
         .help       = "show the TPM device",
         .mhandler.cmd = hmp_info_tpm,
     },
+    {
+        .name       = "thread-pools",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show worker thread pool statistics",
+        .mhandler.cmd = hmp_info_thread_pools,
+    },
+    {
+        .name       = "timers",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show timer statistics for each clock",
+        .mhandler.cmd = hmp_info_timers,
+    },
     {
         .name       = NULL,
     },
@@ -21,17 +21,39 @@
 #define PROTO_TCP  6
 #define PROTO_UDP 17
 
+/*
+ * The bulk of the buffer is summed as native 32-bit words into a 64-bit
+ * accumulator and folded afterwards; the one's complement sum does not
+ * depend on byte order (RFC 1071), so a byte swap at the end gives the
+ * big-endian sum.  A buffer starting at an odd offset has all its bytes
+ * in the other half of their 16-bit word, which is again just a swap.
+ */
 uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
 {
-    uint32_t sum = 0;
+    uint64_t sum64 = 0;
+    uint32_t sum;
     int i;
 
-    for (i = seq; i < seq + len; i++) {
-        if (i & 1) {
-            sum += (uint32_t)buf[i - seq];
-        } else {
-            sum += (uint32_t)buf[i - seq] << 8;
+    for (i = 0; i + 8 <= len; i += 8) {
+        uint32_t w[2];
+
+        memcpy(w, buf + i, sizeof(w));
+        sum64 += (uint64_t)w[0] + w[1];
+    }
+    while (sum64 >> 16) {
+        sum64 = (sum64 & 0xffff) + (sum64 >> 16);
+    }
+    sum = be16_to_cpu(sum64);
+
+    for (; i < len; i++) {
+        sum += i & 1 ? buf[i] : (uint32_t)buf[i] << 8;
+    }
+
+    if (seq & 1) {
+        while (sum >> 16) {
+            sum = (sum & 0xffff) + (sum >> 16);
         }
+        sum = bswap16(sum);
     }
     return sum;
 }
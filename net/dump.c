@@ -27,13 +27,59 @@
 #include "qemu/error-report.h"
 #include "qemu/log.h"
 #include "qemu/timer.h"
+#include "qemu/thread.h"
+#include "qemu/atomic.h"
+#include "qemu/iov.h"
+#include "monitor/monitor.h"
 #include "hub.h"
+#include "util.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/*
+ * Frames are written to the capture file synchronously by default.  With a
+ * ring size configured they are instead formatted into a single-producer,
+ * single-consumer ring buffer, and a writer thread copies them into the
+ * file through a shared mapping that grows DUMP_MAP_CHUNK bytes at a time.
+ * A full ring drops frames rather than stalling the iothread.
+ */
+
+#define DUMP_MAP_CHUNK  (8 * 1024 * 1024)
+
+typedef struct DumpFilter DumpFilter;
 
 typedef struct DumpState {
     NetClientState nc;
     int64_t start_ts;
     int fd;
     int pcap_caplen;
+    NetDumpFormat format;
+    DumpFilter *filter;
+
+    /* Frames that reached the file; written by the writer thread in ring
+     * mode and by dump_receive() otherwise.
+     */
+    uint64_t captured;
+    uint64_t filtered;
+    uint64_t dropped;
+
+    /* Capture ring; ring_head is only written by dump_receive(),
+     * ring_tail and everything below it only by the writer thread.
+     */
+    uint8_t *ring;
+    unsigned long ring_size;
+    unsigned long ring_head;
+    unsigned long ring_tail;
+    bool ring_stop;
+    QemuEvent ring_event;
+    QemuThread ring_thread;
+
+    uint8_t *map;
+    off_t map_off;
+    size_t map_pos;
+    bool map_error;
+    uint64_t map_lost;
 } DumpState;
 
 #define PCAP_MAGIC 0xa1b2c3d4
@@ -57,40 +103,713 @@ struct pcap_sf_pkthdr {
     uint32_t len;
 };
 
+#define PCAPNG_SHB_TYPE         0x0a0d0d0a
+#define PCAPNG_IDB_TYPE         1
+#define PCAPNG_EPB_TYPE         6
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+
+struct pcapng_file_hdr {
+    /* section header block */
+    uint32_t shb_type;
+    uint32_t shb_len;
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int64_t section_len;
+    uint32_t shb_len2;
+    /* interface description block */
+    uint32_t idb_type;
+    uint32_t idb_len;
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+    uint32_t idb_len2;
+} QEMU_PACKED;
+
+/* enhanced packet block, followed by the padded frame and block_len */
+struct pcapng_epb {
+    uint32_t type;
+    uint32_t block_len;
+    uint32_t interface;
+    uint32_t ts_high;
+    uint32_t ts_low;
+    uint32_t caplen;
+    uint32_t len;
+};
+
+/*
+ * Capture filters
+ *
+ * A small subset of the tcpdump/BPF expression syntax:
+ *
+ *   expr    := term { ("or" | "||") term }
+ *   term    := factor { ("and" | "&&") factor }
+ *   factor  := ("not" | "!") factor | "(" expr ")" | primitive
+ *   primitive := "arp" | "ip" | "ip6" | "tcp" | "udp" | "icmp"
+ *              | "host" A.B.C.D | "port" N | "ether" "host" MAC
+ *
+ * tcp, udp, icmp, host and port only match IPv4.  802.1Q tags are skipped.
+ */
+
+typedef enum DumpFilterOp {
+    DUMP_FILTER_AND,
+    DUMP_FILTER_OR,
+    DUMP_FILTER_NOT,
+    DUMP_FILTER_PROTO,
+    DUMP_FILTER_HOST,
+    DUMP_FILTER_PORT,
+    DUMP_FILTER_ETHER_HOST,
+} DumpFilterOp;
+
+struct DumpFilter {
+    DumpFilterOp op;
+    DumpFilter *left;
+    DumpFilter *right;
+    uint16_t ethertype;
+    int ipproto;
+    uint32_t addr;
+    uint16_t port;
+    uint8_t mac[6];
+};
+
+typedef struct DumpFilterParser {
+    const char *p;
+    char tok[32];
+} DumpFilterParser;
+
+typedef struct DumpFrame {
+    const uint8_t *eth;
+    uint16_t ethertype;
+    int ipproto;
+    uint32_t saddr;
+    uint32_t daddr;
+    bool has_ports;
+    uint16_t sport;
+    uint16_t dport;
+} DumpFrame;
+
+static void dump_filter_free(DumpFilter *f)
+{
+    if (f) {
+        dump_filter_free(f->left);
+        dump_filter_free(f->right);
+        g_free(f);
+    }
+}
+
+static void dump_filter_next(DumpFilterParser *ps)
+{
+    size_t n = 0;
+
+    while (qemu_isspace(*ps->p)) {
+        ps->p++;
+    }
+    if (*ps->p == '(' || *ps->p == ')') {
+        ps->tok[n++] = *ps->p++;
+    } else {
+        while (*ps->p && !qemu_isspace(*ps->p) &&
+               *ps->p != '(' && *ps->p != ')') {
+            if (n < sizeof(ps->tok) - 1) {
+                ps->tok[n++] = *ps->p;
+            }
+            ps->p++;
+        }
+    }
+    ps->tok[n] = 0;
+}
+
+static bool dump_filter_accept(DumpFilterParser *ps, const char *a,
+                               const char *b)
+{
+    if (strcmp(ps->tok, a) && (!b || strcmp(ps->tok, b))) {
+        return false;
+    }
+    dump_filter_next(ps);
+    return true;
+}
+
+static DumpFilter *dump_filter_new(DumpFilterOp op, DumpFilter *left,
+                                   DumpFilter *right)
+{
+    DumpFilter *f = g_new0(DumpFilter, 1);
+
+    f->op = op;
+    f->left = left;
+    f->right = right;
+    f->ipproto = -1;
+    return f;
+}
+
+static DumpFilter *dump_filter_parse_or(DumpFilterParser *ps);
+
+static DumpFilter *dump_filter_parse_primitive(DumpFilterParser *ps)
+{
+    static const struct {
+        const char *name;
+        uint16_t ethertype;
+        int ipproto;
+    } protos[] = {
+        { "arp",  0x0806, -1 },
+        { "ip",   0x0800, -1 },
+        { "ip6",  0x86dd, -1 },
+        { "icmp", 0x0800, 1 },
+        { "tcp",  0x0800, 6 },
+        { "udp",  0x0800, 17 },
+    };
+    DumpFilter *f;
+    unsigned int a[4];
+    char *end;
+    long port;
+    int i, n;
+
+    for (i = 0; i < ARRAY_SIZE(protos); i++) {
+        if (!strcmp(ps->tok, protos[i].name)) {
+            f = dump_filter_new(DUMP_FILTER_PROTO, NULL, NULL);
+            f->ethertype = protos[i].ethertype;
+            f->ipproto = protos[i].ipproto;
+            dump_filter_next(ps);
+            return f;
+        }
+    }
+
+    if (dump_filter_accept(ps, "host", NULL)) {
+        n = 0;
+        if (sscanf(ps->tok, "%3u.%3u.%3u.%3u%n",
+                   &a[0], &a[1], &a[2], &a[3], &n) != 4 || ps->tok[n] ||
+            a[0] > 255 || a[1] > 255 || a[2] > 255 || a[3] > 255) {
+            error_report("-net dump: invalid IPv4 address '%s' in filter",
+                         ps->tok);
+            return NULL;
+        }
+        f = dump_filter_new(DUMP_FILTER_HOST, NULL, NULL);
+        f->addr = a[0] << 24 | a[1] << 16 | a[2] << 8 | a[3];
+        dump_filter_next(ps);
+        return f;
+    }
+
+    if (dump_filter_accept(ps, "port", NULL)) {
+        port = strtol(ps->tok, &end, 10);
+        if (!ps->tok[0] || *end || port < 0 || port > 65535) {
+            error_report("-net dump: invalid port '%s' in filter", ps->tok);
+            return NULL;
+        }
+        f = dump_filter_new(DUMP_FILTER_PORT, NULL, NULL);
+        f->port = port;
+        dump_filter_next(ps);
+        return f;
+    }
+
+    if (dump_filter_accept(ps, "ether", NULL)) {
+        if (!dump_filter_accept(ps, "host", NULL)) {
+            error_report("-net dump: expected 'host' after 'ether' in filter");
+            return NULL;
+        }
+        f = dump_filter_new(DUMP_FILTER_ETHER_HOST, NULL, NULL);
+        if (net_parse_macaddr(f->mac, ps->tok) < 0) {
+            error_report("-net dump: invalid MAC address '%s' in filter",
+                         ps->tok);
+            g_free(f);
+            return NULL;
+        }
+        dump_filter_next(ps);
+        return f;
+    }
+
+    if (ps->tok[0]) {
+        error_report("-net dump: unexpected '%s' in filter", ps->tok);
+    } else {
+        error_report("-net dump: unexpected end of filter");
+    }
+    return NULL;
+}
+
+static DumpFilter *dump_filter_parse_not(DumpFilterParser *ps)
+{
+    DumpFilter *f;
+
+    if (dump_filter_accept(ps, "not", "!")) {
+        f = dump_filter_parse_not(ps);
+        return f ? dump_filter_new(DUMP_FILTER_NOT, f, NULL) : NULL;
+    }
+
+    if (dump_filter_accept(ps, "(", NULL)) {
+        f = dump_filter_parse_or(ps);
+        if (f && !dump_filter_accept(ps, ")", NULL)) {
+            error_report("-net dump: missing ')' in filter");
+            dump_filter_free(f);
+            return NULL;
+        }
+        return f;
+    }
+
+    return dump_filter_parse_primitive(ps);
+}
+
+static DumpFilter *dump_filter_parse_and(DumpFilterParser *ps)
+{
+    DumpFilter *f, *right;
+
+    f = dump_filter_parse_not(ps);
+    while (f && dump_filter_accept(ps, "and", "&&")) {
+        right = dump_filter_parse_not(ps);
+        if (!right) {
+            dump_filter_free(f);
+            return NULL;
+        }
+        f = dump_filter_new(DUMP_FILTER_AND, f, right);
+    }
+    return f;
+}
+
+static DumpFilter *dump_filter_parse_or(DumpFilterParser *ps)
+{
+    DumpFilter *f, *right;
+
+    f = dump_filter_parse_and(ps);
+    while (f && dump_filter_accept(ps, "or", "||")) {
+        right = dump_filter_parse_and(ps);
+        if (!right) {
+            dump_filter_free(f);
+            return NULL;
+        }
+        f = dump_filter_new(DUMP_FILTER_OR, f, right);
+    }
+    return f;
+}
+
+static DumpFilter *dump_filter_parse(const char *str)
+{
+    DumpFilterParser ps = { .p = str };
+    DumpFilter *f;
+
+    dump_filter_next(&ps);
+    f = dump_filter_parse_or(&ps);
+    if (f && ps.tok[0]) {
+        error_report("-net dump: unexpected '%s' in filter", ps.tok);
+        dump_filter_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+static void dump_frame_parse(DumpFrame *fr, const uint8_t *buf, size_t size)
+{
+    size_t l3 = 14;
+    size_t ihl;
+
+    memset(fr, 0, sizeof(*fr));
+    fr->eth = buf;
+    fr->ipproto = -1;
+
+    if (size < l3) {
+        return;
+    }
+    fr->ethertype = lduw_be_p(buf + 12);
+    if (fr->ethertype == 0x8100 && size >= l3 + 4) {
+        fr->ethertype = lduw_be_p(buf + 16);
+        l3 += 4;
+    }
+    if (fr->ethertype != 0x0800 || size < l3 + 20) {
+        return;
+    }
+
+    ihl = (buf[l3] & 0xf) * 4;
+    fr->ipproto = buf[l3 + 9];
+    fr->saddr = ldl_be_p(buf + l3 + 12);
+    fr->daddr = ldl_be_p(buf + l3 + 16);
+
+    /* ports are only present in the first fragment */
+    if ((fr->ipproto == 6 || fr->ipproto == 17) &&
+        !(lduw_be_p(buf + l3 + 6) & 0x1fff) && size >= l3 + ihl + 4) {
+        fr->has_ports = true;
+        fr->sport = lduw_be_p(buf + l3 + ihl);
+        fr->dport = lduw_be_p(buf + l3 + ihl + 2);
+    }
+}
+
+static bool dump_filter_match(DumpFilter *f, DumpFrame *fr)
+{
+    switch (f->op) {
+    case DUMP_FILTER_AND:
+        return dump_filter_match(f->left, fr) &&
+               dump_filter_match(f->right, fr);
+    case DUMP_FILTER_OR:
+        return dump_filter_match(f->left, fr) ||
+               dump_filter_match(f->right, fr);
+    case DUMP_FILTER_NOT:
+        return !dump_filter_match(f->left, fr);
+    case DUMP_FILTER_PROTO:
+        return fr->ethertype == f->ethertype &&
+               (f->ipproto < 0 || fr->ipproto == f->ipproto);
+    case DUMP_FILTER_HOST:
+        return fr->ethertype == 0x0800 && fr->ipproto >= 0 &&
+               (fr->saddr == f->addr || fr->daddr == f->addr);
+    case DUMP_FILTER_PORT:
+        return fr->has_ports && (fr->sport == f->port || fr->dport == f->port);
+    case DUMP_FILTER_ETHER_HOST:
+        return fr->ethertype &&
+               (!memcmp(fr->eth, f->mac, 6) || !memcmp(fr->eth + 6, f->mac, 6));
+    default:
+        abort();
+    }
+}
+
+static size_t dump_file_header(DumpState *s, uint8_t *dst)
+{
+    if (s->format == NET_DUMP_FORMAT_PCAPNG) {
+        struct pcapng_file_hdr hdr = {
+            .shb_type = PCAPNG_SHB_TYPE,
+            .shb_len = 28,
+            .magic = PCAPNG_BYTE_ORDER_MAGIC,
+            .version_major = 1,
+            .version_minor = 0,
+            .section_len = -1,
+            .shb_len2 = 28,
+            .idb_type = PCAPNG_IDB_TYPE,
+            .idb_len = 20,
+            .linktype = 1,
+            .snaplen = s->pcap_caplen,
+            .idb_len2 = 20,
+        };
+
+        memcpy(dst, &hdr, sizeof(hdr));
+        return sizeof(hdr);
+    } else {
+        struct pcap_file_hdr hdr = {
+            .magic = PCAP_MAGIC,
+            .version_major = 2,
+            .version_minor = 4,
+            .snaplen = s->pcap_caplen,
+            .linktype = 1,
+        };
+
+        memcpy(dst, &hdr, sizeof(hdr));
+        return sizeof(hdr);
+    }
+}
+
+static size_t dump_record_size(DumpState *s, size_t caplen)
+{
+    if (s->format == NET_DUMP_FORMAT_PCAPNG) {
+        return sizeof(struct pcapng_epb) + ROUND_UP(caplen, 4) +
+               sizeof(uint32_t);
+    }
+    return sizeof(struct pcap_sf_pkthdr) + caplen;
+}
+
+/* Build the iovec of one capture record for a frame at @ts microseconds.
+ * @hdr must have room for the largest record header; return the number of
+ * iovec entries used, at most 4.
+ */
+static int dump_record_iov(DumpState *s, struct iovec *iov, uint8_t *hdr,
+                           uint32_t *block_len, int64_t ts,
+                           const uint8_t *buf, size_t caplen, size_t size)
+{
+    static const uint8_t pad[4];
+
+    iov[1].iov_base = (void *)buf;
+    iov[1].iov_len = caplen;
+
+    if (s->format == NET_DUMP_FORMAT_PCAPNG) {
+        struct pcapng_epb epb = {
+            .type = PCAPNG_EPB_TYPE,
+            .block_len = dump_record_size(s, caplen),
+            .interface = 0,
+            .ts_high = ts >> 32,
+            .ts_low = ts,
+            .caplen = caplen,
+            .len = size,
+        };
+
+        memcpy(hdr, &epb, sizeof(epb));
+        iov[0].iov_base = hdr;
+        iov[0].iov_len = sizeof(epb);
+        iov[2].iov_base = (void *)pad;
+        iov[2].iov_len = ROUND_UP(caplen, 4) - caplen;
+        *block_len = epb.block_len;
+        iov[3].iov_base = block_len;
+        iov[3].iov_len = sizeof(*block_len);
+        return 4;
+    } else {
+        struct pcap_sf_pkthdr pkthdr;
+
+        pkthdr.ts.tv_sec = ts / 1000000;
+        pkthdr.ts.tv_usec = ts % 1000000;
+        pkthdr.caplen = caplen;
+        pkthdr.len = size;
+        memcpy(hdr, &pkthdr, sizeof(pkthdr));
+        iov[0].iov_base = hdr;
+        iov[0].iov_len = sizeof(pkthdr);
+        return 2;
+    }
+}
+
+#ifndef _WIN32
+static int dump_map_write(DumpState *s, const uint8_t *data, size_t len)
+{
+    void *map;
+    size_t n;
+
+    while (len) {
+        if (!s->map || s->map_pos == DUMP_MAP_CHUNK) {
+            if (s->map) {
+                munmap(s->map, DUMP_MAP_CHUNK);
+                s->map = NULL;
+                s->map_off += DUMP_MAP_CHUNK;
+                s->map_pos = 0;
+            }
+            /* Allocate the blocks up front where possible, so that a
+             * full disk shows up here and not as SIGBUS on the mapping.
+             */
+#ifdef CONFIG_FALLOCATE
+            if (fallocate(s->fd, 0, s->map_off, DUMP_MAP_CHUNK) < 0 &&
+                errno != EOPNOTSUPP) {
+                return -1;
+            }
+#endif
+            if (ftruncate(s->fd, s->map_off + DUMP_MAP_CHUNK) < 0) {
+                return -1;
+            }
+            map = mmap(NULL, DUMP_MAP_CHUNK, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, s->fd, s->map_off);
+            if (map == MAP_FAILED) {
+                return -1;
+            }
+            s->map = map;
+        }
+
+        n = MIN(len, DUMP_MAP_CHUNK - s->map_pos);
+        memcpy(s->map + s->map_pos, data, n);
+        s->map_pos += n;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void dump_map_close(DumpState *s)
+{
+    if (s->map) {
+        munmap(s->map, DUMP_MAP_CHUNK);
+        s->map = NULL;
+    }
+    if (ftruncate(s->fd, s->map_off + s->map_pos) < 0) {
+        qemu_log("-net dump truncate error: %s\n", strerror(errno));
+    }
+}
+
+/* Each ring entry is a 32-bit record length followed by the record, padded
+ * to 8 bytes.  A zero length tells the writer to continue at the start of
+ * the ring.
+ */
+static bool dump_ring_put(DumpState *s, int64_t ts, const uint8_t *buf,
+                          size_t caplen, size_t size)
+{
+    uint8_t hdr[sizeof(struct pcapng_epb)];
+    uint32_t block_len;
+    struct iovec iov[4];
+    int iovcnt;
+    size_t rec = dump_record_size(s, caplen);
+    unsigned long need = ROUND_UP(sizeof(uint32_t) + rec, 8);
+    unsigned long head = s->ring_head;
+    unsigned long tail = atomic_mb_read(&s->ring_tail);
+    unsigned long off = head & (s->ring_size - 1);
+    unsigned long pad = 0;
+
+    if (off + need > s->ring_size) {
+        pad = s->ring_size - off;
+    }
+    if (head + pad + need - tail > s->ring_size) {
+        return false;
+    }
+
+    if (pad) {
+        stl_p(s->ring + off, 0);
+        off = 0;
+    }
+    stl_p(s->ring + off, rec);
+    iovcnt = dump_record_iov(s, iov, hdr, &block_len, ts, buf, caplen, size);
+    iov_to_buf(iov, iovcnt, 0, s->ring + off + sizeof(uint32_t), rec);
+
+    smp_wmb();
+    atomic_set(&s->ring_head, head + pad + need);
+    qemu_event_set(&s->ring_event);
+    return true;
+}
+
+static void dump_ring_drain(DumpState *s)
+{
+    unsigned long head = atomic_mb_read(&s->ring_head);
+    unsigned long tail = s->ring_tail;
+    unsigned long off;
+    uint32_t rec;
+
+    while (tail != head) {
+        off = tail & (s->ring_size - 1);
+        rec = ldl_p(s->ring + off);
+        if (!rec) {
+            tail += s->ring_size - off;
+        } else {
+            if (!s->map_error &&
+                dump_map_write(s, s->ring + off + sizeof(uint32_t), rec) < 0) {
+                qemu_log("-net dump write error - stop dump\n");
+                atomic_mb_set(&s->map_error, true);
+            }
+            if (s->map_error) {
+                s->map_lost++;
+            } else {
+                s->captured++;
+            }
+            tail += ROUND_UP(sizeof(uint32_t) + rec, 8);
+        }
+        atomic_mb_set(&s->ring_tail, tail);
+    }
+}
+
+static void *dump_ring_thread(void *opaque)
+{
+    DumpState *s = opaque;
+
+    for (;;) {
+        qemu_event_reset(&s->ring_event);
+        dump_ring_drain(s);
+        if (atomic_mb_read(&s->ring_stop)) {
+            dump_ring_drain(s);
+            break;
+        }
+        qemu_event_wait(&s->ring_event);
+    }
+
+    dump_map_close(s);
+    return NULL;
+}
+
+static int dump_ring_start(DumpState *s, uint64_t ring_size)
+{
+    uint8_t hdr[sizeof(struct pcapng_file_hdr)];
+    uint64_t need;
+
+    /* Must hold the largest record twice, counting wrap padding */
+    need = ROUND_UP(sizeof(uint32_t) + dump_record_size(s, s->pcap_caplen), 8);
+    if (ring_size < 2 * need || ring_size > (1ULL << 31)) {
+        error_report("-net dump: ring size must be between %" PRIu64
+                     " and %llu bytes", 2 * need, 1ULL << 31);
+        return -1;
+    }
+
+    if (dump_map_write(s, hdr, dump_file_header(s, hdr)) < 0) {
+        error_report("-net dump write error: %s", strerror(errno));
+        dump_map_close(s);
+        return -1;
+    }
+
+    s->ring_size = pow2floor(ring_size);
+    if (s->ring_size < ring_size) {
+        s->ring_size <<= 1;
+    }
+    s->ring = qemu_memalign(8, s->ring_size);
+    qemu_event_init(&s->ring_event, false);
+    qemu_thread_create(&s->ring_thread, "net_dump", dump_ring_thread, s,
+                       QEMU_THREAD_JOINABLE);
+    return 0;
+}
+
+static void dump_ring_stop(DumpState *s)
+{
+    atomic_mb_set(&s->ring_stop, true);
+    qemu_event_set(&s->ring_event);
+    qemu_thread_join(&s->ring_thread);
+    qemu_event_destroy(&s->ring_event);
+    qemu_vfree(s->ring);
+    s->ring = NULL;
+}
+#else
+static bool dump_ring_put(DumpState *s, int64_t ts, const uint8_t *buf,
+                          size_t caplen, size_t size)
+{
+    abort();
+}
+
+static int dump_ring_start(DumpState *s, uint64_t ring_size)
+{
+    error_report("-net dump: ring is not supported on this host");
+    return -1;
+}
+
+static void dump_ring_stop(DumpState *s)
+{
+    abort();
+}
+#endif
+
 static ssize_t dump_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
     DumpState *s = DO_UPCAST(DumpState, nc, nc);
-    struct pcap_sf_pkthdr hdr;
+    uint8_t hdr[sizeof(struct pcapng_epb)];
+    uint32_t block_len;
+    struct iovec iov[4];
+    DumpFrame fr;
     int64_t ts;
-    int caplen;
+    size_t caplen;
+    int iovcnt;
 
     /* Early return in case of previous error. */
     if (s->fd < 0) {
         return size;
     }
 
+    if (s->filter) {
+        dump_frame_parse(&fr, buf, size);
+        if (!dump_filter_match(s->filter, &fr)) {
+            s->filtered++;
+            return size;
+        }
+    }
+
     ts = muldiv64(qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL), 1000000, get_ticks_per_sec());
+    ts += s->start_ts * 1000000;
     caplen = size > s->pcap_caplen ? s->pcap_caplen : size;
 
-    hdr.ts.tv_sec = ts / 1000000 + s->start_ts;
-    hdr.ts.tv_usec = ts % 1000000;
-    hdr.caplen = caplen;
-    hdr.len = size;
-    if (write(s->fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
-        write(s->fd, buf, caplen) != caplen) {
+    if (s->ring) {
+        /* Once the writer has failed, nothing more reaches the file */
+        if (atomic_mb_read(&s->map_error) ||
+            !dump_ring_put(s, ts, buf, caplen, size)) {
+            s->dropped++;
+        }
+        return size;
+    }
+
+    iovcnt = dump_record_iov(s, iov, hdr, &block_len, ts, buf, caplen, size);
+    if (writev(s->fd, iov, iovcnt) != dump_record_size(s, caplen)) {
         qemu_log("-net dump write error - stop dump\n");
         close(s->fd);
         s->fd = -1;
+        return size;
     }
+    s->captured++;
 
     return size;
 }
 
+static void dump_print_stats(NetClientState *nc, Monitor *mon)
+{
+    DumpState *s = DO_UPCAST(DumpState, nc, nc);
+
+    monitor_printf(mon, "    capture: packets=%" PRIu64 ",filtered=%" PRIu64
+                   ",dropped=%" PRIu64 "\n",
+                   atomic_read(&s->captured), s->filtered,
+                   s->dropped + atomic_read(&s->map_lost));
+}
+
 static void dump_cleanup(NetClientState *nc)
 {
     DumpState *s = DO_UPCAST(DumpState, nc, nc);
 
+    if (s->ring) {
+        dump_ring_stop(s);
+    }
     close(s->fd);
+    dump_filter_free(s->filter);
 }
 
 static NetClientInfo net_dump_info = {
@@ -98,46 +817,64 @@ static NetClientInfo net_dump_info = {
     .size = sizeof(DumpState),
     .receive = dump_receive,
     .cleanup = dump_cleanup,
+    .print_stats = dump_print_stats,
 };
 
 static int net_dump_init(NetClientState *peer, const char *device,
-                         const char *name, const char *filename, int len)
+                         const char *name, const char *filename, int len,
+                         NetDumpFormat format, const char *filter,
+                         uint64_t ring)
 {
-    struct pcap_file_hdr hdr;
+    uint8_t hdr[sizeof(struct pcapng_file_hdr)];
     NetClientState *nc;
     DumpState *s;
+    DumpFilter *f = NULL;
     struct tm tm;
+    size_t hdr_len;
     int fd;
 
-    fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY, 0644);
-    if (fd < 0) {
-        error_report("-net dump: can't open %s", filename);
-        return -1;
+    if (filter) {
+        f = dump_filter_parse(filter);
+        if (!f) {
+            return -1;
+        }
     }
 
-    hdr.magic = PCAP_MAGIC;
-    hdr.version_major = 2;
-    hdr.version_minor = 4;
-    hdr.thiszone = 0;
-    hdr.sigfigs = 0;
-    hdr.snaplen = len;
-    hdr.linktype = 1;
-
-    if (write(fd, &hdr, sizeof(hdr)) < sizeof(hdr)) {
-        error_report("-net dump write error: %s", strerror(errno));
-        close(fd);
+    fd = open(filename, O_CREAT | O_TRUNC | O_BINARY |
+              (ring ? O_RDWR : O_WRONLY), 0644);
+    if (fd < 0) {
+        error_report("-net dump: can't open %s", filename);
+        dump_filter_free(f);
         return -1;
     }
 
     nc = qemu_new_net_client(&net_dump_info, peer, device, name);
 
     snprintf(nc->info_str, sizeof(nc->info_str),
-             "dump to %s (len=%d)", filename, len);
+             "dump to %s (len=%d%s%s)", filename, len,
+             format == NET_DUMP_FORMAT_PCAPNG ? ",pcapng" : "",
+             ring ? ",ring" : "");
 
     s = DO_UPCAST(DumpState, nc, nc);
 
     s->fd = fd;
     s->pcap_caplen = len;
+    s->format = format;
+    s->filter = f;
+
+    if (ring) {
+        if (dump_ring_start(s, ring) < 0) {
+            qemu_del_net_client(nc);
+            return -1;
+        }
+    } else {
+        hdr_len = dump_file_header(s, hdr);
+        if (write(fd, hdr, hdr_len) < hdr_len) {
+            error_report("-net dump write error: %s", strerror(errno));
+            qemu_del_net_client(nc);
+            return -1;
+        }
+    }
 
     qemu_get_timedate(&tm, 0);
     s->start_ts = mktime(&tm);
@@ -181,5 +918,8 @@ int net_init_dump(const NetClientOptions *opts, const char *name,
         len = 65536;
     }
 
-    return net_dump_init(peer, "dump", name, file, len);
+    return net_dump_init(peer, "dump", name, file, len,
+                         dump->has_format ? dump->format : NET_DUMP_FORMAT_PCAP,
+                         dump->has_filter ? dump->filter : NULL,
+                         dump->has_ring ? dump->ring : 0);
 }
@@ -17,13 +17,24 @@
 #include "clients.h"
 #include "hub.h"
 #include "qemu/iov.h"
+#include "qemu/timer.h"
 
 /*
  * A hub broadcasts incoming packets to all its ports except the source port.
  * Hubs can be used to provide independent network segments, also confusingly
  * named the QEMU 'vlan' feature.
+ *
+ * In learning mode the hub behaves like a switch instead: it remembers the
+ * port each source MAC address was last seen on and sends unicast frames for
+ * a known address to that port only.  Broadcast, multicast and unknown
+ * destinations are still flooded.  Frames that have to be queued on several
+ * ports share a single copy of the payload.
  */
 
+#define NET_HUB_MAC_BITS    8
+#define NET_HUB_MAC_SIZE    (1 << NET_HUB_MAC_BITS)
+#define NET_HUB_MAC_AGE_MS  (300 * 1000)
+
 typedef struct NetHub NetHub;
 
 typedef struct NetHubPort {
@@ -33,51 +44,116 @@ typedef struct NetHubPort {
     int id;
 } NetHubPort;
 
+/* MAC learning table entry, direct mapped; a collision simply evicts the
+ * older address, which then gets flooded until it is learned again.
+ */
+typedef struct NetHubMac {
+    uint8_t addr[6];
+    NetHubPort *port;
+    int64_t seen;
+} NetHubMac;
+
 struct NetHub {
     int id;
     QLIST_ENTRY(NetHub) next;
     int num_ports;
     QLIST_HEAD(, NetHubPort) ports;
+
+    bool learning;
+    NetHubMac *macs;
+    uint64_t forwarded;
+    uint64_t flooded;
+    uint64_t filtered;
 };
 
 static QLIST_HEAD(, NetHub) hubs = QLIST_HEAD_INITIALIZER(&hubs);
 
-static ssize_t net_hub_receive(NetHub *hub, NetHubPort *source_port,
-                               const uint8_t *buf, size_t len)
+static NetHubMac *net_hub_mac_entry(NetHub *hub, const uint8_t *addr)
 {
-    NetHubPort *port;
+    uint32_t h = addr[3] << 16 | addr[4] << 8 | addr[5];
 
-    QLIST_FOREACH(port, &hub->ports, next) {
-        if (port == source_port) {
-            continue;
-        }
+    h ^= (addr[1] << 8 | addr[2]) * 31;
+    return &hub->macs[(h * 2654435761u) >> (32 - NET_HUB_MAC_BITS)];
+}
+
+/* Learn the source address of a frame and look up the port its
+ * destination lives behind; NULL means the frame must be flooded.
+ */
+static NetHubPort *net_hub_switch(NetHub *hub, NetHubPort *source_port,
+                                  const uint8_t *eth)
+{
+    int64_t now = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+    NetHubMac *mac;
+
+    if (!(eth[6] & 1)) {
+        mac = net_hub_mac_entry(hub, eth + 6);
+        memcpy(mac->addr, eth + 6, 6);
+        mac->port = source_port;
+        mac->seen = now;
+    }
 
-        qemu_send_packet(&port->nc, buf, len);
+    if (eth[0] & 1) {
+        return NULL;
     }
-    return len;
+    mac = net_hub_mac_entry(hub, eth);
+    if (!mac->port || memcmp(mac->addr, eth, 6) != 0 ||
+        now - mac->seen > NET_HUB_MAC_AGE_MS) {
+        return NULL;
+    }
+    return mac->port;
 }
 
 static ssize_t net_hub_receive_iov(NetHub *hub, NetHubPort *source_port,
                                    const struct iovec *iov, int iovcnt)
 {
     NetHubPort *port;
+    NetPacketBuf *shared = NULL;
     ssize_t len = iov_size(iov, iovcnt);
+    uint8_t eth[12];
 
+    if (hub->learning &&
+        iov_to_buf(iov, iovcnt, 0, eth, sizeof(eth)) == sizeof(eth)) {
+        port = net_hub_switch(hub, source_port, eth);
+        if (port == source_port) {
+            hub->filtered++;
+            return len;
+        }
+        if (port) {
+            hub->forwarded++;
+            qemu_sendv_packet_shared(&port->nc, iov, iovcnt, &shared);
+            qemu_net_packet_buf_unref(shared);
+            return len;
+        }
+    }
+
+    hub->flooded++;
     QLIST_FOREACH(port, &hub->ports, next) {
         if (port == source_port) {
             continue;
         }
 
-        qemu_sendv_packet(&port->nc, iov, iovcnt);
+        qemu_sendv_packet_shared(&port->nc, iov, iovcnt, &shared);
     }
+    qemu_net_packet_buf_unref(shared);
     return len;
 }
 
+static ssize_t net_hub_receive(NetHub *hub, NetHubPort *source_port,
+                               const uint8_t *buf, size_t len)
+{
+    struct iovec iov = {
+        .iov_base = (uint8_t *)buf,
+        .iov_len = len,
+    };
+
+    return net_hub_receive_iov(hub, source_port, &iov, 1);
+}
+
 static NetHub *net_hub_new(int id)
 {
     NetHub *hub;
 
-    hub = g_malloc(sizeof(*hub));
+    hub = g_malloc0(sizeof(*hub));
     hub->id = id;
     hub->num_ports = 0;
     QLIST_INIT(&hub->ports);
@@ -125,8 +201,16 @@ static ssize_t net_hub_port_receive_iov(NetClientState *nc,
 static void net_hub_port_cleanup(NetClientState *nc)
 {
     NetHubPort *port = DO_UPCAST(NetHubPort, nc, nc);
+    NetHub *hub = port->hub;
+    int i;
 
     QLIST_REMOVE(port, next);
+
+    for (i = 0; hub->macs && i < NET_HUB_MAC_SIZE; i++) {
+        if (hub->macs[i].port == port) {
+            hub->macs[i].port = NULL;
+        }
+    }
 }
 
 static NetClientInfo net_hub_port_info = {
@@ -243,7 +327,13 @@ void net_hub_info(Monitor *mon)
     NetHubPort *port;
 
     QLIST_FOREACH(hub, &hubs, next) {
-        monitor_printf(mon, "hub %d\n", hub->id);
+        monitor_printf(mon, "hub %d", hub->id);
+        if (hub->learning) {
+            monitor_printf(mon, ": learning, forwarded=%" PRIu64
+                           " flooded=%" PRIu64 " filtered=%" PRIu64,
+                           hub->forwarded, hub->flooded, hub->filtered);
+        }
+        monitor_printf(mon, "\n");
         QLIST_FOREACH(port, &hub->ports, next) {
             if (port->nc.peer) {
                 monitor_printf(mon, " \\ ");
@@ -281,6 +371,8 @@ int net_init_hubport(const NetClientOptions *opts, const char *name,
                      NetClientState *peer)
 {
     const NetdevHubPortOptions *hubport;
+    NetHubPort *port;
+    NetClientState *nc;
 
     assert(opts->kind == NET_CLIENT_OPTIONS_KIND_HUBPORT);
     hubport = opts->hubport;
@@ -290,7 +382,14 @@ int net_init_hubport(const NetClientOptions *opts, const char *name,
         return -EINVAL;
     }
 
-    net_hub_add_port(hubport->hubid, name);
+    nc = net_hub_add_port(hubport->hubid, name);
+    port = DO_UPCAST(NetHubPort, nc, nc);
+
+    /* Once enabled by any of its ports, learning applies to the whole hub */
+    if (hubport->has_learning && hubport->learning && !port->hub->learning) {
+        port->hub->learning = true;
+        port->hub->macs = g_new0(NetHubMac, NET_HUB_MAC_SIZE);
+    }
     return 0;
 }
 
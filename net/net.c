@@ -608,6 +608,23 @@ qemu_sendv_packet(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return qemu_sendv_packet_async(nc, iov, iovcnt, NULL);
 }
 
+ssize_t qemu_sendv_packet_shared(NetClientState *sender,
+                                 const struct iovec *iov, int iovcnt,
+                                 NetPacketBuf **shared)
+{
+    NetQueue *queue;
+
+    if (sender->link_down || !sender->peer) {
+        return iov_size(iov, iovcnt);
+    }
+
+    queue = sender->peer->incoming_queue;
+
+    return qemu_net_queue_send_shared(queue, sender,
+                                      QEMU_NET_PACKET_FLAG_NONE,
+                                      iov, iovcnt, shared);
+}
+
 NetClientState *qemu_find_netdev(const char *id)
 {
     NetClientState *nc;
@@ -1023,6 +1040,19 @@ void print_net_client(Monitor *mon, NetClientState *nc)
                    nc->queue_index,
                    NetClientOptionsKind_lookup[nc->info->type],
                    nc->info_str);
+    if (nc->info->print_stats) {
+        nc->info->print_stats(nc, mon);
+    }
+    if (nc->incoming_queue) {
+        NetQueueStats stats;
+
+        qemu_net_queue_get_stats(nc->incoming_queue, &stats);
+        if (stats.queued || stats.dropped) {
+            monitor_printf(mon, "    queue: depth=%u,peak=%u,queued=%" PRIu64
+                           ",dropped=%" PRIu64 "\n", stats.depth, stats.peak,
+                           stats.queued, stats.dropped);
+        }
+    }
 }
 
 RxFilterInfoList *qmp_query_rx_filter(bool has_name, const char *name,
@@ -24,6 +24,7 @@
 #include "net/queue.h"
 #include "qemu/queue.h"
 #include "net/net.h"
+#include "qemu/iov.h"
 
 /* The delivery handler may only return zero if it will call
  * qemu_net_queue_flush() when it determines that it is once again able
@@ -37,27 +38,98 @@
  *
  * If a sent callback isn't provided, we just drop the packet to avoid
  * unbounded queueing.
+ *
+ * Senders that fan the same frame out to several queues (the hub) can use
+ * qemu_net_queue_send_shared().  The payload is copied into a reference
+ * counted NetPacketBuf the first time one of the queues has to keep it,
+ * and every other queue holding the frame takes a reference to that copy.
+ *
+ * Delivered packets are not freed but kept on per-queue free lists, so a
+ * queue that is busy all the time stops allocating once it has warmed up.
+ * Packets that only point to a shared payload come from a header-only
+ * pool.  Payloads up to NET_QUEUE_SMALL_SIZE bytes, i.e. a frame at the
+ * standard 1500 byte MTU plus link and vnet headers, use the small pool;
+ * anything up to NET_BUFSIZE, e.g. a TSO segment, uses the large one.
+ * Only bigger packets, which no backend produces, go straight to the
+ * allocator.  Shared payloads are recycled the same way, through global
+ * free lists since they do not belong to any one queue; like the rest of
+ * the net layer they are only touched under the iothread lock.
  */
 
+#define NET_QUEUE_HEADER_POOL   256
+#define NET_QUEUE_SMALL_SIZE    2048
+#define NET_QUEUE_SMALL_POOL    256
+#define NET_QUEUE_LARGE_POOL    16
+
+enum {
+    NET_PACKET_POOL_HEADER,
+    NET_PACKET_POOL_SMALL,
+    NET_PACKET_POOL_LARGE,
+    NET_PACKET_POOLS,
+    NET_PACKET_POOL_NONE = NET_PACKET_POOLS,
+};
+
+struct NetPacketBuf {
+    int refcnt;
+    size_t size;
+    int pool;
+    QSLIST_ENTRY(NetPacketBuf) next;
+    uint8_t data[0];
+};
+
+typedef struct NetPacketBufPool {
+    QSLIST_HEAD(, NetPacketBuf) free;
+    size_t size;
+    uint32_t count;
+    uint32_t max;
+} NetPacketBufPool;
+
+static NetPacketBufPool net_packet_buf_pools[] = {
+    { .size = NET_QUEUE_SMALL_SIZE, .max = NET_QUEUE_SMALL_POOL },
+    { .size = NET_BUFSIZE, .max = NET_QUEUE_LARGE_POOL },
+};
+
 struct NetPacket {
     QTAILQ_ENTRY(NetPacket) entry;
     NetClientState *sender;
     unsigned flags;
     int size;
     NetPacketSent *sent_cb;
+    NetPacketBuf *shared;
+    int pool;
     uint8_t data[0];
 };
 
+typedef struct NetPacketPool {
+    QTAILQ_HEAD(, NetPacket) free;
+    size_t size;
+    uint32_t count;
+    uint32_t max;
+} NetPacketPool;
+
 struct NetQueue {
     void *opaque;
     uint32_t nq_maxlen;
     uint32_t nq_count;
+    uint32_t nq_peak;
+    uint64_t nq_queued;
+    uint64_t nq_dropped;
 
     QTAILQ_HEAD(packets, NetPacket) packets;
+    NetPacketPool pools[NET_PACKET_POOLS];
 
     unsigned delivering : 1;
 };
 
+static void qemu_net_packet_pool_init(NetPacketPool *pool, size_t size,
+                                      uint32_t max)
+{
+    QTAILQ_INIT(&pool->free);
+    pool->size = size;
+    pool->count = 0;
+    pool->max = max;
+}
+
 NetQueue *qemu_new_net_queue(void *opaque)
 {
     NetQueue *queue;
@@ -69,21 +141,139 @@ NetQueue *qemu_new_net_queue(void *opaque)
     queue->nq_count = 0;
 
     QTAILQ_INIT(&queue->packets);
+    qemu_net_packet_pool_init(&queue->pools[NET_PACKET_POOL_HEADER],
+                              0, NET_QUEUE_HEADER_POOL);
+    qemu_net_packet_pool_init(&queue->pools[NET_PACKET_POOL_SMALL],
+                              NET_QUEUE_SMALL_SIZE, NET_QUEUE_SMALL_POOL);
+    qemu_net_packet_pool_init(&queue->pools[NET_PACKET_POOL_LARGE],
+                              NET_BUFSIZE, NET_QUEUE_LARGE_POOL);
 
     queue->delivering = 0;
 
     return queue;
 }
 
+static NetPacketBuf *qemu_net_packet_buf_alloc(size_t size)
+{
+    NetPacketBufPool *pool;
+    NetPacketBuf *buf;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(net_packet_buf_pools); i++) {
+        pool = &net_packet_buf_pools[i];
+        if (size > pool->size) {
+            continue;
+        }
+        buf = QSLIST_FIRST(&pool->free);
+        if (buf) {
+            QSLIST_REMOVE_HEAD(&pool->free, next);
+            pool->count--;
+        } else {
+            buf = g_malloc(sizeof(NetPacketBuf) + pool->size);
+            buf->pool = i;
+        }
+        return buf;
+    }
+
+    buf = g_malloc(sizeof(NetPacketBuf) + size);
+    buf->pool = -1;
+    return buf;
+}
+
+void qemu_net_packet_buf_unref(NetPacketBuf *buf)
+{
+    NetPacketBufPool *pool;
+
+    if (!buf || --buf->refcnt > 0) {
+        return;
+    }
+
+    if (buf->pool >= 0) {
+        pool = &net_packet_buf_pools[buf->pool];
+        if (pool->count < pool->max) {
+            QSLIST_INSERT_HEAD(&pool->free, buf, next);
+            pool->count++;
+            return;
+        }
+    }
+    g_free(buf);
+}
+
+static NetPacket *qemu_net_packet_alloc(NetQueue *queue, size_t size)
+{
+    NetPacketPool *pool;
+    NetPacket *packet;
+    int i;
+
+    for (i = 0; i < NET_PACKET_POOLS; i++) {
+        pool = &queue->pools[i];
+        if (size > pool->size) {
+            continue;
+        }
+        packet = QTAILQ_FIRST(&pool->free);
+        if (packet) {
+            QTAILQ_REMOVE(&pool->free, packet, entry);
+            pool->count--;
+        } else {
+            packet = g_malloc(sizeof(NetPacket) + pool->size);
+            packet->pool = i;
+        }
+        return packet;
+    }
+
+    packet = g_malloc(sizeof(NetPacket) + size);
+    packet->pool = NET_PACKET_POOL_NONE;
+    return packet;
+}
+
+static void qemu_net_packet_free(NetQueue *queue, NetPacket *packet)
+{
+    NetPacketPool *pool;
+
+    qemu_net_packet_buf_unref(packet->shared);
+
+    if (packet->pool != NET_PACKET_POOL_NONE) {
+        pool = &queue->pools[packet->pool];
+        if (pool->count < pool->max) {
+            QTAILQ_INSERT_HEAD(&pool->free, packet, entry);
+            pool->count++;
+            return;
+        }
+    }
+    g_free(packet);
+}
+
+static void qemu_net_queue_enqueue(NetQueue *queue, NetPacket *packet)
+{
+    queue->nq_count++;
+    queue->nq_queued++;
+    queue->nq_peak = MAX(queue->nq_peak, queue->nq_count);
+    QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
+}
+
+static const uint8_t *qemu_net_packet_data(NetPacket *packet)
+{
+    return packet->shared ? packet->shared->data : packet->data;
+}
+
 void qemu_del_net_queue(NetQueue *queue)
 {
     NetPacket *packet, *next;
+    int i;
 
     QTAILQ_FOREACH_SAFE(packet, &queue->packets, entry, next) {
         QTAILQ_REMOVE(&queue->packets, packet, entry);
+        qemu_net_packet_buf_unref(packet->shared);
         g_free(packet);
     }
 
+    for (i = 0; i < NET_PACKET_POOLS; i++) {
+        QTAILQ_FOREACH_SAFE(packet, &queue->pools[i].free, entry, next) {
+            QTAILQ_REMOVE(&queue->pools[i].free, packet, entry);
+            g_free(packet);
+        }
+    }
+
     g_free(queue);
 }
 
@@ -97,17 +287,18 @@ static void qemu_net_queue_append(NetQueue *queue,
     NetPacket *packet;
 
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
+        queue->nq_dropped++;
         return; /* drop if queue full and no callback */
     }
-    packet = g_malloc(sizeof(NetPacket) + size);
+    packet = qemu_net_packet_alloc(queue, size);
     packet->sender = sender;
     packet->flags = flags;
     packet->size = size;
     packet->sent_cb = sent_cb;
+    packet->shared = NULL;
     memcpy(packet->data, buf, size);
 
-    queue->nq_count++;
-    QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
+    qemu_net_queue_enqueue(queue, packet);
 }
 
 static void qemu_net_queue_append_iov(NetQueue *queue,
@@ -122,17 +313,19 @@ static void qemu_net_queue_append_iov(NetQueue *queue,
     int i;
 
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
+        queue->nq_dropped++;
         return; /* drop if queue full and no callback */
     }
     for (i = 0; i < iovcnt; i++) {
         max_len += iov[i].iov_len;
     }
 
-    packet = g_malloc(sizeof(NetPacket) + max_len);
+    packet = qemu_net_packet_alloc(queue, max_len);
     packet->sender = sender;
     packet->sent_cb = sent_cb;
     packet->flags = flags;
     packet->size = 0;
+    packet->shared = NULL;
 
     for (i = 0; i < iovcnt; i++) {
         size_t len = iov[i].iov_len;
@@ -141,8 +334,39 @@ static void qemu_net_queue_append_iov(NetQueue *queue,
         packet->size += len;
     }
 
-    queue->nq_count++;
-    QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
+    qemu_net_queue_enqueue(queue, packet);
+}
+
+static void qemu_net_queue_append_shared(NetQueue *queue,
+                                         NetClientState *sender,
+                                         unsigned flags,
+                                         const struct iovec *iov,
+                                         int iovcnt,
+                                         NetPacketBuf **shared)
+{
+    NetPacket *packet;
+
+    if (queue->nq_count >= queue->nq_maxlen) {
+        queue->nq_dropped++;
+        return; /* no callback, so drop if queue full */
+    }
+    if (!*shared) {
+        size_t size = iov_size(iov, iovcnt);
+
+        *shared = qemu_net_packet_buf_alloc(size);
+        (*shared)->refcnt = 1;
+        (*shared)->size = iov_to_buf(iov, iovcnt, 0, (*shared)->data, size);
+    }
+
+    packet = qemu_net_packet_alloc(queue, 0);
+    packet->sender = sender;
+    packet->flags = flags;
+    packet->size = (*shared)->size;
+    packet->sent_cb = NULL;
+    packet->shared = *shared;
+    (*shared)->refcnt++;
+
+    qemu_net_queue_enqueue(queue, packet);
 }
 
 static ssize_t qemu_net_queue_deliver(NetQueue *queue,
@@ -225,6 +449,42 @@ ssize_t qemu_net_queue_send_iov(NetQueue *queue,
     return ret;
 }
 
+/* Like qemu_net_queue_send_iov() without a sent callback, except that a
+ * frame which has to be queued shares its payload with the other queues
+ * it was sent to using the same @shared.  *@shared must be NULL for a new
+ * frame; the caller drops its reference with qemu_net_packet_buf_unref()
+ * once the frame has been sent to every queue.
+ */
+ssize_t qemu_net_queue_send_shared(NetQueue *queue,
+                                   NetClientState *sender,
+                                   unsigned flags,
+                                   const struct iovec *iov,
+                                   int iovcnt,
+                                   NetPacketBuf **shared)
+{
+    ssize_t ret;
+
+    if (queue->delivering || !qemu_can_send_packet(sender)) {
+        qemu_net_queue_append_shared(queue, sender, flags, iov, iovcnt, shared);
+        return 0;
+    }
+
+    if (iovcnt == 1) {
+        ret = qemu_net_queue_deliver(queue, sender, flags,
+                                     iov[0].iov_base, iov[0].iov_len);
+    } else {
+        ret = qemu_net_queue_deliver_iov(queue, sender, flags, iov, iovcnt);
+    }
+    if (ret == 0) {
+        qemu_net_queue_append_shared(queue, sender, flags, iov, iovcnt, shared);
+        return 0;
+    }
+
+    qemu_net_queue_flush(queue);
+
+    return ret;
+}
+
 void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
 {
     NetPacket *packet, *next;
@@ -233,7 +493,7 @@ void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
         if (packet->sender == from) {
             QTAILQ_REMOVE(&queue->packets, packet, entry);
             queue->nq_count--;
-            g_free(packet);
+            qemu_net_packet_free(queue, packet);
         }
     }
 }
@@ -251,7 +511,7 @@ bool qemu_net_queue_flush(NetQueue *queue)
         ret = qemu_net_queue_deliver(queue,
                                      packet->sender,
                                      packet->flags,
-                                     packet->data,
+                                     qemu_net_packet_data(packet),
                                      packet->size);
         if (ret == 0) {
             queue->nq_count++;
@@ -263,7 +523,15 @@ bool qemu_net_queue_flush(NetQueue *queue)
             packet->sent_cb(packet->sender, ret);
         }
 
-        g_free(packet);
+        qemu_net_packet_free(queue, packet);
     }
     return true;
 }
+
+void qemu_net_queue_get_stats(NetQueue *queue, NetQueueStats *stats)
+{
+    stats->depth = queue->nq_count;
+    stats->peak = queue->nq_peak;
+    stats->queued = queue->nq_queued;
+    stats->dropped = queue->nq_dropped;
+}
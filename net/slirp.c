@@ -36,6 +36,7 @@
 #include "qemu/sockets.h"
 #include "slirp/libslirp.h"
 #include "sysemu/char.h"
+#include "net/tap.h"
 
 static int get_str_sep(char *buf, int buf_size, const char **pp, int sep)
 {
@@ -73,6 +74,8 @@ typedef struct SlirpState {
     NetClientState nc;
     QTAILQ_ENTRY(SlirpState) entry;
     Slirp *slirp;
+    int vnet_hdr_len;       /* nonzero if frames carry a virtio-net header */
+    bool tso;               /* guest takes large TCP segments */
 #ifndef _WIN32
     char smb_dir[128];
 #endif
@@ -99,17 +102,72 @@ static void slirp_smb_cleanup(SlirpState *s);
 static inline void slirp_smb_cleanup(SlirpState *s) { }
 #endif
 
+static void net_slirp_send(SlirpState *s, const uint8_t *pkt, int pkt_len,
+                           const struct virtio_net_hdr *hdr)
+{
+    struct virtio_net_hdr_mrg_rxbuf vnet_hdr = { };
+    struct iovec iov[2];
+
+    if (!s->vnet_hdr_len) {
+        qemu_send_packet(&s->nc, pkt, pkt_len);
+        return;
+    }
+
+    if (hdr) {
+        vnet_hdr.hdr = *hdr;
+    }
+    iov[0].iov_base = &vnet_hdr;
+    iov[0].iov_len = s->vnet_hdr_len;
+    iov[1].iov_base = (void *)pkt;
+    iov[1].iov_len = pkt_len;
+    qemu_sendv_packet(&s->nc, iov, 2);
+}
+
 void slirp_output(void *opaque, const uint8_t *pkt, int pkt_len)
+{
+    net_slirp_send(opaque, pkt, pkt_len, NULL);
+}
+
+void slirp_output_tso(void *opaque, const uint8_t *pkt, int pkt_len, int mss)
 {
     SlirpState *s = opaque;
+    struct virtio_net_hdr hdr = { };
+    int csum_start = 14 + (pkt[14] & 0xf) * 4;     /* Ethernet + IP header */
 
-    qemu_send_packet(&s->nc, pkt, pkt_len);
+    if (!s->tso) {
+        /* The guest was reset meanwhile; TCP will resend the data */
+        return;
+    }
+
+    hdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+    hdr.hdr_len = csum_start + (pkt[csum_start + 12] >> 4) * 4;
+    hdr.gso_size = mss;
+    hdr.csum_start = csum_start;
+    hdr.csum_offset = 16;                       /* TCP checksum field */
+    net_slirp_send(s, pkt, pkt_len, &hdr);
 }
 
 static ssize_t net_slirp_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
     SlirpState *s = DO_UPCAST(SlirpState, nc, nc);
 
+    if (s->vnet_hdr_len) {
+        const struct virtio_net_hdr *hdr = (const struct virtio_net_hdr *)buf;
+
+        if (size < s->vnet_hdr_len) {
+            return size;
+        }
+        if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+            slirp_input_nocsum(s->slirp, buf + s->vnet_hdr_len,
+                               size - s->vnet_hdr_len);
+        } else {
+            slirp_input(s->slirp, buf + s->vnet_hdr_len,
+                        size - s->vnet_hdr_len);
+        }
+        return size;
+    }
+
     slirp_input(s->slirp, buf, size);
 
     return size;
@@ -124,11 +182,51 @@ static void net_slirp_cleanup(NetClientState *nc)
     QTAILQ_REMOVE(&slirp_stacks, s, entry);
 }
 
+static bool net_slirp_has_vnet_hdr(NetClientState *nc)
+{
+    return true;
+}
+
+static bool net_slirp_has_vnet_hdr_len(NetClientState *nc, int len)
+{
+    return len == sizeof(struct virtio_net_hdr) ||
+           len == sizeof(struct virtio_net_hdr_mrg_rxbuf);
+}
+
+static void net_slirp_using_vnet_hdr(NetClientState *nc, bool using_vnet_hdr)
+{
+    SlirpState *s = DO_UPCAST(SlirpState, nc, nc);
+
+    s->vnet_hdr_len = using_vnet_hdr ? sizeof(struct virtio_net_hdr) : 0;
+}
+
+static void net_slirp_set_vnet_hdr_len(NetClientState *nc, int len)
+{
+    SlirpState *s = DO_UPCAST(SlirpState, nc, nc);
+
+    s->vnet_hdr_len = len;
+}
+
+static void net_slirp_set_offload(NetClientState *nc, int csum, int tso4,
+                                  int tso6, int ecn, int ufo)
+{
+    SlirpState *s = DO_UPCAST(SlirpState, nc, nc);
+
+    /* Large segments come with a partial checksum, so need both */
+    s->tso = s->vnet_hdr_len && csum && tso4;
+    slirp_set_tso(s->slirp, s->tso);
+}
+
 static NetClientInfo net_slirp_info = {
     .type = NET_CLIENT_OPTIONS_KIND_USER,
     .size = sizeof(SlirpState),
     .receive = net_slirp_receive,
     .cleanup = net_slirp_cleanup,
+    .has_vnet_hdr = net_slirp_has_vnet_hdr,
+    .has_vnet_hdr_len = net_slirp_has_vnet_hdr_len,
+    .using_vnet_hdr = net_slirp_using_vnet_hdr,
+    .set_offload = net_slirp_set_offload,
+    .set_vnet_hdr_len = net_slirp_set_vnet_hdr_len,
 };
 
 static int net_slirp_init(NetClientState *peer, const char *model,
@@ -44,12 +44,29 @@
 
 #include "net/vhost_net.h"
 
+/* Frames read from the tap fd per wakeup before handing them to the peer.
+ * Each slot is a NET_BUFSIZE buffer, allocated the first time a batch
+ * grows that large, so a queue that sees bursts of rx_batch frames keeps
+ * rx_batch * 68 KiB around.
+ */
+#define TAP_RX_BATCH_DEFAULT 16
+#define TAP_RX_BATCH_MAX     256
+
 typedef struct TAPState {
     NetClientState nc;
     int fd;
     char down_script[1024];
     char down_script_arg[128];
-    uint8_t buf[NET_BUFSIZE];
+    uint8_t **rx_buf;
+    int *rx_len;
+    unsigned rx_batch;
+    unsigned rx_next;       /* next frame to hand to the peer */
+    unsigned rx_count;      /* frames read in the current batch */
+    QEMUBH *rx_bh;
+    uint64_t rx_batches;
+    uint64_t rx_packets;
+    uint64_t rx_dropped;
+    unsigned rx_max_batch;
     bool read_poll;
     bool write_poll;
     bool using_vnet_hdr;
@@ -183,34 +200,134 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
     tap_read_poll(s, true);
+
+    if (s->rx_next < s->rx_count) {
+        qemu_bh_schedule(s->rx_bh);
+    }
 }
 
-static void tap_send(void *opaque)
+/* Hand the frames of the current batch to the peer, oldest first.  Returns
+ * false if the peer queued a frame instead of taking it; the rest of the
+ * batch stays in the ring until tap_send_completed() is called.
+ */
+static bool tap_rx_flush(TAPState *s)
 {
-    TAPState *s = opaque;
-    int size;
+    while (s->rx_next < s->rx_count) {
+        uint8_t *buf = s->rx_buf[s->rx_next];
+        int size = s->rx_len[s->rx_next];
+        ssize_t ret;
 
-    while (qemu_can_send_packet(&s->nc)) {
-        uint8_t *buf = s->buf;
-
-        size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
-        if (size <= 0) {
-            break;
-        }
+        s->rx_next++;
 
         if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
             buf  += s->host_vnet_hdr_len;
             size -= s->host_vnet_hdr_len;
         }
 
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
-        if (size == 0) {
-            tap_read_poll(s, false);
-            break;
-        } else if (size < 0) {
+        if (size <= 0 || s->nc.link_down || !s->nc.peer) {
+            s->rx_dropped++;
+            continue;
+        }
+
+        ret = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
+        if (ret == 0) {
+            return false;
+        } else if (ret < 0) {
+            s->rx_dropped++;
+        }
+    }
+
+    s->rx_next = s->rx_count = 0;
+    return true;
+}
+
+static int tap_rx_fill(TAPState *s)
+{
+    while (s->rx_count < s->rx_batch) {
+        int size;
+
+        if (!s->rx_buf[s->rx_count]) {
+            s->rx_buf[s->rx_count] = g_malloc(NET_BUFSIZE);
+        }
+        size = tap_read_packet(s->fd, s->rx_buf[s->rx_count], NET_BUFSIZE);
+        if (size <= 0) {
             break;
         }
+        s->rx_len[s->rx_count++] = size;
+    }
+
+    if (s->rx_count) {
+        s->rx_batches++;
+        s->rx_packets += s->rx_count;
+        s->rx_max_batch = MAX(s->rx_max_batch, s->rx_count);
     }
+    return s->rx_count;
+}
+
+static void tap_send(void *opaque)
+{
+    TAPState *s = opaque;
+    bool more;
+
+    more = tap_rx_flush(s);
+    if (more && qemu_can_send_packet(&s->nc) && tap_rx_fill(s)) {
+        more = tap_rx_flush(s);
+    }
+
+    if (!more) {
+        /* Stop reading until the peer has taken the queued frame */
+        tap_read_poll(s, false);
+    }
+}
+
+static void tap_rx_bh(void *opaque)
+{
+    TAPState *s = opaque;
+
+    if (s->read_poll && s->enabled) {
+        tap_send(s);
+    }
+}
+
+static void tap_free_rx_ring(TAPState *s)
+{
+    unsigned i;
+
+    for (i = 0; i < s->rx_batch; i++) {
+        g_free(s->rx_buf[i]);
+    }
+    g_free(s->rx_buf);
+    g_free(s->rx_len);
+}
+
+static void tap_set_rx_batch(TAPState *s, unsigned batch)
+{
+    assert(!s->rx_count);
+
+    tap_free_rx_ring(s);
+    s->rx_batch = batch;
+    s->rx_buf = g_new0(uint8_t *, batch);
+    s->rx_len = g_new(int, batch);
+}
+
+/* Frames read before vhost took over the fd would only reach the guest
+ * out of order with what vhost delivers meanwhile; drop them.
+ */
+static void tap_rx_discard(TAPState *s)
+{
+    s->rx_dropped += s->rx_count - s->rx_next;
+    s->rx_next = s->rx_count = 0;
+}
+
+static void tap_print_stats(NetClientState *nc, Monitor *mon)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    monitor_printf(mon, "    rx: packets=%" PRIu64 ",batches=%" PRIu64
+                   ",avg_batch=%" PRIu64 ",max_batch=%u/%u,dropped=%" PRIu64
+                   "\n", s->rx_packets, s->rx_batches,
+                   s->rx_batches ? s->rx_packets / s->rx_batches : 0,
+                   s->rx_max_batch, s->rx_batch, s->rx_dropped);
 }
 
 static bool tap_has_ufo(NetClientState *nc)
@@ -291,11 +408,18 @@ static void tap_cleanup(NetClientState *nc)
     tap_write_poll(s, false);
     close(s->fd);
     s->fd = -1;
+
+    qemu_bh_delete(s->rx_bh);
+    tap_free_rx_ring(s);
 }
 
 static void tap_poll(NetClientState *nc, bool enable)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    if (!enable) {
+        tap_rx_discard(s);
+    }
     tap_read_poll(s, enable);
     tap_write_poll(s, enable);
 }
@@ -323,6 +447,7 @@ static NetClientInfo net_tap_info = {
     .using_vnet_hdr = tap_using_vnet_hdr,
     .set_offload = tap_set_offload,
     .set_vnet_hdr_len = tap_set_vnet_hdr_len,
+    .print_stats = tap_print_stats,
 };
 
 static TAPState *net_tap_fd_init(NetClientState *peer,
@@ -351,6 +476,8 @@ static TAPState *net_tap_fd_init(NetClientState *peer,
     if (tap_probe_vnet_hdr_len(s->fd, s->host_vnet_hdr_len)) {
         tap_fd_set_vnet_hdr_len(s->fd, s->host_vnet_hdr_len);
     }
+    tap_set_rx_batch(s, TAP_RX_BATCH_DEFAULT);
+    s->rx_bh = qemu_bh_new(tap_rx_bh, s);
     tap_read_poll(s, true);
     s->vhost_net = NULL;
     return s;
@@ -611,6 +738,10 @@ static int net_init_tap_one(const NetdevTapOptions *tap, NetClientState *peer,
         return -1;
     }
 
+    if (tap->has_rx_batch) {
+        tap_set_rx_batch(s, tap->rx_batch);
+    }
+
     if (tap->has_fd || tap->has_fds) {
         snprintf(s->nc.info_str, sizeof(s->nc.info_str), "fd=%d", fd);
     } else if (tap->has_helper) {
@@ -704,6 +835,12 @@ int net_init_tap(const NetClientOptions *opts, const char *name,
         return -1;
     }
 
+    if (tap->has_rx_batch &&
+        (tap->rx_batch < 1 || tap->rx_batch > TAP_RX_BATCH_MAX)) {
+        error_report("rx_batch must be between 1 and %d", TAP_RX_BATCH_MAX);
+        return -1;
+    }
+
     if (tap->has_fd) {
         if (tap->has_ifname || tap->has_script || tap->has_downscript ||
             tap->has_vnet_hdr || tap->has_helper || tap->has_queues ||
@@ -1245,6 +1245,13 @@ This can be really helpful to save bandwidth when playing videos. Disabling
 adaptive encodings allows to restore the original static behavior of encodings
 like Tight.
 
+@item workers=@var{n}
+
+Encode framebuffer updates with @var{n} threads (1 by default, at most 64).
+Updates to different clients are encoded in parallel; for clients using the
+raw or hextile encodings a single update is also split between the threads.
+The zlib based encodings keep one update at a time per client.
+
 @item share=[allow-exclusive|force-shared|ignore]
 
 Set display sharing policy.  'allow-exclusive' allows clients to ask
@@ -1384,7 +1391,7 @@ DEF("net", HAS_ARG, QEMU_OPTION_net,
     "-net tap[,vlan=n][,name=str],ifname=name\n"
     "                connect the host TAP network interface to VLAN 'n'\n"
 #else
-    "-net tap[,vlan=n][,name=str][,fd=h][,fds=x:y:...:z][,ifname=name][,script=file][,downscript=dfile][,helper=helper][,sndbuf=nbytes][,vnet_hdr=on|off][,vhost=on|off][,vhostfd=h][,vhostfds=x:y:...:z][,vhostforce=on|off][,queues=n]\n"
+    "-net tap[,vlan=n][,name=str][,fd=h][,fds=x:y:...:z][,ifname=name][,script=file][,downscript=dfile][,helper=helper][,sndbuf=nbytes][,vnet_hdr=on|off][,vhost=on|off][,vhostfd=h][,vhostfds=x:y:...:z][,vhostforce=on|off][,queues=n][,rx_batch=n]\n"
     "                connect the host TAP network interface to VLAN 'n'\n"
     "                use network scripts 'file' (default=" DEFAULT_NETWORK_SCRIPT ")\n"
     "                to configure it and 'dfile' (default=" DEFAULT_NETWORK_DOWN_SCRIPT ")\n"
@@ -1404,6 +1411,7 @@ DEF("net", HAS_ARG, QEMU_OPTION_net,
     "                use 'vhostfd=h' to connect to an already opened vhost net device\n"
     "                use 'vhostfds=x:y:...:z to connect to multiple already opened vhost net devices\n"
     "                use 'queues=n' to specify the number of queues to be created for multiqueue TAP\n"
+    "                use 'rx_batch=n' to read up to n frames per wakeup (default=16)\n"
     "-net bridge[,vlan=n][,name=str][,br=bridge][,helper=helper]\n"
     "                connects a host TAP network interface to a host bridge device 'br'\n"
     "                (default=" DEFAULT_BRIDGE_INTERFACE ") using the program 'helper'\n"
@@ -1429,8 +1437,11 @@ DEF("net", HAS_ARG, QEMU_OPTION_net,
     "                VALE port (created on the fly) called 'name' ('nmname' is name of the \n"
     "                netmap device, defaults to '/dev/netmap')\n"
 #endif
-    "-net dump[,vlan=n][,file=f][,len=n]\n"
+    "-net dump[,vlan=n][,file=f][,len=n][,format=pcap|pcapng][,filter=expr][,ring=size]\n"
     "                dump traffic on vlan 'n' to file 'f' (max n bytes per packet)\n"
+    "                use 'filter=expr' to only dump matching frames\n"
+    "                use 'ring=size' to write from a separate thread through a\n"
+    "                capture ring of 'size' bytes\n"
     "-net none       use it alone to have zero network devices. If no -net option\n"
     "                is provided, the default is '-net nic -net user'\n", QEMU_ARCH_ALL)
 DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
@@ -1633,6 +1644,13 @@ helper executable is @file{/path/to/qemu-bridge-helper}.
 @option{fd}=@var{h} can be used to specify the handle of an already
 opened host TAP interface.
 
+@option{rx_batch}=@var{n} sets how many frames are read from the TAP
+interface per wakeup before they are passed on to the guest (1 to 256,
+default 16).  @code{info network} shows the batch statistics.  Every frame
+in a batch needs its own 68 KiB receive buffer.  The buffers are allocated
+as bursts first need them and kept until the interface is removed, so
+each queue may use up to @var{n} times 68 KiB of memory.
+
 Examples:
 
 @example
@@ -1769,7 +1787,7 @@ vde_switch -F -sock /tmp/myswitch
 qemu-system-i386 linux.img -net nic -net vde,sock=/tmp/myswitch
 @end example
 
-@item -netdev hubport,id=@var{id},hubid=@var{hubid}
+@item -netdev hubport,id=@var{id},hubid=@var{hubid}[,learning=on|off]
 
 Create a hub port on QEMU "vlan" @var{hubid}.
 
@@ -1777,10 +1795,28 @@ The hubport netdev lets you connect a NIC to a QEMU "vlan" instead of a single
 netdev.  @code{-net} and @code{-device} with parameter @option{vlan} create the
 required hub automatically.
 
-@item -net dump[,vlan=@var{n}][,file=@var{file}][,len=@var{len}]
+With @option{learning=on} the hub learns which port each MAC address lives
+behind and sends unicast frames only to that port, like an Ethernet switch.
+Broadcast, multicast and frames for unknown addresses are still sent to every
+port.  The option affects the whole hub, not just this port.
+
+@item -net dump[,vlan=@var{n}][,file=@var{file}][,len=@var{len}][,format=pcap|pcapng][,filter=@var{expr}][,ring=@var{size}]
 Dump network traffic on VLAN @var{n} to file @var{file} (@file{qemu-vlan0.pcap} by default).
 At most @var{len} bytes (64k by default) per packet are stored. The file format is
-libpcap, so it can be analyzed with tools such as tcpdump or Wireshark.
+libpcap, or pcapng with @option{format=pcapng}, so it can be analyzed with tools
+such as tcpdump or Wireshark.
+
+@option{filter} restricts the dump to frames matching @var{expr}, a subset of
+the tcpdump expression syntax: the primitives @code{arp}, @code{ip},
+@code{ip6}, @code{tcp}, @code{udp}, @code{icmp}, @code{host} @var{a.b.c.d},
+@code{port} @var{n} and @code{ether host} @var{mac}, combined with
+@code{and}, @code{or}, @code{not} and parentheses.
+
+By default every frame is written to the file as it passes.  With
+@option{ring} frames are copied into a capture ring of @var{size} bytes and a
+separate thread writes them to the file through a memory mapping, so that
+dumping does not slow down the guest.  Frames that arrive while the ring is
+full are dropped; @code{info network} shows how many.
 
 @item -net none
 Indicate that no network devices should be configured. It is used to
@@ -2611,6 +2647,19 @@ STEXI
 Run the emulation in single step mode.
 ETEXI
 
+DEF("tb-hot", HAS_ARG, QEMU_OPTION_tb_hot, \
+    "-tb-hot n       count executions of each translated block and print\n"
+    "                the n most executed ones on exit (0: print none)\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -tb-hot @var{n}
+@findex -tb-hot
+Count how often each translated block is executed and time its
+translation.  On exit print the @var{n} most executed blocks with their
+guest symbols to stderr; with @var{n} of 0 only collect them for the
+@code{info tb-hot} monitor command and the @code{query-tb-hot} QMP command.
+ETEXI
+
 DEF("S", 0, QEMU_OPTION_S, \
     "-S              freeze CPU at startup (use 'c' to start execution)\n",
     QEMU_ARCH_ALL)
@@ -2753,6 +2802,17 @@ STEXI
 Start right away with a saved state (@code{loadvm} in monitor)
 ETEXI
 
+DEF("loadvm-file", HAS_ARG, QEMU_OPTION_loadvm_file, \
+    "-loadvm-file file\n" \
+    "                start right away with a state saved by savevm-file\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -loadvm-file @var{file}
+@findex -loadvm-file
+Start right away with a state saved to @var{file} (@code{loadvm-file} in
+monitor)
+ETEXI
+
 #ifndef _WIN32
 DEF("daemonize", 0, QEMU_OPTION_daemonize, \
     "-daemonize      daemonize QEMU after initializing\n", QEMU_ARCH_ALL)
@@ -63,12 +63,23 @@ QEMUClock qemu_clocks[QEMU_CLOCK_MAX];
  * used by different AioContexts / threads. Each clock also has
  * a list of the QEMUTimerLists associated with it, in order that
  * reenabling the clock can call all the notifiers.
+ *
+ * The pending timers are kept in a binary min-heap ordered by expiry
+ * time, so that arming and deleting a timer is O(log n) while the next
+ * deadline is always active_timers[0].  Timers with the same expiry time
+ * fire in the order they were armed.
  */
 
 struct QEMUTimerList {
     QEMUClock *clock;
     QemuMutex active_timers_lock;
-    QEMUTimer *active_timers;
+    QEMUTimer **active_timers;
+    int nb_active;
+    int max_active;
+    uint64_t seq;
+    uint64_t rearms;
+    uint64_t deadline_changes;
+    uint64_t expired;
     QLIST_ENTRY(QEMUTimerList) list;
     QEMUTimerListNotifyCB *notify_cb;
     void *notify_opaque;
@@ -95,6 +106,11 @@ static bool timer_expired_ns(QEMUTimer *timer_head, int64_t current_time)
     return timer_head && (timer_head->expire_time <= current_time);
 }
 
+static QEMUTimer *timerlist_head(QEMUTimerList *timer_list)
+{
+    return timer_list->nb_active ? timer_list->active_timers[0] : NULL;
+}
+
 QEMUTimerList *timerlist_new(QEMUClockType type,
                              QEMUTimerListNotifyCB *cb,
                              void *opaque)
@@ -119,6 +135,7 @@ void timerlist_free(QEMUTimerList *timer_list)
         QLIST_REMOVE(timer_list, list);
     }
     qemu_mutex_destroy(&timer_list->active_timers_lock);
+    g_free(timer_list->active_timers);
     g_free(timer_list);
 }
 
@@ -172,7 +189,7 @@ void qemu_clock_enable(QEMUClockType type, bool enabled)
 
 bool timerlist_has_timers(QEMUTimerList *timer_list)
 {
-    return !!timer_list->active_timers;
+    return timer_list->nb_active > 0;
 }
 
 bool qemu_clock_has_timers(QEMUClockType type)
@@ -186,11 +203,11 @@ bool timerlist_expired(QEMUTimerList *timer_list)
     int64_t expire_time;
 
     qemu_mutex_lock(&timer_list->active_timers_lock);
-    if (!timer_list->active_timers) {
+    if (!timer_list->nb_active) {
         qemu_mutex_unlock(&timer_list->active_timers_lock);
         return false;
     }
-    expire_time = timer_list->active_timers->expire_time;
+    expire_time = timer_list->active_timers[0]->expire_time;
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
     return expire_time < qemu_clock_get_ns(timer_list->clock->type);
@@ -221,11 +238,11 @@ int64_t timerlist_deadline_ns(QEMUTimerList *timer_list)
      * the caller should notice the change and there is no race condition.
      */
     qemu_mutex_lock(&timer_list->active_timers_lock);
-    if (!timer_list->active_timers) {
+    if (!timer_list->nb_active) {
         qemu_mutex_unlock(&timer_list->active_timers_lock);
         return -1;
     }
-    expire_time = timer_list->active_timers->expire_time;
+    expire_time = timer_list->active_timers[0]->expire_time;
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
     delta = expire_time - qemu_clock_get_ns(timer_list->clock->type);
@@ -330,6 +347,7 @@ void timer_init(QEMUTimer *ts,
     ts->opaque = opaque;
     ts->scale = scale;
     ts->expire_time = -1;
+    ts->heap_index = -1;
 }
 
 void timer_free(QEMUTimer *ts)
@@ -337,43 +355,100 @@ void timer_free(QEMUTimer *ts)
     g_free(ts);
 }
 
-static void timer_del_locked(QEMUTimerList *timer_list, QEMUTimer *ts)
+static bool timer_before(QEMUTimer *a, QEMUTimer *b)
+{
+    return a->expire_time < b->expire_time ||
+           (a->expire_time == b->expire_time && a->seq < b->seq);
+}
+
+static void timerlist_heap_set(QEMUTimerList *timer_list, int i,
+                               QEMUTimer *ts)
 {
-    QEMUTimer **pt, *t;
+    timer_list->active_timers[i] = ts;
+    ts->heap_index = i;
+}
 
-    ts->expire_time = -1;
-    pt = &timer_list->active_timers;
-    for(;;) {
-        t = *pt;
-        if (!t)
+/* Restore the heap order after the timer at index i changed its key */
+static void timerlist_heap_fix(QEMUTimerList *timer_list, int i)
+{
+    QEMUTimer **heap = timer_list->active_timers;
+    QEMUTimer *ts = heap[i];
+    int child;
+
+    while (i > 0 && timer_before(ts, heap[(i - 1) / 2])) {
+        timerlist_heap_set(timer_list, i, heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= timer_list->nb_active) {
             break;
-        if (t == ts) {
-            *pt = t->next;
+        }
+        if (child + 1 < timer_list->nb_active &&
+            timer_before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!timer_before(heap[child], ts)) {
             break;
         }
-        pt = &t->next;
+        timerlist_heap_set(timer_list, i, heap[child]);
+        i = child;
+    }
+    timerlist_heap_set(timer_list, i, ts);
+}
+
+static bool timer_in_heap(QEMUTimerList *timer_list, QEMUTimer *ts)
+{
+    return ts->expire_time >= 0 && ts->heap_index >= 0 &&
+           ts->heap_index < timer_list->nb_active &&
+           timer_list->active_timers[ts->heap_index] == ts;
+}
+
+static void timer_del_locked(QEMUTimerList *timer_list, QEMUTimer *ts)
+{
+    int i = ts->heap_index;
+
+    if (!timer_in_heap(timer_list, ts)) {
+        ts->expire_time = -1;
+        return;
+    }
+    ts->expire_time = -1;
+    timer_list->nb_active--;
+    if (i != timer_list->nb_active) {
+        timerlist_heap_set(timer_list, i,
+                           timer_list->active_timers[timer_list->nb_active]);
+        timerlist_heap_fix(timer_list, i);
     }
 }
 
+/* Arm or move ts; returns true if it became the first timer to expire */
 static bool timer_mod_ns_locked(QEMUTimerList *timer_list,
                                 QEMUTimer *ts, int64_t expire_time)
 {
-    QEMUTimer **pt, *t;
+    int i;
 
-    /* add the timer in the sorted list */
-    pt = &timer_list->active_timers;
-    for (;;) {
-        t = *pt;
-        if (!timer_expired_ns(t, expire_time)) {
-            break;
+    if (timer_in_heap(timer_list, ts)) {
+        i = ts->heap_index;
+    } else {
+        if (timer_list->nb_active == timer_list->max_active) {
+            timer_list->max_active = MAX(16, timer_list->max_active * 2);
+            timer_list->active_timers = g_renew(QEMUTimer *,
+                                                timer_list->active_timers,
+                                                timer_list->max_active);
         }
-        pt = &t->next;
+        i = timer_list->nb_active++;
+        timerlist_heap_set(timer_list, i, ts);
     }
     ts->expire_time = MAX(expire_time, 0);
-    ts->next = *pt;
-    *pt = ts;
+    ts->seq = timer_list->seq++;
+    timerlist_heap_fix(timer_list, i);
 
-    return pt == &timer_list->active_timers;
+    timer_list->rearms++;
+    if (ts->heap_index == 0) {
+        timer_list->deadline_changes++;
+        return true;
+    }
+    return false;
 }
 
 static void timerlist_rearm(QEMUTimerList *timer_list)
@@ -401,7 +476,6 @@ void timer_mod_ns(QEMUTimer *ts, int64_t expire_time)
     bool rearm;
 
     qemu_mutex_lock(&timer_list->active_timers_lock);
-    timer_del_locked(timer_list, ts);
     rearm = timer_mod_ns_locked(timer_list, ts, expire_time);
     qemu_mutex_unlock(&timer_list->active_timers_lock);
 
@@ -420,9 +494,6 @@ void timer_mod_anticipate_ns(QEMUTimer *ts, int64_t expire_time)
 
     qemu_mutex_lock(&timer_list->active_timers_lock);
     if (ts->expire_time == -1 || ts->expire_time > expire_time) {
-        if (ts->expire_time != -1) {
-            timer_del_locked(timer_list, ts);
-        }
         rearm = timer_mod_ns_locked(timer_list, ts, expire_time);
     } else {
         rearm = false;
@@ -470,16 +541,15 @@ bool timerlist_run_timers(QEMUTimerList *timer_list)
     current_time = qemu_clock_get_ns(timer_list->clock->type);
     for(;;) {
         qemu_mutex_lock(&timer_list->active_timers_lock);
-        ts = timer_list->active_timers;
+        ts = timerlist_head(timer_list);
         if (!timer_expired_ns(ts, current_time)) {
             qemu_mutex_unlock(&timer_list->active_timers_lock);
             break;
         }
 
         /* remove timer from the list before calling the callback */
-        timer_list->active_timers = ts->next;
-        ts->next = NULL;
-        ts->expire_time = -1;
+        timer_del_locked(timer_list, ts);
+        timer_list->expired++;
         cb = ts->cb;
         opaque = ts->opaque;
         qemu_mutex_unlock(&timer_list->active_timers_lock);
@@ -494,6 +564,22 @@ out:
     return progress;
 }
 
+void qemu_clock_get_stats(QEMUClockType type, QEMUClockStats *stats)
+{
+    QEMUClock *clock = qemu_clock_ptr(type);
+    QEMUTimerList *timer_list;
+
+    memset(stats, 0, sizeof(*stats));
+    QLIST_FOREACH(timer_list, &clock->timerlists, list) {
+        qemu_mutex_lock(&timer_list->active_timers_lock);
+        stats->active += timer_list->nb_active;
+        stats->rearms += timer_list->rearms;
+        stats->deadline_changes += timer_list->deadline_changes;
+        stats->expired += timer_list->expired;
+        qemu_mutex_unlock(&timer_list->active_timers_lock);
+    }
+}
+
 bool qemu_clock_run_timers(QEMUClockType type)
 {
     return timerlist_run_timers(main_loop_tlg.tl[type]);
@@ -607,6 +607,58 @@ Example:
      "arguments": { "enable": true } }
 <- { "return": {} }
 
+EQMP
+
+    {
+        .name       = "savevm-file",
+        .args_type  = "filename:F,threads:i?",
+        .mhandler.cmd_new = qmp_marshal_input_savevm_file,
+    },
+
+SQMP
+savevm-file
+-----------
+
+Save the VM, except block devices, to a file whose RAM image is page
+aligned so that loadvm-file can map it.  Zero pages are not written.
+
+Arguments:
+
+- "filename": the file to save the VM to (json-string)
+- "threads": number of threads writing RAM, 4 by default (json-int, optional)
+
+Example:
+
+-> { "execute": "savevm-file",
+     "arguments": { "filename": "/var/lib/qemu/booted.vmf" } }
+<- { "return": {} }
+
+EQMP
+
+    {
+        .name       = "loadvm-file",
+        .args_type  = "filename:F",
+        .mhandler.cmd_new = qmp_marshal_input_loadvm_file,
+    },
+
+SQMP
+loadvm-file
+-----------
+
+Restore the VM from a file written by savevm-file.  Guest RAM is mapped
+copy-on-write from the file and faulted in on demand, so the file must not
+be modified while the VM uses it.
+
+Arguments:
+
+- "filename": the file to restore the VM from (json-string)
+
+Example:
+
+-> { "execute": "loadvm-file",
+     "arguments": { "filename": "/var/lib/qemu/booted.vmf" } }
+<- { "return": {} }
+
 EQMP
 
     {
@@ -2326,6 +2378,56 @@ EQMP
         .mhandler.cmd_new = qmp_marshal_input_query_cpus,
     },
 
+SQMP
+query-tb-hot
+------------
+
+Show the most executed translated blocks.  Requires -tb-hot.
+
+Arguments:
+
+- "count": maximum number of blocks to return, default 10 (json-int, optional)
+
+Return a json-array of json-objects, hottest first, each containing:
+
+- "pc": guest address of the block (json-int)
+- "count": executions since the block was translated (json-int)
+- "size": guest code size, in bytes (json-int)
+- "host-size": host code size, in bytes (json-int)
+- "gen-time-ns": translation time, in nanoseconds (json-int)
+- "symbol": guest symbol containing "pc" (json-string, optional)
+
+Example:
+
+-> { "execute": "query-tb-hot", "arguments": { "count": 2 } }
+<- {
+      "return":[
+         {
+            "pc":3221260388,
+            "count":1843310,
+            "size":20,
+            "host-size":142,
+            "gen-time-ns":9120,
+            "symbol":"memcpy"
+         },
+         {
+            "pc":3221231620,
+            "count":902117,
+            "size":36,
+            "host-size":311,
+            "gen-time-ns":15840
+         }
+      ]
+   }
+
+EQMP
+
+    {
+        .name       = "query-tb-hot",
+        .args_type  = "count:i?",
+        .mhandler.cmd_new = qmp_marshal_input_query_tb_hot,
+    },
+
 SQMP
 query-iothreads
 ---------------
@@ -2365,6 +2467,187 @@ EQMP
         .mhandler.cmd_new = qmp_marshal_input_query_iothreads,
     },
 
+SQMP
+query-thread-pools
+------------------
+
+Returns information about the worker thread pool of the main loop and of
+each iothread.
+
+Return a json-array. Each pool is represented by a json-object, which contains:
+
+- "iothread": name of the owning iothread, absent for the main loop (json-str, optional)
+- "min-threads": workers kept alive even when idle (json-int)
+- "max-threads": upper bound on the number of workers (json-int)
+- "idle-timeout": milliseconds before a surplus idle worker exits (json-int)
+- "cur-threads": workers running or being created (json-int)
+- "idle-threads": workers waiting for requests (json-int)
+- "queue-depth": requests waiting for a worker (json-int)
+- "max-queue-depth": highest queue depth seen (json-int)
+- "submitted": requests submitted (json-int)
+- "completed": requests completed (json-int)
+- "wait-histogram": queueing latency, power-of-two microsecond buckets (json-array)
+- "run-histogram": run time, power-of-two microsecond buckets (json-array)
+
+Example:
+
+-> { "execute": "query-thread-pools" }
+<- {
+      "return":[
+         {
+            "min-threads":0,
+            "max-threads":64,
+            "idle-timeout":10000,
+            "cur-threads":2,
+            "idle-threads":2,
+            "queue-depth":0,
+            "max-queue-depth":5,
+            "submitted":1204,
+            "completed":1204,
+            "wait-histogram":[310, 12, 80, 402, 390, 10, 0, ...],
+            "run-histogram":[0, 0, 0, 0, 6, 800, 398, ...]
+         }
+      ]
+   }
+
+EQMP
+
+    {
+        .name       = "query-thread-pools",
+        .args_type  = "",
+        .mhandler.cmd_new = qmp_marshal_input_query_thread_pools,
+    },
+
+SQMP
+thread-pool-set
+---------------
+
+Tune the worker thread pool of the main loop or of an iothread.
+
+Arguments:
+
+- "iothread": iothread whose pool is changed, main loop if absent (json-str, optional)
+- "min-threads": workers kept alive even when idle (json-int, optional)
+- "max-threads": upper bound on the number of workers (json-int, optional)
+- "idle-timeout": milliseconds before a surplus idle worker exits (json-int, optional)
+
+Example:
+
+-> { "execute": "thread-pool-set",
+     "arguments": { "iothread": "iothread0", "min-threads": 4,
+                    "max-threads": 8 } }
+<- { "return": {} }
+
+EQMP
+
+    {
+        .name       = "thread-pool-set",
+        .args_type  = "iothread:s?,min-threads:i?,max-threads:i?,idle-timeout:i?",
+        .mhandler.cmd_new = qmp_marshal_input_thread_pool_set,
+    },
+
+SQMP
+query-timers
+------------
+
+Returns timer statistics for each clock, summed over the main loop and
+iothread timer lists.
+
+Return a json-array. Each clock is represented by a json-object, which contains:
+
+- "clock": "realtime", "virtual" or "host" (json-str)
+- "active": pending timers (json-int)
+- "rearms": times a timer was armed or moved (json-int)
+- "deadline-changes": re-arms that made the timer the next to expire (json-int)
+- "expired": timer callbacks run (json-int)
+
+Example:
+
+-> { "execute": "query-timers" }
+<- {
+      "return":[
+         {
+            "clock":"realtime",
+            "active":3,
+            "rearms":1520,
+            "deadline-changes":704,
+            "expired":1498
+         },
+         {
+            "clock":"virtual",
+            "active":9,
+            "rearms":981442,
+            "deadline-changes":120337,
+            "expired":240118
+         },
+         {
+            "clock":"host",
+            "active":0,
+            "rearms":0,
+            "deadline-changes":0,
+            "expired":0
+         }
+      ]
+   }
+
+EQMP
+
+    {
+        .name       = "query-timers",
+        .args_type  = "",
+        .mhandler.cmd_new = qmp_marshal_input_query_timers,
+    },
+
+SQMP
+query-nand
+----------
+
+Returns access statistics and per-block wear for each NAND flash chip.
+
+Arguments:
+
+- "erase-counts": include the erase count of every block (json-bool, optional)
+
+Return a json-array. Each chip is represented by a json-object, which contains:
+
+- "path": QOM path of the flash device (json-str)
+- "pages-read": pages read from the array (json-int)
+- "pages-programmed": pages programmed (json-int)
+- "blocks-erased": blocks erased (json-int)
+- "bytes-read": page data read, in bytes (json-int)
+- "bytes-programmed": page data programmed, in bytes (json-int)
+- "busy-ns": virtual time spent busy, in nanoseconds (json-int)
+- "min-erase-count": lowest erase count of any block (json-int)
+- "max-erase-count": highest erase count of any block (json-int)
+- "erase-counts": erase count of each block (json-array, optional)
+
+Example:
+
+-> { "execute": "query-nand" }
+<- {
+      "return":[
+         {
+            "path":"/machine/unattached/device[4]",
+            "pages-read":5120,
+            "pages-programmed":832,
+            "blocks-erased":13,
+            "bytes-read":10485760,
+            "bytes-programmed":1703936,
+            "busy-ns":153600000,
+            "min-erase-count":0,
+            "max-erase-count":3
+         }
+      ]
+   }
+
+EQMP
+
+    {
+        .name       = "query-nand",
+        .args_type  = "erase-counts:b?",
+        .mhandler.cmd_new = qmp_marshal_input_query_nand,
+    },
+
 SQMP
 query-pci
 ---------
@@ -2724,6 +3007,13 @@ Clients are described by a json-object, each one contain the following:
 - "service": client's port number (json-string)
 - "x509_dname": TLS dname (json-string, optional)
 - "sasl_username": SASL username (json-string, optional)
+- "encodings": a json-array of per-encoding statistics (optional), each
+               one a json-object with:
+         - "encoding": encoding name (json-string)
+         - "rects": rectangles sent (json-int)
+         - "pixels": pixels encoded (json-int)
+         - "bytes": bytes produced by the encoder (json-int)
+         - "ns": host time spent encoding in nanoseconds (json-int)
 
 Example:
 
@@ -2739,7 +3029,16 @@ Example:
             {
                "host":"127.0.0.1",
                "service":"50401",
-               "family":"ipv4"
+               "family":"ipv4",
+               "encodings":[
+                  {
+                     "encoding":"tight",
+                     "rects":1284,
+                     "pixels":3145728,
+                     "bytes":412310,
+                     "ns":98120455
+                  }
+               ]
             }
          ]
       }
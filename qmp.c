@@ -28,6 +28,7 @@
 #include "qapi/qmp-input-visitor.h"
 #include "hw/boards.h"
 #include "qom/object_interfaces.h"
+#include "qemu/timer.h"
 
 NameInfo *qmp_query_name(Error **errp)
 {
@@ -622,3 +623,30 @@ void qmp_object_del(const char *id, Error **errp)
     }
     object_unparent(obj);
 }
+
+ClockTimerInfoList *qmp_query_timers(Error **errp)
+{
+    static const char *const names[QEMU_CLOCK_MAX] = {
+        [QEMU_CLOCK_REALTIME] = "realtime",
+        [QEMU_CLOCK_VIRTUAL] = "virtual",
+        [QEMU_CLOCK_HOST] = "host",
+    };
+    ClockTimerInfoList *head = NULL, **prev = &head;
+    QEMUClockStats stats;
+    QEMUClockType type;
+
+    for (type = 0; type < QEMU_CLOCK_MAX; type++) {
+        ClockTimerInfoList *elem = g_new0(ClockTimerInfoList, 1);
+
+        qemu_clock_get_stats(type, &stats);
+        elem->value = g_new0(ClockTimerInfo, 1);
+        elem->value->clock = g_strdup(names[type]);
+        elem->value->active = stats.active;
+        elem->value->rearms = stats.rearms;
+        elem->value->deadline_changes = stats.deadline_changes;
+        elem->value->expired = stats.expired;
+        *prev = elem;
+        prev = &elem->next;
+    }
+    return head;
+}
@@ -0,0 +1,513 @@
+/*
+ * Snapshots to a flat file with a mappable RAM image
+ *
+ * Each RAM block is stored raw, at an offset aligned to SAVEVM_FILE_ALIGN,
+ * followed by the device state in the usual savevm stream format.  Pages
+ * that are all zero are left as holes.  On load the RAM image is mapped
+ * MAP_PRIVATE over guest memory, so restoring is a handful of mmap() calls
+ * and the guest faults pages in (copy-on-write) as it touches them.
+ *
+ * Block devices are not part of the snapshot.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "config.h"
+#include "cpu.h"
+#include "qemu-common.h"
+#include "qemu/atomic.h"
+#include "qemu/error-report.h"
+#include "qemu/thread.h"
+#include "sysemu/sysemu.h"
+#include "block/block.h"
+#include "migration/qemu-file.h"
+#include "exec/cpu-all.h"
+#include "exec/ram_addr.h"
+#include "hw/xen/xen.h"
+#include "qapi/qmp/qerror.h"
+#include "qmp-commands.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+
+#define SAVEVM_FILE_MAGIC       0x51455646  /* "QEVF" */
+#define SAVEVM_FILE_VERSION     1
+
+/* Largest host page size we care about, so that images can be mapped
+ * on any host.
+ */
+#define SAVEVM_FILE_ALIGN       0x10000
+
+/* Unit of work for the writer threads */
+#define SAVEVM_FILE_CHUNK       (4 * 1024 * 1024)
+
+#define SAVEVM_FILE_DEFAULT_THREADS 4
+#define SAVEVM_FILE_MAX_THREADS     64
+
+/* All fields are big endian */
+typedef struct SaveVMFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t align;
+    uint32_t nb_blocks;
+    uint64_t state_offset;
+    uint64_t state_size;
+} SaveVMFileHeader;
+
+typedef struct SaveVMFileBlock {
+    char idstr[256];
+    uint64_t offset;
+    uint64_t length;
+} SaveVMFileBlock;
+
+typedef struct SaveVMFileWriter {
+    int fd;
+    int nb_blocks;
+    RAMBlock **blocks;
+    uint64_t *offsets;
+    int64_t nb_chunks;
+    int64_t *first_chunk;     /* index of the first chunk of each block */
+    int next_chunk;
+    int error;
+} SaveVMFileWriter;
+
+static int savevm_file_write_run(int fd, const uint8_t *buf, size_t len,
+                                 uint64_t offset)
+{
+    while (len) {
+        ssize_t ret = pwrite(fd, buf, len, offset);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += ret;
+        offset += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/* Write one chunk, skipping zero pages; the file is preallocated sparse */
+static int savevm_file_write_chunk(SaveVMFileWriter *w, int64_t chunk)
+{
+    const uint8_t *host;
+    uint64_t start, len, pos, offset, run = 0;
+    int i, ret;
+
+    for (i = 0; chunk >= w->first_chunk[i + 1]; i++) {
+        /* find the block */
+    }
+    start = (chunk - w->first_chunk[i]) * SAVEVM_FILE_CHUNK;
+    len = MIN(SAVEVM_FILE_CHUNK, w->blocks[i]->length - start);
+    host = w->blocks[i]->host + start;
+    offset = w->offsets[i] + start;
+
+    for (pos = 0; pos < len; pos += TARGET_PAGE_SIZE) {
+        if (!buffer_is_zero(host + pos, TARGET_PAGE_SIZE)) {
+            run += TARGET_PAGE_SIZE;
+            continue;
+        }
+        if (run) {
+            ret = savevm_file_write_run(w->fd, host + pos - run, run,
+                                        offset + pos - run);
+            if (ret < 0) {
+                return ret;
+            }
+            run = 0;
+        }
+    }
+    if (run) {
+        return savevm_file_write_run(w->fd, host + len - run, run,
+                                     offset + len - run);
+    }
+    return 0;
+}
+
+static void *savevm_file_writer_thread(void *opaque)
+{
+    SaveVMFileWriter *w = opaque;
+    int64_t chunk;
+
+    while ((chunk = atomic_fetch_inc(&w->next_chunk)) < w->nb_chunks) {
+        int ret = savevm_file_write_chunk(w, chunk);
+
+        if (ret < 0) {
+            atomic_cmpxchg(&w->error, 0, ret);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static RAMBlock *savevm_file_find_block(const char *idstr)
+{
+    RAMBlock *block;
+
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        if (!strcmp(block->idstr, idstr)) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+static void savevm_file_save(const char *filename, int threads, Error **errp)
+{
+    SaveVMFileWriter w = { .fd = -1 };
+    SaveVMFileHeader hdr;
+    SaveVMFileBlock *entries = NULL;
+    QemuThread *workers = NULL;
+    RAMBlock *block;
+    QEMUFile *f;
+    char *tmpname;
+    size_t hdr_size;
+    uint64_t pos;
+    bool saved = false;
+    int i, ret, fd;
+
+    if (qemu_savevm_state_blocked(errp)) {
+        return;
+    }
+
+    /* Guest RAM may still be mapped from an image loaded from @filename,
+     * so never truncate it in place: write a new file and rename it over.
+     */
+    tmpname = g_strdup_printf("%s.XXXXXX", filename);
+    w.fd = mkstemp(tmpname);
+    if (w.fd < 0) {
+        error_setg_file_open(errp, errno, tmpname);
+        g_free(tmpname);
+        return;
+    }
+    qemu_set_cloexec(w.fd);
+
+    /* Lay out the RAM blocks after the header */
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        w.nb_blocks++;
+    }
+    w.blocks = g_new(RAMBlock *, w.nb_blocks);
+    w.offsets = g_new(uint64_t, w.nb_blocks);
+    w.first_chunk = g_new(int64_t, w.nb_blocks + 1);
+    entries = g_new0(SaveVMFileBlock, w.nb_blocks);
+
+    hdr_size = sizeof(hdr) + w.nb_blocks * sizeof(SaveVMFileBlock);
+    pos = ROUND_UP(hdr_size, SAVEVM_FILE_ALIGN);
+    i = 0;
+    QTAILQ_FOREACH(block, &ram_list.blocks, next) {
+        w.blocks[i] = block;
+        w.offsets[i] = pos;
+        w.first_chunk[i] = w.nb_chunks;
+        w.nb_chunks += DIV_ROUND_UP(block->length, SAVEVM_FILE_CHUNK);
+
+        pstrcpy(entries[i].idstr, sizeof(entries[i].idstr), block->idstr);
+        entries[i].offset = cpu_to_be64(pos);
+        entries[i].length = cpu_to_be64(block->length);
+
+        pos = ROUND_UP(pos + block->length, SAVEVM_FILE_ALIGN);
+        i++;
+    }
+    w.first_chunk[i] = w.nb_chunks;
+
+    if (ftruncate(w.fd, pos) < 0) {
+        error_setg_errno(errp, errno, "Could not resize '%s'", filename);
+        goto out;
+    }
+
+    /* RAM contents, written by a pool of threads */
+    threads = MIN(threads, w.nb_chunks);
+    workers = g_new(QemuThread, threads);
+    for (i = 0; i < threads; i++) {
+        qemu_thread_create(&workers[i], "savevm-file",
+                           savevm_file_writer_thread, &w,
+                           QEMU_THREAD_JOINABLE);
+    }
+    for (i = 0; i < threads; i++) {
+        qemu_thread_join(&workers[i]);
+    }
+    if (w.error) {
+        error_setg_errno(errp, -w.error, "Error writing RAM to '%s'",
+                         filename);
+        goto out;
+    }
+
+    /* Device state, in the savevm stream format */
+    if (lseek(w.fd, pos, SEEK_SET) < 0) {
+        error_setg_errno(errp, errno, "Could not seek in '%s'", filename);
+        goto out;
+    }
+    fd = dup(w.fd);
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "Could not duplicate file descriptor");
+        goto out;
+    }
+    f = qemu_fdopen(fd, "wb");
+    if (!f) {
+        close(fd);
+        error_set(errp, QERR_IO_ERROR);
+        goto out;
+    }
+    ret = qemu_save_device_state(f);
+    hdr.state_size = cpu_to_be64(qemu_ftell(f));
+    qemu_fclose(f);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Error writing device state to '%s'",
+                         filename);
+        goto out;
+    }
+
+    hdr.magic = cpu_to_be32(SAVEVM_FILE_MAGIC);
+    hdr.version = cpu_to_be32(SAVEVM_FILE_VERSION);
+    hdr.align = cpu_to_be32(SAVEVM_FILE_ALIGN);
+    hdr.nb_blocks = cpu_to_be32(w.nb_blocks);
+    hdr.state_offset = cpu_to_be64(pos);
+    ret = savevm_file_write_run(w.fd, (uint8_t *)&hdr, sizeof(hdr), 0);
+    if (ret == 0) {
+        ret = savevm_file_write_run(w.fd, (uint8_t *)entries,
+                                    w.nb_blocks * sizeof(SaveVMFileBlock),
+                                    sizeof(hdr));
+    }
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Error writing header to '%s'",
+                         filename);
+        goto out;
+    }
+
+    if (rename(tmpname, filename) < 0) {
+        error_setg_errno(errp, errno, "Could not rename '%s' to '%s'",
+                         tmpname, filename);
+        goto out;
+    }
+    saved = true;
+
+out:
+    qemu_close(w.fd);
+    if (!saved) {
+        unlink(tmpname);
+    }
+    g_free(tmpname);
+    g_free(workers);
+    g_free(entries);
+    g_free(w.first_chunk);
+    g_free(w.offsets);
+    g_free(w.blocks);
+}
+
+static int savevm_file_read(int fd, void *buf, size_t len, uint64_t offset)
+{
+    uint8_t *p = buf;
+
+    while (len) {
+        ssize_t ret = pread(fd, p, len, offset);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (ret == 0) {
+            return -EINVAL;
+        }
+        p += ret;
+        offset += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/* Replace the contents of a RAM block with the image at @offset */
+static int savevm_file_map_block(int fd, RAMBlock *block, uint64_t offset)
+{
+    uintptr_t pagesize = getpagesize();
+
+    /* Memory we did not allocate ourselves, or that is shared with a
+     * -mem-path file, is filled in by copying instead.
+     */
+    if ((block->flags & RAM_PREALLOC_MASK) || block->fd >= 0 ||
+        ((uintptr_t)block->host | block->length | offset) & (pagesize - 1)) {
+        return savevm_file_read(fd, block->host, block->length, offset);
+    }
+
+    if (mmap(block->host, block->length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        return -errno;
+    }
+    qemu_madvise(block->host, block->length, QEMU_MADV_DONTFORK);
+    return 0;
+}
+
+static void savevm_file_load(const char *filename, Error **errp)
+{
+    SaveVMFileHeader hdr;
+    SaveVMFileBlock *entries = NULL;
+    RAMBlock **blocks = NULL;
+    QEMUFile *f;
+    uint32_t nb_blocks;
+    int fd, i, ret;
+
+    if (xen_enabled()) {
+        error_setg(errp, "savevm-file images can't be loaded under Xen");
+        return;
+    }
+
+    fd = qemu_open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        error_setg_file_open(errp, errno, filename);
+        return;
+    }
+
+    ret = savevm_file_read(fd, &hdr, sizeof(hdr), 0);
+    if (ret < 0 || be32_to_cpu(hdr.magic) != SAVEVM_FILE_MAGIC) {
+        error_setg(errp, "'%s' is not a savevm-file image", filename);
+        goto out;
+    }
+    if (be32_to_cpu(hdr.version) != SAVEVM_FILE_VERSION) {
+        error_setg(errp, "Unsupported savevm-file version %" PRIu32,
+                   be32_to_cpu(hdr.version));
+        goto out;
+    }
+
+    /* Check that the image matches the machine before touching anything */
+    nb_blocks = be32_to_cpu(hdr.nb_blocks);
+    entries = g_new(SaveVMFileBlock, nb_blocks);
+    blocks = g_new(RAMBlock *, nb_blocks);
+    ret = savevm_file_read(fd, entries, nb_blocks * sizeof(SaveVMFileBlock),
+                           sizeof(hdr));
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Could not read '%s'", filename);
+        goto out;
+    }
+    for (i = 0; i < nb_blocks; i++) {
+        entries[i].idstr[sizeof(entries[i].idstr) - 1] = 0;
+        blocks[i] = savevm_file_find_block(entries[i].idstr);
+        if (!blocks[i]) {
+            error_setg(errp, "Unknown RAM block '%s'", entries[i].idstr);
+            goto out;
+        }
+        if (blocks[i]->length != be64_to_cpu(entries[i].length)) {
+            error_setg(errp, "Length mismatch for RAM block '%s'",
+                       entries[i].idstr);
+            goto out;
+        }
+    }
+
+    bdrv_drain_all();
+    qemu_system_reset(VMRESET_SILENT);
+
+    for (i = 0; i < nb_blocks; i++) {
+        ret = savevm_file_map_block(fd, blocks[i],
+                                    be64_to_cpu(entries[i].offset));
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not load RAM block '%s'",
+                             entries[i].idstr);
+            goto out;
+        }
+        cpu_physical_memory_set_dirty_range(blocks[i]->offset,
+                                            blocks[i]->length);
+    }
+
+    /* Guest memory changed behind the back of the code invalidation logic */
+    if (tcg_enabled() && first_cpu) {
+        tb_flush(first_cpu->env_ptr);
+    }
+
+    if (lseek(fd, be64_to_cpu(hdr.state_offset), SEEK_SET) < 0) {
+        error_setg_errno(errp, errno, "Could not seek in '%s'", filename);
+        goto out;
+    }
+    ret = dup(fd);
+    if (ret < 0) {
+        error_setg_errno(errp, errno, "Could not duplicate file descriptor");
+        goto out;
+    }
+    f = qemu_fdopen(ret, "rb");
+    if (!f) {
+        close(ret);
+        error_set(errp, QERR_IO_ERROR);
+        goto out;
+    }
+    ret = qemu_loadvm_state(f);
+    qemu_fclose(f);
+    if (ret < 0) {
+        error_setg(errp, "Error %d while loading VM state", ret);
+    }
+
+out:
+    qemu_close(fd);
+    g_free(blocks);
+    g_free(entries);
+}
+
+void qmp_savevm_file(const char *filename, bool has_threads, int64_t threads,
+                     Error **errp)
+{
+    int saved_vm_running;
+
+    if (!has_threads) {
+        threads = SAVEVM_FILE_DEFAULT_THREADS;
+    }
+    if (threads < 1 || threads > SAVEVM_FILE_MAX_THREADS) {
+        error_set(errp, QERR_INVALID_PARAMETER_VALUE, "threads",
+                  "a value between 1 and 64");
+        return;
+    }
+
+    saved_vm_running = runstate_is_running();
+    vm_stop(RUN_STATE_SAVE_VM);
+
+    savevm_file_save(filename, threads, errp);
+
+    if (saved_vm_running) {
+        vm_start();
+    }
+}
+
+void qmp_loadvm_file(const char *filename, Error **errp)
+{
+    int saved_vm_running = runstate_is_running();
+    Error *local_err = NULL;
+
+    vm_stop(RUN_STATE_RESTORE_VM);
+
+    savevm_file_load(filename, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
+
+    if (saved_vm_running) {
+        vm_start();
+    }
+}
+
+#else
+
+void qmp_savevm_file(const char *filename, bool has_threads, int64_t threads,
+                     Error **errp)
+{
+    error_set(errp, QERR_UNSUPPORTED);
+}
+
+void qmp_loadvm_file(const char *filename, Error **errp)
+{
+    error_set(errp, QERR_UNSUPPORTED);
+}
+
+#endif
+
+int load_vmstate_file(const char *filename)
+{
+    Error *local_err = NULL;
+
+    qmp_loadvm_file(filename, &local_err);
+    if (local_err) {
+        error_report("%s", error_get_pretty(local_err));
+        error_free(local_err);
+        return -EINVAL;
+    }
+    return 0;
+}
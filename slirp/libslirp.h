@@ -21,9 +21,20 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout);
 void slirp_pollfds_poll(GArray *pollfds, int select_error);
 
 void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len);
+/* Like slirp_input(), for a frame whose TCP/UDP checksum the guest left
+ * unfinished (checksum offload); it is not verified.  The frame may also
+ * be a TCP segment larger than the MTU. */
+void slirp_input_nocsum(Slirp *slirp, const uint8_t *pkt, int pkt_len);
+
+/* Hand TCP segments of up to 64k to slirp_output_tso() instead of
+ * splitting them at the MSS */
+void slirp_set_tso(Slirp *slirp, bool enable);
 
 /* you must provide the following functions: */
 void slirp_output(void *opaque, const uint8_t *pkt, int pkt_len);
+/* A TCP/IPv4 frame to be split into segments of @mss payload bytes, with
+ * only the pseudo-header sum in its TCP checksum field */
+void slirp_output_tso(void *opaque, const uint8_t *pkt, int pkt_len, int mss);
 
 int slirp_add_hostfwd(Slirp *slirp, int is_udp,
                       struct in_addr host_addr, int host_port,
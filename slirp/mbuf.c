@@ -89,6 +89,7 @@ m_get(Slirp *slirp)
 	m->m_size = SLIRP_MSIZE - offsetof(struct mbuf, m_dat);
 	m->m_data = m->m_dat;
 	m->m_len = 0;
+	m->m_gso_size = 0;
         m->m_nextpkt = NULL;
         m->m_prevpkt = NULL;
         m->arp_requested = false;
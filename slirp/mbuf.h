@@ -79,6 +79,7 @@ struct mbuf {
 	int	m_len;			/* Amount of data in this mbuf */
 
 	Slirp *slirp;
+	int	m_gso_size;		/* TCP segment size the guest splits this into */
 	bool	arp_requested;
 	uint64_t expiration_date;
 	/* start of dynamic buffer area, must be last element */
@@ -99,6 +100,8 @@ struct mbuf {
 #define M_USEDLIST		0x04	/* XXX mbuf is on used list (for dtom()) */
 #define M_DOFREE		0x08	/* when m_free is called on the mbuf, free()
 					 * it rather than putting it on the free list */
+#define M_CSUM_OK		0x10	/* guest left the TCP/UDP checksum to us,
+					 * don't verify it */
 
 void m_init(Slirp *);
 void m_cleanup(Slirp *slirp);
@@ -235,6 +235,7 @@ Slirp *slirp_init(int restricted, struct in_addr vnetwork,
     }
 
     slirp->opaque = opaque;
+    slirp->polled = g_ptr_array_new();
 
     register_savevm(NULL, "slirp", 0, 3,
                     slirp_state_save, slirp_state_load, slirp);
@@ -253,6 +254,7 @@ void slirp_cleanup(Slirp *slirp)
     ip_cleanup(slirp);
     m_cleanup(slirp);
 
+    g_ptr_array_free(slirp->polled, TRUE);
     g_free(slirp->vdnssearch);
     g_free(slirp->tftp_prefix);
     g_free(slirp->bootp_filename);
@@ -262,6 +264,20 @@ void slirp_cleanup(Slirp *slirp)
 #define CONN_CANFSEND(so) (((so)->so_state & (SS_FCANTSENDMORE|SS_ISFCONNECTED)) == SS_ISFCONNECTED)
 #define CONN_CANFRCV(so) (((so)->so_state & (SS_FCANTRCVMORE|SS_ISFCONNECTED)) == SS_ISFCONNECTED)
 
+static void slirp_poll_add(Slirp *slirp, GArray *pollfds,
+                           struct socket *so, int events)
+{
+    GPollFD pfd = {
+        .fd = so->s,
+        .events = events,
+    };
+
+    so->pollfds_idx = pollfds->len;
+    g_array_append_val(pollfds, pfd);
+    so->polled_idx = slirp->polled->len;
+    g_ptr_array_add(slirp->polled, so);
+}
+
 static void slirp_update_timeout(uint32_t *timeout)
 {
     Slirp *slirp;
@@ -302,6 +318,8 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
      */
 
     QTAILQ_FOREACH(slirp, &slirp_instances, entry) {
+        g_ptr_array_set_size(slirp->polled, 0);
+
         /*
          * *_slowtimo needs calling if there are IP fragments
          * in the fragment queue, or there are TCP connections active
@@ -316,6 +334,7 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
             so_next = so->so_next;
 
             so->pollfds_idx = -1;
+            so->polled_idx = -1;
 
             /*
              * See if we need a tcp_fasttimo
@@ -337,12 +356,8 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
              * Set for reading sockets which are accepting
              */
             if (so->so_state & SS_FACCEPTCONN) {
-                GPollFD pfd = {
-                    .fd = so->s,
-                    .events = G_IO_IN | G_IO_HUP | G_IO_ERR,
-                };
-                so->pollfds_idx = pollfds->len;
-                g_array_append_val(pollfds, pfd);
+                slirp_poll_add(slirp, pollfds, so,
+                               G_IO_IN | G_IO_HUP | G_IO_ERR);
                 continue;
             }
 
@@ -350,12 +365,7 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
              * Set for writing sockets which are connecting
              */
             if (so->so_state & SS_ISFCONNECTING) {
-                GPollFD pfd = {
-                    .fd = so->s,
-                    .events = G_IO_OUT | G_IO_ERR,
-                };
-                so->pollfds_idx = pollfds->len;
-                g_array_append_val(pollfds, pfd);
+                slirp_poll_add(slirp, pollfds, so, G_IO_OUT | G_IO_ERR);
                 continue;
             }
 
@@ -377,23 +387,20 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
             }
 
             if (events) {
-                GPollFD pfd = {
-                    .fd = so->s,
-                    .events = events,
-                };
-                so->pollfds_idx = pollfds->len;
-                g_array_append_val(pollfds, pfd);
+                slirp_poll_add(slirp, pollfds, so, events);
             }
         }
 
         /*
          * UDP sockets
          */
+        slirp->polled_udp = slirp->polled->len;
         for (so = slirp->udb.so_next; so != &slirp->udb;
                 so = so_next) {
             so_next = so->so_next;
 
             so->pollfds_idx = -1;
+            so->polled_idx = -1;
 
             /*
              * See if it's timed out
@@ -418,23 +425,21 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
              * (XXX <= 4 ?)
              */
             if ((so->so_state & SS_ISFCONNECTED) && so->so_queued <= 4) {
-                GPollFD pfd = {
-                    .fd = so->s,
-                    .events = G_IO_IN | G_IO_HUP | G_IO_ERR,
-                };
-                so->pollfds_idx = pollfds->len;
-                g_array_append_val(pollfds, pfd);
+                slirp_poll_add(slirp, pollfds, so,
+                               G_IO_IN | G_IO_HUP | G_IO_ERR);
             }
         }
 
         /*
          * ICMP sockets
          */
+        slirp->polled_icmp = slirp->polled->len;
         for (so = slirp->icmp.so_next; so != &slirp->icmp;
                 so = so_next) {
             so_next = so->so_next;
 
             so->pollfds_idx = -1;
+            so->polled_idx = -1;
 
             /*
              * See if it's timed out
@@ -449,12 +454,8 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
             }
 
             if (so->so_state & SS_ISFCONNECTED) {
-                GPollFD pfd = {
-                    .fd = so->s,
-                    .events = G_IO_IN | G_IO_HUP | G_IO_ERR,
-                };
-                so->pollfds_idx = pollfds->len;
-                g_array_append_val(pollfds, pfd);
+                slirp_poll_add(slirp, pollfds, so,
+                               G_IO_IN | G_IO_HUP | G_IO_ERR);
             }
         }
     }
@@ -464,7 +465,8 @@ void slirp_pollfds_fill(GArray *pollfds, uint32_t *timeout)
 void slirp_pollfds_poll(GArray *pollfds, int select_error)
 {
     Slirp *slirp;
-    struct socket *so, *so_next;
+    struct socket *so;
+    guint i;
     int ret;
 
     if (QTAILQ_EMPTY(&slirp_instances)) {
@@ -496,17 +498,15 @@ void slirp_pollfds_poll(GArray *pollfds, int select_error)
             /*
              * Check TCP sockets
              */
-            for (so = slirp->tcb.so_next; so != &slirp->tcb;
-                    so = so_next) {
+            for (i = 0; i < slirp->polled_udp; i++) {
                 int revents;
 
-                so_next = so->so_next;
-
-                revents = 0;
-                if (so->pollfds_idx != -1) {
-                    revents = g_array_index(pollfds, GPollFD,
-                                            so->pollfds_idx).revents;
+                so = g_ptr_array_index(slirp->polled, i);
+                if (!so) {
+                    continue;
                 }
+                revents = g_array_index(pollfds, GPollFD,
+                                        so->pollfds_idx).revents;
 
                 if (so->so_state & SS_NOFDREF || so->s == -1) {
                     continue;
@@ -627,17 +627,15 @@ void slirp_pollfds_poll(GArray *pollfds, int select_error)
              * Incoming packets are sent straight away, they're not buffered.
              * Incoming UDP data isn't buffered either.
              */
-            for (so = slirp->udb.so_next; so != &slirp->udb;
-                    so = so_next) {
+            for (i = slirp->polled_udp; i < slirp->polled_icmp; i++) {
                 int revents;
 
-                so_next = so->so_next;
-
-                revents = 0;
-                if (so->pollfds_idx != -1) {
-                    revents = g_array_index(pollfds, GPollFD,
-                            so->pollfds_idx).revents;
+                so = g_ptr_array_index(slirp->polled, i);
+                if (!so) {
+                    continue;
                 }
+                revents = g_array_index(pollfds, GPollFD,
+                                        so->pollfds_idx).revents;
 
                 if (so->s != -1 &&
                     (revents & (G_IO_IN | G_IO_HUP | G_IO_ERR))) {
@@ -648,19 +646,17 @@ void slirp_pollfds_poll(GArray *pollfds, int select_error)
             /*
              * Check incoming ICMP relies.
              */
-            for (so = slirp->icmp.so_next; so != &slirp->icmp;
-                    so = so_next) {
-                    int revents;
-
-                    so_next = so->so_next;
+            for (i = slirp->polled_icmp; i < slirp->polled->len; i++) {
+                int revents;
 
-                    revents = 0;
-                    if (so->pollfds_idx != -1) {
-                        revents = g_array_index(pollfds, GPollFD,
-                                                so->pollfds_idx).revents;
-                    }
+                so = g_ptr_array_index(slirp->polled, i);
+                if (!so) {
+                    continue;
+                }
+                revents = g_array_index(pollfds, GPollFD,
+                                        so->pollfds_idx).revents;
 
-                    if (so->s != -1 &&
+                if (so->s != -1 &&
                         (revents & (G_IO_IN | G_IO_HUP | G_IO_ERR))) {
                     icmp_receive(so);
                 }
@@ -730,7 +726,8 @@ static void arp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len)
     }
 }
 
-void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len)
+static void slirp_input_flags(Slirp *slirp, const uint8_t *pkt, int pkt_len,
+                              int flags)
 {
     struct mbuf *m;
     int proto;
@@ -756,6 +753,7 @@ void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len)
 
         m->m_data += 2 + ETH_HLEN;
         m->m_len -= 2 + ETH_HLEN;
+        m->m_flags |= flags;
 
         ip_input(m);
         break;
@@ -764,17 +762,33 @@ void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len)
     }
 }
 
+void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len)
+{
+    slirp_input_flags(slirp, pkt, pkt_len, 0);
+}
+
+void slirp_input_nocsum(Slirp *slirp, const uint8_t *pkt, int pkt_len)
+{
+    slirp_input_flags(slirp, pkt, pkt_len, M_CSUM_OK);
+}
+
+void slirp_set_tso(Slirp *slirp, bool enable)
+{
+    slirp->tso = enable;
+}
+
 /* Output the IP packet to the ethernet device. Returns 0 if the packet must be
  * re-queued.
  */
 int if_encap(Slirp *slirp, struct mbuf *ifm)
 {
-    uint8_t buf[1600];
-    struct ethhdr *eh = (struct ethhdr *)buf;
+    uint8_t stack_buf[1600];
+    uint8_t *buf = stack_buf;
+    struct ethhdr *eh;
     uint8_t ethaddr[ETH_ALEN];
     const struct ip *iph = (const struct ip *)ifm->m_data;
 
-    if (ifm->m_len + ETH_HLEN > sizeof(buf)) {
+    if (ifm->m_len + ETH_HLEN > sizeof(stack_buf) && !ifm->m_gso_size) {
         return 1;
     }
 
@@ -816,13 +830,25 @@ int if_encap(Slirp *slirp, struct mbuf *ifm)
         }
         return 0;
     } else {
+        if (ifm->m_len + ETH_HLEN > sizeof(stack_buf)) {
+            buf = g_malloc(ifm->m_len + ETH_HLEN);
+        }
+        eh = (struct ethhdr *)buf;
         memcpy(eh->h_dest, ethaddr, ETH_ALEN);
         memcpy(eh->h_source, special_ethaddr, ETH_ALEN - 4);
         /* XXX: not correct */
         memcpy(&eh->h_source[2], &slirp->vhost_addr, 4);
         eh->h_proto = htons(ETH_P_IP);
         memcpy(buf + sizeof(struct ethhdr), ifm->m_data, ifm->m_len);
-        slirp_output(slirp->opaque, buf, ifm->m_len + ETH_HLEN);
+        if (ifm->m_gso_size) {
+            slirp_output_tso(slirp->opaque, buf, ifm->m_len + ETH_HLEN,
+                             ifm->m_gso_size);
+        } else {
+            slirp_output(slirp->opaque, buf, ifm->m_len + ETH_HLEN);
+        }
+        if (buf != stack_buf) {
+            g_free(buf);
+        }
         return 1;
     }
 }
@@ -1174,6 +1200,7 @@ static int slirp_state_load(QEMUFile *f, void *opaque, int version_id)
 
         if (ret < 0)
             return ret;
+        sohash(so, IPPROTO_TCP);
 
         if ((so->so_faddr.s_addr & slirp->vnetwork_mask.s_addr) !=
             slirp->vnetwork_addr.s_addr) {
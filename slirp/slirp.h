@@ -241,19 +241,29 @@ struct Slirp {
     uint8_t *vdnssearch;
 
     /* tcp states */
+    bool tso;               /* guest takes large segments, see slirp_set_tso */
     struct socket tcb;
     struct socket *tcp_last_so;
+    struct socket *tcb_hash[SO_HASH_SIZE];
     tcp_seq tcp_iss;        /* tcp initial send seq # */
     uint32_t tcp_now;       /* for RFC 1323 timestamps */
 
     /* udp states */
     struct socket udb;
     struct socket *udp_last_so;
+    struct socket *udb_hash[SO_HASH_SIZE];
 
     /* icmp states */
     struct socket icmp;
     struct socket *icmp_last_so;
 
+    /* sockets handed to the main loop by slirp_pollfds_fill(), TCP first,
+     * then UDP from polled_udp and ICMP from polled_icmp on; entries of
+     * sockets freed in between are NULL */
+    GPtrArray *polled;
+    guint polled_udp;
+    guint polled_icmp;
+
     /* tftp states */
     char *tftp_prefix;
     struct tftp_session tftp_sessions[TFTP_SESSIONS_MAX];
@@ -15,24 +15,81 @@
 static void sofcantrcvmore(struct socket *so);
 static void sofcantsendmore(struct socket *so);
 
+static unsigned int
+sohash_bucket(int proto, struct in_addr laddr, u_int lport,
+              struct in_addr faddr, u_int fport)
+{
+	uint32_t h = laddr.s_addr ^ ((uint32_t)lport << 16);
+
+	if (proto == IPPROTO_TCP)
+		h ^= faddr.s_addr * 31 + fport;
+
+	return (h * 0x9e3779b1u) >> (32 - SO_HASH_BITS);
+}
+
+static void
+sounhash(struct socket *so)
+{
+	if (so->so_hprev) {
+		if (so->so_hnext)
+			so->so_hnext->so_hprev = so->so_hprev;
+		*so->so_hprev = so->so_hnext;
+		so->so_hnext = NULL;
+		so->so_hprev = NULL;
+	}
+}
+
+/*
+ * (Re)hash a socket under its current addresses; must be called whenever
+ * they change.  TCP sockets are keyed on the full 4-tuple, UDP sockets on
+ * the guest address and port only, like udp_input() looks them up.
+ */
+void
+sohash(struct socket *so, int proto)
+{
+	Slirp *slirp = so->slirp;
+	struct socket **head;
+
+	sounhash(so);
+
+	head = proto == IPPROTO_TCP ? slirp->tcb_hash : slirp->udb_hash;
+	head += sohash_bucket(proto, so->so_laddr, so->so_lport,
+	                      so->so_faddr, so->so_fport);
+
+	so->so_hnext = *head;
+	if (*head)
+		(*head)->so_hprev = &so->so_hnext;
+	so->so_hprev = head;
+	*head = so;
+}
+
+/*
+ * Find the TCP or UDP socket for a guest address; faddr and fport are
+ * ignored for UDP
+ */
 struct socket *
-solookup(struct socket *head, struct in_addr laddr, u_int lport,
+solookup(Slirp *slirp, int proto, struct in_addr laddr, u_int lport,
          struct in_addr faddr, u_int fport)
 {
 	struct socket *so;
 
-	for (so = head->so_next; so != head; so = so->so_next) {
+	if (proto == IPPROTO_TCP)
+		so = slirp->tcb_hash[sohash_bucket(proto, laddr, lport,
+		                                   faddr, fport)];
+	else
+		so = slirp->udb_hash[sohash_bucket(proto, laddr, lport,
+		                                   faddr, fport)];
+
+	for (; so; so = so->so_hnext) {
 		if (so->so_lport == lport &&
 		    so->so_laddr.s_addr == laddr.s_addr &&
-		    so->so_faddr.s_addr == faddr.s_addr &&
-		    so->so_fport == fport)
+		    (proto != IPPROTO_TCP ||
+		     (so->so_faddr.s_addr == faddr.s_addr &&
+		      so->so_fport == fport)))
 		   break;
 	}
 
-	if (so == head)
-	   return (struct socket *)NULL;
 	return so;
-
 }
 
 /*
@@ -52,6 +109,7 @@ socreate(Slirp *slirp)
     so->s = -1;
     so->slirp = slirp;
     so->pollfds_idx = -1;
+    so->polled_idx = -1;
   }
   return(so);
 }
@@ -75,8 +133,13 @@ sofree(struct socket *so)
   } else if (so == slirp->icmp_last_so) {
       slirp->icmp_last_so = &slirp->icmp;
   }
+  if (so->polled_idx != -1 && so->polled_idx < slirp->polled->len &&
+      g_ptr_array_index(slirp->polled, so->polled_idx) == so) {
+      g_ptr_array_index(slirp->polled, so->polled_idx) = NULL;
+  }
   m_free(so->so_m);
 
+  sounhash(so);
   if(so->so_next && so->so_prev)
     remque(so);  /* crashes if so is not in a queue */
 
@@ -650,6 +713,7 @@ tcp_listen(Slirp *slirp, uint32_t haddr, u_int hport, uint32_t laddr,
 	   so->so_faddr = slirp->vhost_addr;
 	else
 	   so->so_faddr = addr.sin_addr;
+	sohash(so, IPPROTO_TCP);
 
 	so->s = s;
 	return so;
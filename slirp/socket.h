@@ -11,16 +11,22 @@
 #define SO_EXPIRE 240000
 #define SO_EXPIREFAST 10000
 
+/* Buckets in the TCP and UDP socket hash tables */
+#define SO_HASH_BITS 10
+#define SO_HASH_SIZE (1 << SO_HASH_BITS)
+
 /*
  * Our socket structure
  */
 
 struct socket {
   struct socket *so_next,*so_prev;      /* For a linked list of sockets */
+  struct socket *so_hnext,**so_hprev;   /* Hash chain, see sohash() */
 
   int s;                           /* The actual socket */
 
   int pollfds_idx;                 /* GPollFD GArray index */
+  int polled_idx;                  /* Index in slirp->polled */
 
   Slirp *slirp;			   /* managing slirp instance */
 
@@ -76,7 +82,8 @@ struct socket {
 #define SS_HOSTFWD		0x1000	/* Socket describes host->guest forwarding */
 #define SS_INCOMING		0x2000	/* Connection was initiated by a host on the internet */
 
-struct socket * solookup(struct socket *, struct in_addr, u_int, struct in_addr, u_int);
+void sohash(struct socket *, int);
+struct socket * solookup(Slirp *, int, struct in_addr, u_int, struct in_addr, u_int);
 struct socket * socreate(Slirp *);
 void sofree(struct socket *);
 int soread(struct socket *);
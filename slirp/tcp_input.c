@@ -282,7 +282,7 @@ tcp_input(struct mbuf *m, int iphlen, struct socket *inso)
 	ti->ti_x1 = 0;
 	ti->ti_len = htons((uint16_t)tlen);
 	len = sizeof(struct ip ) + tlen;
-	if(cksum(m, len)) {
+	if (!(m->m_flags & M_CSUM_OK) && cksum(m, len)) {
 	  goto drop;
 	}
 
@@ -325,8 +325,8 @@ findso:
 	    so->so_lport != ti->ti_sport ||
 	    so->so_laddr.s_addr != ti->ti_src.s_addr ||
 	    so->so_faddr.s_addr != ti->ti_dst.s_addr) {
-		so = solookup(&slirp->tcb, ti->ti_src, ti->ti_sport,
-			       ti->ti_dst, ti->ti_dport);
+		so = solookup(slirp, IPPROTO_TCP, ti->ti_src, ti->ti_sport,
+			      ti->ti_dst, ti->ti_dport);
 		if (so)
 			slirp->tcp_last_so = so;
 	}
@@ -378,6 +378,7 @@ findso:
 	  so->so_lport = ti->ti_sport;
 	  so->so_faddr = ti->ti_dst;
 	  so->so_fport = ti->ti_dport;
+	  sohash(so, IPPROTO_TCP);
 
 	  if ((so->so_iptos = tcp_tos(so)) == 0)
 	    so->so_iptos = ((struct ip *)ti)->ip_tos;
@@ -50,6 +50,9 @@ static const u_char  tcp_outflags[TCP_NSTATES] = {
 #undef MAX_TCPOPTLEN
 #define MAX_TCPOPTLEN	32	/* max # bytes that go in options */
 
+/* Largest segment sent to a guest that takes large segments */
+#define TCP_TSO_MAXLEN	(IP_MAXPACKET - sizeof(struct tcpiphdr) - MAX_TCPOPTLEN)
+
 /*
  * Tcp output routine: figure out what should be sent and send it.
  */
@@ -57,7 +60,7 @@ int
 tcp_output(struct tcpcb *tp)
 {
 	register struct socket *so = tp->t_socket;
-	register long len, win;
+	register long len, win, maxlen;
 	int off, flags, error;
 	register struct mbuf *m;
 	register struct tcpiphdr *ti;
@@ -144,8 +147,16 @@ again:
 		}
 	}
 
-	if (len > tp->t_maxseg) {
-		len = tp->t_maxseg;
+	/*
+	 * A guest that segments TCP itself takes up to TCP_TSO_MAXLEN
+	 * bytes at a time, as a multiple of the segment size.
+	 */
+	maxlen = tp->t_maxseg;
+	if (so->slirp->tso && tp->t_maxseg > 0)
+		maxlen = (TCP_TSO_MAXLEN / tp->t_maxseg) * tp->t_maxseg;
+
+	if (len > maxlen) {
+		len = maxlen;
 		sendalot = 1;
 	}
 	if (SEQ_LT(tp->snd_nxt + len, tp->snd_una + so->so_snd.sb_cc))
@@ -164,7 +175,7 @@ again:
 	 * to send into a small window), then must resend.
 	 */
 	if (len) {
-		if (len == tp->t_maxseg)
+		if (len >= tp->t_maxseg)
 			goto send;
 		if ((1 || idle || tp->t_flags & TF_NODELAY) &&
 		    len + off >= so->so_snd.sb_cc)
@@ -280,8 +291,8 @@ send:
 	 * Adjust data length if insertion of options will
 	 * bump the packet length beyond the t_maxseg length.
 	 */
-	 if (len > tp->t_maxseg - optlen) {
-		len = tp->t_maxseg - optlen;
+	 if (len > maxlen - optlen) {
+		len = maxlen - optlen;
 		sendalot = 1;
 	 }
 
@@ -296,11 +307,17 @@ send:
 			error = 1;
 			goto out;
 		}
+		if (M_FREEROOM(m) < IF_MAXLINKHDR + hdrlen + len) {
+			m_inc(m, IF_MAXLINKHDR + hdrlen + len);
+		}
 		m->m_data += IF_MAXLINKHDR;
 		m->m_len = hdrlen;
 
 		sbcopy(&so->so_snd, off, (int) len, mtod(m, caddr_t) + hdrlen);
 		m->m_len += len;
+		if (len > tp->t_maxseg - optlen) {
+			m->m_gso_size = tp->t_maxseg - optlen;
+		}
 
 		/*
 		 * If we're sending everything we've got, set PUSH.
@@ -386,7 +403,12 @@ send:
 	if (len + optlen)
 		ti->ti_len = htons((uint16_t)(sizeof (struct tcphdr) +
 		    optlen + len));
-	ti->ti_sum = cksum(m, (int)(hdrlen + len));
+	if (m->m_gso_size) {
+		/* The guest finishes the checksum of each segment */
+		ti->ti_sum = ~cksum(m, sizeof(struct ipovly));
+	} else {
+		ti->ti_sum = cksum(m, (int)(hdrlen + len));
+	}
 
 	/*
 	 * In transmit state, time the transmission and arrange for
@@ -438,6 +438,7 @@ void tcp_connect(struct socket *inso)
         (loopback_addr.s_addr & loopback_mask)) {
         so->so_faddr = slirp->vhost_addr;
     }
+    sohash(so, IPPROTO_TCP);
 
     /* Close the accept() socket, set right state */
     if (inso->so_state & SS_FACCEPTONCE) {
@@ -590,19 +591,13 @@ tcp_emu(struct socket *so, struct mbuf *m)
 					HTONS(n1);
 					HTONS(n2);
 					/* n2 is the one on our host */
-					for (tmpso = slirp->tcb.so_next;
-					     tmpso != &slirp->tcb;
-					     tmpso = tmpso->so_next) {
-						if (tmpso->so_laddr.s_addr == so->so_laddr.s_addr &&
-						    tmpso->so_lport == n2 &&
-						    tmpso->so_faddr.s_addr == so->so_faddr.s_addr &&
-						    tmpso->so_fport == n1) {
-							if (getsockname(tmpso->s,
-								(struct sockaddr *)&addr, &addrlen) == 0)
-							   n2 = ntohs(addr.sin_port);
-							break;
-						}
-					}
+					tmpso = solookup(slirp, IPPROTO_TCP,
+							 so->so_laddr, n2,
+							 so->so_faddr, n1);
+					if (tmpso &&
+					    getsockname(tmpso->s,
+						(struct sockaddr *)&addr, &addrlen) == 0)
+					   n2 = ntohs(addr.sin_port);
 				}
                                 so_rcv->sb_cc = snprintf(so_rcv->sb_data,
                                                          so_rcv->sb_datalen,
@@ -116,7 +116,7 @@ udp_input(register struct mbuf *m, int iphlen)
 	/*
 	 * Checksum extended UDP header and data.
 	 */
-	if (uh->uh_sum) {
+	if (uh->uh_sum && !(m->m_flags & M_CSUM_OK)) {
       memset(&((struct ipovly *)ip)->ih_mbuf, 0, sizeof(struct mbuf_ptr));
 	  ((struct ipovly *)ip)->ih_x1 = 0;
 	  ((struct ipovly *)ip)->ih_len = uh->uh_ulen;
@@ -154,21 +154,10 @@ udp_input(register struct mbuf *m, int iphlen)
 	so = slirp->udp_last_so;
 	if (so->so_lport != uh->uh_sport ||
 	    so->so_laddr.s_addr != ip->ip_src.s_addr) {
-		struct socket *tmp;
-
-		for (tmp = slirp->udb.so_next; tmp != &slirp->udb;
-		     tmp = tmp->so_next) {
-			if (tmp->so_lport == uh->uh_sport &&
-			    tmp->so_laddr.s_addr == ip->ip_src.s_addr) {
-				so = tmp;
-				break;
-			}
-		}
-		if (tmp == &slirp->udb) {
-		  so = NULL;
-		} else {
-		  slirp->udp_last_so = so;
-		}
+		so = solookup(slirp, IPPROTO_UDP, ip->ip_src, uh->uh_sport,
+			      ip->ip_dst, uh->uh_dport);
+		if (so)
+			slirp->udp_last_so = so;
 	}
 
 	if (so == NULL) {
@@ -192,6 +181,7 @@ udp_input(register struct mbuf *m, int iphlen)
 	   */
 	  so->so_laddr = ip->ip_src;
 	  so->so_lport = uh->uh_sport;
+	  sohash(so, IPPROTO_UDP);
 
 	  if ((so->so_iptos = udp_tos(so)) == 0)
 	    so->so_iptos = ip->ip_tos;
@@ -384,6 +374,7 @@ udp_listen(Slirp *slirp, uint32_t haddr, u_int hport, uint32_t laddr,
 	}
 	so->so_lport = lport;
 	so->so_laddr.s_addr = laddr;
+	sohash(so, IPPROTO_UDP);
 	if (flags != SS_FACCEPTONCE)
 	   so->so_expire = 0;
 
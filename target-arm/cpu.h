@@ -40,6 +40,9 @@
 #include "fpu/softfloat.h"
 
 #define TARGET_HAS_ICE 1
+/* translate.c and translate-a64.c keep their per-TB state in TCG_THREAD
+   variables, so several threads can translate at once.  */
+#define TARGET_HAS_PARALLEL_TRANSLATE 1
 
 #define EXCP_UDEF            1   /* undefined instruction */
 #define EXCP_SWI             2   /* software interrupt */
@@ -53,6 +56,12 @@
 #define EXCP_STREX          10
 #define EXCP_SMC            11   /* secure monitor call */
 
+/* Operand size for the user-mode strex_cmpxchg helper beyond the
+ * log2 byte sizes 0..3: two words at addr and addr + 4, as LDREXD and
+ * 32-bit LDXP load them, with the first word in the low half.
+ */
+#define ARM_CMPXCHG_32X2     4
+
 #define ARMV7M_EXCP_RESET   1
 #define ARMV7M_EXCP_NMI     2
 #define ARMV7M_EXCP_HARD    3
@@ -163,6 +172,13 @@ typedef struct CPUARMState {
     uint32_t NF; /* N is bit 31. All other bits are undefined.  */
     uint32_t ZF; /* Z set if zero.  */
     uint32_t QF; /* 0 or 1 */
+    /* After a flag-setting add or subtract the AArch32 translator leaves
+     * C and V uncomputed; cc_op (CC_OP_*) says how to derive them from NF
+     * and cc_a, the first operand.  CF and VF are only valid when cc_op
+     * is CC_OP_FLAGS.  Use arm_cf() and arm_vf() to read them.
+     */
+    uint32_t cc_op;
+    uint32_t cc_a;
     uint32_t GE; /* cpsr[19:16] */
     uint32_t thumb; /* cpsr[5]. 0 = arm mode, 1 = thumb mode. */
     uint32_t condexec_bits; /* IT bits.  cpsr[15:10,26:25].  */
@@ -455,6 +471,41 @@ int arm_cpu_handle_mmu_fault(CPUState *cpu, vaddr address, int rw,
 #define PSTATE_MODE_EL1t 4
 #define PSTATE_MODE_EL0t 0
 
+/* Representations of the C and V flags, see CPUARMState.cc_op */
+enum {
+    CC_OP_FLAGS = 0, /* CF and VF hold the flags */
+    CC_OP_ADD,       /* NF = cc_a + b */
+    CC_OP_SUB,       /* NF = cc_a - b */
+};
+
+/* Return the C flag as 0 or 1 */
+static inline uint32_t arm_cf(CPUARMState *env)
+{
+    switch (env->cc_op) {
+    case CC_OP_ADD:
+        return env->NF < env->cc_a;
+    case CC_OP_SUB:
+        return env->cc_a >= env->cc_a - env->NF;
+    default:
+        return env->CF;
+    }
+}
+
+/* Return the V flag in bit 31 */
+static inline uint32_t arm_vf(CPUARMState *env)
+{
+    uint32_t a = env->cc_a;
+
+    switch (env->cc_op) {
+    case CC_OP_ADD:
+        return (env->NF ^ a) & ~(a ^ (env->NF - a));
+    case CC_OP_SUB:
+        return (env->NF ^ a) & (a ^ (a - env->NF));
+    default:
+        return env->VF;
+    }
+}
+
 /* Return the current PSTATE value. For the moment we don't support 32<->64 bit
  * interprocessing, so we don't attempt to sync with the cpsr state used by
  * the 32 bit decoder.
@@ -465,7 +516,7 @@ static inline uint32_t pstate_read(CPUARMState *env)
 
     ZF = (env->ZF == 0);
     return (env->NF & 0x80000000) | (ZF << 30)
-        | (env->CF << 29) | ((env->VF & 0x80000000) >> 3)
+        | (arm_cf(env) << 29) | ((arm_vf(env) & 0x80000000) >> 3)
         | env->pstate | env->daif;
 }
 
@@ -475,6 +526,7 @@ static inline void pstate_write(CPUARMState *env, uint32_t val)
     env->NF = val;
     env->CF = (val >> 29) & 1;
     env->VF = (val << 3) & 0x80000000;
+    env->cc_op = CC_OP_FLAGS;
     env->daif = val & PSTATE_DAIF;
     env->pstate = val & ~CACHED_PSTATE_BITS;
 }
@@ -490,8 +542,8 @@ static inline uint32_t xpsr_read(CPUARMState *env)
     int ZF;
     ZF = (env->ZF == 0);
     return (env->NF & 0x80000000) | (ZF << 30)
-        | (env->CF << 29) | ((env->VF & 0x80000000) >> 3) | (env->QF << 27)
-        | (env->thumb << 24) | ((env->condexec_bits & 3) << 25)
+        | (arm_cf(env) << 29) | ((arm_vf(env) & 0x80000000) >> 3)
+        | (env->QF << 27) | (env->thumb << 24) | ((env->condexec_bits & 3) << 25)
         | ((env->condexec_bits & 0xfc) << 8)
         | env->v7m.exception;
 }
@@ -504,6 +556,7 @@ static inline void xpsr_write(CPUARMState *env, uint32_t val, uint32_t mask)
         env->NF = val;
         env->CF = (val >> 29) & 1;
         env->VF = (val << 3) & 0x80000000;
+        env->cc_op = CC_OP_FLAGS;
     }
     if (mask & CPSR_Q)
         env->QF = ((val & CPSR_Q) != 0);
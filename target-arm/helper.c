@@ -2684,7 +2684,8 @@ uint32_t cpsr_read(CPUARMState *env)
     int ZF;
     ZF = (env->ZF == 0);
     return env->uncached_cpsr | (env->NF & 0x80000000) | (ZF << 30) |
-        (env->CF << 29) | ((env->VF & 0x80000000) >> 3) | (env->QF << 27)
+        (arm_cf(env) << 29) | ((arm_vf(env) & 0x80000000) >> 3) |
+        (env->QF << 27)
         | (env->thumb << 5) | ((env->condexec_bits & 3) << 25)
         | ((env->condexec_bits & 0xfc) << 8)
         | (env->GE << 16) | (env->daif & CPSR_AIF);
@@ -2697,6 +2698,7 @@ void cpsr_write(CPUARMState *env, uint32_t val, uint32_t mask)
         env->NF = val;
         env->CF = (val >> 29) & 1;
         env->VF = (val << 3) & 0x80000000;
+        env->cc_op = CC_OP_FLAGS;
     }
     if (mask & CPSR_Q)
         env->QF = ((val & CPSR_Q) != 0);
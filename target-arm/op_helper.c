@@ -94,6 +94,58 @@ void tlb_fill(CPUState *cs, target_ulong addr, int is_write, int mmu_idx,
 }
 #endif
 
+#ifdef CONFIG_USER_ONLY
+/* Atomically replace the guest memory at ADDR with NEWV if it still
+ * holds CMP, returning what was there.  Both values are in register
+ * form and SIZE is a log2 byte count or ARM_CMPXCHG_32X2.  This lets
+ * threads of a user-mode guest run store-exclusives concurrently
+ * without stopping each other.  Unaligned or inaccessible addresses
+ * raise a data abort; the caller has synced the PC for that.
+ */
+uint64_t HELPER(strex_cmpxchg)(CPUARMState *env, uint64_t addr,
+                                uint64_t cmp, uint64_t newv, uint32_t size)
+{
+    int len = size == ARM_CMPXCHG_32X2 ? 8 : 1 << size;
+    void *haddr = g2h(addr);
+
+    if ((addr & (len - 1)) || addr != (target_ulong)addr ||
+        page_check_range(addr, len, PAGE_READ | PAGE_WRITE) < 0) {
+        env->exclusive_addr = -1;
+        env->cp15.c6_data = addr;
+        raise_exception(env, EXCP_DATA_ABORT);
+    }
+
+    switch (size) {
+    case 0:
+        return atomic_cmpxchg((uint8_t *)haddr, cmp, newv);
+    case 1:
+        return tswap16(atomic_cmpxchg((uint16_t *)haddr, tswap16(cmp),
+                                      tswap16(newv)));
+    case 2:
+        return tswap32(atomic_cmpxchg((uint32_t *)haddr, tswap32(cmp),
+                                      tswap32(newv)));
+    case 3:
+        return tswap64(atomic_cmpxchg((uint64_t *)haddr, tswap64(cmp),
+                                      tswap64(newv)));
+    case ARM_CMPXCHG_32X2: {
+        union {
+            uint32_t w[2];
+            uint64_t d;
+        } c, n, old;
+
+        c.w[0] = tswap32(cmp);
+        c.w[1] = tswap32(cmp >> 32);
+        n.w[0] = tswap32(newv);
+        n.w[1] = tswap32(newv >> 32);
+        old.d = atomic_cmpxchg((uint64_t *)haddr, c.d, n.d);
+        return tswap32(old.w[0]) | (uint64_t)tswap32(old.w[1]) << 32;
+    }
+    default:
+        abort();
+    }
+}
+#endif
+
 uint32_t HELPER(add_setq)(CPUARMState *env, uint32_t a, uint32_t b)
 {
     uint32_t res = a + b;
@@ -243,6 +295,11 @@ void HELPER(wfe)(CPUARMState *env)
     cpu_loop_exit(cs);
 }
 
+void *HELPER(lookup_tb_ptr)(CPUARMState *env)
+{
+    return tb_lookup_tc_ptr(env);
+}
+
 void HELPER(exception)(CPUARMState *env, uint32_t excp)
 {
     CPUState *cs = CPU(arm_env_get_cpu(env));
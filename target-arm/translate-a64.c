@@ -24,6 +24,7 @@
 
 #include "cpu.h"
 #include "tcg-op.h"
+#include "tcg-op-vec.h"
 #include "qemu/log.h"
 #include "translate.h"
 #include "qemu/host-utils.h"
@@ -36,7 +37,6 @@
 
 static TCGv_i64 cpu_X[32];
 static TCGv_i64 cpu_pc;
-static TCGv_i32 cpu_NF, cpu_ZF, cpu_CF, cpu_VF;
 
 /* Load/store exclusive handling */
 static TCGv_i64 cpu_exclusive_addr;
@@ -93,17 +93,20 @@ void a64_translate_init(void)
     cpu_pc = tcg_global_mem_new_i64(TCG_AREG0,
                                     offsetof(CPUARMState, pc),
                                     "pc");
+    /* SP and LR are kept in host registers if possible, see
+       arm_translate_init() */
     for (i = 0; i < 32; i++) {
-        cpu_X[i] = tcg_global_mem_new_i64(TCG_AREG0,
-                                          offsetof(CPUARMState, xregs[i]),
-                                          regnames[i]);
+        if (i >= 30) {
+            cpu_X[i] = tcg_global_mem_new_pinned_i64(TCG_AREG0,
+                                            offsetof(CPUARMState, xregs[i]),
+                                            regnames[i]);
+        } else {
+            cpu_X[i] = tcg_global_mem_new_i64(TCG_AREG0,
+                                              offsetof(CPUARMState, xregs[i]),
+                                              regnames[i]);
+        }
     }
 
-    cpu_NF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, NF), "NF");
-    cpu_ZF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, ZF), "ZF");
-    cpu_CF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, CF), "CF");
-    cpu_VF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, VF), "VF");
-
     cpu_exclusive_addr = tcg_global_mem_new_i64(TCG_AREG0,
         offsetof(CPUARMState, exclusive_addr), "exclusive_addr");
     cpu_exclusive_val = tcg_global_mem_new_i64(TCG_AREG0,
@@ -197,11 +200,6 @@ static inline bool use_goto_tb(DisasContext *s, int n, uint64_t dest)
         return false;
     }
 
-    /* Only link tbs from inside the same guest page */
-    if ((s->tb->pc & TARGET_PAGE_MASK) != (dest & TARGET_PAGE_MASK)) {
-        return false;
-    }
-
     return true;
 }
 
@@ -211,16 +209,22 @@ static inline void gen_goto_tb(DisasContext *s, int n, uint64_t dest)
 
     tb = s->tb;
     if (use_goto_tb(s, n, dest)) {
-        tcg_gen_goto_tb(n);
-        gen_a64_set_pc_im(dest);
-        tcg_gen_exit_tb((intptr_t)tb + n);
+        if ((tb->pc & TARGET_PAGE_MASK) == (dest & TARGET_PAGE_MASK)) {
+            tcg_gen_goto_tb(n);
+            gen_a64_set_pc_im(dest);
+            tcg_gen_exit_tb((intptr_t)tb + n);
+        } else {
+            /* Links across pages are validated against the TLB */
+            gen_a64_set_pc_im(dest);
+            gen_goto_tb_cross_page(s, n, dest);
+        }
         s->is_jmp = DISAS_TB_JUMP;
     } else {
         gen_a64_set_pc_im(dest);
         if (s->singlestep_enabled) {
             gen_exception(EXCP_DEBUG);
         }
-        tcg_gen_exit_tb(0);
+        gen_lookup_and_goto_ptr(s);
         s->is_jmp = DISAS_JUMP;
     }
 }
@@ -374,6 +378,12 @@ static inline int fp_reg_hi_offset(int regno)
     return offsetof(CPUARMState, vfp.regs[regno * 2 + 1]);
 }
 
+/* Offset of the whole 128 bit vector Qn, for the tcg_gen_vec_* operations */
+static inline int vec_full_reg_offset(int regno)
+{
+    return offsetof(CPUARMState, vfp.regs[regno * 2]);
+}
+
 /* Convenience accessors for reading and writing single and double
  * FP registers. Writing clears the upper parts of the associated
  * 128 bit vector register, as required by the architecture.
@@ -1494,8 +1504,11 @@ static void disas_b_exc_sys(DisasContext *s, uint32_t insn)
  * and avoids having to monitor regular stores.
  *
  * In system emulation mode only one CPU will be running at once, so
- * this sequence is effectively atomic.  In user emulation mode we
- * throw an exception and handle the atomic operation elsewhere.
+ * this sequence is effectively atomic.  In user emulation mode other
+ * guest threads run concurrently, so the store is a host
+ * compare-and-swap against the value the load saw.  Hosts have no
+ * portable 16 byte compare-and-swap, so a pair of 64-bit registers
+ * still throws an exception and is handled in the cpu loop.
  */
 static void gen_load_exclusive(DisasContext *s, int rt, int rt2,
                                TCGv_i64 addr, int size, bool is_pair)
@@ -1528,12 +1541,66 @@ static void gen_load_exclusive(DisasContext *s, int rt, int rt2,
 
 #ifdef CONFIG_USER_ONLY
 static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
-                                TCGv_i64 addr, int size, int is_pair)
+                                TCGv_i64 inaddr, int size, int is_pair)
 {
-    tcg_gen_mov_i64(cpu_exclusive_test, addr);
-    tcg_gen_movi_i32(cpu_exclusive_info,
-                     size | is_pair << 2 | (rd << 4) | (rt << 9) | (rt2 << 14));
-    gen_exception_insn(s, 4, EXCP_STREX);
+    /* if (env->exclusive_addr == addr
+     *     && cmpxchg([addr], env->exclusive_val, {Rt}) succeeds) {
+     *     {Rd} = 0;
+     * } else {
+     *     {Rd} = 1;
+     * }
+     * env->exclusive_addr = -1;
+     *
+     * A pair of words is swapped as one doubleword.
+     */
+    int fail_label;
+    int done_label;
+    TCGv_i64 addr, cmp, val, old;
+    TCGv_i32 tcg_size;
+
+    if (is_pair && size == 3) {
+        tcg_gen_mov_i64(cpu_exclusive_test, inaddr);
+        tcg_gen_movi_i32(cpu_exclusive_info,
+                         size | is_pair << 2 | (rd << 4) | (rt << 9) |
+                         (rt2 << 14));
+        gen_exception_insn(s, 4, EXCP_STREX);
+        return;
+    }
+
+    fail_label = gen_new_label();
+    done_label = gen_new_label();
+    addr = tcg_temp_local_new_i64();
+    tcg_gen_mov_i64(addr, inaddr);
+    tcg_gen_brcond_i64(TCG_COND_NE, addr, cpu_exclusive_addr, fail_label);
+
+    cmp = tcg_temp_new_i64();
+    val = tcg_temp_new_i64();
+    if (is_pair) {
+        tcg_gen_concat32_i64(cmp, cpu_exclusive_val, cpu_exclusive_high);
+        tcg_gen_concat32_i64(val, cpu_reg(s, rt), cpu_reg(s, rt2));
+        size = ARM_CMPXCHG_32X2;
+    } else {
+        tcg_gen_mov_i64(cmp, cpu_exclusive_val);
+        tcg_gen_mov_i64(val, cpu_reg(s, rt));
+    }
+
+    /* A bad address raises a data abort from the helper */
+    gen_a64_set_pc_im(s->pc - 4);
+    old = tcg_temp_new_i64();
+    tcg_size = tcg_const_i32(size);
+    gen_helper_strex_cmpxchg(old, cpu_env, addr, cmp, val, tcg_size);
+    tcg_temp_free_i32(tcg_size);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_i64(addr);
+
+    tcg_gen_setcond_i64(TCG_COND_NE, cpu_reg(s, rd), old, cmp);
+    tcg_temp_free_i64(old);
+    tcg_temp_free_i64(cmp);
+    tcg_gen_br(done_label);
+    gen_set_label(fail_label);
+    tcg_gen_movi_i64(cpu_reg(s, rd), 1);
+    gen_set_label(done_label);
+    tcg_gen_movi_i64(cpu_exclusive_addr, -1);
 }
 #else
 static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
@@ -5221,9 +5288,7 @@ static void handle_simd_dupe(DisasContext *s, int is_q, int rd, int rn,
                              int imm5)
 {
     int size = ctz32(imm5);
-    int esize = 8 << size;
-    int elements = (is_q ? 128 : 64) / esize;
-    int index, i;
+    int index;
     TCGv_i64 tmp;
 
     if (size > 3 || (size == 3 && !is_q)) {
@@ -5235,10 +5300,8 @@ static void handle_simd_dupe(DisasContext *s, int is_q, int rd, int rn,
 
     tmp = tcg_temp_new_i64();
     read_vec_element(s, tmp, rn, index, size);
-
-    for (i = 0; i < elements; i++) {
-        write_vec_element(s, tmp, rd, i, size);
-    }
+    tcg_gen_vec_dup_i64(size, cpu_env, vec_full_reg_offset(rd),
+                        is_q ? 16 : 8, tmp);
 
     if (!is_q) {
         clear_vec_high(s, rd);
@@ -5289,17 +5352,13 @@ static void handle_simd_dupg(DisasContext *s, int is_q, int rd, int rn,
                              int imm5)
 {
     int size = ctz32(imm5);
-    int esize = 8 << size;
-    int elements = (is_q ? 128 : 64)/esize;
-    int i = 0;
 
     if (size > 3 || ((size == 3) && !is_q)) {
         unallocated_encoding(s);
         return;
     }
-    for (i = 0; i < elements; i++) {
-        write_vec_element(s, cpu_reg(s, rn), rd, i, size);
-    }
+    tcg_gen_vec_dup_i64(size, cpu_env, vec_full_reg_offset(rd),
+                        is_q ? 16 : 8, cpu_reg(s, rn));
     if (!is_q) {
         clear_vec_high(s, rd);
     }
@@ -7647,6 +7706,30 @@ static void handle_vec_simd_shri(DisasContext *s, bool is_q, bool is_u,
         break;
     }
 
+    if (opcode == 0x00) {
+        /* SSHR, USHR: whole-vector shifts */
+        uint32_t dofs = vec_full_reg_offset(rd);
+        uint32_t aofs = vec_full_reg_offset(rn);
+        uint32_t oprsz = is_q ? 16 : 8;
+
+        if (shift < esize) {
+            if (is_u) {
+                tcg_gen_vec_shri(size, cpu_env, dofs, aofs, shift, oprsz);
+            } else {
+                tcg_gen_vec_sari(size, cpu_env, dofs, aofs, shift, oprsz);
+            }
+        } else if (is_u) {
+            /* Shift by the element size: all zeroes */
+            tcg_gen_vec_xor(cpu_env, dofs, aofs, aofs, oprsz);
+        } else {
+            tcg_gen_vec_sari(size, cpu_env, dofs, aofs, esize - 1, oprsz);
+        }
+        if (!is_q) {
+            clear_vec_high(s, rd);
+        }
+        return;
+    }
+
     if (round) {
         uint64_t round_const = 1ULL << (shift - 1);
         tcg_round = tcg_const_i64(round_const);
@@ -7703,6 +7786,16 @@ static void handle_vec_simd_shli(DisasContext *s, bool is_q, bool insert,
         return;
     }
 
+    if (!insert) {
+        /* SHL: whole-vector shift */
+        tcg_gen_vec_shli(size, cpu_env, vec_full_reg_offset(rd),
+                         vec_full_reg_offset(rn), shift, is_q ? 16 : 8);
+        if (!is_q) {
+            clear_vec_high(s, rd);
+        }
+        return;
+    }
+
     for (i = 0; i < elements; i++) {
         read_vec_element(s, tcg_rn, rn, i, size);
         if (insert) {
@@ -8332,11 +8425,39 @@ static void disas_simd_3same_logic(DisasContext *s, uint32_t insn)
     int size = extract32(insn, 22, 2);
     bool is_u = extract32(insn, 29, 1);
     bool is_q = extract32(insn, 30, 1);
-    TCGv_i64 tcg_op1 = tcg_temp_new_i64();
-    TCGv_i64 tcg_op2 = tcg_temp_new_i64();
+    TCGv_i64 tcg_op1, tcg_op2;
     TCGv_i64 tcg_res[2];
     int pass;
 
+    if (size == 0 || (!is_u && size != 3)) {
+        /* AND, BIC, ORR, EOR: whole-vector operations */
+        uint32_t dofs = vec_full_reg_offset(rd);
+        uint32_t aofs = vec_full_reg_offset(rn);
+        uint32_t bofs = vec_full_reg_offset(rm);
+        uint32_t oprsz = is_q ? 16 : 8;
+
+        switch (size | (is_u << 2)) {
+        case 0:
+            tcg_gen_vec_and(cpu_env, dofs, aofs, bofs, oprsz);
+            break;
+        case 1:
+            tcg_gen_vec_andc(cpu_env, dofs, aofs, bofs, oprsz);
+            break;
+        case 2:
+            tcg_gen_vec_or(cpu_env, dofs, aofs, bofs, oprsz);
+            break;
+        case 4:
+            tcg_gen_vec_xor(cpu_env, dofs, aofs, bofs, oprsz);
+            break;
+        }
+        if (!is_q) {
+            clear_vec_high(s, rd);
+        }
+        return;
+    }
+
+    tcg_op1 = tcg_temp_new_i64();
+    tcg_op2 = tcg_temp_new_i64();
     tcg_res[0] = tcg_temp_new_i64();
     tcg_res[1] = tcg_temp_new_i64();
 
@@ -8640,6 +8761,55 @@ static void disas_simd_3same_float(DisasContext *s, uint32_t insn)
 }
 
 /* Integer op subgroup of C3.6.16. */
+/* Emit the integer three-same insns that map directly onto whole-vector
+ * TCG operations; returns false if the caller must handle the insn.
+ */
+static bool handle_vec_3same_int(DisasContext *s, int opcode, bool u,
+                                 int size, bool is_q, int rd, int rn, int rm)
+{
+    uint32_t dofs = vec_full_reg_offset(rd);
+    uint32_t aofs = vec_full_reg_offset(rn);
+    uint32_t bofs = vec_full_reg_offset(rm);
+    uint32_t oprsz = is_q ? 16 : 8;
+    TCGCond cond;
+
+    switch (opcode) {
+    case 0x10: /* ADD, SUB */
+        if (u) {
+            tcg_gen_vec_sub(size, cpu_env, dofs, aofs, bofs, oprsz);
+        } else {
+            tcg_gen_vec_add(size, cpu_env, dofs, aofs, bofs, oprsz);
+        }
+        goto done;
+    case 0x11: /* CMEQ */
+        if (!u) {
+            return false;
+        }
+        cond = TCG_COND_EQ;
+        break;
+    case 0x6: /* CMGT, CMHI */
+        cond = u ? TCG_COND_GTU : TCG_COND_GT;
+        break;
+    case 0x7: /* CMGE, CMHS */
+        cond = u ? TCG_COND_GEU : TCG_COND_GE;
+        break;
+    default:
+        return false;
+    }
+
+    /* Narrow compares are only worth it when the host has vector support */
+    if (size != 3 && !TCG_TARGET_HAS_vec) {
+        return false;
+    }
+    tcg_gen_vec_cmp(cond, size, cpu_env, dofs, aofs, bofs, oprsz);
+
+done:
+    if (!is_q) {
+        clear_vec_high(s, rd);
+    }
+    return true;
+}
+
 static void disas_simd_3same_int(DisasContext *s, uint32_t insn)
 {
     int is_q = extract32(insn, 30, 1);
@@ -8685,6 +8855,10 @@ static void disas_simd_3same_int(DisasContext *s, uint32_t insn)
         break;
     }
 
+    if (handle_vec_3same_int(s, opcode, u, size, is_q, rd, rn, rm)) {
+        return;
+    }
+
     if (size == 3) {
         for (pass = 0; pass < (is_q ? 2 : 1); pass++) {
             TCGv_i64 tcg_op1 = tcg_temp_new_i64();
@@ -10323,7 +10497,7 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
         max_insns = CF_COUNT_MASK;
     }
 
-    gen_tb_start();
+    gen_tb_start(tb);
 
     tcg_clear_temp_count();
 
@@ -10403,11 +10577,12 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
         default:
         case DISAS_UPDATE:
             gen_a64_set_pc_im(dc->pc);
-            /* fall through */
-        case DISAS_JUMP:
             /* indicate that the hash table must be used to find the next TB */
             tcg_gen_exit_tb(0);
             break;
+        case DISAS_JUMP:
+            gen_lookup_and_goto_ptr(dc);
+            break;
         case DISAS_TB_JUMP:
         case DISAS_EXC:
         case DISAS_SWI:
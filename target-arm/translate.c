@@ -27,6 +27,7 @@
 #include "cpu.h"
 #include "disas/disas.h"
 #include "tcg-op.h"
+#include "tcg-op-vec.h"
 #include "qemu/log.h"
 #include "qemu/bitops.h"
 
@@ -48,7 +49,7 @@
 #define ARCH(x) do { if (!ENABLE_ARCH_##x) goto illegal_op; } while(0)
 
 #include "translate.h"
-static uint32_t gen_opc_condexec_bits[OPC_BUF_SIZE];
+static TCG_THREAD uint32_t gen_opc_condexec_bits[OPC_BUF_SIZE];
 
 #if defined(CONFIG_USER_ONLY)
 #define IS_USER(s) 1
@@ -58,19 +59,16 @@ static uint32_t gen_opc_condexec_bits[OPC_BUF_SIZE];
 
 TCGv_ptr cpu_env;
 /* We reuse the same 64-bit temporaries for efficiency.  */
-static TCGv_i64 cpu_V0, cpu_V1, cpu_M0;
+static TCG_THREAD TCGv_i64 cpu_V0, cpu_V1, cpu_M0;
 static TCGv_i32 cpu_R[16];
-static TCGv_i32 cpu_CF, cpu_NF, cpu_VF, cpu_ZF;
+TCGv_i32 cpu_CF, cpu_NF, cpu_VF, cpu_ZF;
+static TCGv_i32 cpu_CC_OP, cpu_CC_A;
 static TCGv_i64 cpu_exclusive_addr;
 static TCGv_i64 cpu_exclusive_val;
-#ifdef CONFIG_USER_ONLY
-static TCGv_i64 cpu_exclusive_test;
-static TCGv_i32 cpu_exclusive_info;
-#endif
 
 /* FIXME:  These should be removed.  */
-static TCGv_i32 cpu_F0s, cpu_F1s;
-static TCGv_i64 cpu_F0d, cpu_F1d;
+static TCG_THREAD TCGv_i32 cpu_F0s, cpu_F1s;
+static TCG_THREAD TCGv_i64 cpu_F0d, cpu_F1d;
 
 #include "exec/gen-icount.h"
 
@@ -85,28 +83,43 @@ void arm_translate_init(void)
 
     cpu_env = tcg_global_reg_new_ptr(TCG_AREG0, "env");
 
+    /* The flags are shared with the A64 translator.  They are pinned
+       first, since nearly every guest loop sets them in one TB and
+       tests them in the next; then A64 and A32 SP and LR as far as the
+       host has registers to spare.  NF, ZF and CC_A are all that an
+       A32 add or subtract writes, so they go before CF and VF.  */
+    cpu_NF = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                           offsetof(CPUARMState, NF), "NF");
+    cpu_ZF = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                           offsetof(CPUARMState, ZF), "ZF");
+    cpu_CC_A = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                             offsetof(CPUARMState, cc_a),
+                                             "cc_a");
+    cpu_CF = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                           offsetof(CPUARMState, CF), "CF");
+    cpu_VF = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                           offsetof(CPUARMState, VF), "VF");
+    cpu_CC_OP = tcg_global_mem_new_i32(TCG_AREG0,
+                                       offsetof(CPUARMState, cc_op), "cc_op");
+
+    a64_translate_init();
+
     for (i = 0; i < 16; i++) {
-        cpu_R[i] = tcg_global_mem_new_i32(TCG_AREG0,
-                                          offsetof(CPUARMState, regs[i]),
-                                          regnames[i]);
+        if (i == 13 || i == 14) {
+            cpu_R[i] = tcg_global_mem_new_pinned_i32(TCG_AREG0,
+                                            offsetof(CPUARMState, regs[i]),
+                                            regnames[i]);
+        } else {
+            cpu_R[i] = tcg_global_mem_new_i32(TCG_AREG0,
+                                              offsetof(CPUARMState, regs[i]),
+                                              regnames[i]);
+        }
     }
-    cpu_CF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, CF), "CF");
-    cpu_NF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, NF), "NF");
-    cpu_VF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, VF), "VF");
-    cpu_ZF = tcg_global_mem_new_i32(TCG_AREG0, offsetof(CPUARMState, ZF), "ZF");
 
     cpu_exclusive_addr = tcg_global_mem_new_i64(TCG_AREG0,
         offsetof(CPUARMState, exclusive_addr), "exclusive_addr");
     cpu_exclusive_val = tcg_global_mem_new_i64(TCG_AREG0,
         offsetof(CPUARMState, exclusive_val), "exclusive_val");
-#ifdef CONFIG_USER_ONLY
-    cpu_exclusive_test = tcg_global_mem_new_i64(TCG_AREG0,
-        offsetof(CPUARMState, exclusive_test), "exclusive_test");
-    cpu_exclusive_info = tcg_global_mem_new_i32(TCG_AREG0,
-        offsetof(CPUARMState, exclusive_info), "exclusive_info");
-#endif
-
-    a64_translate_init();
 }
 
 static inline TCGv_i32 load_cpu_offset(int offset)
@@ -173,14 +186,18 @@ static void store_reg(DisasContext *s, int reg, TCGv_i32 var)
 #define gen_uxtb16(var) gen_helper_uxtb16(var, var)
 
 
-static inline void gen_set_cpsr(TCGv_i32 var, uint32_t mask)
+static inline void gen_set_cpsr(DisasContext *s, TCGv_i32 var, uint32_t mask)
 {
     TCGv_i32 tmp_mask = tcg_const_i32(mask);
     gen_helper_cpsr_write(cpu_env, var, tmp_mask);
     tcg_temp_free_i32(tmp_mask);
+    if (mask & CPSR_NZCV) {
+        /* cpsr_write also resets cc_op.  */
+        s->cc_op = CC_OP_FLAGS;
+    }
 }
 /* Set NZCV flags from the high 4 bits of var.  */
-#define gen_set_nzcv(var) gen_set_cpsr(var, CPSR_NZCV)
+#define gen_set_nzcv(s, var) gen_set_cpsr(s, var, CPSR_NZCV)
 
 static void gen_exception(int excp)
 {
@@ -343,59 +360,140 @@ static void gen_add16(TCGv_i32 t0, TCGv_i32 t1)
     tcg_temp_free_i32(t1);
 }
 
+/* The A32/T32 decoder leaves C and V uncomputed after ADDS/SUBS and
+   friends: NF and ZF hold the result, CC_A the first operand and CC_OP
+   says which operation it was (see CPUARMState.cc_op).  Most such flag
+   settings are only consumed by an EQ/NE/MI/PL test or not at all, and a
+   following CMP overwrites them anyway.  */
+static void gen_set_cc_op(DisasContext *s, int op)
+{
+    if (s->cc_op != op) {
+        tcg_gen_movi_i32(cpu_CC_OP, op);
+        s->cc_op = op;
+    }
+}
+
+/* Compute into CF and VF the C and V flags left by a CC_OP_ADD or
+   CC_OP_SUB operation.  */
+static void gen_cc_compute_cv(int op, TCGv_i32 cf, TCGv_i32 vf)
+{
+    TCGv_i32 b = tcg_temp_new_i32();
+
+    if (op == CC_OP_ADD) {
+        tcg_gen_sub_i32(b, cpu_NF, cpu_CC_A);
+        tcg_gen_setcond_i32(TCG_COND_LTU, cf, cpu_NF, cpu_CC_A);
+        tcg_gen_xor_i32(vf, cpu_NF, cpu_CC_A);
+        tcg_gen_xor_i32(b, cpu_CC_A, b);
+        tcg_gen_andc_i32(vf, vf, b);
+    } else {
+        tcg_gen_sub_i32(b, cpu_CC_A, cpu_NF);
+        tcg_gen_setcond_i32(TCG_COND_GEU, cf, cpu_CC_A, b);
+        tcg_gen_xor_i32(vf, cpu_NF, cpu_CC_A);
+        tcg_gen_xor_i32(b, cpu_CC_A, b);
+        tcg_gen_and_i32(vf, vf, b);
+    }
+    tcg_temp_free_i32(b);
+}
+
+/* Make CF and VF valid.  Must be called before anything that reads them
+   or sets some but not all of the NZCV flags.  */
+static void gen_flags_cv(DisasContext *s)
+{
+    TCGv_i32 add_cf, add_vf, sub_cf, sub_vf, op;
+
+    switch (s->cc_op) {
+    case CC_OP_FLAGS:
+        return;
+    case CC_OP_ADD:
+    case CC_OP_SUB:
+        gen_cc_compute_cv(s->cc_op, cpu_CF, cpu_VF);
+        break;
+    default:
+        add_cf = tcg_temp_new_i32();
+        add_vf = tcg_temp_new_i32();
+        sub_cf = tcg_temp_new_i32();
+        sub_vf = tcg_temp_new_i32();
+        gen_cc_compute_cv(CC_OP_ADD, add_cf, add_vf);
+        gen_cc_compute_cv(CC_OP_SUB, sub_cf, sub_vf);
+        op = tcg_const_i32(CC_OP_ADD);
+        tcg_gen_movcond_i32(TCG_COND_EQ, sub_cf, cpu_CC_OP, op,
+                            add_cf, sub_cf);
+        tcg_gen_movcond_i32(TCG_COND_EQ, sub_vf, cpu_CC_OP, op,
+                            add_vf, sub_vf);
+        tcg_gen_movi_i32(op, CC_OP_FLAGS);
+        tcg_gen_movcond_i32(TCG_COND_NE, cpu_CF, cpu_CC_OP, op,
+                            sub_cf, cpu_CF);
+        tcg_gen_movcond_i32(TCG_COND_NE, cpu_VF, cpu_CC_OP, op,
+                            sub_vf, cpu_VF);
+        tcg_temp_free_i32(op);
+        tcg_temp_free_i32(add_cf);
+        tcg_temp_free_i32(add_vf);
+        tcg_temp_free_i32(sub_cf);
+        tcg_temp_free_i32(sub_vf);
+        break;
+    }
+    gen_set_cc_op(s, CC_OP_FLAGS);
+}
+
 /* Set CF to the top bit of var.  */
-static void gen_set_CF_bit31(TCGv_i32 var)
+static void gen_set_CF_bit31(DisasContext *s, TCGv_i32 var)
 {
+    gen_flags_cv(s);
     tcg_gen_shri_i32(cpu_CF, var, 31);
 }
 
 /* Set N and Z flags from var.  */
-static inline void gen_logic_CC(TCGv_i32 var)
+static inline void gen_logic_CC(DisasContext *s, TCGv_i32 var)
 {
+    gen_flags_cv(s);
     tcg_gen_mov_i32(cpu_NF, var);
     tcg_gen_mov_i32(cpu_ZF, var);
 }
 
 /* T0 += T1 + CF.  */
-static void gen_adc(TCGv_i32 t0, TCGv_i32 t1)
+static void gen_adc(DisasContext *s, TCGv_i32 t0, TCGv_i32 t1)
 {
+    gen_flags_cv(s);
     tcg_gen_add_i32(t0, t0, t1);
     tcg_gen_add_i32(t0, t0, cpu_CF);
 }
 
 /* dest = T0 + T1 + CF. */
-static void gen_add_carry(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+static void gen_add_carry(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                          TCGv_i32 t1)
 {
+    gen_flags_cv(s);
     tcg_gen_add_i32(dest, t0, t1);
     tcg_gen_add_i32(dest, dest, cpu_CF);
 }
 
 /* dest = T0 - T1 + CF - 1.  */
-static void gen_sub_carry(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+static void gen_sub_carry(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                          TCGv_i32 t1)
 {
+    gen_flags_cv(s);
     tcg_gen_sub_i32(dest, t0, t1);
     tcg_gen_add_i32(dest, dest, cpu_CF);
     tcg_gen_subi_i32(dest, dest, 1);
 }
 
-/* dest = T0 + T1. Compute C, N, V and Z flags */
-static void gen_add_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+/* dest = T0 + T1. Compute N and Z flags, C and V lazily */
+static void gen_add_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                       TCGv_i32 t1)
 {
-    TCGv_i32 tmp = tcg_temp_new_i32();
-    tcg_gen_movi_i32(tmp, 0);
-    tcg_gen_add2_i32(cpu_NF, cpu_CF, t0, tmp, t1, tmp);
+    tcg_gen_mov_i32(cpu_CC_A, t0);
+    tcg_gen_add_i32(cpu_NF, t0, t1);
     tcg_gen_mov_i32(cpu_ZF, cpu_NF);
-    tcg_gen_xor_i32(cpu_VF, cpu_NF, t0);
-    tcg_gen_xor_i32(tmp, t0, t1);
-    tcg_gen_andc_i32(cpu_VF, cpu_VF, tmp);
-    tcg_temp_free_i32(tmp);
+    gen_set_cc_op(s, CC_OP_ADD);
     tcg_gen_mov_i32(dest, cpu_NF);
 }
 
 /* dest = T0 + T1 + CF.  Compute C, N, V and Z flags */
-static void gen_adc_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+static void gen_adc_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                       TCGv_i32 t1)
 {
     TCGv_i32 tmp = tcg_temp_new_i32();
+    gen_flags_cv(s);
     if (TCG_TARGET_HAS_add2_i32) {
         tcg_gen_movi_i32(tmp, 0);
         tcg_gen_add2_i32(cpu_NF, cpu_CF, t0, tmp, cpu_CF, tmp);
@@ -420,27 +518,24 @@ static void gen_adc_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
     tcg_gen_mov_i32(dest, cpu_NF);
 }
 
-/* dest = T0 - T1. Compute C, N, V and Z flags */
-static void gen_sub_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+/* dest = T0 - T1. Compute N and Z flags, C and V lazily */
+static void gen_sub_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                       TCGv_i32 t1)
 {
-    TCGv_i32 tmp;
+    tcg_gen_mov_i32(cpu_CC_A, t0);
     tcg_gen_sub_i32(cpu_NF, t0, t1);
     tcg_gen_mov_i32(cpu_ZF, cpu_NF);
-    tcg_gen_setcond_i32(TCG_COND_GEU, cpu_CF, t0, t1);
-    tcg_gen_xor_i32(cpu_VF, cpu_NF, t0);
-    tmp = tcg_temp_new_i32();
-    tcg_gen_xor_i32(tmp, t0, t1);
-    tcg_gen_and_i32(cpu_VF, cpu_VF, tmp);
-    tcg_temp_free_i32(tmp);
+    gen_set_cc_op(s, CC_OP_SUB);
     tcg_gen_mov_i32(dest, cpu_NF);
 }
 
 /* dest = T0 + ~T1 + CF.  Compute C, N, V and Z flags */
-static void gen_sbc_CC(TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
+static void gen_sbc_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0,
+                       TCGv_i32 t1)
 {
     TCGv_i32 tmp = tcg_temp_new_i32();
     tcg_gen_not_i32(tmp, t1);
-    gen_adc_CC(dest, t0, tmp);
+    gen_adc_CC(s, dest, t0, tmp);
     tcg_temp_free_i32(tmp);
 }
 
@@ -485,8 +580,9 @@ static void tcg_gen_abs_i32(TCGv_i32 dest, TCGv_i32 src)
     tcg_temp_free_i32(tmp);
 }
 
-static void shifter_out_im(TCGv_i32 var, int shift)
+static void shifter_out_im(DisasContext *s, TCGv_i32 var, int shift)
 {
+    gen_flags_cv(s);
     if (shift == 0) {
         tcg_gen_andi_i32(cpu_CF, var, 1);
     } else {
@@ -498,26 +594,26 @@ static void shifter_out_im(TCGv_i32 var, int shift)
 }
 
 /* Shift by immediate.  Includes special handling for shift == 0.  */
-static inline void gen_arm_shift_im(TCGv_i32 var, int shiftop,
-                                    int shift, int flags)
+static inline void gen_arm_shift_im(DisasContext *s, TCGv_i32 var,
+                                    int shiftop, int shift, int flags)
 {
     switch (shiftop) {
     case 0: /* LSL */
         if (shift != 0) {
             if (flags)
-                shifter_out_im(var, 32 - shift);
+                shifter_out_im(s, var, 32 - shift);
             tcg_gen_shli_i32(var, var, shift);
         }
         break;
     case 1: /* LSR */
         if (shift == 0) {
             if (flags) {
-                tcg_gen_shri_i32(cpu_CF, var, 31);
+                gen_set_CF_bit31(s, var);
             }
             tcg_gen_movi_i32(var, 0);
         } else {
             if (flags)
-                shifter_out_im(var, shift - 1);
+                shifter_out_im(s, var, shift - 1);
             tcg_gen_shri_i32(var, var, shift);
         }
         break;
@@ -525,7 +621,7 @@ static inline void gen_arm_shift_im(TCGv_i32 var, int shiftop,
         if (shift == 0)
             shift = 32;
         if (flags)
-            shifter_out_im(var, shift - 1);
+            shifter_out_im(s, var, shift - 1);
         if (shift == 32)
           shift = 31;
         tcg_gen_sari_i32(var, var, shift);
@@ -533,13 +629,14 @@ static inline void gen_arm_shift_im(TCGv_i32 var, int shiftop,
     case 3: /* ROR/RRX */
         if (shift != 0) {
             if (flags)
-                shifter_out_im(var, shift - 1);
+                shifter_out_im(s, var, shift - 1);
             tcg_gen_rotri_i32(var, var, shift); break;
         } else {
             TCGv_i32 tmp = tcg_temp_new_i32();
+            gen_flags_cv(s);
             tcg_gen_shli_i32(tmp, cpu_CF, 31);
             if (flags)
-                shifter_out_im(var, 0);
+                shifter_out_im(s, var, 0);
             tcg_gen_shri_i32(var, var, 1);
             tcg_gen_or_i32(var, var, tmp);
             tcg_temp_free_i32(tmp);
@@ -547,10 +644,11 @@ static inline void gen_arm_shift_im(TCGv_i32 var, int shiftop,
     }
 };
 
-static inline void gen_arm_shift_reg(TCGv_i32 var, int shiftop,
-                                     TCGv_i32 shift, int flags)
+static inline void gen_arm_shift_reg(DisasContext *s, TCGv_i32 var,
+                                     int shiftop, TCGv_i32 shift, int flags)
 {
     if (flags) {
+        gen_flags_cv(s);
         switch (shiftop) {
         case 0: gen_helper_shl_cc(var, cpu_env, var, shift); break;
         case 1: gen_helper_shr_cc(var, cpu_env, var, shift); break;
@@ -746,6 +844,41 @@ void arm_gen_test_cc(int cc, int label)
     }
 }
 
+/* arm_gen_test_cc for the A32/T32 decoder.  While the flags come from a
+   subtraction, conditions involving C or V compare its operands directly
+   rather than computing those flags first.  */
+static void gen_test_cc(DisasContext *s, int cc, int label)
+{
+    static const TCGCond sub_cond[16] = {
+        [2] = TCG_COND_GEU,      /* cs */
+        [3] = TCG_COND_LTU,      /* cc */
+        [8] = TCG_COND_GTU,      /* hi */
+        [9] = TCG_COND_LEU,      /* ls */
+        [10] = TCG_COND_GE,      /* ge */
+        [11] = TCG_COND_LT,      /* lt */
+        [12] = TCG_COND_GT,      /* gt */
+        [13] = TCG_COND_LE,      /* le */
+    };
+    TCGv_i32 b;
+
+    switch (cc) {
+    case 0: case 1: case 4: case 5:
+        /* Z and N are always up to date.  */
+        break;
+    default:
+        if (s->cc_op == CC_OP_SUB && sub_cond[cc] != TCG_COND_NEVER) {
+            b = tcg_temp_new_i32();
+            tcg_gen_sub_i32(b, cpu_CC_A, cpu_NF);
+            tcg_gen_brcond_i32(sub_cond[cc], cpu_CC_A, b, label);
+            tcg_temp_free_i32(b);
+            return;
+        }
+        gen_flags_cv(s);
+        break;
+    }
+    arm_gen_test_cc(cc, label);
+}
+
 static const uint8_t table_logic_cc[16] = {
     1, /* and */
     1, /* xor */
@@ -770,7 +903,7 @@ static inline void gen_bx_im(DisasContext *s, uint32_t addr)
 {
     TCGv_i32 tmp;
 
-    s->is_jmp = DISAS_UPDATE;
+    s->is_jmp = DISAS_JUMP;
     if (s->thumb != (addr & 1)) {
         tmp = tcg_temp_new_i32();
         tcg_gen_movi_i32(tmp, addr & 1);
@@ -783,7 +916,7 @@ static inline void gen_bx_im(DisasContext *s, uint32_t addr)
 /* Set PC and Thumb state from var.  var is marked as dead.  */
 static inline void gen_bx(DisasContext *s, TCGv_i32 var)
 {
-    s->is_jmp = DISAS_UPDATE;
+    s->is_jmp = DISAS_JUMP;
     tcg_gen_andi_i32(cpu_R[15], var, ~1);
     tcg_gen_andi_i32(var, var, 1);
     store_cpu_field(var, thumb);
@@ -931,7 +1064,7 @@ static inline void gen_add_data_offset(DisasContext *s, unsigned int insn,
         shift = (insn >> 7) & 0x1f;
         shiftop = (insn >> 5) & 3;
         offset = load_reg(s, rm);
-        gen_arm_shift_im(offset, shiftop, shift, 0);
+        gen_arm_shift_im(s, offset, shiftop, shift, 0);
         if (!(insn & (1 << 23)))
             tcg_gen_sub_i32(var, var, offset);
         else
@@ -1865,7 +1998,7 @@ static int disas_iwmmxt_insn(CPUARMState *env, DisasContext *s, uint32_t insn)
             break;
         }
         tcg_gen_shli_i32(tmp, tmp, 28);
-        gen_set_nzcv(tmp);
+        gen_set_nzcv(s, tmp);
         tcg_temp_free_i32(tmp);
         break;
     case 0x401: case 0x405: case 0x409: case 0x40d:	/* TBCST */
@@ -1913,7 +2046,7 @@ static int disas_iwmmxt_insn(CPUARMState *env, DisasContext *s, uint32_t insn)
             tcg_gen_and_i32(tmp, tmp, tmp2);
             break;
         }
-        gen_set_nzcv(tmp);
+        gen_set_nzcv(s, tmp);
         tcg_temp_free_i32(tmp2);
         tcg_temp_free_i32(tmp);
         break;
@@ -1961,7 +2094,7 @@ static int disas_iwmmxt_insn(CPUARMState *env, DisasContext *s, uint32_t insn)
             tcg_gen_or_i32(tmp, tmp, tmp2);
             break;
         }
-        gen_set_nzcv(tmp);
+        gen_set_nzcv(s, tmp);
         tcg_temp_free_i32(tmp2);
         tcg_temp_free_i32(tmp);
         break;
@@ -2891,6 +3024,7 @@ static int disas_vfp_v8_insn(CPUARMState *env, DisasContext *s, uint32_t insn)
     }
 
     if ((insn & 0x0f800e50) == 0x0e000a00) {
+        gen_flags_cv(s);
         return handle_vsel(insn, rd, rn, rm, dp);
     } else if ((insn & 0x0fb00e10) == 0x0e800a00) {
         return handle_vminmaxnm(insn, rd, rn, rm, dp);
@@ -3088,7 +3222,7 @@ static int disas_vfp_insn(CPUARMState * env, DisasContext *s, uint32_t insn)
                     }
                     if (rd == 15) {
                         /* Set the 4 flag bits in the CPSR.  */
-                        gen_set_nzcv(tmp);
+                        gen_set_nzcv(s, tmp);
                         tcg_temp_free_i32(tmp);
                     } else {
                         store_reg(s, rd, tmp);
@@ -3793,6 +3927,64 @@ static int disas_vfp_insn(CPUARMState * env, DisasContext *s, uint32_t insn)
     return 0;
 }
 
+/* End the TB after an indirect branch.  The PC and the rest of the state
+ * that selects the next TB must already be written back.  If that TB has
+ * been translated, jump straight to it; otherwise return to the main loop.
+ */
+void gen_lookup_and_goto_ptr(DisasContext *s)
+{
+    TCGv_ptr ptr;
+
+    if (!TCG_TARGET_HAS_goto_ptr || s->singlestep_enabled ||
+        (s->tb->cflags & CF_LAST_IO)) {
+        tcg_gen_exit_tb(0);
+        return;
+    }
+
+    ptr = tcg_temp_new_ptr();
+    gen_helper_lookup_tb_ptr(ptr, cpu_env);
+    tcg_gen_goto_ptr(ptr);
+    tcg_temp_free_ptr(ptr);
+}
+
+/* Emit a direct jump through slot @n to @dest, which is on another guest
+ * page than the start of the TB; the PC must already be set to @dest.
+ * For system emulation the linked jump is only taken while this CPU's TLB
+ * maps the destination page to the host page it was linked against (see
+ * tb_add_cross_page_jump); otherwise we fall through to the exit, as if
+ * the jump was not linked, and the main loop links it again.
+ */
+void gen_goto_tb_cross_page(DisasContext *s, int n, target_ulong dest)
+{
+#ifndef CONFIG_USER_ONLY
+    int index = (dest >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    int mmu_idx = s->user;
+    int label = gen_new_label();
+    TCGv addr = tcg_temp_new();
+    TCGv_ptr addend, linked;
+
+    tcg_gen_ld_tl(addr, cpu_env,
+                  offsetof(CPUARMState, tlb_table[mmu_idx][index].addr_code));
+    tcg_gen_brcondi_tl(TCG_COND_NE, addr, dest & TARGET_PAGE_MASK, label);
+    tcg_temp_free(addr);
+
+    addend = tcg_temp_new_ptr();
+    linked = tcg_const_ptr(&s->tb->jmp_addend[n]);
+    tcg_gen_ld_ptr(addend, cpu_env,
+                   offsetof(CPUARMState, tlb_table[mmu_idx][index].addend));
+    tcg_gen_ld_ptr(linked, linked, 0);
+    tcg_gen_brcond_ptr(TCG_COND_NE, addend, linked, label);
+    tcg_temp_free_ptr(addend);
+    tcg_temp_free_ptr(linked);
+#endif
+
+    tcg_gen_goto_tb(n);
+#ifndef CONFIG_USER_ONLY
+    gen_set_label(label);
+#endif
+    tcg_gen_exit_tb((uintptr_t)s->tb + n);
+}
+
 static inline void gen_goto_tb(DisasContext *s, int n, target_ulong dest)
 {
     TranslationBlock *tb;
@@ -3804,7 +3996,7 @@ static inline void gen_goto_tb(DisasContext *s, int n, target_ulong dest)
         tcg_gen_exit_tb((uintptr_t)tb + n);
     } else {
         gen_set_pc_im(s, dest);
-        tcg_gen_exit_tb(0);
+        gen_goto_tb_cross_page(s, n, dest);
     }
 }
 
@@ -3882,7 +4074,7 @@ static int gen_set_psr(DisasContext *s, uint32_t mask, int spsr, TCGv_i32 t0)
         tcg_gen_or_i32(tmp, tmp, t0);
         store_cpu_field(tmp, spsr);
     } else {
-        gen_set_cpsr(t0, mask);
+        gen_set_cpsr(s, t0, mask);
     }
     tcg_temp_free_i32(t0);
     gen_lookup_tb(s);
@@ -3904,7 +4096,7 @@ static void gen_exception_return(DisasContext *s, TCGv_i32 pc)
     TCGv_i32 tmp;
     store_reg(s, 15, pc);
     tmp = load_cpu_field(spsr);
-    gen_set_cpsr(tmp, 0xffffffff);
+    gen_set_cpsr(s, tmp, 0xffffffff);
     tcg_temp_free_i32(tmp);
     s->is_jmp = DISAS_UPDATE;
 }
@@ -3912,7 +4104,7 @@ static void gen_exception_return(DisasContext *s, TCGv_i32 pc)
 /* Generate a v6 exception return.  Marks both values as dead.  */
 static void gen_rfe(DisasContext *s, TCGv_i32 pc, TCGv_i32 cpsr)
 {
-    gen_set_cpsr(cpsr, 0xffffffff);
+    gen_set_cpsr(s, cpsr, 0xffffffff);
     tcg_temp_free_i32(cpsr);
     store_reg(s, 15, pc);
     s->is_jmp = DISAS_UPDATE;
@@ -4925,6 +5117,68 @@ static const uint8_t neon_2rm_sizes[] = {
    We process data in a mixture of 32-bit and 64-bit chunks.
    Mostly we use 32-bit chunks so we can use normal scalar instructions.  */
 
+/* Emit the integer "three registers of the same length" insns that map
+ * directly onto whole-vector TCG operations.  Returns false for anything
+ * that must go through the element-by-element code instead.
+ */
+static bool gen_neon_3same_vec(int op, int u, int size, int q,
+                               int rd, int rn, int rm)
+{
+    uint32_t dofs = vfp_reg_offset(1, rd);
+    uint32_t aofs = vfp_reg_offset(1, rn);
+    uint32_t bofs = vfp_reg_offset(1, rm);
+    uint32_t oprsz = q ? 16 : 8;
+    TCGCond cond;
+
+    switch (op) {
+    case NEON_3R_VADD_VSUB:
+        if (u) {
+            tcg_gen_vec_sub(size, cpu_env, dofs, aofs, bofs, oprsz);
+        } else {
+            tcg_gen_vec_add(size, cpu_env, dofs, aofs, bofs, oprsz);
+        }
+        return true;
+    case NEON_3R_LOGIC:
+        switch (size | (u << 2)) {
+        case 0: /* VAND */
+            tcg_gen_vec_and(cpu_env, dofs, aofs, bofs, oprsz);
+            return true;
+        case 1: /* VBIC */
+            tcg_gen_vec_andc(cpu_env, dofs, aofs, bofs, oprsz);
+            return true;
+        case 2: /* VORR, VMOV */
+            tcg_gen_vec_or(cpu_env, dofs, aofs, bofs, oprsz);
+            return true;
+        case 4: /* VEOR */
+            tcg_gen_vec_xor(cpu_env, dofs, aofs, bofs, oprsz);
+            return true;
+        default:
+            return false;
+        }
+    /* Compares are only worth it when the host has vector support */
+    case NEON_3R_VTST_VCEQ:
+        if (!u) {
+            return false;
+        }
+        cond = TCG_COND_EQ;
+        break;
+    case NEON_3R_VCGT:
+        cond = u ? TCG_COND_GTU : TCG_COND_GT;
+        break;
+    case NEON_3R_VCGE:
+        cond = u ? TCG_COND_GEU : TCG_COND_GE;
+        break;
+    default:
+        return false;
+    }
+
+    if (!TCG_TARGET_HAS_vec) {
+        return false;
+    }
+    tcg_gen_vec_cmp(cond, size, cpu_env, dofs, aofs, bofs, oprsz);
+    return true;
+}
+
 static int disas_neon_data_insn(CPUARMState * env, DisasContext *s, uint32_t insn)
 {
     int op;
@@ -4961,6 +5215,9 @@ static int disas_neon_data_insn(CPUARMState * env, DisasContext *s, uint32_t ins
         if (q && ((rd | rn | rm) & 1)) {
             return 1;
         }
+        if (gen_neon_3same_vec(op, u, size, q, rd, rn, rm)) {
+            return 0;
+        }
         if (size == 3 && op != NEON_3R_LOGIC) {
             /* 64-bit element instructions. */
             for (pass = 0; pass < (q ? 2 : 1); pass++) {
@@ -5470,6 +5727,33 @@ static int disas_neon_data_insn(CPUARMState * env, DisasContext *s, uint32_t ins
                     abort();
                 }
 
+                if (op == 0 || (op == 5 && !u)) {
+                    /* VSHR, VSHL: whole-vector shifts */
+                    uint32_t dofs = vfp_reg_offset(1, rd);
+                    uint32_t aofs = vfp_reg_offset(1, rm);
+                    uint32_t oprsz = q ? 16 : 8;
+
+                    if (op == 5) {
+                        tcg_gen_vec_shli(size, cpu_env, dofs, aofs,
+                                         shift, oprsz);
+                    } else if (-shift < (8 << size)) {
+                        if (u) {
+                            tcg_gen_vec_shri(size, cpu_env, dofs, aofs,
+                                             -shift, oprsz);
+                        } else {
+                            tcg_gen_vec_sari(size, cpu_env, dofs, aofs,
+                                             -shift, oprsz);
+                        }
+                    } else if (u) {
+                        /* Shift by the element size: all zeroes */
+                        tcg_gen_vec_xor(cpu_env, dofs, aofs, aofs, oprsz);
+                    } else {
+                        tcg_gen_vec_sari(size, cpu_env, dofs, aofs,
+                                         (8 << size) - 1, oprsz);
+                    }
+                    return 0;
+                }
+
                 for (pass = 0; pass < count; pass++) {
                     if (size == 3) {
                         neon_load_reg64(cpu_V0, rm + pass);
@@ -6934,7 +7218,7 @@ static int disas_coproc_insn(CPUARMState * env, DisasContext *s, uint32_t insn)
                     /* Destination register of r15 for 32 bit loads sets
                      * the condition codes from the high 4 bits of the value
                      */
-                    gen_set_nzcv(tmp);
+                    gen_set_nzcv(s, tmp);
                     tcg_temp_free_i32(tmp);
                 } else {
                     store_reg(s, rt, tmp);
@@ -7058,8 +7342,9 @@ static void gen_addq(DisasContext *s, TCGv_i64 val, int rlow, int rhigh)
 }
 
 /* Set N and Z flags from hi|lo.  */
-static void gen_logicq_cc(TCGv_i32 lo, TCGv_i32 hi)
+static void gen_logicq_cc(DisasContext *s, TCGv_i32 lo, TCGv_i32 hi)
 {
+    gen_flags_cv(s);
     tcg_gen_mov_i32(cpu_NF, hi);
     tcg_gen_or_i32(cpu_ZF, lo, hi);
 }
@@ -7071,8 +7356,9 @@ static void gen_logicq_cc(TCGv_i32 lo, TCGv_i32 hi)
    regular stores.
 
    In system emulation mode only one CPU will be running at once, so
-   this sequence is effectively atomic.  In user emulation mode we
-   throw an exception and handle the atomic operation elsewhere.  */
+   this sequence is effectively atomic.  In user emulation mode other
+   guest threads run concurrently, so the store is a host
+   compare-and-swap against the value the load saw.  */
 static void gen_load_exclusive(DisasContext *s, int rt, int rt2,
                                TCGv_i32 addr, int size)
 {
@@ -7119,10 +7405,54 @@ static void gen_clrex(DisasContext *s)
 static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
                                 TCGv_i32 addr, int size)
 {
-    tcg_gen_extu_i32_i64(cpu_exclusive_test, addr);
-    tcg_gen_movi_i32(cpu_exclusive_info,
-                     size | (rd << 4) | (rt << 8) | (rt2 << 12));
-    gen_exception_insn(s, 4, EXCP_STREX);
+    TCGv_i32 tmp, tmp2;
+    TCGv_i64 extaddr, val64, old;
+    int done_label;
+    int fail_label;
+
+    /* if (env->exclusive_addr == addr
+           && cmpxchg([addr], env->exclusive_val, {Rt}) succeeds) {
+         {Rd} = 0;
+       } else {
+         {Rd} = 1;
+       } */
+    fail_label = gen_new_label();
+    done_label = gen_new_label();
+    extaddr = tcg_temp_local_new_i64();
+    tcg_gen_extu_i32_i64(extaddr, addr);
+    tcg_gen_brcond_i64(TCG_COND_NE, extaddr, cpu_exclusive_addr, fail_label);
+
+    val64 = tcg_temp_new_i64();
+    tmp = load_reg(s, rt);
+    if (size == 3) {
+        tmp2 = load_reg(s, rt2);
+        tcg_gen_concat_i32_i64(val64, tmp, tmp2);
+        tcg_temp_free_i32(tmp2);
+        size = ARM_CMPXCHG_32X2;
+    } else {
+        tcg_gen_extu_i32_i64(val64, tmp);
+    }
+    tcg_temp_free_i32(tmp);
+
+    /* A bad address raises a data abort from the helper.  */
+    gen_set_condexec(s);
+    gen_set_pc_im(s, s->pc - 4);
+    old = tcg_temp_new_i64();
+    tmp = tcg_const_i32(size);
+    gen_helper_strex_cmpxchg(old, cpu_env, extaddr, cpu_exclusive_val,
+                             val64, tmp);
+    tcg_temp_free_i32(tmp);
+    tcg_temp_free_i64(val64);
+    tcg_temp_free_i64(extaddr);
+
+    tcg_gen_setcond_i64(TCG_COND_NE, old, old, cpu_exclusive_val);
+    tcg_gen_trunc_i64_i32(cpu_R[rd], old);
+    tcg_temp_free_i64(old);
+    tcg_gen_br(done_label);
+    gen_set_label(fail_label);
+    tcg_gen_movi_i32(cpu_R[rd], 1);
+    gen_set_label(done_label);
+    tcg_gen_movi_i64(cpu_exclusive_addr, -1);
 }
 #else
 static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
@@ -7490,8 +7820,9 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
         /* if not always execute, we generate a conditional jump to
            next instruction */
         s->condlabel = gen_new_label();
-        arm_gen_test_cc(cond ^ 1, s->condlabel);
+        gen_test_cc(s, cond ^ 1, s->condlabel);
         s->condjmp = 1;
+        s->condjmp_cc_op = s->cc_op;
     }
     if ((insn & 0x0f900000) == 0x03000000) {
         if ((insn & (1 << 21)) == 0) {
@@ -7725,7 +8056,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
             tmp2 = tcg_temp_new_i32();
             tcg_gen_movi_i32(tmp2, val);
             if (logic_cc && shift) {
-                gen_set_CF_bit31(tmp2);
+                gen_set_CF_bit31(s, tmp2);
             }
         } else {
             /* register */
@@ -7734,11 +8065,11 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
             shiftop = (insn >> 5) & 3;
             if (!(insn & (1 << 4))) {
                 shift = (insn >> 7) & 0x1f;
-                gen_arm_shift_im(tmp2, shiftop, shift, logic_cc);
+                gen_arm_shift_im(s, tmp2, shiftop, shift, logic_cc);
             } else {
                 rs = (insn >> 8) & 0xf;
                 tmp = load_reg(s, rs);
-                gen_arm_shift_reg(tmp2, shiftop, tmp, logic_cc);
+                gen_arm_shift_reg(s, tmp2, shiftop, tmp, logic_cc);
             }
         }
         if (op1 != 0x0f && op1 != 0x0d) {
@@ -7752,14 +8083,14 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
         case 0x00:
             tcg_gen_and_i32(tmp, tmp, tmp2);
             if (logic_cc) {
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
         case 0x01:
             tcg_gen_xor_i32(tmp, tmp, tmp2);
             if (logic_cc) {
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
@@ -7769,11 +8100,11 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
                 if (IS_USER(s)) {
                     goto illegal_op;
                 }
-                gen_sub_CC(tmp, tmp, tmp2);
+                gen_sub_CC(s, tmp, tmp, tmp2);
                 gen_exception_return(s, tmp);
             } else {
                 if (set_cc) {
-                    gen_sub_CC(tmp, tmp, tmp2);
+                    gen_sub_CC(s, tmp, tmp, tmp2);
                 } else {
                     tcg_gen_sub_i32(tmp, tmp, tmp2);
                 }
@@ -7782,7 +8113,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
             break;
         case 0x03:
             if (set_cc) {
-                gen_sub_CC(tmp, tmp2, tmp);
+                gen_sub_CC(s, tmp, tmp2, tmp);
             } else {
                 tcg_gen_sub_i32(tmp, tmp2, tmp);
             }
@@ -7790,7 +8121,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
             break;
         case 0x04:
             if (set_cc) {
-                gen_add_CC(tmp, tmp, tmp2);
+                gen_add_CC(s, tmp, tmp, tmp2);
             } else {
                 tcg_gen_add_i32(tmp, tmp, tmp2);
             }
@@ -7798,58 +8129,58 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
             break;
         case 0x05:
             if (set_cc) {
-                gen_adc_CC(tmp, tmp, tmp2);
+                gen_adc_CC(s, tmp, tmp, tmp2);
             } else {
-                gen_add_carry(tmp, tmp, tmp2);
+                gen_add_carry(s, tmp, tmp, tmp2);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
         case 0x06:
             if (set_cc) {
-                gen_sbc_CC(tmp, tmp, tmp2);
+                gen_sbc_CC(s, tmp, tmp, tmp2);
             } else {
-                gen_sub_carry(tmp, tmp, tmp2);
+                gen_sub_carry(s, tmp, tmp, tmp2);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
         case 0x07:
             if (set_cc) {
-                gen_sbc_CC(tmp, tmp2, tmp);
+                gen_sbc_CC(s, tmp, tmp2, tmp);
             } else {
-                gen_sub_carry(tmp, tmp2, tmp);
+                gen_sub_carry(s, tmp, tmp2, tmp);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
         case 0x08:
             if (set_cc) {
                 tcg_gen_and_i32(tmp, tmp, tmp2);
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             tcg_temp_free_i32(tmp);
             break;
         case 0x09:
             if (set_cc) {
                 tcg_gen_xor_i32(tmp, tmp, tmp2);
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             tcg_temp_free_i32(tmp);
             break;
         case 0x0a:
             if (set_cc) {
-                gen_sub_CC(tmp, tmp, tmp2);
+                gen_sub_CC(s, tmp, tmp, tmp2);
             }
             tcg_temp_free_i32(tmp);
             break;
         case 0x0b:
             if (set_cc) {
-                gen_add_CC(tmp, tmp, tmp2);
+                gen_add_CC(s, tmp, tmp, tmp2);
             }
             tcg_temp_free_i32(tmp);
             break;
         case 0x0c:
             tcg_gen_or_i32(tmp, tmp, tmp2);
             if (logic_cc) {
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
@@ -7862,7 +8193,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
                 gen_exception_return(s, tmp2);
             } else {
                 if (logic_cc) {
-                    gen_logic_CC(tmp2);
+                    gen_logic_CC(s, tmp2);
                 }
                 store_reg_bx(env, s, rd, tmp2);
             }
@@ -7870,7 +8201,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
         case 0x0e:
             tcg_gen_andc_i32(tmp, tmp, tmp2);
             if (logic_cc) {
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             }
             store_reg_bx(env, s, rd, tmp);
             break;
@@ -7878,7 +8209,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
         case 0x0f:
             tcg_gen_not_i32(tmp2, tmp2);
             if (logic_cc) {
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             }
             store_reg_bx(env, s, rd, tmp2);
             break;
@@ -7921,7 +8252,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
                             tcg_temp_free_i32(tmp2);
                         }
                         if (insn & (1 << 20))
-                            gen_logic_CC(tmp);
+                            gen_logic_CC(s, tmp);
                         store_reg(s, rd, tmp);
                         break;
                     case 4:
@@ -7953,7 +8284,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
                             tcg_temp_free_i32(ah);
                         }
                         if (insn & (1 << 20)) {
-                            gen_logicq_cc(tmp, tmp2);
+                            gen_logicq_cc(s, tmp, tmp2);
                         }
                         store_reg(s, rn, tmp);
                         store_reg(s, rd, tmp2);
@@ -8619,7 +8950,7 @@ static void disas_arm_insn(CPUARMState * env, DisasContext *s)
                 if ((insn & (1 << 22)) && !user) {
                     /* Restore CPSR from SPSR.  */
                     tmp = load_cpu_field(spsr);
-                    gen_set_cpsr(tmp, 0xffffffff);
+                    gen_set_cpsr(s, tmp, 0xffffffff);
                     tcg_temp_free_i32(tmp);
                     s->is_jmp = DISAS_UPDATE;
                 }
@@ -8711,32 +9042,32 @@ gen_thumb2_data_op(DisasContext *s, int op, int conds, uint32_t shifter_out,
         break;
     case 8: /* add */
         if (conds)
-            gen_add_CC(t0, t0, t1);
+            gen_add_CC(s, t0, t0, t1);
         else
             tcg_gen_add_i32(t0, t0, t1);
         break;
     case 10: /* adc */
         if (conds)
-            gen_adc_CC(t0, t0, t1);
+            gen_adc_CC(s, t0, t0, t1);
         else
-            gen_adc(t0, t1);
+            gen_adc(s, t0, t1);
         break;
     case 11: /* sbc */
         if (conds) {
-            gen_sbc_CC(t0, t0, t1);
+            gen_sbc_CC(s, t0, t0, t1);
         } else {
-            gen_sub_carry(t0, t0, t1);
+            gen_sub_carry(s, t0, t0, t1);
         }
         break;
     case 13: /* sub */
         if (conds)
-            gen_sub_CC(t0, t0, t1);
+            gen_sub_CC(s, t0, t0, t1);
         else
             tcg_gen_sub_i32(t0, t0, t1);
         break;
     case 14: /* rsb */
         if (conds)
-            gen_sub_CC(t0, t1, t0);
+            gen_sub_CC(s, t0, t1, t0);
         else
             tcg_gen_sub_i32(t0, t1, t0);
         break;
@@ -8744,9 +9075,9 @@ gen_thumb2_data_op(DisasContext *s, int op, int conds, uint32_t shifter_out,
         return 1;
     }
     if (logic_cc) {
-        gen_logic_CC(t0);
+        gen_logic_CC(s, t0);
         if (shifter_out)
-            gen_set_CF_bit31(t1);
+            gen_set_CF_bit31(s, t1);
     }
     return 0;
 }
@@ -9104,7 +9435,7 @@ static int disas_thumb2_insn(CPUARMState *env, DisasContext *s, uint16_t insn_hw
             shift = ((insn >> 6) & 3) | ((insn >> 10) & 0x1c);
             conds = (insn & (1 << 20)) != 0;
             logic_cc = (conds && thumb2_logic_op(op));
-            gen_arm_shift_im(tmp2, shiftop, shift, logic_cc);
+            gen_arm_shift_im(s, tmp2, shiftop, shift, logic_cc);
             if (gen_thumb2_data_op(s, op, conds, 0, tmp, tmp2))
                 goto illegal_op;
             tcg_temp_free_i32(tmp2);
@@ -9127,9 +9458,9 @@ static int disas_thumb2_insn(CPUARMState *env, DisasContext *s, uint16_t insn_hw
                 goto illegal_op;
             op = (insn >> 21) & 3;
             logic_cc = (insn & (1 << 20)) != 0;
-            gen_arm_shift_reg(tmp, op, tmp2, logic_cc);
+            gen_arm_shift_reg(s, tmp, op, tmp2, logic_cc);
             if (logic_cc)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             store_reg_bx(env, s, rd, tmp);
             break;
         case 1: /* Sign/zero extend.  */
@@ -9569,8 +9900,9 @@ static int disas_thumb2_insn(CPUARMState *env, DisasContext *s, uint16_t insn_hw
                 op = (insn >> 22) & 0xf;
                 /* Generate a conditional jump to next instruction.  */
                 s->condlabel = gen_new_label();
-                arm_gen_test_cc(op ^ 1, s->condlabel);
+                gen_test_cc(s, op ^ 1, s->condlabel);
                 s->condjmp = 1;
+                s->condjmp_cc_op = s->cc_op;
 
                 /* offset[11:1] = insn[10:0] */
                 offset = (insn & 0x7ff) << 1;
@@ -9926,8 +10258,9 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
         cond = s->condexec_cond;
         if (cond != 0x0e) {     /* Skip conditional when condition is AL. */
           s->condlabel = gen_new_label();
-          arm_gen_test_cc(cond ^ 1, s->condlabel);
+          gen_test_cc(s, cond ^ 1, s->condlabel);
           s->condjmp = 1;
+          s->condjmp_cc_op = s->cc_op;
         }
     }
 
@@ -9956,12 +10289,12 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
                 if (s->condexec_mask)
                     tcg_gen_sub_i32(tmp, tmp, tmp2);
                 else
-                    gen_sub_CC(tmp, tmp, tmp2);
+                    gen_sub_CC(s, tmp, tmp, tmp2);
             } else {
                 if (s->condexec_mask)
                     tcg_gen_add_i32(tmp, tmp, tmp2);
                 else
-                    gen_add_CC(tmp, tmp, tmp2);
+                    gen_add_CC(s, tmp, tmp, tmp2);
             }
             tcg_temp_free_i32(tmp2);
             store_reg(s, rd, tmp);
@@ -9970,9 +10303,9 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
             rm = (insn >> 3) & 7;
             shift = (insn >> 6) & 0x1f;
             tmp = load_reg(s, rm);
-            gen_arm_shift_im(tmp, op, shift, s->condexec_mask == 0);
+            gen_arm_shift_im(s, tmp, op, shift, s->condexec_mask == 0);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             store_reg(s, rd, tmp);
         }
         break;
@@ -9984,7 +10317,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
             tmp = tcg_temp_new_i32();
             tcg_gen_movi_i32(tmp, insn & 0xff);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             store_reg(s, rd, tmp);
         } else {
             tmp = load_reg(s, rd);
@@ -9992,7 +10325,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
             tcg_gen_movi_i32(tmp2, insn & 0xff);
             switch (op) {
             case 1: /* cmp */
-                gen_sub_CC(tmp, tmp, tmp2);
+                gen_sub_CC(s, tmp, tmp, tmp2);
                 tcg_temp_free_i32(tmp);
                 tcg_temp_free_i32(tmp2);
                 break;
@@ -10000,7 +10333,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
                 if (s->condexec_mask)
                     tcg_gen_add_i32(tmp, tmp, tmp2);
                 else
-                    gen_add_CC(tmp, tmp, tmp2);
+                    gen_add_CC(s, tmp, tmp, tmp2);
                 tcg_temp_free_i32(tmp2);
                 store_reg(s, rd, tmp);
                 break;
@@ -10008,7 +10341,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
                 if (s->condexec_mask)
                     tcg_gen_sub_i32(tmp, tmp, tmp2);
                 else
-                    gen_sub_CC(tmp, tmp, tmp2);
+                    gen_sub_CC(s, tmp, tmp, tmp2);
                 tcg_temp_free_i32(tmp2);
                 store_reg(s, rd, tmp);
                 break;
@@ -10045,7 +10378,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
             case 1: /* cmp */
                 tmp = load_reg(s, rd);
                 tmp2 = load_reg(s, rm);
-                gen_sub_CC(tmp, tmp, tmp2);
+                gen_sub_CC(s, tmp, tmp, tmp2);
                 tcg_temp_free_i32(tmp2);
                 tcg_temp_free_i32(tmp);
                 break;
@@ -10097,49 +10430,52 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
         case 0x0: /* and */
             tcg_gen_and_i32(tmp, tmp, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             break;
         case 0x1: /* eor */
             tcg_gen_xor_i32(tmp, tmp, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             break;
         case 0x2: /* lsl */
             if (s->condexec_mask) {
                 gen_shl(tmp2, tmp2, tmp);
             } else {
+                gen_flags_cv(s);
                 gen_helper_shl_cc(tmp2, cpu_env, tmp2, tmp);
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             }
             break;
         case 0x3: /* lsr */
             if (s->condexec_mask) {
                 gen_shr(tmp2, tmp2, tmp);
             } else {
+                gen_flags_cv(s);
                 gen_helper_shr_cc(tmp2, cpu_env, tmp2, tmp);
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             }
             break;
         case 0x4: /* asr */
             if (s->condexec_mask) {
                 gen_sar(tmp2, tmp2, tmp);
             } else {
+                gen_flags_cv(s);
                 gen_helper_sar_cc(tmp2, cpu_env, tmp2, tmp);
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             }
             break;
         case 0x5: /* adc */
             if (s->condexec_mask) {
-                gen_adc(tmp, tmp2);
+                gen_adc(s, tmp, tmp2);
             } else {
-                gen_adc_CC(tmp, tmp, tmp2);
+                gen_adc_CC(s, tmp, tmp, tmp2);
             }
             break;
         case 0x6: /* sbc */
             if (s->condexec_mask) {
-                gen_sub_carry(tmp, tmp, tmp2);
+                gen_sub_carry(s, tmp, tmp, tmp2);
             } else {
-                gen_sbc_CC(tmp, tmp, tmp2);
+                gen_sbc_CC(s, tmp, tmp, tmp2);
             }
             break;
         case 0x7: /* ror */
@@ -10147,48 +10483,49 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
                 tcg_gen_andi_i32(tmp, tmp, 0x1f);
                 tcg_gen_rotr_i32(tmp2, tmp2, tmp);
             } else {
+                gen_flags_cv(s);
                 gen_helper_ror_cc(tmp2, cpu_env, tmp2, tmp);
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             }
             break;
         case 0x8: /* tst */
             tcg_gen_and_i32(tmp, tmp, tmp2);
-            gen_logic_CC(tmp);
+            gen_logic_CC(s, tmp);
             rd = 16;
             break;
         case 0x9: /* neg */
             if (s->condexec_mask)
                 tcg_gen_neg_i32(tmp, tmp2);
             else
-                gen_sub_CC(tmp, tmp, tmp2);
+                gen_sub_CC(s, tmp, tmp, tmp2);
             break;
         case 0xa: /* cmp */
-            gen_sub_CC(tmp, tmp, tmp2);
+            gen_sub_CC(s, tmp, tmp, tmp2);
             rd = 16;
             break;
         case 0xb: /* cmn */
-            gen_add_CC(tmp, tmp, tmp2);
+            gen_add_CC(s, tmp, tmp, tmp2);
             rd = 16;
             break;
         case 0xc: /* orr */
             tcg_gen_or_i32(tmp, tmp, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             break;
         case 0xd: /* mul */
             tcg_gen_mul_i32(tmp, tmp, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             break;
         case 0xe: /* bic */
             tcg_gen_andc_i32(tmp, tmp, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp);
+                gen_logic_CC(s, tmp);
             break;
         case 0xf: /* mvn */
             tcg_gen_not_i32(tmp2, tmp2);
             if (!s->condexec_mask)
-                gen_logic_CC(tmp2);
+                gen_logic_CC(s, tmp2);
             val = 1;
             rm = rd;
             break;
@@ -10452,6 +10789,7 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
             tmp = load_reg(s, rm);
             s->condlabel = gen_new_label();
             s->condjmp = 1;
+            s->condjmp_cc_op = s->cc_op;
             if (insn & (1 << 11))
                 tcg_gen_brcondi_i32(TCG_COND_EQ, tmp, 0, s->condlabel);
             else
@@ -10599,8 +10937,9 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s)
         }
         /* generate a conditional jump to next instruction */
         s->condlabel = gen_new_label();
-        arm_gen_test_cc(cond ^ 1, s->condlabel);
+        gen_test_cc(s, cond ^ 1, s->condlabel);
         s->condjmp = 1;
+        s->condjmp_cc_op = s->cc_op;
 
         /* jump to the offset */
         val = (uint32_t)s->pc + 2;
@@ -10674,6 +11013,7 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
     dc->pc = pc_start;
     dc->singlestep_enabled = cs->singlestep_enabled;
     dc->condjmp = 0;
+    dc->cc_op = CC_OP_DYNAMIC;
 
     dc->aarch64 = 0;
     dc->thumb = ARM_TBFLAG_THUMB(tb->flags);
@@ -10705,7 +11045,7 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
     if (max_insns == 0)
         max_insns = CF_COUNT_MASK;
 
-    gen_tb_start();
+    gen_tb_start(tb);
 
     tcg_clear_temp_count();
 
@@ -10816,6 +11156,9 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
         if (dc->condjmp && !dc->is_jmp) {
             gen_set_label(dc->condlabel);
             dc->condjmp = 0;
+            if (dc->cc_op != dc->condjmp_cc_op) {
+                dc->cc_op = CC_OP_DYNAMIC;
+            }
         }
 
         if (tcg_check_temp_count()) {
@@ -10887,8 +11230,10 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
         case DISAS_NEXT:
             gen_goto_tb(dc, 1, dc->pc);
             break;
-        default:
         case DISAS_JUMP:
+            gen_lookup_and_goto_ptr(dc);
+            break;
+        default:
         case DISAS_UPDATE:
             /* indicate that the hash table must be used to find the next TB */
             tcg_gen_exit_tb(0);
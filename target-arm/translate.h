@@ -10,6 +10,10 @@ typedef struct DisasContext {
     int condjmp;
     /* The label that will be jumped to when the instruction is skipped.  */
     int condlabel;
+    /* CC_OP_* value of cpu_CC_OP, or CC_OP_DYNAMIC if unknown.  */
+    int cc_op;
+    /* cc_op on the path that skips a conditional instruction.  */
+    int condjmp_cc_op;
     /* Thumb-2 conditional execution bits.  */
     int condexec_mask;
     int condexec_cond;
@@ -33,6 +37,10 @@ typedef struct DisasContext {
 } DisasContext;
 
 extern TCGv_ptr cpu_env;
+extern TCGv_i32 cpu_NF, cpu_ZF, cpu_CF, cpu_VF;
+
+/* cc_op is only known when the TB runs */
+#define CC_OP_DYNAMIC -1
 
 static inline int arm_dc_feature(DisasContext *dc, int feature)
 {
@@ -77,5 +85,7 @@ static inline void gen_a64_set_pc_im(uint64_t val)
 #endif
 
 void arm_gen_test_cc(int cc, int label);
+void gen_lookup_and_goto_ptr(DisasContext *s);
+void gen_goto_tb_cross_page(DisasContext *s, int n, target_ulong dest);
 
 #endif /* TARGET_ARM_TRANSLATE_H */
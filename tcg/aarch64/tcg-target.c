@@ -53,6 +53,13 @@ static const int tcg_target_reg_alloc_order[] = {
     TCG_REG_X8, /* will not use, see tcg_target_init */
 };
 
+/* Callee-saved registers handed out to pinned globals, taken from the end
+   of the allocation order.  X28 may be needed for GUEST_BASE.  */
+static const int tcg_target_pinned_regs[TCG_TARGET_NB_PINNED_REGS] = {
+    TCG_REG_X27, TCG_REG_X26, TCG_REG_X25,
+    TCG_REG_X24, TCG_REG_X23, TCG_REG_X22,
+};
+
 static const int tcg_target_call_iarg_regs[8] = {
     TCG_REG_X0, TCG_REG_X1, TCG_REG_X2, TCG_REG_X3,
     TCG_REG_X4, TCG_REG_X5, TCG_REG_X6, TCG_REG_X7
@@ -333,6 +340,33 @@ typedef enum {
     I3510_EOR       = 0x4a000000,
     I3510_EON       = 0x4a200000,
     I3510_ANDS      = 0x6a000000,
+
+    /* Load/store register (unsigned immediate), SIMD registers.  */
+    I3313_LDRD      = 0xfd400000,
+    I3313_STRD      = 0xfd000000,
+    I3313_LDRQ      = 0x3dc00000,
+    I3313_STRQ      = 0x3d800000,
+
+    /* AdvSIMD shift by immediate.  */
+    I3614_SHL       = 0x0f005400,
+    I3614_SSHR      = 0x0f000400,
+    I3614_USHR      = 0x2f000400,
+
+    /* AdvSIMD three same.  */
+    I3616_ADD       = 0x0e208400,
+    I3616_SUB       = 0x2e208400,
+    I3616_AND       = 0x0e201c00,
+    I3616_BIC       = 0x0e601c00,
+    I3616_ORR       = 0x0ea01c00,
+    I3616_EOR       = 0x2e201c00,
+    I3616_CMEQ      = 0x2e208c00,
+    I3616_CMGT      = 0x0e203400,
+    I3616_CMGE      = 0x0e203c00,
+    I3616_CMHI      = 0x2e203400,
+    I3616_CMHS      = 0x2e203c00,
+
+    /* AdvSIMD two-reg misc.  */
+    I3617_NOT       = 0x2e205800,
 } AArch64Insn;
 
 static inline enum aarch64_ldst_op_data
@@ -494,6 +528,24 @@ static void tcg_out_insn_3509(TCGContext *s, AArch64Insn insn, TCGType ext,
 }
 
 
+static void tcg_out_insn_3614(TCGContext *s, AArch64Insn insn, bool q,
+                              int rd, int rn, unsigned immhb)
+{
+    tcg_out32(s, insn | q << 30 | immhb << 16 | rn << 5 | rd);
+}
+
+static void tcg_out_insn_3616(TCGContext *s, AArch64Insn insn, bool q,
+                              int size, int rd, int rn, int rm)
+{
+    tcg_out32(s, insn | q << 30 | size << 22 | rm << 16 | rn << 5 | rd);
+}
+
+static void tcg_out_insn_3617(TCGContext *s, AArch64Insn insn, bool q,
+                              int size, int rd, int rn)
+{
+    tcg_out32(s, insn | q << 30 | size << 22 | rn << 5 | rd);
+}
+
 static inline void tcg_out_ldst_9(TCGContext *s,
                                   enum aarch64_ldst_op_data op_data,
                                   enum aarch64_ldst_op_type op_type,
@@ -1234,6 +1286,118 @@ static inline void tcg_out_load_pair(TCGContext *s, TCGReg addr,
     tcg_out32(s, 0xa9400000 | idx << 16 | r2 << 10 | addr << 5 | r1);
 }
 
+/* The vector opcodes work on guest state in memory.  The operands are
+   loaded into V0-V2, which are call-clobbered and not otherwise used, and
+   the result stored back.  The arithmetic always works on the full 128
+   bits; only the loads and stores depend on the vector size.  */
+
+static void tcg_out_vec_ldst(TCGContext *s, AArch64Insn insn, int oprsz,
+                             int vreg, TCGReg base, intptr_t ofs)
+{
+    if (ofs >= 0 && (ofs & (oprsz - 1)) == 0 && ofs / oprsz <= 0xfff) {
+        tcg_out32(s, insn | (ofs / oprsz) << 10 | base << 5 | vreg);
+    } else {
+        tcg_out_movi(s, TCG_TYPE_I64, TCG_REG_TMP, ofs);
+        tcg_out_insn(s, 3502, ADD, TCG_TYPE_I64, TCG_REG_TMP, base,
+                     TCG_REG_TMP);
+        tcg_out32(s, insn | TCG_REG_TMP << 5 | vreg);
+    }
+}
+
+static void tcg_out_vec_op(TCGContext *s, TCGOpcode opc, const TCGArg *args)
+{
+    TCGReg base = args[0];
+    intptr_t dofs = args[1], aofs = args[2];
+    TCGArg b = args[3];
+    int oprsz = args[4], vece = args[5];
+    AArch64Insn ld = oprsz == 16 ? I3313_LDRQ : I3313_LDRD;
+    AArch64Insn st = oprsz == 16 ? I3313_STRQ : I3313_STRD;
+
+    tcg_out_vec_ldst(s, ld, oprsz, 0, base, aofs);
+
+    switch (opc) {
+    case INDEX_op_add_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, ADD, 1, vece, 0, 0, 1);
+        break;
+    case INDEX_op_sub_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, SUB, 1, vece, 0, 0, 1);
+        break;
+    case INDEX_op_and_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, AND, 1, 0, 0, 0, 1);
+        break;
+    case INDEX_op_or_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, ORR, 1, 0, 0, 0, 1);
+        break;
+    case INDEX_op_xor_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, EOR, 1, 0, 0, 0, 1);
+        break;
+    case INDEX_op_andc_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        tcg_out_insn(s, 3616, BIC, 1, 0, 0, 0, 1);
+        break;
+
+    /* The immediate encodes both the element size and the count */
+    case INDEX_op_shli_vec:
+        tcg_out_insn(s, 3614, SHL, 1, 0, 0, (8 << vece) + b);
+        break;
+    case INDEX_op_shri_vec:
+        tcg_out_insn(s, 3614, USHR, 1, 0, 0, (16 << vece) - b);
+        break;
+    case INDEX_op_sari_vec:
+        tcg_out_insn(s, 3614, SSHR, 1, 0, 0, (16 << vece) - b);
+        break;
+
+    case INDEX_op_cmp_vec:
+        tcg_out_vec_ldst(s, ld, oprsz, 1, base, b);
+        switch ((TCGCond)args[6]) {
+        case TCG_COND_EQ:
+            tcg_out_insn(s, 3616, CMEQ, 1, vece, 0, 0, 1);
+            break;
+        case TCG_COND_NE:
+            tcg_out_insn(s, 3616, CMEQ, 1, vece, 0, 0, 1);
+            tcg_out_insn(s, 3617, NOT, 1, 0, 0, 0);
+            break;
+        case TCG_COND_GT:
+            tcg_out_insn(s, 3616, CMGT, 1, vece, 0, 0, 1);
+            break;
+        case TCG_COND_LT:
+            tcg_out_insn(s, 3616, CMGT, 1, vece, 0, 1, 0);
+            break;
+        case TCG_COND_GE:
+            tcg_out_insn(s, 3616, CMGE, 1, vece, 0, 0, 1);
+            break;
+        case TCG_COND_LE:
+            tcg_out_insn(s, 3616, CMGE, 1, vece, 0, 1, 0);
+            break;
+        case TCG_COND_GTU:
+            tcg_out_insn(s, 3616, CMHI, 1, vece, 0, 0, 1);
+            break;
+        case TCG_COND_LTU:
+            tcg_out_insn(s, 3616, CMHI, 1, vece, 0, 1, 0);
+            break;
+        case TCG_COND_GEU:
+            tcg_out_insn(s, 3616, CMHS, 1, vece, 0, 0, 1);
+            break;
+        case TCG_COND_LEU:
+            tcg_out_insn(s, 3616, CMHS, 1, vece, 0, 1, 0);
+            break;
+        default:
+            tcg_abort();
+        }
+        break;
+
+    default:
+        tcg_abort();
+    }
+
+    tcg_out_vec_ldst(s, st, oprsz, 0, base, dofs);
+}
+
 static void tcg_out_op(TCGContext *s, TCGOpcode opc,
                        const TCGArg args[TCG_MAX_OP_ARGS],
                        const int const_args[TCG_MAX_OP_ARGS])
@@ -1270,6 +1434,23 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc,
         s->tb_next_offset[a0] = s->code_ptr - s->code_buf;
         break;
 
+    case INDEX_op_goto_ptr:
+        tcg_out_gotor(s, a0);
+        break;
+
+    case INDEX_op_add_vec:
+    case INDEX_op_sub_vec:
+    case INDEX_op_and_vec:
+    case INDEX_op_or_vec:
+    case INDEX_op_xor_vec:
+    case INDEX_op_andc_vec:
+    case INDEX_op_shli_vec:
+    case INDEX_op_shri_vec:
+    case INDEX_op_sari_vec:
+    case INDEX_op_cmp_vec:
+        tcg_out_vec_op(s, opc, args);
+        break;
+
     case INDEX_op_call:
         if (const_args[0]) {
             tcg_out_call(s, a0);
@@ -1620,6 +1801,17 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc,
 static const TCGTargetOpDef aarch64_op_defs[] = {
     { INDEX_op_exit_tb, { } },
     { INDEX_op_goto_tb, { } },
+    { INDEX_op_goto_ptr, { "r" } },
+    { INDEX_op_add_vec, { "r" } },
+    { INDEX_op_sub_vec, { "r" } },
+    { INDEX_op_and_vec, { "r" } },
+    { INDEX_op_or_vec, { "r" } },
+    { INDEX_op_xor_vec, { "r" } },
+    { INDEX_op_andc_vec, { "r" } },
+    { INDEX_op_shli_vec, { "r" } },
+    { INDEX_op_shri_vec, { "r" } },
+    { INDEX_op_sari_vec, { "r" } },
+    { INDEX_op_cmp_vec, { "r" } },
     { INDEX_op_call, { "ri" } },
     { INDEX_op_br, { } },
 
@@ -1818,10 +2010,18 @@ static void tcg_target_qemu_prologue(TCGContext *s)
 #endif
 
     tcg_out_mov(s, TCG_TYPE_PTR, TCG_AREG0, tcg_target_call_iarg_regs[0]);
+    tcg_out_pinned_ld(s);
     tcg_out_gotor(s, tcg_target_call_iarg_regs[1]);
 
+    /* Return path for goto_ptr: exit to the main loop without chaining,
+       like exit_tb(0), and fall through to the epilogue.  */
+    s->code_gen_epilogue = s->code_ptr;
+    tcg_out_movi(s, TCG_TYPE_I64, TCG_REG_X0, 0);
+
     tb_ret_addr = s->code_ptr;
 
+    tcg_out_pinned_st(s);
+
     /* Remove TCG locals stack space.  */
     tcg_out_insn(s, 3401, ADDI, TCG_TYPE_I64, TCG_REG_SP, TCG_REG_SP,
                  frame_size_tcg_locals * TCG_TARGET_STACK_ALIGN);
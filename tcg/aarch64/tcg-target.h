@@ -31,6 +31,7 @@ typedef enum {
 } TCGReg;
 
 #define TCG_TARGET_NB_REGS 32
+#define TCG_TARGET_NB_PINNED_REGS 6
 
 /* used for function call generation */
 #define TCG_REG_CALL_STACK              TCG_REG_SP
@@ -57,6 +58,8 @@ typedef enum {
 #define TCG_TARGET_HAS_nor_i32          0
 #define TCG_TARGET_HAS_deposit_i32      1
 #define TCG_TARGET_HAS_movcond_i32      1
+#define TCG_TARGET_HAS_goto_ptr         1
+#define TCG_TARGET_HAS_vec              1
 #define TCG_TARGET_HAS_add2_i32         1
 #define TCG_TARGET_HAS_sub2_i32         1
 #define TCG_TARGET_HAS_mulu2_i32        0
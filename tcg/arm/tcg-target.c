@@ -1710,6 +1710,9 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         }
         s->tb_next_offset[args[0]] = s->code_ptr - s->code_buf;
         break;
+    case INDEX_op_goto_ptr:
+        tcg_out_bx(s, COND_AL, args[0]);
+        break;
     case INDEX_op_call:
         if (const_args[0])
             tcg_out_call(s, args[0]);
@@ -1975,6 +1978,7 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
 static const TCGTargetOpDef arm_op_defs[] = {
     { INDEX_op_exit_tb, { } },
     { INDEX_op_goto_tb, { } },
+    { INDEX_op_goto_ptr, { "r" } },
     { INDEX_op_call, { "ri" } },
     { INDEX_op_br, { } },
 
@@ -2134,6 +2138,12 @@ static void tcg_target_qemu_prologue(TCGContext *s)
     tcg_out_mov(s, TCG_TYPE_PTR, TCG_AREG0, tcg_target_call_iarg_regs[0]);
 
     tcg_out_bx(s, COND_AL, tcg_target_call_iarg_regs[1]);
+
+    /* Return path for goto_ptr: exit to the main loop without chaining,
+       like exit_tb(0), and fall through to the epilogue.  */
+    s->code_gen_epilogue = s->code_ptr;
+    tcg_out_movi32(s, COND_AL, TCG_REG_R0, 0);
+
     tb_ret_addr = s->code_ptr;
 
     /* Epilogue.  We branch here via tb_ret_addr.  */
@@ -133,6 +133,9 @@ static bool have_movbe;
    it there.  Therefore we always define the variable.  */
 bool have_bmi1;
 
+/* Likewise for SSE2, which is always available on x86_64.  */
+bool have_sse2;
+
 #if defined(CONFIG_CPUID_H) && defined(bit_BMI2)
 static bool have_bmi2;
 #else
@@ -351,6 +354,39 @@ static inline int tcg_target_const_match(tcg_target_long val,
 #define OPC_GRP3_Ev	(0xf7)
 #define OPC_GRP5	(0xff)
 
+/* SSE and SSE2 instructions, used for the vector opcodes.  */
+#define OPC_MOVUPS_VxWx (0x10 | P_EXT)
+#define OPC_MOVUPS_WxVx (0x11 | P_EXT)
+#define OPC_MOVLPS_VqMq (0x12 | P_EXT)
+#define OPC_MOVLPS_MqVq (0x13 | P_EXT)
+#define OPC_MOVAPS_VxWx (0x28 | P_EXT)
+#define OPC_PACKSSWB    (0x63 | P_EXT | P_DATA16)
+#define OPC_PACKUSWB    (0x67 | P_EXT | P_DATA16)
+#define OPC_PADDB       (0xfc | P_EXT | P_DATA16)
+#define OPC_PADDW       (0xfd | P_EXT | P_DATA16)
+#define OPC_PADDD       (0xfe | P_EXT | P_DATA16)
+#define OPC_PADDQ       (0xd4 | P_EXT | P_DATA16)
+#define OPC_PAND        (0xdb | P_EXT | P_DATA16)
+#define OPC_PANDN       (0xdf | P_EXT | P_DATA16)
+#define OPC_PCMPEQB     (0x74 | P_EXT | P_DATA16)
+#define OPC_PCMPEQW     (0x75 | P_EXT | P_DATA16)
+#define OPC_PCMPEQD     (0x76 | P_EXT | P_DATA16)
+#define OPC_PCMPGTB     (0x64 | P_EXT | P_DATA16)
+#define OPC_PCMPGTW     (0x65 | P_EXT | P_DATA16)
+#define OPC_PCMPGTD     (0x66 | P_EXT | P_DATA16)
+#define OPC_POR         (0xeb | P_EXT | P_DATA16)
+#define OPC_PSHIFTW_Ib  (0x71 | P_EXT | P_DATA16) /* /2 /4 /6 */
+#define OPC_PSHIFTD_Ib  (0x72 | P_EXT | P_DATA16) /* /2 /4 /6 */
+#define OPC_PSHIFTQ_Ib  (0x73 | P_EXT | P_DATA16) /* /2 /6 */
+#define OPC_PSHUFD      (0x70 | P_EXT | P_DATA16)
+#define OPC_PSUBB       (0xf8 | P_EXT | P_DATA16)
+#define OPC_PSUBW       (0xf9 | P_EXT | P_DATA16)
+#define OPC_PSUBD       (0xfa | P_EXT | P_DATA16)
+#define OPC_PSUBQ       (0xfb | P_EXT | P_DATA16)
+#define OPC_PUNPCKLBW   (0x60 | P_EXT | P_DATA16)
+#define OPC_PUNPCKHBW   (0x68 | P_EXT | P_DATA16)
+#define OPC_PXOR        (0xef | P_EXT | P_DATA16)
+
 /* Group 1 opcode extensions for 0x80-0x83.
    These are also used as modifiers for OPC_ARITH.  */
 #define ARITH_ADD 0
@@ -1713,6 +1749,215 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args, bool is64)
 #endif
 }
 
+/* Group 12-14 opcode extensions for the SSE2 shifts by immediate.  */
+#define EXT_PSRL 2
+#define EXT_PSRA 4
+#define EXT_PSLL 6
+
+/* The vector opcodes work on guest state in memory.  They load their
+   operands into %xmm0-%xmm2, which the register allocator does not know
+   about and which are therefore free to clobber, and store the result.
+   Only the low 8 bytes are loaded and stored for 8-byte vectors; the
+   rest of the registers is don't care.  Memory operands of SSE2
+   arithmetic must be aligned, so everything goes through movups.  */
+
+static const int vec_add_insn[4] = {
+    OPC_PADDB, OPC_PADDW, OPC_PADDD, OPC_PADDQ
+};
+static const int vec_sub_insn[4] = {
+    OPC_PSUBB, OPC_PSUBW, OPC_PSUBD, OPC_PSUBQ
+};
+static const int vec_cmpeq_insn[3] = {
+    OPC_PCMPEQB, OPC_PCMPEQW, OPC_PCMPEQD
+};
+static const int vec_cmpgt_insn[3] = {
+    OPC_PCMPGTB, OPC_PCMPGTW, OPC_PCMPGTD
+};
+static const int vec_shift_insn[4] = {
+    0, OPC_PSHIFTW_Ib, OPC_PSHIFTD_Ib, OPC_PSHIFTQ_Ib
+};
+
+static void tcg_out_vec_ld(TCGContext *s, int xmm, TCGReg base,
+                           intptr_t ofs, int oprsz)
+{
+    tcg_out_modrm_offset(s, oprsz == 16 ? OPC_MOVUPS_VxWx : OPC_MOVLPS_VqMq,
+                         xmm, base, ofs);
+}
+
+static void tcg_out_vec_st(TCGContext *s, int xmm, TCGReg base,
+                           intptr_t ofs, int oprsz)
+{
+    tcg_out_modrm_offset(s, oprsz == 16 ? OPC_MOVUPS_WxVx : OPC_MOVLPS_MqVq,
+                         xmm, base, ofs);
+}
+
+static void tcg_out_vec_shifti(TCGContext *s, int ext, int vece, int xmm,
+                               int shift)
+{
+    tcg_out_modrm(s, vec_shift_insn[vece], ext, xmm);
+    tcg_out8(s, shift);
+}
+
+static void tcg_out_vec_cmp(TCGContext *s, TCGReg base, intptr_t dofs,
+                            intptr_t aofs, intptr_t bofs, int oprsz,
+                            int vece, TCGCond cond)
+{
+    bool invert = false;
+    intptr_t t;
+
+    /* Reduce to EQ, GT and GTU, which SSE2 provides or can emulate. */
+    switch (cond) {
+    case TCG_COND_LT:
+    case TCG_COND_GE:
+    case TCG_COND_LTU:
+    case TCG_COND_GEU:
+        t = aofs, aofs = bofs, bofs = t;
+        cond = tcg_swap_cond(cond);
+        break;
+    default:
+        break;
+    }
+    switch (cond) {
+    case TCG_COND_NE:
+    case TCG_COND_LE:
+    case TCG_COND_LEU:
+        cond = tcg_invert_cond(cond);
+        invert = true;
+        break;
+    default:
+        break;
+    }
+
+    tcg_out_vec_ld(s, 0, base, aofs, oprsz);
+    tcg_out_vec_ld(s, 1, base, bofs, oprsz);
+
+    if (cond == TCG_COND_GTU) {
+        /* Bias both operands by the sign bit and compare signed */
+        tcg_out_modrm(s, OPC_PCMPEQB, 2, 2);
+        if (vece == MO_32) {
+            tcg_out_vec_shifti(s, EXT_PSLL, MO_32, 2, 31);
+        } else {
+            tcg_out_vec_shifti(s, EXT_PSLL, MO_16, 2, 15);
+            if (vece == MO_8) {
+                /* 0x8000 saturates to 0x80 */
+                tcg_out_modrm(s, OPC_PACKSSWB, 2, 2);
+            }
+        }
+        tcg_out_modrm(s, OPC_PXOR, 0, 2);
+        tcg_out_modrm(s, OPC_PXOR, 1, 2);
+        cond = TCG_COND_GT;
+    }
+
+    if (cond == TCG_COND_EQ) {
+        tcg_out_modrm(s, vec_cmpeq_insn[vece], 0, 1);
+    } else {
+        tcg_out_modrm(s, vec_cmpgt_insn[vece], 0, 1);
+    }
+    if (invert) {
+        tcg_out_modrm(s, OPC_PCMPEQB, 2, 2);
+        tcg_out_modrm(s, OPC_PXOR, 0, 2);
+    }
+
+    tcg_out_vec_st(s, 0, base, dofs, oprsz);
+}
+
+static void tcg_out_vec_op(TCGContext *s, TCGOpcode opc, const TCGArg *args)
+{
+    TCGReg base = args[0];
+    intptr_t dofs = args[1], aofs = args[2];
+    TCGArg b = args[3];
+    int oprsz = args[4], vece = args[5];
+    int res = 0, i;
+
+    if (opc == INDEX_op_cmp_vec) {
+        tcg_out_vec_cmp(s, base, dofs, aofs, b, oprsz, vece, args[6]);
+        return;
+    }
+
+    tcg_out_vec_ld(s, 0, base, aofs, oprsz);
+
+    switch (opc) {
+    case INDEX_op_add_vec:
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, vec_add_insn[vece], 0, 1);
+        break;
+    case INDEX_op_sub_vec:
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, vec_sub_insn[vece], 0, 1);
+        break;
+    case INDEX_op_and_vec:
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, OPC_PAND, 0, 1);
+        break;
+    case INDEX_op_or_vec:
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, OPC_POR, 0, 1);
+        break;
+    case INDEX_op_xor_vec:
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, OPC_PXOR, 0, 1);
+        break;
+    case INDEX_op_andc_vec:
+        /* pandn complements its destination */
+        tcg_out_vec_ld(s, 1, base, b, oprsz);
+        tcg_out_modrm(s, OPC_PANDN, 1, 0);
+        res = 1;
+        break;
+
+    case INDEX_op_shli_vec:
+        if (vece == MO_8) {
+            /* There are no byte shifts; b is at most 7 */
+            for (i = 0; i < b; i++) {
+                tcg_out_modrm(s, OPC_PADDB, 0, 0);
+            }
+        } else {
+            tcg_out_vec_shifti(s, EXT_PSLL, vece, 0, b);
+        }
+        break;
+    case INDEX_op_shri_vec:
+        if (vece == MO_8) {
+            /* Zero-extend to words, shift and pack again */
+            tcg_out_modrm(s, OPC_PXOR, 2, 2);
+            tcg_out_modrm(s, OPC_MOVAPS_VxWx, 1, 0);
+            tcg_out_modrm(s, OPC_PUNPCKLBW, 0, 2);
+            tcg_out_modrm(s, OPC_PUNPCKHBW, 1, 2);
+            tcg_out_vec_shifti(s, EXT_PSRL, MO_16, 0, b);
+            tcg_out_vec_shifti(s, EXT_PSRL, MO_16, 1, b);
+            tcg_out_modrm(s, OPC_PACKUSWB, 0, 1);
+        } else {
+            tcg_out_vec_shifti(s, EXT_PSRL, vece, 0, b);
+        }
+        break;
+    case INDEX_op_sari_vec:
+        if (vece == MO_8) {
+            /* Put each byte in the high half of a word, shift and pack */
+            tcg_out_modrm(s, OPC_MOVAPS_VxWx, 1, 0);
+            tcg_out_modrm(s, OPC_PUNPCKLBW, 0, 0);
+            tcg_out_modrm(s, OPC_PUNPCKHBW, 1, 1);
+            tcg_out_vec_shifti(s, EXT_PSRA, MO_16, 0, 8 + b);
+            tcg_out_vec_shifti(s, EXT_PSRA, MO_16, 1, 8 + b);
+            tcg_out_modrm(s, OPC_PACKSSWB, 0, 1);
+        } else if (vece == MO_64) {
+            /* Shift logically and or in the sign, replicated from the
+               high dword of each quadword */
+            tcg_out_modrm(s, OPC_MOVAPS_VxWx, 1, 0);
+            tcg_out_vec_shifti(s, EXT_PSRA, MO_32, 1, 31);
+            tcg_out_modrm(s, OPC_PSHUFD, 1, 1);
+            tcg_out8(s, 0xf5);
+            tcg_out_vec_shifti(s, EXT_PSRL, MO_64, 0, b);
+            tcg_out_vec_shifti(s, EXT_PSLL, MO_64, 1, 64 - b);
+            tcg_out_modrm(s, OPC_POR, 0, 1);
+        } else {
+            tcg_out_vec_shifti(s, EXT_PSRA, vece, 0, b);
+        }
+        break;
+    default:
+        tcg_abort();
+    }
+
+    tcg_out_vec_st(s, res, base, dofs, oprsz);
+}
+
 static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
                               const TCGArg *args, const int *const_args)
 {
@@ -1746,6 +1991,22 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         }
         s->tb_next_offset[args[0]] = s->code_ptr - s->code_buf;
         break;
+    case INDEX_op_goto_ptr:
+        /* jmp *reg, possibly to the epilogue */
+        tcg_out_modrm(s, OPC_GRP5, EXT5_JMPN_Ev, args[0]);
+        break;
+    case INDEX_op_add_vec:
+    case INDEX_op_sub_vec:
+    case INDEX_op_and_vec:
+    case INDEX_op_or_vec:
+    case INDEX_op_xor_vec:
+    case INDEX_op_andc_vec:
+    case INDEX_op_shli_vec:
+    case INDEX_op_shri_vec:
+    case INDEX_op_sari_vec:
+    case INDEX_op_cmp_vec:
+        tcg_out_vec_op(s, opc, args);
+        break;
     case INDEX_op_call:
         if (const_args[0]) {
             tcg_out_calli(s, args[0]);
@@ -2078,6 +2339,17 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
 static const TCGTargetOpDef x86_op_defs[] = {
     { INDEX_op_exit_tb, { } },
     { INDEX_op_goto_tb, { } },
+    { INDEX_op_goto_ptr, { "r" } },
+    { INDEX_op_add_vec, { "r" } },
+    { INDEX_op_sub_vec, { "r" } },
+    { INDEX_op_and_vec, { "r" } },
+    { INDEX_op_or_vec, { "r" } },
+    { INDEX_op_xor_vec, { "r" } },
+    { INDEX_op_andc_vec, { "r" } },
+    { INDEX_op_shli_vec, { "r" } },
+    { INDEX_op_shri_vec, { "r" } },
+    { INDEX_op_sari_vec, { "r" } },
+    { INDEX_op_cmp_vec, { "r" } },
     { INDEX_op_call, { "ri" } },
     { INDEX_op_br, { } },
     { INDEX_op_mov_i32, { "r", "r" } },
@@ -2229,6 +2501,14 @@ static int tcg_target_callee_save_regs[] = {
 #endif
 };
 
+#if TCG_TARGET_REG_BITS == 64
+/* Callee-saved registers handed out to pinned globals.  RBP is left to
+   the allocator so that temps can still live across helper calls.  */
+static const int tcg_target_pinned_regs[TCG_TARGET_NB_PINNED_REGS] = {
+    TCG_REG_R15, TCG_REG_R13, TCG_REG_R12, TCG_REG_RBX,
+};
+#endif
+
 /* Compute frame size via macros, to share between tcg_target_qemu_prologue
    and tcg_register_jit.  */
 
@@ -2270,14 +2550,21 @@ static void tcg_target_qemu_prologue(TCGContext *s)
 			 + stack_addend);
 #else
     tcg_out_mov(s, TCG_TYPE_PTR, TCG_AREG0, tcg_target_call_iarg_regs[0]);
+    tcg_out_pinned_ld(s);
     tcg_out_addi(s, TCG_REG_ESP, -stack_addend);
     /* jmp *tb.  */
     tcg_out_modrm(s, OPC_GRP5, EXT5_JMPN_Ev, tcg_target_call_iarg_regs[1]);
 #endif
 
+    /* Return path for goto_ptr: exit to the main loop without
+       chaining, like exit_tb(0), and fall through to the epilogue.  */
+    s->code_gen_epilogue = s->code_ptr;
+    tcg_out_movi(s, TCG_TYPE_PTR, TCG_REG_EAX, 0);
+
     /* TB epilogue */
     tb_ret_addr = s->code_ptr;
 
+    tcg_out_pinned_st(s);
     tcg_out_addi(s, TCG_REG_CALL_STACK, stack_addend);
 
     for (i = ARRAY_SIZE(tcg_target_callee_save_regs) - 1; i >= 0; i--) {
@@ -2301,6 +2588,9 @@ static void tcg_target_init(TCGContext *s)
 
     if (max >= 1) {
         __cpuid(1, a, b, c, d);
+#ifdef bit_SSE2
+        have_sse2 = (d & bit_SSE2) != 0;
+#endif
 #ifndef have_cmov
         /* For 32-bit, 99% certainty that we're running on hardware that
            supports cmov, but we still need to check.  In case cmov is not
@@ -2326,6 +2616,11 @@ static void tcg_target_init(TCGContext *s)
     }
 #endif
 
+    if (TCG_TARGET_REG_BITS == 64) {
+        /* SSE2 is part of the x86_64 baseline.  */
+        have_sse2 = true;
+    }
+
     if (TCG_TARGET_REG_BITS == 64) {
         tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_I32], 0, 0xffff);
         tcg_regset_set32(tcg_target_available_regs[TCG_TYPE_I64], 0, 0xffff);
@@ -29,6 +29,7 @@
 #ifdef __x86_64__
 # define TCG_TARGET_REG_BITS  64
 # define TCG_TARGET_NB_REGS   16
+# define TCG_TARGET_NB_PINNED_REGS 4
 #else
 # define TCG_TARGET_REG_BITS  32
 # define TCG_TARGET_NB_REGS    8
@@ -74,6 +75,7 @@ typedef enum {
 #endif
 
 extern bool have_bmi1;
+extern bool have_sse2;
 
 /* optional instructions */
 #define TCG_TARGET_HAS_div2_i32         1
@@ -93,6 +95,8 @@ extern bool have_bmi1;
 #define TCG_TARGET_HAS_nor_i32          0
 #define TCG_TARGET_HAS_deposit_i32      1
 #define TCG_TARGET_HAS_movcond_i32      1
+#define TCG_TARGET_HAS_goto_ptr         1
+#define TCG_TARGET_HAS_vec              have_sse2
 #define TCG_TARGET_HAS_add2_i32         1
 #define TCG_TARGET_HAS_sub2_i32         1
 #define TCG_TARGET_HAS_mulu2_i32        1
@@ -49,7 +49,21 @@ struct tcg_temp_info {
     tcg_target_ulong mask;
 };
 
-static struct tcg_temp_info temps[TCG_MAX_TEMPS];
+static TCG_THREAD struct tcg_temp_info temps[TCG_MAX_TEMPS];
+
+/* Env memory known to hold the value of a temp, either because it was
+   loaded into the temp or stored from it.  Only env slots that do not
+   back a global are tracked, see tcg_env_slot().  */
+struct tcg_mem_info {
+    TCGArg temp;
+    tcg_target_long offset;
+    int size;
+};
+
+#define MAX_MEM_INFO 16
+
+static TCG_THREAD struct tcg_mem_info mems[MAX_MEM_INFO];
+static TCG_THREAD int nb_mems;
 
 /* Reset TEMP's state to TCG_TEMP_UNDEF.  If TEMP only had one copy, remove
    the copy flag from the left temp.  */
@@ -77,6 +91,155 @@ static void reset_all_temps(int nb_temps)
     }
 }
 
+/* Reset the temps that do not survive the end of a basic block.  Globals
+   and local temps keep their values along the fall-through path of a
+   conditional branch.  */
+static void reset_bb_temps(TCGContext *s, int nb_temps)
+{
+    int i;
+    for (i = s->nb_globals; i < nb_temps; i++) {
+        if (!s->temps[i].temp_local) {
+            reset_temp(i);
+        }
+    }
+}
+
+static void reset_mems_temp(TCGArg temp)
+{
+    int i;
+    for (i = 0; i < nb_mems; i++) {
+        if (mems[i].temp == temp) {
+            mems[i--] = mems[--nb_mems];
+        }
+    }
+}
+
+static void reset_mems_overlap(tcg_target_long offset, int size)
+{
+    int i;
+    for (i = 0; i < nb_mems; i++) {
+        if (mems[i].offset < offset + size
+            && offset < mems[i].offset + mems[i].size) {
+            mems[i--] = mems[--nb_mems];
+        }
+    }
+}
+
+static void reset_mems_bb(TCGContext *s)
+{
+    int i;
+    for (i = 0; i < nb_mems; i++) {
+        if (mems[i].temp >= s->nb_globals
+            && !s->temps[mems[i].temp].temp_local) {
+            mems[i--] = mems[--nb_mems];
+        }
+    }
+}
+
+static struct tcg_mem_info *find_mem(tcg_target_long offset, int size)
+{
+    int i;
+    for (i = 0; i < nb_mems; i++) {
+        if (mems[i].offset == offset && mems[i].size == size) {
+            return &mems[i];
+        }
+    }
+    return NULL;
+}
+
+static void record_mem(TCGArg temp, tcg_target_long offset, int size)
+{
+    reset_mems_overlap(offset, size);
+    if (nb_mems == MAX_MEM_INFO) {
+        /* Forget the oldest entry.  */
+        memmove(&mems[0], &mems[1], (MAX_MEM_INFO - 1) * sizeof(mems[0]));
+        nb_mems--;
+    }
+    mems[nb_mems].temp = temp;
+    mems[nb_mems].offset = offset;
+    mems[nb_mems].size = size;
+    nb_mems++;
+}
+
+/* Return the number of bytes accessed by a host load or store op, or 0
+   if OP is not one.  */
+static int mem_op_size(TCGOpcode op)
+{
+    switch (op) {
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld8s):
+    CASE_OP_32_64(st8):
+        return 1;
+    CASE_OP_32_64(ld16u):
+    CASE_OP_32_64(ld16s):
+    CASE_OP_32_64(st16):
+        return 2;
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_st32_i64:
+    case INDEX_op_ld_i32:
+    case INDEX_op_st_i32:
+        return 4;
+    case INDEX_op_ld_i64:
+    case INDEX_op_st_i64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/* Forget what OP may overwrite in env memory.  Full-width loads and
+   stores to tracked slots are handled by the caller.  */
+static void mem_op_clobber(TCGContext *s, TCGOpcode op, const TCGOpDef *def,
+                           const TCGArg *args)
+{
+    int i, size, nb_oargs;
+
+    if (op == INDEX_op_call) {
+        nb_oargs = args[0] >> 16;
+        i = nb_oargs + (args[0] & 0xffff);
+        if (!(args[i + 1] & TCG_CALL_NO_SIDE_EFFECTS)) {
+            nb_mems = 0;
+            return;
+        }
+        for (i = 0; i < nb_oargs; i++) {
+            reset_mems_temp(args[i + 1]);
+        }
+        return;
+    }
+
+    if (def->flags & TCG_OPF_BB_END) {
+        switch (op) {
+        CASE_OP_32_64(brcond):
+        case INDEX_op_brcond2_i32:
+            reset_mems_bb(s);
+            return;
+        default:
+            nb_mems = 0;
+            return;
+        }
+    }
+    if (def->flags & TCG_OPF_SIDE_EFFECTS) {
+        /* Guest memory accesses may fault and vector ops work directly
+           on env memory.  */
+        nb_mems = 0;
+        return;
+    }
+
+    size = mem_op_size(op);
+    if (size && def->nb_oargs == 0) {
+        if (s->temps[args[1]].fixed_reg && s->temps[args[1]].reg == TCG_AREG0) {
+            reset_mems_overlap(args[2], size);
+        } else {
+            /* Might point anywhere into env.  */
+            nb_mems = 0;
+        }
+    }
+    for (i = 0; i < def->nb_oargs; i++) {
+        reset_mems_temp(args[i]);
+    }
+}
+
 static int op_bits(TCGOpcode op)
 {
     const TCGOpDef *def = &tcg_op_defs[op];
@@ -513,11 +676,14 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
                                     TCGArg *args, TCGOpDef *tcg_op_defs)
 {
     int i, nb_ops, op_index, nb_temps, nb_globals, nb_call_args;
+    int mem_size;
     tcg_target_ulong mask, affected;
     TCGOpcode op;
     const TCGOpDef *def;
     TCGArg *gen_args;
-    TCGArg tmp;
+    TCGArg tmp, mem_temp;
+    tcg_target_long mem_offset;
+    struct tcg_mem_info *m;
 
     /* Array VALS has an element for each temp.
        If this temp holds a constant then its value is kept in VALS' element.
@@ -527,6 +693,7 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
     nb_temps = s->nb_temps;
     nb_globals = s->nb_globals;
     reset_all_temps(nb_temps);
+    nb_mems = 0;
 
     nb_ops = tcg_opc_ptr - s->gen_opc_buf;
     gen_args = args;
@@ -550,6 +717,59 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
             }
         }
 
+        /* Replace loads of env slots whose value is known by moves, and
+           drop stores of the value a slot already holds.  */
+        mem_size = 0;
+        switch (op) {
+        CASE_OP_32_64(ld):
+        CASE_OP_32_64(st):
+            if (!tcg_env_slot(s, args[1], args[2], op_bits(op) / 8)) {
+                break;
+            }
+            mem_size = op_bits(op) / 8;
+            mem_temp = args[0];
+            mem_offset = args[2];
+            m = find_mem(mem_offset, mem_size);
+            if (!m) {
+                break;
+            }
+            if (def->nb_oargs == 0) {
+                if (temps_are_copies(m->temp, args[0])
+                    || (temps[m->temp].state == TCG_TEMP_CONST
+                        && temps[args[0]].state == TCG_TEMP_CONST
+                        && temps[m->temp].val == temps[args[0]].val)) {
+                    s->gen_opc_buf[op_index] = INDEX_op_nop;
+#ifdef CONFIG_PROFILER
+                    s->env_st_del_count++;
+#endif
+                    args += 3;
+                    continue;
+                }
+                break;
+            }
+            if (m->temp == args[0]) {
+                s->gen_opc_buf[op_index] = INDEX_op_nop;
+            } else if (temps[m->temp].state == TCG_TEMP_CONST) {
+                s->gen_opc_buf[op_index] = op_to_movi(op);
+                tcg_opt_gen_movi(gen_args, args[0], temps[m->temp].val);
+                reset_mems_temp(args[0]);
+                gen_args += 2;
+            } else {
+                s->gen_opc_buf[op_index] = op_to_mov(op);
+                tcg_opt_gen_mov(s, gen_args, args[0], m->temp);
+                reset_mems_temp(args[0]);
+                gen_args += 2;
+            }
+#ifdef CONFIG_PROFILER
+            s->env_ld_del_count++;
+#endif
+            args += 3;
+            continue;
+        default:
+            break;
+        }
+        mem_op_clobber(s, op, def, args);
+
         /* For commutative operations make constant second argument */
         switch (op) {
         CASE_OP_32_64(add):
@@ -1254,7 +1474,15 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
                block, otherwise we only trash the output args.  "mask" is
                the non-zero bits mask for the first output arg.  */
             if (def->flags & TCG_OPF_BB_END) {
-                reset_all_temps(nb_temps);
+                switch (op) {
+                CASE_OP_32_64(brcond):
+                case INDEX_op_brcond2_i32:
+                    reset_bb_temps(s, nb_temps);
+                    break;
+                default:
+                    reset_all_temps(nb_temps);
+                    break;
+                }
             } else {
                 for (i = 0; i < def->nb_oargs; i++) {
                     reset_temp(args[i]);
@@ -1272,6 +1500,10 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
             gen_args += def->nb_args;
             break;
         }
+
+        if (mem_size) {
+            record_mem(mem_temp, mem_offset, mem_size);
+        }
     }
 
     return gen_args;
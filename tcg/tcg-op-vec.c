@@ -0,0 +1,424 @@
+/*
+ * Tiny Code Generator for QEMU - vector operations
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "qemu-common.h"
+
+#define NO_CPU_IO_DEFS
+#include "cpu.h"
+
+#include "tcg-op.h"
+#include "tcg-op-vec.h"
+
+/* Replicate the low element of C, of size VECE, over 64 bits */
+static uint64_t dup_const(unsigned vece, uint64_t c)
+{
+    switch (vece) {
+    case MO_8:
+        return 0x0101010101010101ull * (uint8_t)c;
+    case MO_16:
+        return 0x0001000100010001ull * (uint16_t)c;
+    case MO_32:
+        return 0x0000000100000001ull * (uint32_t)c;
+    case MO_64:
+        return c;
+    default:
+        tcg_abort();
+    }
+}
+
+static uint64_t lane_mask(unsigned vece)
+{
+    return vece == MO_64 ? -1ull : (1ull << (8 << vece)) - 1;
+}
+
+static void vec_gen_op(TCGOpcode opc, TCGv_ptr base, TCGArg dofs,
+                       TCGArg aofs, TCGArg b, TCGArg oprsz, TCGArg vece)
+{
+    *tcg_ctx.gen_opc_ptr++ = opc;
+    *tcg_ctx.gen_opparam_ptr++ = GET_TCGV_PTR(base);
+    *tcg_ctx.gen_opparam_ptr++ = dofs;
+    *tcg_ctx.gen_opparam_ptr++ = aofs;
+    *tcg_ctx.gen_opparam_ptr++ = b;
+    *tcg_ctx.gen_opparam_ptr++ = oprsz;
+    *tcg_ctx.gen_opparam_ptr++ = vece;
+}
+
+/* Integer register expansion, 64 bits at a time */
+
+typedef void VecGen3Fn(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b);
+typedef void VecGen2iFn(unsigned vece, TCGv_i64 d, TCGv_i64 a,
+                        unsigned shift);
+
+static void vec_expand3(VecGen3Fn *fn, unsigned vece, TCGv_ptr base,
+                        uint32_t dofs, uint32_t aofs, uint32_t bofs,
+                        uint32_t oprsz)
+{
+    TCGv_i64 d = tcg_temp_new_i64();
+    TCGv_i64 a = tcg_temp_new_i64();
+    TCGv_i64 b = tcg_temp_new_i64();
+    uint32_t i;
+
+    for (i = 0; i < oprsz; i += 8) {
+        tcg_gen_ld_i64(a, base, aofs + i);
+        tcg_gen_ld_i64(b, base, bofs + i);
+        fn(vece, d, a, b);
+        tcg_gen_st_i64(d, base, dofs + i);
+    }
+
+    tcg_temp_free_i64(d);
+    tcg_temp_free_i64(a);
+    tcg_temp_free_i64(b);
+}
+
+static void vec_expand2i(VecGen2iFn *fn, unsigned vece, TCGv_ptr base,
+                         uint32_t dofs, uint32_t aofs, unsigned shift,
+                         uint32_t oprsz)
+{
+    TCGv_i64 d = tcg_temp_new_i64();
+    TCGv_i64 a = tcg_temp_new_i64();
+    uint32_t i;
+
+    for (i = 0; i < oprsz; i += 8) {
+        tcg_gen_ld_i64(a, base, aofs + i);
+        fn(vece, d, a, shift);
+        tcg_gen_st_i64(d, base, dofs + i);
+    }
+
+    tcg_temp_free_i64(d);
+    tcg_temp_free_i64(a);
+}
+
+/* Add the elements with their top bit masked off, so that no carry
+   crosses into the next element, then fix up the top bits.  */
+static void gen_add64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    uint64_t m = dup_const(vece, 1ull << ((8 << vece) - 1));
+    TCGv_i64 t1, t2;
+
+    if (vece == MO_64) {
+        tcg_gen_add_i64(d, a, b);
+        return;
+    }
+
+    t1 = tcg_temp_new_i64();
+    t2 = tcg_temp_new_i64();
+    tcg_gen_andi_i64(t1, a, ~m);
+    tcg_gen_andi_i64(t2, b, ~m);
+    tcg_gen_add_i64(d, t1, t2);
+    tcg_gen_xor_i64(t1, a, b);
+    tcg_gen_andi_i64(t1, t1, m);
+    tcg_gen_xor_i64(d, d, t1);
+    tcg_temp_free_i64(t1);
+    tcg_temp_free_i64(t2);
+}
+
+/* Likewise, with the top bit of each minuend element set so that no
+   borrow crosses into the next element.  */
+static void gen_sub64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    uint64_t m = dup_const(vece, 1ull << ((8 << vece) - 1));
+    TCGv_i64 t1, t2;
+
+    if (vece == MO_64) {
+        tcg_gen_sub_i64(d, a, b);
+        return;
+    }
+
+    t1 = tcg_temp_new_i64();
+    t2 = tcg_temp_new_i64();
+    tcg_gen_ori_i64(t1, a, m);
+    tcg_gen_andi_i64(t2, b, ~m);
+    tcg_gen_sub_i64(d, t1, t2);
+    tcg_gen_eqv_i64(t1, a, b);
+    tcg_gen_andi_i64(t1, t1, m);
+    tcg_gen_xor_i64(d, d, t1);
+    tcg_temp_free_i64(t1);
+    tcg_temp_free_i64(t2);
+}
+
+static void gen_and64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    tcg_gen_and_i64(d, a, b);
+}
+
+static void gen_or64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    tcg_gen_or_i64(d, a, b);
+}
+
+static void gen_xor64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    tcg_gen_xor_i64(d, a, b);
+}
+
+static void gen_andc64(unsigned vece, TCGv_i64 d, TCGv_i64 a, TCGv_i64 b)
+{
+    tcg_gen_andc_i64(d, a, b);
+}
+
+static void gen_shli64(unsigned vece, TCGv_i64 d, TCGv_i64 a, unsigned c)
+{
+    tcg_gen_shli_i64(d, a, c);
+    if (vece != MO_64) {
+        tcg_gen_andi_i64(d, d, dup_const(vece, lane_mask(vece) << c));
+    }
+}
+
+static void gen_shri64(unsigned vece, TCGv_i64 d, TCGv_i64 a, unsigned c)
+{
+    tcg_gen_shri_i64(d, a, c);
+    if (vece != MO_64) {
+        tcg_gen_andi_i64(d, d, dup_const(vece, lane_mask(vece) >> c));
+    }
+}
+
+/* Shift logically, then copy the shifted sign bit of each element into
+   the C bits above it with a multiplication, which cannot carry out of
+   the element.  */
+static void gen_sari64(unsigned vece, TCGv_i64 d, TCGv_i64 a, unsigned c)
+{
+    uint64_t s_mask = dup_const(vece, (1ull << ((8 << vece) - 1)) >> c);
+    uint64_t c_mask = dup_const(vece, lane_mask(vece) >> c);
+    TCGv_i64 s;
+
+    if (vece == MO_64) {
+        tcg_gen_sari_i64(d, a, c);
+        return;
+    }
+
+    s = tcg_temp_new_i64();
+    tcg_gen_shri_i64(d, a, c);
+    tcg_gen_andi_i64(s, d, s_mask);
+    tcg_gen_muli_i64(s, s, (2 << c) - 2);
+    tcg_gen_andi_i64(d, d, c_mask);
+    tcg_gen_or_i64(d, d, s);
+    tcg_temp_free_i64(s);
+}
+
+void tcg_gen_vec_add(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                     uint32_t aofs, uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_add_vec, base, dofs, aofs, bofs, oprsz, vece);
+    } else {
+        vec_expand3(gen_add64, vece, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+void tcg_gen_vec_sub(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                     uint32_t aofs, uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_sub_vec, base, dofs, aofs, bofs, oprsz, vece);
+    } else {
+        vec_expand3(gen_sub64, vece, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+void tcg_gen_vec_and(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                     uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_and_vec, base, dofs, aofs, bofs, oprsz, MO_64);
+    } else {
+        vec_expand3(gen_and64, MO_64, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+void tcg_gen_vec_or(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                    uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_or_vec, base, dofs, aofs, bofs, oprsz, MO_64);
+    } else {
+        vec_expand3(gen_or64, MO_64, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+void tcg_gen_vec_xor(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                     uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_xor_vec, base, dofs, aofs, bofs, oprsz, MO_64);
+    } else {
+        vec_expand3(gen_xor64, MO_64, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+void tcg_gen_vec_andc(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                      uint32_t bofs, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(INDEX_op_andc_vec, base, dofs, aofs, bofs, oprsz, MO_64);
+    } else {
+        vec_expand3(gen_andc64, MO_64, base, dofs, aofs, bofs, oprsz);
+    }
+}
+
+static void vec_gen_shift(TCGOpcode opc, VecGen2iFn *fn, unsigned vece,
+                          TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                          unsigned shift, uint32_t oprsz)
+{
+    assert(oprsz == 8 || oprsz == 16);
+    assert(shift < (8 << vece));
+    if (shift == 0) {
+        /* not all hosts can encode a right shift by zero */
+        if (dofs != aofs) {
+            tcg_gen_vec_or(base, dofs, aofs, aofs, oprsz);
+        }
+    } else if (TCG_TARGET_HAS_vec) {
+        vec_gen_op(opc, base, dofs, aofs, shift, oprsz, vece);
+    } else {
+        vec_expand2i(fn, vece, base, dofs, aofs, shift, oprsz);
+    }
+}
+
+void tcg_gen_vec_shli(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz)
+{
+    vec_gen_shift(INDEX_op_shli_vec, gen_shli64, vece, base, dofs, aofs,
+                  shift, oprsz);
+}
+
+void tcg_gen_vec_shri(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz)
+{
+    vec_gen_shift(INDEX_op_shri_vec, gen_shri64, vece, base, dofs, aofs,
+                  shift, oprsz);
+}
+
+void tcg_gen_vec_sari(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz)
+{
+    vec_gen_shift(INDEX_op_sari_vec, gen_sari64, vece, base, dofs, aofs,
+                  shift, oprsz);
+}
+
+void tcg_gen_vec_cmp(TCGCond cond, unsigned vece, TCGv_ptr base,
+                     uint32_t dofs, uint32_t aofs, uint32_t bofs,
+                     uint32_t oprsz)
+{
+    TCGv_i64 d, a, b, ta, tb;
+    unsigned esize = 8 << vece;
+    uint32_t i;
+    unsigned j;
+
+    assert(oprsz == 8 || oprsz == 16);
+    if (TCG_TARGET_HAS_vec && vece != MO_64) {
+        *tcg_ctx.gen_opc_ptr++ = INDEX_op_cmp_vec;
+        *tcg_ctx.gen_opparam_ptr++ = GET_TCGV_PTR(base);
+        *tcg_ctx.gen_opparam_ptr++ = dofs;
+        *tcg_ctx.gen_opparam_ptr++ = aofs;
+        *tcg_ctx.gen_opparam_ptr++ = bofs;
+        *tcg_ctx.gen_opparam_ptr++ = oprsz;
+        *tcg_ctx.gen_opparam_ptr++ = vece;
+        *tcg_ctx.gen_opparam_ptr++ = cond;
+        return;
+    }
+
+    d = tcg_temp_new_i64();
+    a = tcg_temp_new_i64();
+    b = tcg_temp_new_i64();
+    ta = tcg_temp_new_i64();
+    tb = tcg_temp_new_i64();
+
+    for (i = 0; i < oprsz; i += 8) {
+        tcg_gen_ld_i64(a, base, aofs + i);
+        tcg_gen_ld_i64(b, base, bofs + i);
+        if (vece == MO_64) {
+            tcg_gen_setcond_i64(cond, d, a, b);
+            tcg_gen_neg_i64(d, d);
+        } else {
+            tcg_gen_movi_i64(d, 0);
+            for (j = 0; j < 64; j += esize) {
+                if (is_unsigned_cond(cond)) {
+                    tcg_gen_shri_i64(ta, a, j);
+                    tcg_gen_andi_i64(ta, ta, lane_mask(vece));
+                    tcg_gen_shri_i64(tb, b, j);
+                    tcg_gen_andi_i64(tb, tb, lane_mask(vece));
+                } else {
+                    tcg_gen_shli_i64(ta, a, 64 - esize - j);
+                    tcg_gen_sari_i64(ta, ta, 64 - esize);
+                    tcg_gen_shli_i64(tb, b, 64 - esize - j);
+                    tcg_gen_sari_i64(tb, tb, 64 - esize);
+                }
+                tcg_gen_setcond_i64(cond, ta, ta, tb);
+                tcg_gen_neg_i64(ta, ta);
+                tcg_gen_andi_i64(ta, ta, lane_mask(vece) << j);
+                tcg_gen_or_i64(d, d, ta);
+            }
+        }
+        tcg_gen_st_i64(d, base, dofs + i);
+    }
+
+    tcg_temp_free_i64(d);
+    tcg_temp_free_i64(a);
+    tcg_temp_free_i64(b);
+    tcg_temp_free_i64(ta);
+    tcg_temp_free_i64(tb);
+}
+
+void tcg_gen_vec_dup_i64(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                         uint32_t oprsz, TCGv_i64 val)
+{
+    TCGv_i64 t = tcg_temp_new_i64();
+    uint32_t i;
+
+    assert(oprsz == 8 || oprsz == 16);
+    switch (vece) {
+    case MO_8:
+        tcg_gen_ext8u_i64(t, val);
+        tcg_gen_muli_i64(t, t, dup_const(MO_8, 1));
+        break;
+    case MO_16:
+        tcg_gen_ext16u_i64(t, val);
+        tcg_gen_muli_i64(t, t, dup_const(MO_16, 1));
+        break;
+    case MO_32:
+        tcg_gen_deposit_i64(t, val, val, 32, 32);
+        break;
+    default:
+        tcg_gen_mov_i64(t, val);
+        break;
+    }
+    for (i = 0; i < oprsz; i += 8) {
+        tcg_gen_st_i64(t, base, dofs + i);
+    }
+    tcg_temp_free_i64(t);
+}
+
+void tcg_gen_vec_dup_i32(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                         uint32_t oprsz, TCGv_i32 val)
+{
+    TCGv_i64 t = tcg_temp_new_i64();
+
+    assert(vece <= MO_32);
+    tcg_gen_extu_i32_i64(t, val);
+    tcg_gen_vec_dup_i64(vece, base, dofs, oprsz, t);
+    tcg_temp_free_i64(t);
+}
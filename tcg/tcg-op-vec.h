@@ -0,0 +1,70 @@
+/*
+ * Tiny Code Generator for QEMU - vector operations
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TCG_OP_VEC_H
+#define TCG_OP_VEC_H
+
+/* Element-wise operations on 8 or 16 byte vectors stored at byte offsets
+ * from BASE (normally cpu_env).  VECE is the element size, MO_8 .. MO_64.
+ * The vectors may be identical but must not otherwise overlap, and must
+ * not back a TCG global.
+ *
+ * Hosts with TCG_TARGET_HAS_vec compute them in SIMD registers; other
+ * hosts get an expansion working 64 bits at a time in integer registers.
+ */
+
+void tcg_gen_vec_add(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                     uint32_t aofs, uint32_t bofs, uint32_t oprsz);
+void tcg_gen_vec_sub(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                     uint32_t aofs, uint32_t bofs, uint32_t oprsz);
+
+void tcg_gen_vec_and(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                     uint32_t bofs, uint32_t oprsz);
+void tcg_gen_vec_or(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                    uint32_t bofs, uint32_t oprsz);
+void tcg_gen_vec_xor(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                     uint32_t bofs, uint32_t oprsz);
+void tcg_gen_vec_andc(TCGv_ptr base, uint32_t dofs, uint32_t aofs,
+                      uint32_t bofs, uint32_t oprsz);
+
+/* Shift counts must be less than the element size in bits */
+void tcg_gen_vec_shli(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz);
+void tcg_gen_vec_shri(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz);
+void tcg_gen_vec_sari(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                      uint32_t aofs, unsigned shift, uint32_t oprsz);
+
+/* Set each element of D to all ones if COND holds for the corresponding
+ * elements of A and B, to zero otherwise.  Without TCG_TARGET_HAS_vec
+ * elements narrower than 64 bits are compared one at a time.
+ */
+void tcg_gen_vec_cmp(TCGCond cond, unsigned vece, TCGv_ptr base,
+                     uint32_t dofs, uint32_t aofs, uint32_t bofs,
+                     uint32_t oprsz);
+
+/* Replicate the low element of VAL into every element of D */
+void tcg_gen_vec_dup_i32(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                         uint32_t oprsz, TCGv_i32 val);
+void tcg_gen_vec_dup_i64(unsigned vece, TCGv_ptr base, uint32_t dofs,
+                         uint32_t oprsz, TCGv_i64 val);
+
+#endif /* TCG_OP_VEC_H */
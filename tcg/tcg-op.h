@@ -2647,6 +2647,15 @@ static inline void tcg_gen_goto_tb(unsigned idx)
     tcg_gen_op1i(INDEX_op_goto_tb, idx);
 }
 
+/* Jump to the host code at @addr, typically the result of a TB lookup
+   helper; only available if TCG_TARGET_HAS_goto_ptr.  */
+static inline void tcg_gen_goto_ptr(TCGv_ptr addr)
+{
+    tcg_debug_assert(TCG_TARGET_HAS_goto_ptr);
+    *tcg_ctx.gen_opc_ptr++ = INDEX_op_goto_ptr;
+    *tcg_ctx.gen_opparam_ptr++ = GET_TCGV_PTR(addr);
+}
+
 
 void tcg_gen_qemu_ld_i32(TCGv_i32, TCGv, TCGArg, TCGMemOp);
 void tcg_gen_qemu_st_i32(TCGv_i32, TCGv, TCGArg, TCGMemOp);
@@ -2876,6 +2885,8 @@ static inline void tcg_gen_qemu_st64(TCGv_i64 arg, TCGv addr, int mem_index)
     tcg_gen_addi_i32(TCGV_PTR_TO_NAT(R), TCGV_PTR_TO_NAT(A), (B))
 # define tcg_gen_ext_i32_ptr(R, A) \
     tcg_gen_mov_i32(TCGV_PTR_TO_NAT(R), (A))
+# define tcg_gen_brcond_ptr(C, A, B, L) \
+    tcg_gen_brcond_i32((C), TCGV_PTR_TO_NAT(A), TCGV_PTR_TO_NAT(B), (L))
 #else
 # define tcg_gen_ld_ptr(R, A, O) \
     tcg_gen_ld_i64(TCGV_PTR_TO_NAT(R), (A), (O))
@@ -2887,4 +2898,6 @@ static inline void tcg_gen_qemu_st64(TCGv_i64 arg, TCGv addr, int mem_index)
     tcg_gen_addi_i64(TCGV_PTR_TO_NAT(R), TCGV_PTR_TO_NAT(A), (B))
 # define tcg_gen_ext_i32_ptr(R, A) \
     tcg_gen_ext_i32_i64(TCGV_PTR_TO_NAT(R), (A))
+# define tcg_gen_brcond_ptr(C, A, B, L) \
+    tcg_gen_brcond_i64((C), TCGV_PTR_TO_NAT(A), TCGV_PTR_TO_NAT(B), (L))
 #endif /* TCG_TARGET_REG_BITS == 32 */
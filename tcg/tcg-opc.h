@@ -180,6 +180,27 @@ DEF(debug_insn_start, 0, 0, 1, TCG_OPF_NOT_PRESENT)
 #endif
 DEF(exit_tb, 0, 0, 1, TCG_OPF_BB_END)
 DEF(goto_tb, 0, 0, 1, TCG_OPF_BB_END)
+DEF(goto_ptr, 0, 1, 0, TCG_OPF_BB_END | IMPL(TCG_TARGET_HAS_goto_ptr))
+
+/* Vector operations on memory addressed by the single input, normally
+   the env pointer: dst, a, b offsets, size in bytes (8 or 16), element
+   size as MO_8 .. MO_64.  Shifts take a constant count in place of b,
+   compares additionally take a TCGCond and only support elements of up
+   to 32 bits.  The memory must not back a TCG global.  */
+#define IMPL_VEC (TCG_OPF_SIDE_EFFECTS | IMPL(TCG_TARGET_HAS_vec))
+
+DEF(add_vec, 0, 1, 5, IMPL_VEC)
+DEF(sub_vec, 0, 1, 5, IMPL_VEC)
+DEF(and_vec, 0, 1, 5, IMPL_VEC)
+DEF(or_vec, 0, 1, 5, IMPL_VEC)
+DEF(xor_vec, 0, 1, 5, IMPL_VEC)
+DEF(andc_vec, 0, 1, 5, IMPL_VEC)
+DEF(shli_vec, 0, 1, 5, IMPL_VEC)
+DEF(shri_vec, 0, 1, 5, IMPL_VEC)
+DEF(sari_vec, 0, 1, 5, IMPL_VEC)
+DEF(cmp_vec, 0, 1, 6, IMPL_VEC)
+
+#undef IMPL_VEC
 
 #define IMPL_NEW_LDST \
     (TCG_OPF_CALL_CLOBBER | TCG_OPF_SIDE_EFFECTS \
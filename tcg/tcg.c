@@ -106,6 +106,11 @@ static int tcg_target_const_match(tcg_target_long val,
 static void tcg_out_tb_init(TCGContext *s);
 static void tcg_out_tb_finalize(TCGContext *s);
 
+/* Forward declarations for functions declared here and used in
+   tcg-target.c. */
+static void tcg_out_pinned_ld(TCGContext *s) __attribute__((unused));
+static void tcg_out_pinned_st(TCGContext *s) __attribute__((unused));
+
 
 TCGOpDef tcg_op_defs[] = {
 #define DEF(s, oargs, iargs, cargs, flags) { #s, oargs, iargs, cargs, iargs + oargs + cargs, flags },
@@ -257,6 +262,29 @@ void tcg_pool_reset(TCGContext *s)
     s->pool_current = NULL;
 }
 
+void tcg_pool_delete(TCGContext *s)
+{
+    TCGPool *p, *t;
+
+    tcg_pool_reset(s);
+    for (p = s->pool_first; p; p = t) {
+        t = p->next;
+        g_free(p);
+    }
+    s->pool_first = NULL;
+}
+
+/* Start a context for a new thread from its parent's globals, helpers
+   and code buffer.  The pool is per-thread and starts out empty.  */
+void tcg_context_clone(TCGContext *s, const TCGContext *parent)
+{
+    *s = *parent;
+    s->pool_cur = s->pool_end = NULL;
+    s->pool_first = s->pool_current = s->pool_first_large = NULL;
+    s->labels = NULL;
+    s->be = NULL;
+}
+
 #include "helper.h"
 
 typedef struct TCGHelperInfo {
@@ -336,6 +364,7 @@ void tcg_prologue_init(TCGContext *s)
     s->code_ptr = s->code_buf;
     tcg_target_qemu_prologue(s);
     flush_icache_range((uintptr_t)s->code_buf, (uintptr_t)s->code_ptr);
+    s->prologue_done = true;
 
 #ifdef DEBUG_DISAS
     if (qemu_loglevel_mask(CPU_LOG_TB_OUT_ASM)) {
@@ -498,6 +527,58 @@ TCGv_i64 tcg_global_mem_new_i64(int reg, intptr_t offset, const char *name)
     return MAKE_TCGV_I64(idx);
 }
 
+static inline int tcg_global_mem_new_pinned_internal(TCGType type, int reg,
+                                                     intptr_t offset,
+                                                     const char *name)
+{
+    int idx = tcg_global_mem_new_internal(type, reg, offset, name);
+#ifdef TCG_TARGET_NB_PINNED_REGS
+    TCGContext *s = &tcg_ctx;
+    TCGTemp *ts = &s->temps[idx];
+    int hreg;
+
+    /* A 64-bit global split in two halves on a 32-bit host stays in
+       memory, as does anything not addressed through env.  */
+    if (reg != TCG_AREG0 || ts->type != type ||
+        s->nb_pinned == TCG_TARGET_NB_PINNED_REGS) {
+        return idx;
+    }
+    hreg = tcg_target_pinned_regs[s->nb_pinned++];
+    assert(!tcg_regset_test_reg(s->reserved_regs, hreg));
+    assert(!tcg_regset_test_reg(tcg_target_call_clobber_regs, hreg));
+
+    ts->fixed_reg = 1;
+    ts->pinned = 1;
+    ts->reg = hreg;
+    tcg_regset_set_reg(s->reserved_regs, hreg);
+
+    /* The prologue and epilogue move pinned globals in and out of their
+       registers, so they have to be regenerated.  Nothing can have been
+       translated yet that branches to the old epilogue.  */
+    if (s->prologue_done) {
+        assert(tb_ctx.nb_tbs == 0);
+        tcg_prologue_init(s);
+    }
+#endif
+    return idx;
+}
+
+TCGv_i32 tcg_global_mem_new_pinned_i32(int reg, intptr_t offset,
+                                       const char *name)
+{
+    int idx = tcg_global_mem_new_pinned_internal(TCG_TYPE_I32, reg, offset,
+                                                 name);
+    return MAKE_TCGV_I32(idx);
+}
+
+TCGv_i64 tcg_global_mem_new_pinned_i64(int reg, intptr_t offset,
+                                       const char *name)
+{
+    int idx = tcg_global_mem_new_pinned_internal(TCG_TYPE_I64, reg, offset,
+                                                 name);
+    return MAKE_TCGV_I64(idx);
+}
+
 static inline int tcg_temp_new_internal(TCGType type, int temp_local)
 {
     TCGContext *s = &tcg_ctx;
@@ -1000,6 +1081,8 @@ static void tcg_reg_alloc_start(TCGContext *s)
         ts = &s->temps[i];
         if (ts->fixed_reg) {
             ts->val_type = TEMP_VAL_REG;
+            /* we may have been entered through a chained jump */
+            ts->mem_coherent = 0;
         } else {
             ts->val_type = TEMP_VAL_MEM;
         }
@@ -1390,6 +1473,28 @@ void tcg_add_target_add_op_defs(const TCGTargetOpDef *tdefs)
 #endif
 }
 
+bool tcg_env_slot(TCGContext *s, TCGArg base, tcg_target_long ofs, int size)
+{
+    TCGTemp *ts = &s->temps[base];
+    int i;
+
+    if (base >= s->nb_globals || !ts->fixed_reg || ts->reg != TCG_AREG0) {
+        return false;
+    }
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->fixed_reg && !ts->pinned) {
+            continue;
+        }
+        if (ts->mem_reg == TCG_AREG0
+            && ts->mem_offset < ofs + size
+            && ofs < ts->mem_offset + (ts->type == TCG_TYPE_I32 ? 4 : 8)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 #ifdef USE_LIVENESS_ANALYSIS
 
 /* set a nop for an operation using 'nb_args' */
@@ -1429,6 +1534,81 @@ static inline void tcg_la_bb_end(TCGContext *s, uint8_t *dead_temps,
     }
 }
 
+/* Env slots that are overwritten before being read again.  Since the
+   liveness analysis walks the ops backwards, a store to such a slot is
+   dead.  Anything that may read env memory or leave the TB empties the
+   set.  */
+typedef struct TCGDeadMem {
+    tcg_target_long start, end;
+} TCGDeadMem;
+
+#define TCG_MAX_DEAD_MEMS 16
+
+/* Update DEAD for OP and return true if OP is a dead store.  */
+static bool tcg_la_dead_store(TCGContext *s, TCGOpcode op,
+                              const TCGOpDef *def, const TCGArg *args,
+                              TCGDeadMem *dead, int *nb_dead)
+{
+    tcg_target_long start, end;
+    int i;
+
+    if (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS)) {
+        *nb_dead = 0;
+        return false;
+    }
+
+    switch (op) {
+    case INDEX_op_ld8u_i32:
+    case INDEX_op_ld8s_i32:
+    case INDEX_op_ld16u_i32:
+    case INDEX_op_ld16s_i32:
+    case INDEX_op_ld_i32:
+    case INDEX_op_ld8u_i64:
+    case INDEX_op_ld8s_i64:
+    case INDEX_op_ld16u_i64:
+    case INDEX_op_ld16s_i64:
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_ld_i64:
+        if (!s->temps[args[1]].fixed_reg
+            || s->temps[args[1]].reg != TCG_AREG0) {
+            *nb_dead = 0;
+            return false;
+        }
+        /* No load is wider than 8 bytes.  */
+        start = args[2];
+        end = start + 8;
+        for (i = 0; i < *nb_dead; i++) {
+            if (dead[i].start < end && start < dead[i].end) {
+                dead[i--] = dead[--*nb_dead];
+            }
+        }
+        return false;
+
+    case INDEX_op_st_i32:
+    case INDEX_op_st_i64:
+        start = args[2];
+        end = start + (op == INDEX_op_st_i32 ? 4 : 8);
+        if (!tcg_env_slot(s, args[1], start, end - start)) {
+            return false;
+        }
+        for (i = 0; i < *nb_dead; i++) {
+            if (dead[i].start <= start && end <= dead[i].end) {
+                return true;
+            }
+        }
+        if (*nb_dead < TCG_MAX_DEAD_MEMS) {
+            dead[*nb_dead].start = start;
+            dead[*nb_dead].end = end;
+            (*nb_dead)++;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
 /* Liveness analysis : update the opc_dead_args array to tell if a
    given input arguments is dead. Instructions updating dead
    temporaries are removed. */
@@ -1442,6 +1622,8 @@ static void tcg_liveness_analysis(TCGContext *s)
     uint16_t dead_args;
     uint8_t sync_args;
     bool have_op_new2;
+    TCGDeadMem dead_mems[TCG_MAX_DEAD_MEMS];
+    int nb_dead_mems = 0;
     
     s->gen_opc_ptr++; /* skip end */
 
@@ -1471,6 +1653,9 @@ static void tcg_liveness_analysis(TCGContext *s)
                 args++;
                 call_flags = args[nb_oargs + nb_iargs];
 
+                /* the helper may read any env field */
+                nb_dead_mems = 0;
+
                 /* pure functions can be removed if their result is not
                    used */
                 if (call_flags & TCG_CALL_NO_SIDE_EFFECTS) {
@@ -1632,6 +1817,15 @@ static void tcg_liveness_analysis(TCGContext *s)
             nb_iargs = def->nb_iargs;
             nb_oargs = def->nb_oargs;
 
+            if (tcg_la_dead_store(s, op, def, args,
+                                  dead_mems, &nb_dead_mems)) {
+                tcg_set_nop(s, s->gen_opc_buf + op_index, args, def->nb_args);
+#ifdef CONFIG_PROFILER
+                s->env_st_del_count++;
+#endif
+                break;
+            }
+
             /* Test if the operation can be removed because all
                its outputs are dead. We assume that nb_oargs == 0
                implies side effects */
@@ -1814,8 +2008,8 @@ static inline void tcg_reg_sync(TCGContext *s, int reg)
             temp_allocate_frame(s, temp);
         }
         tcg_out_st(s, ts->type, reg, ts->mem_reg, ts->mem_offset);
+        ts->mem_coherent = 1;
     }
-    ts->mem_coherent = 1;
 }
 
 /* free register 'reg' by spilling the corresponding temporary if necessary */
@@ -1919,6 +2113,78 @@ static inline void temp_save(TCGContext *s, int temp, TCGRegSet allocated_regs)
 #endif
 }
 
+/* Pinned globals are kept in their host register for the whole time
+   generated code runs: the prologue loads them and the epilogue stores
+   them back, so exit_tb and goto_tb need nothing.  Memory only has to be
+   brought up to date where C code can look at it without going through
+   the epilogue, i.e. before helper calls and ops that may longjmp out.  */
+static void pinned_sync(TCGContext *s)
+{
+    TCGTemp *ts;
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->pinned && !ts->mem_coherent) {
+            tcg_out_st(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+            ts->mem_coherent = 1;
+        }
+    }
+}
+
+/* reload pinned globals after a helper that may have modified them */
+static void pinned_reload(TCGContext *s)
+{
+    TCGTemp *ts;
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->pinned) {
+            tcg_out_ld(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+            ts->mem_coherent = 1;
+        }
+    }
+}
+
+/* at a label, we can not tell whether the memory copy is up to date */
+static void pinned_invalidate(TCGContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        if (s->temps[i].pinned) {
+            s->temps[i].mem_coherent = 0;
+        }
+    }
+}
+
+static void tcg_out_pinned_ld(TCGContext *s)
+{
+    TCGTemp *ts;
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->pinned) {
+            tcg_out_ld(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+        }
+    }
+}
+
+static void tcg_out_pinned_st(TCGContext *s)
+{
+    TCGTemp *ts;
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        ts = &s->temps[i];
+        if (ts->pinned) {
+            tcg_out_st(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+        }
+    }
+}
+
 /* save globals to their canonical location and assume they can be
    modified be the following code. 'allocated_regs' is used in case a
    temporary registers needs to be allocated to store a constant. */
@@ -1946,6 +2212,7 @@ static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
         temp_sync(s, i, allocated_regs);
 #endif
     }
+    pinned_sync(s);
 }
 
 /* at the end of a basic block, we assume all temporaries are dead and
@@ -1989,6 +2256,7 @@ static void tcg_reg_alloc_movi(TCGContext *s, const TCGArg *args,
         /* for fixed registers, we do not do any constant
            propagation */
         tcg_out_movi(s, ots->type, ots->reg, val);
+        ots->mem_coherent = 0;
     } else {
         /* The movi is not explicitly generated here */
         if (ots->val_type == TEMP_VAL_REG)
@@ -2235,10 +2503,12 @@ static void tcg_reg_alloc_op(TCGContext *s,
     for(i = 0; i < nb_oargs; i++) {
         ts = &s->temps[args[i]];
         reg = new_args[i];
-        if (ts->fixed_reg && ts->reg != reg) {
-            tcg_out_mov(s, ts->type, ts->reg, reg);
-        }
-        if (NEED_SYNC_ARG(i)) {
+        if (ts->fixed_reg) {
+            if (ts->reg != reg) {
+                tcg_out_mov(s, ts->type, ts->reg, reg);
+            }
+            ts->mem_coherent = 0;
+        } else if (NEED_SYNC_ARG(i)) {
             tcg_reg_sync(s, reg);
         }
         if (IS_DEAD_ARG(i)) {
@@ -2401,10 +2671,15 @@ static int tcg_reg_alloc_call(TCGContext *s, const TCGOpDef *def,
         sync_globals(s, allocated_regs);
     } else {
         save_globals(s, allocated_regs);
+        pinned_sync(s);
     }
 
     tcg_out_op(s, opc, &func_arg, &const_func_arg);
 
+    if (!(flags & (TCG_CALL_NO_READ_GLOBALS | TCG_CALL_NO_WRITE_GLOBALS))) {
+        pinned_reload(s);
+    }
+
     /* assign output registers and emit moves if needed */
     for(i = 0; i < nb_oargs; i++) {
         arg = args[i];
@@ -2415,6 +2690,7 @@ static int tcg_reg_alloc_call(TCGContext *s, const TCGOpDef *def,
             if (ts->reg != reg) {
                 tcg_out_mov(s, ts->type, ts->reg, reg);
             }
+            ts->mem_coherent = 0;
         } else {
             if (ts->val_type == TEMP_VAL_REG) {
                 s->reg_to_temp[ts->reg] = -1;
@@ -2544,6 +2820,7 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
             break;
         case INDEX_op_set_label:
             tcg_reg_alloc_bb_end(s, s->reserved_regs);
+            pinned_invalidate(s);
             tcg_out_label(s, args[0], s->code_ptr);
             break;
         case INDEX_op_call:
@@ -2632,6 +2909,12 @@ void tcg_dump_info(FILE *f, fprintf_function cpu_fprintf)
     cpu_fprintf(f, "deleted ops/TB      %0.2f\n",
                 s->tb_count ? 
                 (double)s->del_op_count / s->tb_count : 0);
+    cpu_fprintf(f, "  env loads fwd/TB  %0.2f\n",
+                s->tb_count ?
+                (double)s->env_ld_del_count / s->tb_count : 0);
+    cpu_fprintf(f, "  env stores del/TB %0.2f\n",
+                s->tb_count ?
+                (double)s->env_st_del_count / s->tb_count : 0);
     cpu_fprintf(f, "avg temps/TB        %0.2f max=%d\n",
                 s->tb_count ? 
                 (double)s->temp_count / s->tb_count : 0,
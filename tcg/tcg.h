@@ -439,6 +439,9 @@ typedef struct TCGTemp {
                                   basic blocks. Otherwise, it is not
                                   preserved across basic blocks. */
     unsigned int temp_allocated:1; /* never used for code gen */
+    unsigned int pinned:1; /* fixed_reg global that also has a canonical
+                              location in memory, see
+                              tcg_global_mem_new_pinned_i32() */
     const char *name;
 } TCGTemp;
 
@@ -455,6 +458,7 @@ struct TCGContext {
     int nb_labels;
     int nb_globals;
     int nb_temps;
+    int nb_pinned;
 
     /* goto_tb support */
     uint8_t *code_buf;
@@ -493,6 +497,8 @@ struct TCGContext {
     int64_t temp_count;
     int temp_count_max;
     int64_t del_op_count;
+    int64_t env_ld_del_count; /* env loads replaced by moves */
+    int64_t env_st_del_count; /* redundant or dead env stores */
     int64_t code_in_len;
     int64_t code_out_len;
     int64_t interm_time;
@@ -520,19 +526,25 @@ struct TCGContext {
     /* Code generation */
     int code_gen_max_blocks;
     uint8_t *code_gen_prologue;
+    void *code_gen_epilogue;        /* goto_ptr target for a lookup miss */
+    bool prologue_done;
     uint8_t *code_gen_buffer;
     size_t code_gen_buffer_size;
-    /* threshold to flush the translated code buffer */
-    size_t code_gen_buffer_max_size;
-    uint8_t *code_gen_ptr;
-
-    TBContext tb_ctx;
 
     /* The TCGBackendData structure is private to tcg-target.c.  */
     struct TCGBackendData *be;
 };
 
-extern TCGContext tcg_ctx;
+/* In user mode every guest thread translates with its own context;
+   state that lives across a single translation must use TCG_THREAD
+   too.  */
+#ifdef CONFIG_USER_ONLY
+#define TCG_THREAD __thread
+#else
+#define TCG_THREAD
+#endif
+
+extern TCG_THREAD TCGContext tcg_ctx;
 
 /* pool based memory allocation */
 
@@ -556,6 +568,7 @@ static inline void *tcg_malloc(int size)
 }
 
 void tcg_context_init(TCGContext *s);
+void tcg_context_clone(TCGContext *s, const TCGContext *parent);
 void tcg_prologue_init(TCGContext *s);
 void tcg_func_start(TCGContext *s);
 
@@ -566,6 +579,17 @@ void tcg_set_frame(TCGContext *s, int reg, intptr_t start, intptr_t size);
 
 TCGv_i32 tcg_global_reg_new_i32(int reg, const char *name);
 TCGv_i32 tcg_global_mem_new_i32(int reg, intptr_t offset, const char *name);
+/* Like tcg_global_mem_new_i32(), but if the host has a callee-saved
+ * register to spare, keep the value in it for as long as generated code
+ * runs, including across chained jumps between TBs.  The prologue loads
+ * pinned globals and the epilogue stores them back; in between, memory
+ * is only updated before helper calls and ops that may raise exceptions.
+ * REG must be TCG_AREG0, and no other global may alias the same field.
+ * Pinned globals must be created before any code is translated; call in
+ * order of decreasing benefit, the rest fall back to plain globals.
+ */
+TCGv_i32 tcg_global_mem_new_pinned_i32(int reg, intptr_t offset,
+                                       const char *name);
 TCGv_i32 tcg_temp_new_internal_i32(int temp_local);
 static inline TCGv_i32 tcg_temp_new_i32(void)
 {
@@ -580,6 +604,8 @@ char *tcg_get_arg_str_i32(TCGContext *s, char *buf, int buf_size, TCGv_i32 arg);
 
 TCGv_i64 tcg_global_reg_new_i64(int reg, const char *name);
 TCGv_i64 tcg_global_mem_new_i64(int reg, intptr_t offset, const char *name);
+TCGv_i64 tcg_global_mem_new_pinned_i64(int reg, intptr_t offset,
+                                       const char *name);
 TCGv_i64 tcg_temp_new_internal_i64(int temp_local);
 static inline TCGv_i64 tcg_temp_new_i64(void)
 {
@@ -707,6 +733,10 @@ void tcg_gen_shifti_i64(TCGv_i64 ret, TCGv_i64 arg1,
 TCGArg *tcg_optimize(TCGContext *s, uint16_t *tcg_opc_ptr, TCGArg *args,
                      TCGOpDef *tcg_op_def);
 
+/* Return true if SIZE bytes at BASE + OFS are in env and do not hold a
+   global, so that the optimizer may track loads and stores to them.  */
+bool tcg_env_slot(TCGContext *s, TCGArg base, tcg_target_long ofs, int size);
+
 /* only used for debugging purposes */
 void tcg_dump_ops(TCGContext *s);
 
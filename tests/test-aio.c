@@ -492,6 +492,68 @@ static void test_timer_schedule(void)
 
 #endif /* !_WIN32 */
 
+#define TIMER_ORDER_COUNT 64
+
+typedef struct {
+    QEMUTimer timer;
+    int64_t expire;
+    int armed;      /* order in which the timer was last armed */
+} TimerOrderData;
+
+static int timer_order_fired[TIMER_ORDER_COUNT];
+static int timer_order_n;
+
+static void timer_order_cb(void *opaque)
+{
+    timer_order_fired[timer_order_n++] = (uintptr_t)opaque;
+}
+
+static void test_timer_order(void)
+{
+    static TimerOrderData data[TIMER_ORDER_COUNT];
+    QEMUTimerList *tl = ctx->tlg.tl[QEMU_CLOCK_REALTIME];
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int armed = 0, expected = 0;
+    int i;
+
+    for (i = 0; i < TIMER_ORDER_COUNT; i++) {
+        aio_timer_init(ctx, &data[i].timer, QEMU_CLOCK_REALTIME,
+                       SCALE_NS, timer_order_cb, (void *)(uintptr_t)i);
+        data[i].expire = now - 1000 + (i * 7) % 16;
+        data[i].armed = armed++;
+        timer_mod_ns(&data[i].timer, data[i].expire);
+    }
+    /* Move some timers, both earlier and later, and drop others */
+    for (i = 0; i < TIMER_ORDER_COUNT; i += 5) {
+        data[i].expire = now - 1000 + (i * 3) % 16;
+        data[i].armed = armed++;
+        timer_mod_ns(&data[i].timer, data[i].expire);
+    }
+    for (i = 3; i < TIMER_ORDER_COUNT; i += 9) {
+        timer_del(&data[i].timer);
+        g_assert(!timer_pending(&data[i].timer));
+        data[i].armed = -1;
+    }
+    for (i = 0; i < TIMER_ORDER_COUNT; i++) {
+        expected += data[i].armed >= 0;
+    }
+
+    timer_order_n = 0;
+    g_assert(timerlist_run_timers(tl));
+    g_assert_cmpint(timer_order_n, ==, expected);
+    g_assert(!timerlist_has_timers(tl));
+
+    /* Earlier expiry first, equal expiry in the order they were armed */
+    for (i = 1; i < timer_order_n; i++) {
+        TimerOrderData *a = &data[timer_order_fired[i - 1]];
+        TimerOrderData *b = &data[timer_order_fired[i]];
+
+        g_assert(a->armed >= 0 && b->armed >= 0);
+        g_assert(a->expire < b->expire ||
+                 (a->expire == b->expire && a->armed < b->armed));
+    }
+}
+
 /* Now the same tests, using the context as a GSource.  They are
  * very similar to the ones above, with g_main_context_iteration
  * replacing aio_poll.  However:
@@ -860,6 +922,7 @@ int main(int argc, char **argv)
 #if !defined(_WIN32)
     g_test_add_func("/aio/timer/schedule",          test_timer_schedule);
 #endif
+    g_test_add_func("/aio/timer/order",             test_timer_order);
 
     g_test_add_func("/aio-gsource/notify",                  test_source_notify);
     g_test_add_func("/aio-gsource/flush",                   test_source_flush);
@@ -202,6 +202,60 @@ static void test_cancel(void)
     }
 }
 
+static void test_stats(void)
+{
+    ThreadPoolStats before, after;
+    uint64_t waited = 0, ran = 0;
+    int i;
+
+    thread_pool_get_stats(pool, &before);
+    test_submit_many();
+    thread_pool_get_stats(pool, &after);
+
+    g_assert_cmpint(after.submitted - before.submitted, ==, 100);
+    g_assert_cmpint(after.completed - before.completed, ==, 100);
+    g_assert_cmpint(after.queue_depth, ==, 0);
+    g_assert_cmpint(after.max_queue_depth, >=, 1);
+    for (i = 0; i < THREAD_POOL_HIST_BUCKETS; i++) {
+        waited += after.wait_hist[i] - before.wait_hist[i];
+        ran += after.run_hist[i] - before.run_hist[i];
+    }
+    g_assert_cmpint(waited, ==, 100);
+    g_assert_cmpint(ran, ==, 100);
+}
+
+static void test_idle_reap(void)
+{
+    ThreadPool *reap_pool = thread_pool_new(ctx);
+    WorkerTestData data[20];
+    ThreadPoolStats stats;
+    int i;
+
+    /* Grow the pool, then let surplus workers time out.  */
+    thread_pool_set_params(reap_pool, 2, 8, 10);
+    for (i = 0; i < 20; i++) {
+        data[i].n = 0;
+        data[i].ret = -EINPROGRESS;
+        thread_pool_submit_aio(reap_pool, worker_cb, &data[i],
+                               done_cb, &data[i]);
+    }
+
+    active = 20;
+    while (active > 0) {
+        aio_poll(ctx, true);
+    }
+    while (aio_poll(ctx, false)) {
+        /* Let the thread creation bottom half run.  */
+    }
+    g_usleep(200000);
+
+    thread_pool_get_stats(reap_pool, &stats);
+    g_assert_cmpint(stats.cur_threads, ==, 2);
+    g_assert_cmpint(stats.idle_threads, ==, 2);
+
+    thread_pool_free(reap_pool);
+}
+
 int main(int argc, char **argv)
 {
     int ret;
@@ -217,6 +271,8 @@ int main(int argc, char **argv)
     g_test_add_func("/thread-pool/submit-co", test_submit_co);
     g_test_add_func("/thread-pool/submit-many", test_submit_many);
     g_test_add_func("/thread-pool/cancel", test_cancel);
+    g_test_add_func("/thread-pool/stats", test_stats);
+    g_test_add_func("/thread-pool/idle-reap", test_idle_reap);
 
     ret = g_test_run();
 
@@ -24,6 +24,7 @@
 #include "qemu/event_notifier.h"
 #include "block/thread-pool.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 
 static void do_spawn_thread(ThreadPool *pool);
 
@@ -49,6 +50,9 @@ struct ThreadPoolElement {
     enum ThreadState state;
     int ret;
 
+    /* Host monotonic timestamp taken at submission, protected by lock.  */
+    int64_t submit_time;
+
     /* Access to this list is protected by lock.  */
     QTAILQ_ENTRY(ThreadPoolElement) reqs;
 
@@ -63,7 +67,6 @@ struct ThreadPool {
     QemuCond check_cancel;
     QemuCond worker_stopped;
     QemuSemaphore sem;
-    int max_threads;
     QEMUBH *new_thread_bh;
 
     /* The following variables are only accessed from one AioContext. */
@@ -77,8 +80,25 @@ struct ThreadPool {
     int pending_threads; /* threads created but not running yet */
     int pending_cancellations; /* whether we need a cond_broadcast */
     bool stopping;
+    int min_threads;
+    int max_threads;
+    int idle_timeout;    /* milliseconds before an idle worker exits */
+    ThreadPoolStats stats;
 };
 
+/* Bucket i counts latencies in [2^(i-1), 2^i) microseconds.  */
+static void thread_pool_hist_add(uint64_t *hist, int64_t ns)
+{
+    int64_t us = ns / 1000;
+    int bucket = 0;
+
+    while (us > 0 && bucket < THREAD_POOL_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    hist[bucket]++;
+}
+
 static void *worker_thread(void *opaque)
 {
     ThreadPool *pool = opaque;
@@ -89,15 +109,23 @@ static void *worker_thread(void *opaque)
 
     while (!pool->stopping) {
         ThreadPoolElement *req;
+        int64_t start;
         int ret;
 
+        /* Workers beyond min_threads exit once they have been idle for
+         * idle_timeout milliseconds.
+         */
         do {
+            int timeout = pool->idle_timeout;
+
             pool->idle_threads++;
             qemu_mutex_unlock(&pool->lock);
-            ret = qemu_sem_timedwait(&pool->sem, 10000);
+            ret = qemu_sem_timedwait(&pool->sem, timeout);
             qemu_mutex_lock(&pool->lock);
             pool->idle_threads--;
-        } while (ret == -1 && !QTAILQ_EMPTY(&pool->request_list));
+        } while (ret == -1 && !pool->stopping &&
+                 (!QTAILQ_EMPTY(&pool->request_list) ||
+                  pool->cur_threads <= pool->min_threads));
         if (ret == -1 || pool->stopping) {
             break;
         }
@@ -105,16 +133,23 @@ static void *worker_thread(void *opaque)
         req = QTAILQ_FIRST(&pool->request_list);
         QTAILQ_REMOVE(&pool->request_list, req, reqs);
         req->state = THREAD_ACTIVE;
+        start = get_clock();
+        pool->stats.queue_depth--;
+        thread_pool_hist_add(pool->stats.wait_hist, start - req->submit_time);
         qemu_mutex_unlock(&pool->lock);
 
         ret = req->func(req->arg);
 
+        /* Account for the request before it can be seen as done.  */
+        qemu_mutex_lock(&pool->lock);
+        pool->stats.completed++;
+        thread_pool_hist_add(pool->stats.run_hist, get_clock() - start);
+
         req->ret = ret;
         /* Write ret before state.  */
         smp_wmb();
         req->state = THREAD_DONE;
 
-        qemu_mutex_lock(&pool->lock);
         if (pool->pending_cancellations) {
             qemu_cond_broadcast(&pool->check_cancel);
         }
@@ -214,6 +249,7 @@ static void thread_pool_cancel(BlockDriverAIOCB *acb)
          */
         qemu_sem_timedwait(&pool->sem, 0) == 0) {
         QTAILQ_REMOVE(&pool->request_list, elem, reqs);
+        pool->stats.queue_depth--;
         elem->state = THREAD_CANCELED;
         event_notifier_set(&pool->notifier);
     } else {
@@ -252,6 +288,11 @@ BlockDriverAIOCB *thread_pool_submit_aio(ThreadPool *pool,
         spawn_thread(pool);
     }
     QTAILQ_INSERT_TAIL(&pool->request_list, req, reqs);
+    req->submit_time = get_clock();
+    pool->stats.submitted++;
+    if (++pool->stats.queue_depth > pool->stats.max_queue_depth) {
+        pool->stats.max_queue_depth = pool->stats.queue_depth;
+    }
     qemu_mutex_unlock(&pool->lock);
     qemu_sem_post(&pool->sem);
     return &req->common;
@@ -298,7 +339,9 @@ static void thread_pool_init_one(ThreadPool *pool, AioContext *ctx)
     qemu_cond_init(&pool->check_cancel);
     qemu_cond_init(&pool->worker_stopped);
     qemu_sem_init(&pool->sem, 0);
-    pool->max_threads = 64;
+    pool->min_threads = 0;
+    pool->max_threads = THREAD_POOL_DEFAULT_MAX_THREADS;
+    pool->idle_timeout = THREAD_POOL_DEFAULT_IDLE_TIMEOUT;
     pool->new_thread_bh = aio_bh_new(ctx, spawn_thread_bh_fn, pool);
 
     QLIST_INIT(&pool->head);
@@ -307,6 +350,45 @@ static void thread_pool_init_one(ThreadPool *pool, AioContext *ctx)
     aio_set_event_notifier(ctx, &pool->notifier, event_notifier_ready);
 }
 
+void thread_pool_set_params(ThreadPool *pool, int min_threads,
+                            int max_threads, int idle_timeout)
+{
+    assert(min_threads >= 0 && max_threads > 0);
+    assert(min_threads <= max_threads && idle_timeout > 0);
+
+    qemu_mutex_lock(&pool->lock);
+    pool->min_threads = min_threads;
+    pool->max_threads = max_threads;
+    pool->idle_timeout = idle_timeout;
+
+    /* Start the reserve now so that the first requests do not pay for
+     * thread creation.  Surplus workers are reaped by their idle timeout.
+     */
+    while (pool->cur_threads < pool->min_threads) {
+        spawn_thread(pool);
+    }
+    qemu_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_get_params(ThreadPool *pool, int *min_threads,
+                            int *max_threads, int *idle_timeout)
+{
+    qemu_mutex_lock(&pool->lock);
+    *min_threads = pool->min_threads;
+    *max_threads = pool->max_threads;
+    *idle_timeout = pool->idle_timeout;
+    qemu_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_get_stats(ThreadPool *pool, ThreadPoolStats *stats)
+{
+    qemu_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    stats->cur_threads = pool->cur_threads;
+    stats->idle_threads = pool->idle_threads;
+    qemu_mutex_unlock(&pool->lock);
+}
+
 ThreadPool *thread_pool_new(AioContext *ctx)
 {
     ThreadPool *pool = g_new(ThreadPool, 1);
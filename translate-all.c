@@ -59,6 +59,10 @@
 #include "exec/cputlb.h"
 #include "translate-all.h"
 #include "qemu/timer.h"
+#include "qemu/atomic.h"
+#if !defined(CONFIG_USER_ONLY)
+#include "qmp-commands.h"
+#endif
 
 //#define DEBUG_TB_INVALIDATE
 //#define DEBUG_FLUSH
@@ -123,7 +127,16 @@ uintptr_t qemu_host_page_mask;
 static void *l1_map[V_L1_SIZE];
 
 /* code generation context */
-TCGContext tcg_ctx;
+TCG_THREAD TCGContext tcg_ctx;
+
+/* translation blocks, shared by all the code generation contexts */
+TBContext tb_ctx;
+
+/* region this thread is generating code into, see tb_gen_code_abort() */
+static TCG_THREAD TBRegion *tb_gen_region;
+
+bool tb_profile_enabled;
+int tb_hot_exit_count;
 
 static void tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
                          tb_page_addr_t phys_page2);
@@ -380,6 +393,10 @@ static void page_init(void)
 #endif
 }
 
+/* Lookups walk the map without a lock.  Threads that race to fill the
+ * same slot both allocate, and the loser of the compare-and-swap frees
+ * its copy, so user-mode threads never serialize on the map itself.
+ */
 static PageDesc *page_find_alloc(tb_page_addr_t index, int alloc)
 {
     PageDesc *pd;
@@ -393,9 +410,11 @@ static PageDesc *page_find_alloc(tb_page_addr_t index, int alloc)
         P = mmap(NULL, SIZE, PROT_READ | PROT_WRITE,    \
                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);   \
     } while (0)
+# define FREE(P, SIZE) munmap(P, SIZE)
 #else
 # define ALLOC(P, SIZE) \
     do { P = g_malloc0(SIZE); } while (0)
+# define FREE(P, SIZE) g_free(P)
 #endif
 
     /* Level 1.  Always allocated.  */
@@ -403,29 +422,44 @@ static PageDesc *page_find_alloc(tb_page_addr_t index, int alloc)
 
     /* Level 2..N-1.  */
     for (i = V_L1_SHIFT / V_L2_BITS - 1; i > 0; i--) {
-        void **p = *lp;
+        void **p = atomic_read(lp);
 
         if (p == NULL) {
+            void **old;
+
             if (!alloc) {
                 return NULL;
             }
             ALLOC(p, sizeof(void *) * V_L2_SIZE);
-            *lp = p;
+            old = atomic_cmpxchg(lp, NULL, p);
+            if (old) {
+                FREE(p, sizeof(void *) * V_L2_SIZE);
+                p = old;
+            }
         }
+        smp_read_barrier_depends();
 
         lp = p + ((index >> (i * V_L2_BITS)) & (V_L2_SIZE - 1));
     }
 
-    pd = *lp;
+    pd = atomic_read(lp);
     if (pd == NULL) {
+        PageDesc *old;
+
         if (!alloc) {
             return NULL;
         }
         ALLOC(pd, sizeof(PageDesc) * V_L2_SIZE);
-        *lp = pd;
+        old = atomic_cmpxchg(lp, NULL, pd);
+        if (old) {
+            FREE(pd, sizeof(PageDesc) * V_L2_SIZE);
+            pd = old;
+        }
     }
+    smp_read_barrier_depends();
 
 #undef ALLOC
+#undef FREE
 
     return pd + (index & (V_L2_SIZE - 1));
 }
@@ -437,6 +471,7 @@ static inline PageDesc *page_find(tb_page_addr_t index)
 
 #if !defined(CONFIG_USER_ONLY)
 #define mmap_lock() do { } while (0)
+#define mmap_read_lock() do { } while (0)
 #define mmap_unlock() do { } while (0)
 #endif
 
@@ -484,6 +519,14 @@ static inline PageDesc *page_find(tb_page_addr_t index)
   (DEFAULT_CODE_GEN_BUFFER_SIZE_1 < MAX_CODE_GEN_BUFFER_SIZE \
    ? DEFAULT_CODE_GEN_BUFFER_SIZE_1 : MAX_CODE_GEN_BUFFER_SIZE)
 
+#if defined(CONFIG_USER_ONLY)
+/* The buffer is split in regions so that up to TB_REGIONS_MAX guest
+   threads can translate at the same time, as long as each region is
+   still big enough to hold a fair number of TBs.  */
+#define TB_REGIONS_MAX      16
+#define TB_REGION_MIN_SIZE  (2u * 1024 * 1024)
+#endif
+
 static inline size_t size_code_gen_buffer(size_t tb_size)
 {
     /* Size the buffer.  */
@@ -583,14 +626,39 @@ static inline void code_gen_alloc(size_t tb_size)
             tcg_ctx.code_gen_buffer_size - 1024;
     tcg_ctx.code_gen_buffer_size -= 1024;
 
-    tcg_ctx.code_gen_buffer_max_size = tcg_ctx.code_gen_buffer_size -
-        (TCG_MAX_OP_SIZE * OPC_BUF_SIZE);
     tcg_ctx.code_gen_max_blocks = tcg_ctx.code_gen_buffer_size /
             CODE_GEN_AVG_BLOCK_SIZE;
-    tcg_ctx.tb_ctx.tbs =
+    tb_ctx.tbs =
             g_malloc(tcg_ctx.code_gen_max_blocks * sizeof(TranslationBlock));
 }
 
+/* Split the code buffer and the TB array in regions.  System mode
+   translates from a single thread and uses one region.  */
+static void tb_region_init(void)
+{
+    int i, n = 1;
+
+#if defined(CONFIG_USER_ONLY)
+    n = tcg_ctx.code_gen_buffer_size / TB_REGION_MIN_SIZE;
+    n = MAX(1, MIN(n, TB_REGIONS_MAX));
+    pthread_cond_init(&tb_ctx.region_cond, NULL);
+#endif
+    tb_ctx.region_size = (tcg_ctx.code_gen_buffer_size / n) &
+                         ~(size_t)(CODE_GEN_ALIGN - 1);
+    tb_ctx.regions = g_new0(TBRegion, n);
+    tb_ctx.nb_regions = n;
+    for (i = 0; i < n; i++) {
+        TBRegion *r = &tb_ctx.regions[i];
+
+        r->code_start = tcg_ctx.code_gen_buffer + i * tb_ctx.region_size;
+        r->code_ptr = r->code_start;
+        r->code_end = r->code_start + tb_ctx.region_size -
+                      (TCG_MAX_OP_SIZE * OPC_BUF_SIZE);
+        r->max_tbs = tcg_ctx.code_gen_max_blocks / n;
+        r->tbs = tb_ctx.tbs + i * r->max_tbs;
+    }
+}
+
 /* Must be called before using the QEMU cpus. 'tb_size' is the size
    (in bytes) allocated to the translation buffer. Zero means default
    size. */
@@ -598,7 +666,7 @@ void tcg_exec_init(unsigned long tb_size)
 {
     cpu_gen_init();
     code_gen_alloc(tb_size);
-    tcg_ctx.code_gen_ptr = tcg_ctx.code_gen_buffer;
+    tb_region_init();
     tcg_register_jit(tcg_ctx.code_gen_buffer, tcg_ctx.code_gen_buffer_size);
     page_init();
 #if !defined(CONFIG_USER_ONLY) || !defined(CONFIG_USE_GUEST_BASE)
@@ -613,32 +681,89 @@ bool tcg_enabled(void)
     return tcg_ctx.code_gen_buffer != NULL;
 }
 
-/* Allocate a new translation block. Flush the translation buffer if
-   too many translation blocks or too much generated code. */
-static TranslationBlock *tb_alloc(target_ulong pc)
+static inline bool tb_region_full(TBRegion *r)
 {
-    TranslationBlock *tb;
+    return r->nb_tbs >= r->max_tbs || r->code_ptr >= r->code_end;
+}
 
-    if (tcg_ctx.tb_ctx.nb_tbs >= tcg_ctx.code_gen_max_blocks ||
-        (tcg_ctx.code_gen_ptr - tcg_ctx.code_gen_buffer) >=
-         tcg_ctx.code_gen_buffer_max_size) {
-        return NULL;
+static inline TBRegion *tb_region_of(TranslationBlock *tb)
+{
+    return &tb_ctx.regions[(tb - tb_ctx.tbs) / tb_ctx.regions[0].max_tbs];
+}
+
+static void tb_flush_locked(CPUState *cpu);
+
+/* Claim a region with room for at least one more TB, flushing the
+   translation buffer once all of them are full.  Called with tb_lock
+   held.  */
+static TBRegion *tb_region_get(CPUState *cpu)
+{
+    TBRegion *r;
+    int i;
+
+    for (;;) {
+        for (i = 0; i < tb_ctx.nb_regions; i++) {
+            r = &tb_ctx.regions[i];
+            if (!r->busy && !tb_region_full(r)) {
+                r->busy = true;
+                tb_ctx.nb_busy_regions++;
+                return r;
+            }
+        }
+        if (tb_ctx.nb_busy_regions == 0) {
+            /* flush must be done */
+            tb_flush_locked(cpu);
+            continue;
+        }
+#if defined(CONFIG_USER_ONLY)
+        /* wait for another thread to finish its translation */
+        pthread_cond_wait(&tb_ctx.region_cond, &tb_ctx.tb_lock);
+#else
+        /* only the TCG cpu thread translates in system mode */
+        abort();
+#endif
     }
-    tb = &tcg_ctx.tb_ctx.tbs[tcg_ctx.tb_ctx.nb_tbs++];
+}
+
+static void tb_region_put(TBRegion *r)
+{
+    r->busy = false;
+    tb_ctx.nb_busy_regions--;
+#if defined(CONFIG_USER_ONLY)
+    pthread_cond_broadcast(&tb_ctx.region_cond);
+#endif
+}
+
+/* Allocate a new translation block at the end of region 'r'.  Called
+   with tb_lock held.  */
+static TranslationBlock *tb_alloc(TBRegion *r, target_ulong pc)
+{
+    TranslationBlock *tb;
+
+    tb = &r->tbs[r->nb_tbs];
     tb->pc = pc;
     tb->cflags = 0;
+    tb->exec_count = 0;
+    tb->tc_ptr = r->code_ptr;
+    /* tb_find_pc() looks at the region without tb_lock */
+    smp_wmb();
+    r->nb_tbs++;
+    tb_ctx.nb_tbs++;
     return tb;
 }
 
 void tb_free(TranslationBlock *tb)
 {
+    TBRegion *r = tb_region_of(tb);
+
     /* In practice this is mostly used for single use temporary TB
        Ignore the hard cases and just back up if this TB happens to
        be the last one generated.  */
-    if (tcg_ctx.tb_ctx.nb_tbs > 0 &&
-            tb == &tcg_ctx.tb_ctx.tbs[tcg_ctx.tb_ctx.nb_tbs - 1]) {
-        tcg_ctx.code_gen_ptr = tb->tc_ptr;
-        tcg_ctx.tb_ctx.nb_tbs--;
+    if (r->nb_tbs > 0 &&
+            tb == &r->tbs[r->nb_tbs - 1]) {
+        r->code_ptr = tb->tc_ptr;
+        r->nb_tbs--;
+        tb_ctx.nb_tbs--;
     }
 }
 
@@ -684,36 +809,53 @@ static void page_flush_tb(void)
     }
 }
 
-/* flush all the translation blocks */
-/* XXX: tb_flush is currently not thread safe */
-void tb_flush(CPUArchState *env1)
+/* flush all the translation blocks; called with tb_lock held */
+/* XXX: other threads may still be running code from the old TBs */
+static void tb_flush_locked(CPUState *cpu)
 {
-    CPUState *cpu = ENV_GET_CPU(env1);
+    TBRegion *r;
+    int i;
 
+#if defined(CONFIG_USER_ONLY)
+    /* Translations in progress write into the regions reset below.  */
+    while (tb_ctx.nb_busy_regions) {
+        pthread_cond_wait(&tb_ctx.region_cond, &tb_ctx.tb_lock);
+    }
+#endif
+    for (i = 0; i < tb_ctx.nb_regions; i++) {
+        r = &tb_ctx.regions[i];
 #if defined(DEBUG_FLUSH)
-    printf("qemu: flush code_size=%ld nb_tbs=%d avg_tb_size=%ld\n",
-           (unsigned long)(tcg_ctx.code_gen_ptr - tcg_ctx.code_gen_buffer),
-           tcg_ctx.tb_ctx.nb_tbs, tcg_ctx.tb_ctx.nb_tbs > 0 ?
-           ((unsigned long)(tcg_ctx.code_gen_ptr - tcg_ctx.code_gen_buffer)) /
-           tcg_ctx.tb_ctx.nb_tbs : 0);
+        printf("qemu: flush region %d code_size=%ld nb_tbs=%d\n", i,
+               (unsigned long)(r->code_ptr - r->code_start), r->nb_tbs);
 #endif
-    if ((unsigned long)(tcg_ctx.code_gen_ptr - tcg_ctx.code_gen_buffer)
-        > tcg_ctx.code_gen_buffer_size) {
-        cpu_abort(cpu, "Internal error: code buffer overflow\n");
+        if ((unsigned long)(r->code_ptr - r->code_start)
+            > tb_ctx.region_size) {
+            cpu_abort(cpu, "Internal error: code buffer overflow\n");
+        }
+        r->code_ptr = r->code_start;
+        r->nb_tbs = 0;
     }
-    tcg_ctx.tb_ctx.nb_tbs = 0;
+    tb_ctx.nb_tbs = 0;
 
     CPU_FOREACH(cpu) {
         memset(cpu->tb_jmp_cache, 0, sizeof(cpu->tb_jmp_cache));
     }
 
-    memset(tcg_ctx.tb_ctx.tb_phys_hash, 0, sizeof(tcg_ctx.tb_ctx.tb_phys_hash));
+    memset(tb_ctx.tb_phys_hash, 0, sizeof(tb_ctx.tb_phys_hash));
     page_flush_tb();
 
-    tcg_ctx.code_gen_ptr = tcg_ctx.code_gen_buffer;
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
-    tcg_ctx.tb_ctx.tb_flush_count++;
+    tb_ctx.tb_flush_count++;
+    /* Don't forget to invalidate previous TB info.  */
+    tb_ctx.tb_invalidated_flag = 1;
+}
+
+void tb_flush(CPUArchState *env1)
+{
+    spin_lock(&tb_ctx.tb_lock);
+    tb_flush_locked(ENV_GET_CPU(env1));
+    spin_unlock(&tb_ctx.tb_lock);
 }
 
 #ifdef DEBUG_TB_CHECK
@@ -743,7 +885,7 @@ static void tb_page_check(void)
     int i, flags1, flags2;
 
     for (i = 0; i < CODE_GEN_PHYS_HASH_SIZE; i++) {
-        for (tb = tcg_ctx.tb_ctx.tb_phys_hash[i]; tb != NULL;
+        for (tb = tb_ctx.tb_phys_hash[i]; tb != NULL;
                 tb = tb->phys_hash_next) {
             flags1 = page_get_flags(tb->pc);
             flags2 = page_get_flags(tb->pc + tb->size - 1);
@@ -836,7 +978,7 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
     /* remove the TB from the hash list */
     phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
     h = tb_phys_hash_func(phys_pc);
-    tb_hash_remove(&tcg_ctx.tb_ctx.tb_phys_hash[h], tb);
+    tb_hash_remove(&tb_ctx.tb_phys_hash[h], tb);
 
     /* remove the TB from the page list */
     if (tb->page_addr[0] != page_addr) {
@@ -850,7 +992,7 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
         invalidate_page_bitmap(p);
     }
 
-    tcg_ctx.tb_ctx.tb_invalidated_flag = 1;
+    tb_ctx.tb_invalidated_flag = 1;
 
     /* remove the TB from the hash list */
     h = tb_jmp_cache_hash_func(tb->pc);
@@ -879,9 +1021,44 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
     }
     tb->jmp_first = (TranslationBlock *)((uintptr_t)tb | 2); /* fail safe */
 
-    tcg_ctx.tb_ctx.tb_phys_invalidate_count++;
+    tb_ctx.tb_phys_invalidate_count++;
 }
 
+#if !defined(CONFIG_USER_ONLY)
+/* Link jump 'n' of 'tb' to 'tb_next', which starts on another guest page.
+   Unlike a jump within the page, where the mapping of the destination is
+   implied by the one of 'tb', the link is only made if the TLB of 'env'
+   maps the destination to the physical page 'tb_next' was translated
+   from.  The TLB addend is recorded so that the generated code can check
+   the mapping on every pass and fall back to the main loop, which relinks
+   the jump, after a remap.  Invalidating either TB unlinks the jump as
+   usual. */
+void tb_add_cross_page_jump(CPUArchState *env, TranslationBlock *tb, int n,
+                            TranslationBlock *tb_next)
+{
+    target_ulong page = tb_next->pc & TARGET_PAGE_MASK;
+    int mmu_idx = cpu_mmu_index(env);
+    int index = (tb_next->pc >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+    ram_addr_t ram_addr;
+
+    /* the jump may still point to the TB of an earlier mapping */
+    if (tb->jmp_next[n]) {
+        tb_jmp_remove(tb, n);
+        tb_reset_jump(tb, n);
+    }
+
+    if (te->addr_code != page ||
+        !qemu_ram_addr_from_host((void *)(te->addend + page), &ram_addr) ||
+        ram_addr != tb_next->page_addr[0]) {
+        return;
+    }
+
+    tb->jmp_addend[n] = te->addend;
+    tb_add_jump(tb, n, tb_next);
+}
+#endif
+
 static inline void set_bits(uint8_t *tab, int start, int len)
 {
     int end, mask, end1;
@@ -938,35 +1115,50 @@ static void build_page_bitmap(PageDesc *p)
     }
 }
 
+/* Translate the block at 'pc'.  Called with tb_lock held, which is
+   dropped while generating code so that other threads can look up,
+   chain and translate TBs in the meantime; the mmap lock keeps the
+   guest code from being unmapped or invalidated under us.  Only targets
+   whose translator keeps all per-TB state in TCG_THREAD variables
+   define TARGET_HAS_PARALLEL_TRANSLATE; the others translate one TB at
+   a time.  */
 TranslationBlock *tb_gen_code(CPUState *cpu,
                               target_ulong pc, target_ulong cs_base,
                               int flags, int cflags)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb;
-    uint8_t *tc_ptr;
+    TBRegion *r;
     tb_page_addr_t phys_pc, phys_page2;
     target_ulong virt_page2;
     int code_gen_size;
+    int64_t ti = 0;
 
     phys_pc = get_page_addr_code(env, pc);
-    tb = tb_alloc(pc);
-    if (!tb) {
-        /* flush must be done */
-        tb_flush(env);
-        /* cannot fail at this point */
-        tb = tb_alloc(pc);
-        /* Don't forget to invalidate previous TB info.  */
-        tcg_ctx.tb_ctx.tb_invalidated_flag = 1;
-    }
-    tc_ptr = tcg_ctx.code_gen_ptr;
-    tb->tc_ptr = tc_ptr;
+
+    spin_unlock(&tb_ctx.tb_lock);
+#ifdef TARGET_HAS_PARALLEL_TRANSLATE
+    mmap_read_lock();
+#else
+    mmap_lock();
+#endif
+    spin_lock(&tb_ctx.tb_lock);
+    r = tb_region_get(cpu);
+    tb = tb_alloc(r, pc);
+    tb_gen_region = r;
+    spin_unlock(&tb_ctx.tb_lock);
+
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    if (tb_profile_enabled) {
+        ti = get_clock();
+    }
     cpu_gen_code(env, tb, &code_gen_size);
-    tcg_ctx.code_gen_ptr = (void *)(((uintptr_t)tcg_ctx.code_gen_ptr +
-            code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
+    if (tb_profile_enabled) {
+        tb->gen_time = get_clock() - ti;
+        tb->tc_size = code_gen_size;
+    }
 
     /* check next page if needed */
     virt_page2 = (pc + tb->size - 1) & TARGET_PAGE_MASK;
@@ -974,10 +1166,37 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     if ((pc & TARGET_PAGE_MASK) != virt_page2) {
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
+
+    spin_lock(&tb_ctx.tb_lock);
+    r->code_ptr = (void *)(((uintptr_t)r->code_ptr +
+            code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
+    tb_gen_region = NULL;
+    tb_region_put(r);
     tb_link_page(tb, phys_pc, phys_page2);
+    mmap_unlock();
     return tb;
 }
 
+/* Called by cpu_exec() when an exception longjmp'd out of the guest
+   code or of the translator.  In the latter case release what
+   tb_gen_code() holds and drop the half-generated TB.  Return true if
+   a translation was interrupted, in which case tb_lock is not held.  */
+bool tb_gen_code_abort(void)
+{
+    TBRegion *r = tb_gen_region;
+
+    if (!r) {
+        return false;
+    }
+    tb_gen_region = NULL;
+    spin_lock(&tb_ctx.tb_lock);
+    tb_free(&r->tbs[r->nb_tbs - 1]);
+    tb_region_put(r);
+    spin_unlock(&tb_ctx.tb_lock);
+    mmap_unlock();
+    return true;
+}
+
 /*
  * Invalidate all TBs which intersect with the target physical address range
  * [start;end[. NOTE: start and end may refer to *different* physical pages.
@@ -988,11 +1207,13 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t end,
                               int is_cpu_write_access)
 {
+    spin_lock(&tb_ctx.tb_lock);
     while (start < end) {
         tb_invalidate_phys_page_range(start, end, is_cpu_write_access);
         start &= TARGET_PAGE_MASK;
         start += TARGET_PAGE_SIZE;
     }
+    spin_unlock(&tb_ctx.tb_lock);
 }
 
 /*
@@ -1172,6 +1393,7 @@ static void tb_invalidate_phys_page(tb_page_addr_t addr,
     if (!p) {
         return;
     }
+    spin_lock(&tb_ctx.tb_lock);
     tb = p->first_tb;
 #ifdef TARGET_HAS_PRECISE_SMC
     if (tb && pc != 0) {
@@ -1210,12 +1432,14 @@ static void tb_invalidate_phys_page(tb_page_addr_t addr,
            itself */
         cpu->current_tb = NULL;
         tb_gen_code(cpu, current_pc, current_cs_base, current_flags, 1);
+        spin_unlock(&tb_ctx.tb_lock);
         if (locked) {
             mmap_unlock();
         }
         cpu_resume_from_signal(cpu, puc);
     }
 #endif
+    spin_unlock(&tb_ctx.tb_lock);
 }
 #endif
 
@@ -1279,19 +1503,18 @@ static inline void tb_alloc_page(TranslationBlock *tb,
 }
 
 /* add a new TB and link it to the physical page tables. phys_page2 is
-   (-1) to indicate that only one page contains the TB. */
+   (-1) to indicate that only one page contains the TB.  Called with
+   tb_lock held and the mmap lock (at least shared) held, so that no
+   other thread invalidates this TB before we are done.  */
 static void tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
                          tb_page_addr_t phys_page2)
 {
     unsigned int h;
     TranslationBlock **ptb;
 
-    /* Grab the mmap lock to stop another thread invalidating this TB
-       before we are done.  */
-    mmap_lock();
     /* add in the physical hash table */
     h = tb_phys_hash_func(phys_pc);
-    ptb = &tcg_ctx.tb_ctx.tb_phys_hash[h];
+    ptb = &tb_ctx.tb_phys_hash[h];
     tb->phys_hash_next = *ptb;
     *ptb = tb;
 
@@ -1318,7 +1541,6 @@ static void tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
 #ifdef DEBUG_TB_CHECK
     tb_page_check();
 #endif
-    mmap_unlock();
 }
 
 /* find the TB 'tb' such that tb[0].tc_ptr <= tc_ptr <
@@ -1327,21 +1549,27 @@ static TranslationBlock *tb_find_pc(uintptr_t tc_ptr)
 {
     int m_min, m_max, m;
     uintptr_t v;
+    size_t i;
+    TBRegion *r;
     TranslationBlock *tb;
 
-    if (tcg_ctx.tb_ctx.nb_tbs <= 0) {
+    if (tc_ptr < (uintptr_t)tcg_ctx.code_gen_buffer) {
         return NULL;
     }
-    if (tc_ptr < (uintptr_t)tcg_ctx.code_gen_buffer ||
-        tc_ptr >= (uintptr_t)tcg_ctx.code_gen_ptr) {
+    i = (tc_ptr - (uintptr_t)tcg_ctx.code_gen_buffer) / tb_ctx.region_size;
+    if (i >= tb_ctx.nb_regions) {
+        return NULL;
+    }
+    r = &tb_ctx.regions[i];
+    if (r->nb_tbs <= 0 || tc_ptr >= (uintptr_t)r->code_ptr) {
         return NULL;
     }
     /* binary search (cf Knuth) */
     m_min = 0;
-    m_max = tcg_ctx.tb_ctx.nb_tbs - 1;
+    m_max = r->nb_tbs - 1;
     while (m_min <= m_max) {
         m = (m_min + m_max) >> 1;
-        tb = &tcg_ctx.tb_ctx.tbs[m];
+        tb = &r->tbs[m];
         v = (uintptr_t)tb->tc_ptr;
         if (v == tc_ptr) {
             return tb;
@@ -1351,7 +1579,7 @@ static TranslationBlock *tb_find_pc(uintptr_t tc_ptr)
             m_min = m + 1;
         }
     }
-    return &tcg_ctx.tb_ctx.tbs[m_max];
+    return &r->tbs[m_max];
 }
 
 #if defined(TARGET_HAS_ICE) && !defined(CONFIG_USER_ONLY)
@@ -1385,7 +1613,144 @@ void tb_check_watchpoint(CPUState *cpu)
     tb_phys_invalidate(tb, -1);
 }
 
+/* Copy of the profile of one TB, so that the TB itself may be flushed
+   and reused while the report is being printed. */
+typedef struct TBHotEntry {
+    target_ulong pc;
+    uint64_t exec_count;
+    uint16_t size;
+    uint32_t tc_size;
+    int64_t gen_time;
+} TBHotEntry;
+
+static int tb_hot_cmp(const void *a, const void *b)
+{
+    const TBHotEntry *e1 = a;
+    const TBHotEntry *e2 = b;
+
+    if (e1->exec_count != e2->exec_count) {
+        return e1->exec_count < e2->exec_count ? 1 : -1;
+    }
+    return 0;
+}
+
+/* Return a snapshot of the live TBs sorted by execution count, hottest
+   first, with their number and the total count over all of them.  Other
+   threads of a user-mode guest may still be translating or flushing, so
+   the snapshot is taken under tb_lock. */
+static TBHotEntry *tb_hot_sort(int *nb_entries, uint64_t *total)
+{
+    TBHotEntry *entries;
+    int nb_tbs, i, j;
+
+    spin_lock(&tb_ctx.tb_lock);
+    entries = g_new(TBHotEntry, tb_ctx.nb_tbs + 1);
+    nb_tbs = 0;
+    *total = 0;
+    for (i = 0; i < tb_ctx.nb_regions; i++) {
+        TBRegion *r = &tb_ctx.regions[i];
+
+        for (j = 0; j < r->nb_tbs; j++) {
+            TranslationBlock *tb = &r->tbs[j];
+
+            entries[nb_tbs].pc = tb->pc;
+            entries[nb_tbs].exec_count = tb->exec_count;
+            entries[nb_tbs].size = tb->size;
+            entries[nb_tbs].tc_size = tb->tc_size;
+            entries[nb_tbs].gen_time = tb->gen_time;
+            *total += tb->exec_count;
+            nb_tbs++;
+        }
+    }
+    spin_unlock(&tb_ctx.tb_lock);
+
+    qsort(entries, nb_tbs, sizeof(*entries), tb_hot_cmp);
+    *nb_entries = nb_tbs;
+    return entries;
+}
+
+void tb_hot_dump(FILE *f, fprintf_function cpu_fprintf, int count)
+{
+    TBHotEntry *entries;
+    uint64_t total;
+    int nb_entries, i;
+
+    if (!tb_profile_enabled) {
+        cpu_fprintf(f, "TB profiling is not enabled, use -tb-hot\n");
+        return;
+    }
+
+    entries = tb_hot_sort(&nb_entries, &total);
+    cpu_fprintf(f, "%" PRIu64 " TB executions in %d TBs\n",
+                total, nb_entries);
+    cpu_fprintf(f, "%-18s %14s %6s %6s %6s %10s  %s\n", "pc", "count",
+                "share", "size", "host", "gen-ns", "symbol");
+    for (i = 0; i < MIN(count, nb_entries); i++) {
+        TBHotEntry *tb = &entries[i];
+
+        if (!tb->exec_count) {
+            break;
+        }
+        cpu_fprintf(f, "0x%016" PRIx64 " %14" PRIu64 " %5.1f%% %6u"
+                    " %6u %10" PRId64 "  %s\n", (uint64_t)tb->pc,
+                    tb->exec_count, tb->exec_count * 100.0 / total,
+                    tb->size, tb->tc_size, tb->gen_time,
+                    lookup_symbol(tb->pc));
+    }
+    g_free(entries);
+}
+
+void tb_hot_exit(void)
+{
+    if (tb_profile_enabled && tb_hot_exit_count > 0) {
+        tb_hot_dump(stderr, fprintf, tb_hot_exit_count);
+    }
+}
+
 #ifndef CONFIG_USER_ONLY
+TbHotInfoList *qmp_query_tb_hot(bool has_count, int64_t count, Error **errp)
+{
+    TbHotInfoList *head = NULL, **prev = &head;
+    TBHotEntry *entries;
+    uint64_t total;
+    int nb_entries, i;
+
+    if (!tb_profile_enabled) {
+        error_setg(errp, "TB profiling is not enabled, use -tb-hot");
+        return NULL;
+    }
+    if (!has_count) {
+        count = 10;
+    }
+
+    entries = tb_hot_sort(&nb_entries, &total);
+    for (i = 0; i < MIN(count, nb_entries); i++) {
+        TBHotEntry *tb = &entries[i];
+        TbHotInfoList *elem;
+        const char *sym;
+
+        if (!tb->exec_count) {
+            break;
+        }
+        elem = g_new0(TbHotInfoList, 1);
+        elem->value = g_new0(TbHotInfo, 1);
+        elem->value->pc = tb->pc;
+        elem->value->count = tb->exec_count;
+        elem->value->size = tb->size;
+        elem->value->host_size = tb->tc_size;
+        elem->value->gen_time_ns = tb->gen_time;
+        sym = lookup_symbol(tb->pc);
+        if (sym[0]) {
+            elem->value->has_symbol = true;
+            elem->value->symbol = g_strdup(sym);
+        }
+        *prev = elem;
+        prev = &elem->next;
+    }
+    g_free(entries);
+    return head;
+}
+
 /* mask must never be zero, except for A20 change call */
 static void tcg_handle_interrupt(CPUState *cpu, int mask)
 {
@@ -1496,63 +1861,69 @@ void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
 
 void dump_exec_info(FILE *f, fprintf_function cpu_fprintf)
 {
-    int i, target_code_size, max_target_code_size;
+    int i, j, target_code_size, max_target_code_size;
     int direct_jmp_count, direct_jmp2_count, cross_page;
+    ptrdiff_t code_gen_size;
+    size_t code_gen_max_size;
     TranslationBlock *tb;
+    TBRegion *r;
 
     target_code_size = 0;
     max_target_code_size = 0;
     cross_page = 0;
     direct_jmp_count = 0;
     direct_jmp2_count = 0;
-    for (i = 0; i < tcg_ctx.tb_ctx.nb_tbs; i++) {
-        tb = &tcg_ctx.tb_ctx.tbs[i];
-        target_code_size += tb->size;
-        if (tb->size > max_target_code_size) {
-            max_target_code_size = tb->size;
-        }
-        if (tb->page_addr[1] != -1) {
-            cross_page++;
-        }
-        if (tb->tb_next_offset[0] != 0xffff) {
-            direct_jmp_count++;
-            if (tb->tb_next_offset[1] != 0xffff) {
-                direct_jmp2_count++;
+    code_gen_size = 0;
+    code_gen_max_size = 0;
+    for (i = 0; i < tb_ctx.nb_regions; i++) {
+        r = &tb_ctx.regions[i];
+        code_gen_size += r->code_ptr - r->code_start;
+        code_gen_max_size += r->code_end - r->code_start;
+        for (j = 0; j < r->nb_tbs; j++) {
+            tb = &r->tbs[j];
+            target_code_size += tb->size;
+            if (tb->size > max_target_code_size) {
+                max_target_code_size = tb->size;
+            }
+            if (tb->page_addr[1] != -1) {
+                cross_page++;
+            }
+            if (tb->tb_next_offset[0] != 0xffff) {
+                direct_jmp_count++;
+                if (tb->tb_next_offset[1] != 0xffff) {
+                    direct_jmp2_count++;
+                }
             }
         }
     }
     /* XXX: avoid using doubles ? */
     cpu_fprintf(f, "Translation buffer state:\n");
     cpu_fprintf(f, "gen code size       %td/%zd\n",
-                tcg_ctx.code_gen_ptr - tcg_ctx.code_gen_buffer,
-                tcg_ctx.code_gen_buffer_max_size);
+                code_gen_size, code_gen_max_size);
     cpu_fprintf(f, "TB count            %d/%d\n",
-            tcg_ctx.tb_ctx.nb_tbs, tcg_ctx.code_gen_max_blocks);
+            tb_ctx.nb_tbs, tcg_ctx.code_gen_max_blocks);
     cpu_fprintf(f, "TB avg target size  %d max=%d bytes\n",
-            tcg_ctx.tb_ctx.nb_tbs ? target_code_size /
-                    tcg_ctx.tb_ctx.nb_tbs : 0,
+            tb_ctx.nb_tbs ? target_code_size /
+                    tb_ctx.nb_tbs : 0,
             max_target_code_size);
     cpu_fprintf(f, "TB avg host size    %td bytes (expansion ratio: %0.1f)\n",
-            tcg_ctx.tb_ctx.nb_tbs ? (tcg_ctx.code_gen_ptr -
-                                     tcg_ctx.code_gen_buffer) /
-                                     tcg_ctx.tb_ctx.nb_tbs : 0,
-                target_code_size ? (double) (tcg_ctx.code_gen_ptr -
-                                             tcg_ctx.code_gen_buffer) /
-                                             target_code_size : 0);
+            tb_ctx.nb_tbs ? code_gen_size / tb_ctx.nb_tbs : 0,
+                target_code_size ? (double) code_gen_size /
+                                            target_code_size : 0);
     cpu_fprintf(f, "cross page TB count %d (%d%%)\n", cross_page,
-            tcg_ctx.tb_ctx.nb_tbs ? (cross_page * 100) /
-                                    tcg_ctx.tb_ctx.nb_tbs : 0);
+            tb_ctx.nb_tbs ? (cross_page * 100) /
+                                    tb_ctx.nb_tbs : 0);
     cpu_fprintf(f, "direct jump count   %d (%d%%) (2 jumps=%d %d%%)\n",
                 direct_jmp_count,
-                tcg_ctx.tb_ctx.nb_tbs ? (direct_jmp_count * 100) /
-                        tcg_ctx.tb_ctx.nb_tbs : 0,
+                tb_ctx.nb_tbs ? (direct_jmp_count * 100) /
+                        tb_ctx.nb_tbs : 0,
                 direct_jmp2_count,
-                tcg_ctx.tb_ctx.nb_tbs ? (direct_jmp2_count * 100) /
-                        tcg_ctx.tb_ctx.nb_tbs : 0);
+                tb_ctx.nb_tbs ? (direct_jmp2_count * 100) /
+                        tb_ctx.nb_tbs : 0);
     cpu_fprintf(f, "\nStatistics:\n");
-    cpu_fprintf(f, "TB flush count      %d\n", tcg_ctx.tb_ctx.tb_flush_count);
+    cpu_fprintf(f, "TB flush count      %d\n", tb_ctx.tb_flush_count);
     cpu_fprintf(f, "TB invalidate count %d\n",
-            tcg_ctx.tb_ctx.tb_phys_invalidate_count);
+            tb_ctx.tb_phys_invalidate_count);
     cpu_fprintf(f, "TLB flush count     %d\n", tlb_flush_count);
     tcg_dump_info(f, cpu_fprintf);
 }
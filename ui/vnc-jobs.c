@@ -41,19 +41,27 @@
  * - VncState::output lock: used to make sure the output buffer is not corrupted
  *                          if two threads try to write on it at the same time
  *
- * While the VNC worker thread is working, the VncDisplay global lock is held
- * to avoid screen corruption (this does not block vnc_refresh() because it
- * uses trylock()) but the output lock is not held because the thread works on
- * its own output buffer.
+ * Several worker threads share the queue.  While a worker is encoding it is
+ * counted in VncDisplay::encoders, which makes vnc_trylock_display() fail
+ * so that vnc_refresh() leaves the server surface alone; the display lock
+ * itself is only held to update the counter, so workers run concurrently.
+ * The output lock is not held because each thread works on its own output
+ * buffer.
  * When the encoding job is done, the worker thread will hold the output lock
  * and copy its output buffer in vs->output.
+ *
+ * The jobs of one client are encoded in order, one at a time, because the
+ * zlib based encodings keep their stream state across updates.  Updates in
+ * an encoding without such state are split into bands of rectangles that
+ * the workers encode in parallel, each part sent as its own framebuffer
+ * update message.
  */
 
 struct VncJobQueue {
     QemuCond cond;
     QemuMutex mutex;
-    QemuThread thread;
-    Buffer buffer;
+    int nthreads;
+    unsigned int batch;
     bool exit;
     QTAILQ_HEAD(, VncJob) jobs;
 };
@@ -61,8 +69,7 @@ struct VncJobQueue {
 typedef struct VncJobQueue VncJobQueue;
 
 /*
- * We use a single global queue, but most of the functions are
- * already reentrant, so we can easily add more than one encoding thread
+ * We use a single global queue shared by all the encoding threads
  */
 static VncJobQueue *queue;
 
@@ -102,18 +109,97 @@ int vnc_job_add_rect(VncJob *job, int x, int y, int w, int h)
     return 1;
 }
 
+static bool vnc_job_splittable(VncJob *job)
+{
+    switch (job->encoding) {
+    case VNC_ENCODING_ZLIB:
+    case VNC_ENCODING_TIGHT:
+    case VNC_ENCODING_TIGHT_PNG:
+    case VNC_ENCODING_ZRLE:
+    case VNC_ENCODING_ZYWRLE:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/* Queue job as up to n parts of consecutive rectangles */
+static void vnc_job_split_locked(VncJob *job, int n)
+{
+    VncRectEntry *entry, *tmp;
+    VncJob *part = NULL;
+    int count = 0, per, i = 0;
+
+    QLIST_FOREACH(entry, &job->rectangles, next) {
+        count++;
+    }
+    per = DIV_ROUND_UP(count, n);
+
+    QTAILQ_INSERT_TAIL(&queue->jobs, job, next);
+    QLIST_FOREACH_SAFE(entry, &job->rectangles, next, tmp) {
+        if (i && i % per == 0) {
+            part = g_malloc0(sizeof(VncJob));
+            part->vs = job->vs;
+            part->batch = job->batch;
+            part->encoding = job->encoding;
+            QLIST_INIT(&part->rectangles);
+            QTAILQ_INSERT_TAIL(&queue->jobs, part, next);
+        }
+        if (part) {
+            QLIST_REMOVE(entry, next);
+            QLIST_INSERT_HEAD(&part->rectangles, entry, next);
+        }
+        i++;
+    }
+}
+
 void vnc_job_push(VncJob *job)
 {
     vnc_lock_queue(queue);
     if (queue->exit || QLIST_EMPTY(&job->rectangles)) {
         g_free(job);
     } else {
-        QTAILQ_INSERT_TAIL(&queue->jobs, job, next);
+        job->batch = queue->batch++;
+        /* Encode with what decided the split, even if the client sends
+         * SetEncodings before the parts run: parts of one batch may run
+         * concurrently, which a stateful encoding must never do.
+         */
+        job->encoding = job->vs->vnc_encoding;
+        if (queue->nthreads > 1 && vnc_job_splittable(job)) {
+            vnc_job_split_locked(job, queue->nthreads);
+        } else {
+            QTAILQ_INSERT_TAIL(&queue->jobs, job, next);
+        }
         qemu_cond_broadcast(&queue->cond);
     }
     vnc_unlock_queue(queue);
 }
 
+/*
+ * Find the first job that can be encoded now: a client's jobs run in queue
+ * order, and only the parts of one split update overlap.
+ */
+static VncJob *vnc_job_next_locked(VncJobQueue *queue)
+{
+    VncJob *job, *prev;
+
+    QTAILQ_FOREACH(job, &queue->jobs, next) {
+        if (job->busy) {
+            continue;
+        }
+        QTAILQ_FOREACH(prev, &queue->jobs, next) {
+            if (prev == job ||
+                (prev->vs == job->vs && prev->batch != job->batch)) {
+                break;
+            }
+        }
+        if (prev == job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
 static bool vnc_has_job_locked(VncState *vs)
 {
     VncJob *job;
@@ -142,7 +228,7 @@ void vnc_jobs_clear(VncState *vs)
 
     vnc_lock_queue(queue);
     QTAILQ_FOREACH_SAFE(job, &queue->jobs, next, tmp) {
-        if (job->vs == vs || !vs) {
+        if ((job->vs == vs || !vs) && !job->busy) {
             QTAILQ_REMOVE(&queue->jobs, job, next);
         }
     }
@@ -179,9 +265,12 @@ void vnc_jobs_consume_buffer(VncState *vs)
 /*
  * Copy data for local use
  */
-static void vnc_async_encoding_start(VncState *orig, VncState *local)
+static void vnc_async_encoding_start(VncJob *job, VncState *local,
+                                     Buffer *buffer)
 {
-    local->vnc_encoding = orig->vnc_encoding;
+    VncState *orig = job->vs;
+
+    local->vnc_encoding = job->encoding;
     local->features = orig->features;
     local->vd = orig->vd;
     local->lossy_rect = orig->lossy_rect;
@@ -192,24 +281,49 @@ static void vnc_async_encoding_start(VncState *orig, VncState *local)
     local->zlib = orig->zlib;
     local->hextile = orig->hextile;
     local->zrle = orig->zrle;
-    local->output =  queue->buffer;
+    local->output = *buffer;
     local->csock = -1; /* Don't do any network work on this thread */
+    memset(local->stats, 0, sizeof(local->stats));
 
     buffer_reset(&local->output);
 }
 
-static void vnc_async_encoding_end(VncState *orig, VncState *local)
+static void vnc_async_encoding_end(VncState *orig, VncState *local,
+                                   Buffer *buffer)
 {
+    int i;
+
     orig->tight = local->tight;
     orig->zlib = local->zlib;
     orig->hextile = local->hextile;
     orig->zrle = local->zrle;
     orig->lossy_rect = local->lossy_rect;
 
-    queue->buffer = local->output;
+    for (i = 0; i < VNC_ENC_STAT_MAX; i++) {
+        orig->stats[i].rects += local->stats[i].rects;
+        orig->stats[i].pixels += local->stats[i].pixels;
+        orig->stats[i].bytes += local->stats[i].bytes;
+        orig->stats[i].ns += local->stats[i].ns;
+    }
+
+    *buffer = local->output;
+}
+
+static void vnc_encoder_enter(VncDisplay *vd)
+{
+    vnc_lock_display(vd);
+    vd->encoders++;
+    vnc_unlock_display(vd);
+}
+
+static void vnc_encoder_exit(VncDisplay *vd)
+{
+    vnc_lock_display(vd);
+    vd->encoders--;
+    vnc_unlock_display(vd);
 }
 
-static int vnc_worker_thread_loop(VncJobQueue *queue)
+static int vnc_worker_thread_loop(VncJobQueue *queue, Buffer *buffer)
 {
     VncJob *job;
     VncRectEntry *entry, *tmp;
@@ -218,16 +332,15 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     int saved_offset;
 
     vnc_lock_queue(queue);
-    while (QTAILQ_EMPTY(&queue->jobs) && !queue->exit) {
+    while (!queue->exit && !(job = vnc_job_next_locked(queue))) {
         qemu_cond_wait(&queue->cond, &queue->mutex);
     }
-    /* Here job can only be NULL if queue->exit is true */
-    job = QTAILQ_FIRST(&queue->jobs);
-    vnc_unlock_queue(queue);
-
     if (queue->exit) {
+        vnc_unlock_queue(queue);
         return -1;
     }
+    job->busy = true;
+    vnc_unlock_queue(queue);
 
     vnc_lock_output(job->vs);
     if (job->vs->csock == -1 || job->vs->abort == true) {
@@ -237,7 +350,7 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     vnc_unlock_output(job->vs);
 
     /* Make a local copy of vs and switch output buffers */
-    vnc_async_encoding_start(job->vs, &vs);
+    vnc_async_encoding_start(job, &vs, buffer);
 
     /* Start sending rectangles */
     n_rectangles = 0;
@@ -246,14 +359,14 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     saved_offset = vs.output.offset;
     vnc_write_u16(&vs, 0);
 
-    vnc_lock_display(job->vs->vd);
+    vnc_encoder_enter(job->vs->vd);
     QLIST_FOREACH_SAFE(entry, &job->rectangles, next, tmp) {
         int n;
 
         if (job->vs->csock == -1) {
-            vnc_unlock_display(job->vs->vd);
+            vnc_encoder_exit(job->vs->vd);
             /* Copy persistent encoding data */
-            vnc_async_encoding_end(job->vs, &vs);
+            vnc_async_encoding_end(job->vs, &vs, buffer);
             goto disconnected;
         }
 
@@ -265,7 +378,7 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
         }
         g_free(entry);
     }
-    vnc_unlock_display(job->vs->vd);
+    vnc_encoder_exit(job->vs->vd);
 
     /* Put n_rectangles at the beginning of the message */
     vs.output.buffer[saved_offset] = (n_rectangles >> 8) & 0xFF;
@@ -277,12 +390,12 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
         buffer_append(&job->vs->jobs_buffer, vs.output.buffer,
                       vs.output.offset);
         /* Copy persistent encoding data */
-        vnc_async_encoding_end(job->vs, &vs);
+        vnc_async_encoding_end(job->vs, &vs, buffer);
 
 	qemu_bh_schedule(job->vs->bh);
     }  else {
         /* Copy persistent encoding data */
-        vnc_async_encoding_end(job->vs, &vs);
+        vnc_async_encoding_end(job->vs, &vs, buffer);
     }
     vnc_unlock_output(job->vs);
 
@@ -309,7 +422,6 @@ static void vnc_queue_clear(VncJobQueue *q)
 {
     qemu_cond_destroy(&queue->cond);
     qemu_mutex_destroy(&queue->mutex);
-    buffer_free(&queue->buffer);
     g_free(q);
     queue = NULL; /* Unset global queue */
 }
@@ -317,11 +429,19 @@ static void vnc_queue_clear(VncJobQueue *q)
 static void *vnc_worker_thread(void *arg)
 {
     VncJobQueue *queue = arg;
+    Buffer buffer;
+    bool last;
 
-    qemu_thread_get_self(&queue->thread);
+    memset(&buffer, 0, sizeof(buffer));
+    while (!vnc_worker_thread_loop(queue, &buffer)) ;
+    buffer_free(&buffer);
 
-    while (!vnc_worker_thread_loop(queue)) ;
-    vnc_queue_clear(queue);
+    vnc_lock_queue(queue);
+    last = --queue->nthreads == 0;
+    vnc_unlock_queue(queue);
+    if (last) {
+        vnc_queue_clear(queue);
+    }
     return NULL;
 }
 
@@ -330,17 +450,22 @@ static bool vnc_worker_thread_running(void)
     return queue; /* Check global queue */
 }
 
-void vnc_start_worker_thread(void)
+/* Grow the pool to n threads; it never shrinks until stopped */
+void vnc_start_worker_threads(int n)
 {
-    VncJobQueue *q;
+    QemuThread thread;
 
-    if (vnc_worker_thread_running())
-        return ;
+    if (!vnc_worker_thread_running()) {
+        queue = vnc_queue_init(); /* Set global queue */
+    }
 
-    q = vnc_queue_init();
-    qemu_thread_create(&q->thread, "vnc_worker", vnc_worker_thread, q,
-                       QEMU_THREAD_DETACHED);
-    queue = q; /* Set global queue */
+    vnc_lock_queue(queue);
+    while (queue->nthreads < n) {
+        qemu_thread_create(&thread, "vnc_worker", vnc_worker_thread, queue,
+                           QEMU_THREAD_DETACHED);
+        queue->nthreads++;
+    }
+    vnc_unlock_queue(queue);
 }
 
 void vnc_stop_worker_thread(void)
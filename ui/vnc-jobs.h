@@ -39,13 +39,21 @@ void vnc_jobs_clear(VncState *vs);
 void vnc_jobs_join(VncState *vs);
 
 void vnc_jobs_consume_buffer(VncState *vs);
-void vnc_start_worker_thread(void);
+void vnc_start_worker_threads(int n);
 void vnc_stop_worker_thread(void);
 
 /* Locks */
+/* Fails while a worker is encoding from the server surface */
 static inline int vnc_trylock_display(VncDisplay *vd)
 {
-    return qemu_mutex_trylock(&vd->mutex);
+    if (qemu_mutex_trylock(&vd->mutex)) {
+        return -1;
+    }
+    if (vd->encoders) {
+        qemu_mutex_unlock(&vd->mutex);
+        return -1;
+    }
+    return 0;
 }
 
 static inline void vnc_lock_display(VncDisplay *vd)
@@ -300,7 +300,46 @@ static void vnc_qmp_event(VncState *vs, MonitorEvent event)
     qobject_decref(data);
 }
 
-static VncClientInfo *qmp_query_vnc_client(const VncState *client)
+static const char *vnc_enc_stat_names[VNC_ENC_STAT_MAX] = {
+    [VNC_ENC_STAT_RAW]       = "raw",
+    [VNC_ENC_STAT_HEXTILE]   = "hextile",
+    [VNC_ENC_STAT_ZLIB]      = "zlib",
+    [VNC_ENC_STAT_TIGHT]     = "tight",
+    [VNC_ENC_STAT_TIGHT_PNG] = "tight-png",
+    [VNC_ENC_STAT_ZRLE]      = "zrle",
+    [VNC_ENC_STAT_ZYWRLE]    = "zywrle",
+};
+
+static VncEncodingInfoList *qmp_query_vnc_encodings(VncState *client)
+{
+    VncEncodingInfoList *head = NULL, **prev = &head;
+    VncEncodingStats stats[VNC_ENC_STAT_MAX];
+    int i;
+
+    vnc_lock_output(client);
+    memcpy(stats, client->stats, sizeof(stats));
+    vnc_unlock_output(client);
+
+    for (i = 0; i < VNC_ENC_STAT_MAX; i++) {
+        VncEncodingInfoList *elem;
+
+        if (!stats[i].pixels) {
+            continue;
+        }
+        elem = g_new0(VncEncodingInfoList, 1);
+        elem->value = g_new0(VncEncodingInfo, 1);
+        elem->value->encoding = g_strdup(vnc_enc_stat_names[i]);
+        elem->value->rects = stats[i].rects;
+        elem->value->pixels = stats[i].pixels;
+        elem->value->bytes = stats[i].bytes;
+        elem->value->ns = stats[i].ns;
+        *prev = elem;
+        prev = &elem->next;
+    }
+    return head;
+}
+
+static VncClientInfo *qmp_query_vnc_client(VncState *client)
 {
     struct sockaddr_storage sa;
     socklen_t salen = sizeof(sa);
@@ -337,6 +376,9 @@ static VncClientInfo *qmp_query_vnc_client(const VncState *client)
     }
 #endif
 
+    info->encodings = qmp_query_vnc_encodings(client);
+    info->has_encodings = info->encodings != NULL;
+
     return info;
 }
 
@@ -700,33 +742,49 @@ int vnc_raw_send_framebuffer_update(VncState *vs, int x, int y, int w, int h)
 
 int vnc_send_framebuffer_update(VncState *vs, int x, int y, int w, int h)
 {
-    int n = 0;
+    VncEncodingStats *stats;
+    size_t offset = vs->output.offset;
+    int64_t start = get_clock();
+    int n = 0, enc;
 
     switch(vs->vnc_encoding) {
         case VNC_ENCODING_ZLIB:
             n = vnc_zlib_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_ZLIB;
             break;
         case VNC_ENCODING_HEXTILE:
             vnc_framebuffer_update(vs, x, y, w, h, VNC_ENCODING_HEXTILE);
             n = vnc_hextile_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_HEXTILE;
             break;
         case VNC_ENCODING_TIGHT:
             n = vnc_tight_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_TIGHT;
             break;
         case VNC_ENCODING_TIGHT_PNG:
             n = vnc_tight_png_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_TIGHT_PNG;
             break;
         case VNC_ENCODING_ZRLE:
             n = vnc_zrle_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_ZRLE;
             break;
         case VNC_ENCODING_ZYWRLE:
             n = vnc_zywrle_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_ZYWRLE;
             break;
         default:
             vnc_framebuffer_update(vs, x, y, w, h, VNC_ENCODING_RAW);
             n = vnc_raw_send_framebuffer_update(vs, x, y, w, h);
+            enc = VNC_ENC_STAT_RAW;
             break;
     }
+
+    stats = &vs->stats[enc];
+    stats->rects += MAX(n, 0);
+    stats->pixels += w * h;
+    stats->bytes += vs->output.offset - offset;
+    stats->ns += get_clock() - start;
     return n;
 }
 
@@ -2650,6 +2708,24 @@ static void vnc_rect_updated(VncDisplay *vd, int x, int y, struct timeval * tv)
     rect->updated = true;
 }
 
+/* Compare one dirty block, a vector at a time when the rows allow it */
+static bool vnc_block_equal(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    const VECTYPE *va = (const VECTYPE *)a;
+    const VECTYPE *vb = (const VECTYPE *)b;
+    size_t i;
+
+    if (((uintptr_t)a | (uintptr_t)b | len) % sizeof(VECTYPE)) {
+        return memcmp(a, b, len) == 0;
+    }
+    for (i = 0; i < len / sizeof(VECTYPE); i++) {
+        if (!ALL_EQ(va[i], vb[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static int vnc_refresh_server_surface(VncDisplay *vd)
 {
     int width = pixman_image_get_width(vd->guest.fb);
@@ -2717,7 +2793,7 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
             if (!test_and_clear_bit(x, vd->guest.dirty[y])) {
                 continue;
             }
-            if (memcmp(server_ptr, guest_ptr, cmp_bytes) == 0) {
+            if (vnc_block_equal(server_ptr, guest_ptr, cmp_bytes)) {
                 continue;
             }
             memcpy(server_ptr, guest_ptr, cmp_bytes);
@@ -2928,6 +3004,7 @@ void vnc_display_init(DisplayState *ds)
 
     QTAILQ_INIT(&vs->clients);
     vs->expires = TIME_MAX;
+    vs->workers = 1;
 
     if (keyboard_layout)
         vs->kbd_layout = init_keyboard_layout(name2keysym, keyboard_layout);
@@ -2938,7 +3015,7 @@ void vnc_display_init(DisplayState *ds)
         exit(1);
 
     qemu_mutex_init(&vs->mutex);
-    vnc_start_worker_thread();
+    vnc_start_worker_threads(1);
 
     vs->dcl.ops = &dcl_ops;
     register_displaychangelistener(&vs->dcl);
@@ -3159,6 +3236,16 @@ void vnc_display_open(DisplayState *ds, const char *display, Error **errp)
 #endif
         } else if (strncmp(options, "non-adaptive", 12) == 0) {
             vs->non_adaptive = true;
+        } else if (strncmp(options, "workers=", 8) == 0) {
+            char *end;
+            long workers = strtol(options + 8, &end, 10);
+
+            if (end == options + 8 || (*end && *end != ',') ||
+                workers < 1 || workers > 64) {
+                error_setg(errp, "vnc workers= must be between 1 and 64");
+                goto fail;
+            }
+            vs->workers = workers;
         } else if (strncmp(options, "share=", 6) == 0) {
             if (strncmp(options+6, "ignore", 6) == 0) {
                 vs->share_policy = VNC_SHARE_POLICY_IGNORE;
@@ -3173,6 +3260,8 @@ void vnc_display_open(DisplayState *ds, const char *display, Error **errp)
         }
     }
 
+    vnc_start_worker_threads(vs->workers);
+
     /* adaptive updates are only used with tight encoding and
      * if lossy updates are enabled so we can disable all the
      * calculations otherwise */
@@ -161,6 +161,7 @@ struct VncDisplay
     kbd_layout_t *kbd_layout;
     int lock_key_sync;
     QemuMutex mutex;
+    int encoders;   /* workers reading the server surface, under mutex */
 
     QEMUCursor *cursor;
     int cursor_msize;
@@ -175,6 +176,7 @@ struct VncDisplay
     int auth;
     bool lossy;
     bool non_adaptive;
+    int workers;
 #ifdef CONFIG_VNC_TLS
     int subauth; /* Used by VeNCrypt */
     VncDisplayTLS tls;
@@ -228,6 +230,25 @@ typedef struct VncZywrle {
     int buf[VNC_ZRLE_TILE_WIDTH * VNC_ZRLE_TILE_HEIGHT];
 } VncZywrle;
 
+/* Per-encoding counters, indexes into VncState::stats */
+enum {
+    VNC_ENC_STAT_RAW,
+    VNC_ENC_STAT_HEXTILE,
+    VNC_ENC_STAT_ZLIB,
+    VNC_ENC_STAT_TIGHT,
+    VNC_ENC_STAT_TIGHT_PNG,
+    VNC_ENC_STAT_ZRLE,
+    VNC_ENC_STAT_ZYWRLE,
+    VNC_ENC_STAT_MAX,
+};
+
+typedef struct VncEncodingStats {
+    uint64_t rects;
+    uint64_t pixels;
+    uint64_t bytes;
+    uint64_t ns;
+} VncEncodingStats;
+
 struct VncRect
 {
     int x;
@@ -245,6 +266,9 @@ struct VncRectEntry
 struct VncJob
 {
     VncState *vs;
+    unsigned int batch;     /* jobs split from the same update share it */
+    int encoding;           /* vs->vnc_encoding when the job was pushed */
+    bool busy;              /* a worker is encoding this job */
 
     QLIST_HEAD(, VncRectEntry) rectangles;
     QTAILQ_ENTRY(VncJob) next;
@@ -330,6 +354,9 @@ struct VncState
     VncZrle zrle;
     VncZywrle zywrle;
 
+    /* Accumulated by the workers under output_mutex */
+    VncEncodingStats stats[VNC_ENC_STAT_MAX];
+
     Notifier mouse_mode_notifier;
 
     QTAILQ_ENTRY(VncState) next;
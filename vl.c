@@ -2942,6 +2942,7 @@ int main(int argc, char **argv, char **envp)
     int optind;
     const char *optarg;
     const char *loadvm = NULL;
+    const char *loadvm_file = NULL;
     MachineClass *machine_class;
     QEMUMachine *machine;
     const char *cpu_model;
@@ -3353,6 +3354,10 @@ int main(int argc, char **argv, char **envp)
             case QEMU_OPTION_singlestep:
                 singlestep = 1;
                 break;
+            case QEMU_OPTION_tb_hot:
+                tb_profile_enabled = true;
+                tb_hot_exit_count = atoi(optarg);
+                break;
             case QEMU_OPTION_S:
                 autostart = 0;
                 break;
@@ -3565,6 +3570,9 @@ int main(int argc, char **argv, char **envp)
 	    case QEMU_OPTION_loadvm:
 		loadvm = optarg;
 		break;
+            case QEMU_OPTION_loadvm_file:
+                loadvm_file = optarg;
+                break;
             case QEMU_OPTION_full_screen:
                 full_screen = 1;
                 break;
@@ -4484,6 +4492,11 @@ int main(int argc, char **argv, char **envp)
             autostart = 0;
         }
     }
+    if (loadvm_file) {
+        if (load_vmstate_file(loadvm_file) < 0) {
+            autostart = 0;
+        }
+    }
 
     if (incoming) {
         Error *local_err = NULL;
@@ -4509,6 +4522,7 @@ int main(int argc, char **argv, char **envp)
     main_loop();
     bdrv_close_all();
     pause_all_vcpus();
+    tb_hot_exit();
     res_free();
 #ifdef CONFIG_TPM
     tpm_cleanup();